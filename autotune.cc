@@ -0,0 +1,187 @@
+// Copyright 2024 The Hay Authors
+//
+// Licensed under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#include "autotune.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+// Reads the "key<TAB>threads grain [kernel]" lines of `path` into `entries`,
+// skipping malformed ones.
+void readEntries(const std::string &path,
+                 std::map<std::string, TuneConfig> &entries) {
+  FILE *file = fopen(path.c_str(), "r");
+  if (!file) {
+    return;
+  }
+  char line[1024];
+  while (fgets(line, sizeof line, file)) {
+    char *tab = strchr(line, '\t');
+    if (!tab) {
+      continue;
+    }
+    TuneConfig config;
+    if (sscanf(tab + 1, "%d %d %d", &config.threads, &config.grain,
+               &config.kernel) < 2 ||
+        config.threads < 1 || config.grain < 1 || config.kernel < 0) {
+      continue;
+    }
+    entries[std::string(line, tab)] = config;
+  }
+  fclose(file);
+}
+
+// Creates the parent directories of `path`.
+void makeParentDirs(const std::string &path) {
+  for (size_t i = path.find('/', 1); i != std::string::npos;
+       i = path.find('/', i + 1)) {
+    mkdir(path.substr(0, i).c_str(), 0755);
+  }
+}
+
+} // namespace
+
+std::string hostCpuModel() {
+  std::string model = "unknown";
+  FILE *file = fopen("/proc/cpuinfo", "r");
+  if (!file) {
+    return model;
+  }
+  // x86 has "model name", Arm has "CPU implementer" and "CPU part".
+  std::string implementer, part;
+  char line[1024];
+  while (fgets(line, sizeof line, file)) {
+    char *colon = strchr(line, ':');
+    if (!colon) {
+      continue;
+    }
+    std::string_view name(line, colon);
+    std::string_view value(colon + 1);
+    while (!value.empty() && (value.front() == ' ' || value.front() == '\t')) {
+      value.remove_prefix(1);
+    }
+    while (!value.empty() && value.back() == '\n') {
+      value.remove_suffix(1);
+    }
+    name = name.substr(0, name.find_last_not_of(" \t") + 1);
+    if (name == "model name") {
+      model = value;
+      break;
+    }
+    if (name == "CPU implementer" && implementer.empty()) {
+      implementer = value;
+    } else if (name == "CPU part" && part.empty()) {
+      part = value;
+    }
+  }
+  fclose(file);
+  if (model == "unknown" && !part.empty()) {
+    model = fmt::format("arm {} {}", implementer, part);
+  }
+  // Keys are tab- and '|'-separated.
+  for (char &c : model) {
+    if (c == '\t' || c == '|') {
+      c = ' ';
+    }
+  }
+  return model;
+}
+
+std::string defaultTuneCachePath() {
+  if (const char *path = getenv("HAY_TUNE_CACHE")) {
+    return path;
+  }
+  if (const char *dir = getenv("XDG_CACHE_HOME"); dir && *dir) {
+    return fmt::format("{}/hay/autotune.txt", dir);
+  }
+  if (const char *home = getenv("HOME"); home && *home) {
+    return fmt::format("{}/.cache/hay/autotune.txt", home);
+  }
+  return "";
+}
+
+TuneCache::TuneCache(std::string path) : path(std::move(path)) {
+  if (!this->path.empty()) {
+    readEntries(this->path, entries);
+  }
+}
+
+bool TuneCache::lookup(const std::string &key, TuneConfig *config) const {
+  auto it = entries.find(key);
+  if (it == entries.end()) {
+    return false;
+  }
+  *config = it->second;
+  return true;
+}
+
+void TuneCache::store(const std::string &key, const TuneConfig &config) {
+  entries[key] = config;
+}
+
+bool TuneCache::save() const {
+  if (path.empty()) {
+    return true;
+  }
+  // Keep what other processes saved since we loaded.
+  std::map<std::string, TuneConfig> merged;
+  readEntries(path, merged);
+  for (const auto &[key, config] : entries) {
+    merged[key] = config;
+  }
+  makeParentDirs(path);
+  std::string tmp_path = fmt::format("{}.{}.tmp", path, getpid());
+  FILE *file = fopen(tmp_path.c_str(), "w");
+  if (!file) {
+    fmt::print(stderr, "TuneCache: could not open {}: {}\n", tmp_path,
+               strerror(errno));
+    return false;
+  }
+  for (const auto &[key, config] : merged) {
+    fmt::print(file, "{}\t{} {} {}\n", key, config.threads, config.grain,
+               config.kernel);
+  }
+  fclose(file);
+  if (rename(tmp_path.c_str(), path.c_str()) != 0) {
+    fmt::print(stderr, "TuneCache: could not rename {} to {}: {}\n", tmp_path,
+               path, strerror(errno));
+    remove(tmp_path.c_str());
+    return false;
+  }
+  return true;
+}
+
+std::vector<TuneConfig> tuneCandidates(int max_threads, int kernel_count) {
+  std::vector<int> thread_counts;
+  for (int t = 1; t < max_threads; t *= 2) {
+    thread_counts.push_back(t);
+  }
+  thread_counts.push_back(std::max(max_threads, 1));
+  std::vector<TuneConfig> candidates;
+  for (int kernel = 0; kernel < std::max(kernel_count, 1); ++kernel) {
+    for (int threads : thread_counts) {
+      for (int grain : {1, 8, 64, 512}) {
+        candidates.push_back({threads, grain, kernel});
+      }
+    }
+  }
+  return candidates;
+}
+
+std::vector<TuneConfig> tuneKernelCandidates(int kernel_count) {
+  std::vector<TuneConfig> candidates;
+  for (int kernel = 0; kernel < std::max(kernel_count, 1); ++kernel) {
+    candidates.push_back({1, 1, kernel});
+  }
+  return candidates;
+}
@@ -0,0 +1,134 @@
+// Copyright 2024 The Hay Authors
+//
+// Licensed under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#ifndef HAY_AUTOTUNE_H_
+#define HAY_AUTOTUNE_H_
+
+#include "simd.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <fmt/format.h>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Startup auto-tuning of kernel variants and host launch parameters. The
+// best blocking of a kernel, thread count and work granularity depend on the
+// shape and the machine, so the search driver microbenchmarks the candidates
+// once per shape and host, persists the winners in a cache file, and then
+// dispatches to the winning kernel through its variant table:
+//
+//   TuneCache cache(defaultTuneCachePath());
+//   TuneConfig config = autotune(
+//       cache, tuneKey("enumerate 1x2x2 r4"),
+//       tuneCandidates(hostThreadCount(), M::cost_kernel_count),
+//       [&](const TuneConfig &c) { return secondsToRun(sample, c); });
+//   auto cost = M::cost_kernel(config.kernel);
+//
+// The lane width is fixed at compile time by the SIMD backend, which
+// $HAY_TARGET_CPU selects, so it is part of the key instead of tuned.
+
+struct TuneConfig {
+  // Host threads to run on.
+  int threads = 1;
+  // Work items handed out at a time by parallelFor: more amortizes the
+  // scheduling, fewer balances the load better.
+  int grain = 1;
+  // Index of the kernel variant in the table of the tuned computation, e.g.
+  // MatmulTensor::cost_kernel.
+  int kernel = 0;
+
+  friend bool operator==(const TuneConfig &, const TuneConfig &) = default;
+};
+
+// CPU model name, e.g. from /proc/cpuinfo, or "unknown".
+std::string hostCpuModel();
+
+// Cache key of a shape on this host and SIMD backend.
+inline std::string tuneKey(std::string_view shape) {
+  return fmt::format("{}|{} {}|{}", hostCpuModel(), simd_backend_name,
+                     Uint1xN::elem_count, shape);
+}
+
+// $HAY_TUNE_CACHE if set, else hay/autotune.txt under $XDG_CACHE_HOME or
+// ~/.cache, or "" if none of these is set.
+std::string defaultTuneCachePath();
+
+// Tuned configs by key, loaded from and saved to a text file of
+// "key<TAB>threads grain kernel" lines, kernel 0 if missing. An empty path
+// keeps the cache in memory.
+class TuneCache {
+public:
+  explicit TuneCache(std::string path);
+
+  bool lookup(const std::string &key, TuneConfig *config) const;
+  void store(const std::string &key, const TuneConfig &config);
+  // Merges this cache into the file, replacing it atomically. Returns false,
+  // with a message on stderr, on failure.
+  bool save() const;
+
+private:
+  std::string path;
+  std::map<std::string, TuneConfig> entries;
+};
+
+// Threads in powers of two up to max_threads, and max_threads itself, times
+// a few grains, times kernels 0 to kernel_count - 1.
+std::vector<TuneConfig> tuneCandidates(int max_threads, int kernel_count = 1);
+
+// Kernels 0 to kernel_count - 1 on one thread, for single-threaded work.
+std::vector<TuneConfig> tuneKernelCandidates(int kernel_count);
+
+struct TuneOptions {
+  // Timings per candidate, keeping the fastest.
+  int repetitions = 3;
+  // Benchmarks even when the cache has the key.
+  bool force = false;
+  bool verbose = false;
+};
+
+// Returns the cached config for `key` if it is one of the candidates, or
+// else the candidate for which measure(config), the seconds a fixed sample of
+// work takes, is lowest, which is stored in the cache and saved. Cached
+// configs that are no longer candidates, e.g. naming a kernel that was
+// removed, are stale.
+template <typename Measure>
+TuneConfig autotune(TuneCache &cache, const std::string &key,
+                    const std::vector<TuneConfig> &candidates,
+                    Measure measure, const TuneOptions &options = {}) {
+  TuneConfig best;
+  if (!options.force && cache.lookup(key, &best) &&
+      std::find(candidates.begin(), candidates.end(), best) !=
+          candidates.end()) {
+    return best;
+  }
+  double best_seconds = -1;
+  for (const TuneConfig &config : candidates) {
+    double seconds = -1;
+    for (int i = 0; i < options.repetitions; ++i) {
+      double s = measure(config);
+      if (seconds < 0 || s < seconds) {
+        seconds = s;
+      }
+    }
+    if (options.verbose) {
+      fmt::print(stderr,
+                 "autotune {}: {} threads, grain {}, kernel {}: {:.3g} s\n",
+                 key, config.threads, config.grain, config.kernel, seconds);
+    }
+    if (best_seconds < 0 || seconds < best_seconds) {
+      best_seconds = seconds;
+      best = config;
+    }
+  }
+  cache.store(key, best);
+  cache.save();
+  return best;
+}
+
+#endif // HAY_AUTOTUNE_H_
@@ -0,0 +1,113 @@
+// Copyright 2024 The Hay Authors
+//
+// Licensed under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#include "autotune.h"
+#include "testlib.h"
+
+#include <cstdio>
+
+struct TestTuneCandidates {
+  static void Run() {
+    std::vector<TuneConfig> candidates = tuneCandidates(6);
+    // 1, 2, 4 and 6 threads, 4 grains each.
+    CHECK_EQ(candidates.size(), size_t{16});
+    CHECK(candidates.front() == (TuneConfig{1, 1}));
+    CHECK(candidates.back() == (TuneConfig{6, 512}));
+    CHECK_EQ(tuneCandidates(1).size(), size_t{4});
+    // Times 3 kernels, kernel-major.
+    candidates = tuneCandidates(6, 3);
+    CHECK_EQ(candidates.size(), size_t{48});
+    CHECK(candidates[16] == (TuneConfig{1, 1, 1}));
+    CHECK(candidates.back() == (TuneConfig{6, 512, 2}));
+    candidates = tuneKernelCandidates(3);
+    CHECK_EQ(candidates.size(), size_t{3});
+    CHECK(candidates.back() == (TuneConfig{1, 1, 2}));
+  }
+};
+
+struct TestAutotunePicksFastest {
+  static void Run() {
+    TuneCache cache("");
+    int calls = 0;
+    // Fastest at 4 threads and a grain of 64.
+    auto measure = [&](const TuneConfig &c) {
+      ++calls;
+      return 1.0 + (c.threads - 4) * (c.threads - 4) +
+             (c.grain - 64) * (c.grain - 64) + 0.1 * (calls % 3);
+    };
+    std::vector<TuneConfig> candidates = tuneCandidates(8);
+    std::string key = tuneKey("test");
+    TuneConfig best = autotune(cache, key, candidates, measure);
+    CHECK(best == (TuneConfig{4, 64}));
+    CHECK_EQ(calls, 3 * static_cast<int>(candidates.size()));
+    // Cached now.
+    TuneConfig cached = autotune(cache, key, candidates, measure);
+    CHECK(cached == best);
+    CHECK_EQ(calls, 3 * static_cast<int>(candidates.size()));
+    // A cached config that is no longer a candidate is retuned.
+    cache.store(key, {4, 64, 1});
+    calls = 0;
+    CHECK(autotune(cache, key, candidates, measure) == best);
+    CHECK_EQ(calls, 3 * static_cast<int>(candidates.size()));
+  }
+};
+
+struct TestTuneCacheFile {
+  static void Run() {
+    const char *path = "autotune_test.txt";
+    remove(path);
+    {
+      TuneCache cache(path);
+      TuneConfig config;
+      CHECK(!cache.lookup("a", &config));
+      cache.store("a", {2, 8});
+      CHECK(cache.save());
+    }
+    {
+      // Saving merges with entries saved by others.
+      TuneCache cache(path);
+      cache.store("b", {8, 1, 2});
+      TuneCache other(path);
+      other.store("c", {1, 512});
+      CHECK(other.save());
+      CHECK(cache.save());
+    }
+    TuneCache cache(path);
+    TuneConfig config;
+    CHECK(cache.lookup("a", &config));
+    CHECK(config == (TuneConfig{2, 8}));
+    CHECK(cache.lookup("b", &config));
+    CHECK(config == (TuneConfig{8, 1, 2}));
+    CHECK(cache.lookup("c", &config));
+    CHECK(config == (TuneConfig{1, 512}));
+    // Lines without a kernel, from before kernels were tuned, are kernel 0,
+    // and malformed ones are skipped.
+    FILE *file = fopen(path, "w");
+    fputs("old\t4 64\nbad\t4 64 -1\n", file);
+    fclose(file);
+    TuneCache old(path);
+    CHECK(old.lookup("old", &config));
+    CHECK(config == (TuneConfig{4, 64, 0}));
+    CHECK(!old.lookup("bad", &config));
+    remove(path);
+  }
+};
+
+struct TestTuneKey {
+  static void Run() {
+    std::string key = tuneKey("enumerate 1x2x2 r4");
+    CHECK(key.find(simd_backend_name) != std::string::npos);
+    CHECK(key.ends_with("|enumerate 1x2x2 r4"));
+    CHECK(key.find('\t') == std::string::npos);
+  }
+};
+
+int main() {
+  TEST(TestTuneCandidates);
+  TEST(TestAutotunePicksFastest);
+  TEST(TestTuneCacheFile);
+  TEST(TestTuneKey);
+}
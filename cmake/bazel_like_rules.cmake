@@ -86,4 +86,66 @@ function(cc_test)
     COMMAND
       "$<TARGET_FILE:${_NAME}>"
     )
-endfunction()
\ No newline at end of file
+endfunction()
+
+# cc_binary()
+#
+# CMake function to imitate Bazel's cc_binary rule.
+function(cc_binary)
+  cmake_parse_arguments(
+    _RULE
+    ""
+    "NAME"
+    "SRCS;COPTS;DEPS"
+    ${ARGN}
+  )
+
+  set(_NAME "${_RULE_NAME}")
+
+  add_executable(${_NAME} "")
+  target_sources(${_NAME}
+    PRIVATE
+      ${_RULE_SRCS}
+  )
+  set_target_properties(${_NAME} PROPERTIES OUTPUT_NAME "${_RULE_NAME}")
+  target_compile_options(${_NAME}
+    PRIVATE
+      ${_RULE_COPTS}
+  )
+  target_link_libraries(${_NAME}
+    PUBLIC
+      ${_RULE_DEPS}
+  )
+endfunction()
+
+# cc_benchmark()
+#
+# CMake function for benchmark binaries: a cc_binary, plus a test running it
+# with TEST_ARGS, typically a minimal run time, so that benchmarks keep
+# building and running.
+function(cc_benchmark)
+  cmake_parse_arguments(
+    _RULE
+    ""
+    "NAME"
+    "SRCS;COPTS;DEPS;TEST_ARGS"
+    ${ARGN}
+  )
+
+  cc_binary(
+    NAME
+      ${_RULE_NAME}
+    SRCS
+      ${_RULE_SRCS}
+    COPTS
+      ${_RULE_COPTS}
+    DEPS
+      ${_RULE_DEPS}
+  )
+  add_test(
+    NAME
+      ${_RULE_NAME}
+    COMMAND
+      "$<TARGET_FILE:${_RULE_NAME}>" ${_RULE_TEST_ARGS}
+    )
+endfunction()
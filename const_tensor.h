@@ -0,0 +1,207 @@
+// Copyright 2024 The Hay Authors
+//
+// Licensed under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#ifndef HAY_CONST_TENSOR_H_
+#define HAY_CONST_TENSOR_H_
+
+#include "vector.h"
+
+#include <type_traits>
+#include <utility>
+
+// Tensors of 0/1 constants known at compile time, passed to contract and
+// matmul as template arguments instead of as runtime Vector operands:
+//
+//   static constexpr ConstTensor<{4, 4}> t = ...;
+//   Vector<Uint1xN, {4, 3}> r = matmul(constant<t>, v);
+//
+// A product with a constant 0 vanishes and one with a constant 1 is the
+// other factor, so each result element is a straight-line sum, by add, of the
+// runtime elements that meet the ones of the constant: no mul or madd, no
+// cst but for the all-zero sums, and no add for the first term.
+
+template <Indices sizes> struct ConstTensor {
+  static constexpr auto shape = sizes;
+  static constexpr int order = sizes.size();
+  static constexpr int flatSize = product(sizes);
+  // Row-major, like Vector::elems.
+  bool bits[flatSize > 0 ? flatSize : 1] = {};
+
+  static constexpr int flatten_indices(Indices<order> indices) {
+    int f = 0;
+    for (int i = 0; i < order; ++i) {
+      f = f * sizes[i] + indices[i];
+    }
+    return f;
+  }
+  constexpr bool at(Indices<order> indices) const {
+    return bits[flatten_indices(indices)];
+  }
+  constexpr void set(Indices<order> indices, bool value = true) {
+    bits[flatten_indices(indices)] = value;
+  }
+  // Number of ones.
+  constexpr int weight() const {
+    int w = 0;
+    for (int i = 0; i < flatSize; ++i) {
+      w += bits[i];
+    }
+    return w;
+  }
+
+  friend constexpr bool operator==(const ConstTensor &,
+                                   const ConstTensor &) = default;
+};
+
+// The type of constant<t>, which selects the overloads below.
+template <auto t> struct Constant {};
+template <auto t> inline constexpr Constant<t> constant{};
+
+template <auto t> using ConstTensorOf = std::remove_cvref_t<decltype(t)>;
+
+// The runtime Vector of a constant tensor, e.g. to compare with.
+template <typename EType, auto t>
+Vector<EType, ConstTensorOf<t>::shape> to_vector(Constant<t>) {
+  Vector<EType, ConstTensorOf<t>::shape> v;
+  for (int i = 0; i < ConstTensorOf<t>::flatSize; ++i) {
+    v.elems[i] = EType::cst(t.bits[i]);
+  }
+  return v;
+}
+
+namespace const_tensor_internal {
+
+// For each element of a contraction, the indices of the elements of the
+// runtime operand to add up.
+template <int result_size, int k_size> struct Terms {
+  int count[result_size > 0 ? result_size : 1] = {};
+  int src[result_size > 0 ? result_size : 1][k_size > 0 ? k_size : 1] = {};
+
+  constexpr int add_count() const {
+    int adds = 0;
+    for (int i = 0; i < result_size; ++i) {
+      adds += count[i] > 1 ? count[i] - 1 : 0;
+    }
+    return adds;
+  }
+  constexpr int zero_count() const {
+    int zeros = 0;
+    for (int i = 0; i < result_size; ++i) {
+      zeros += count[i] == 0;
+    }
+    return zeros;
+  }
+};
+
+// The terms of contract<c1, c2>(v1, v2) where v1 is the constant t if
+// const_first, else v2 is. As in the runtime contract, v1 is laid out as
+// [outer1, k, inner1], v2 as [outer2, k, inner2] and the result as
+// [outer1, inner1, outer2, inner2].
+template <auto t, bool const_first, Indices sizes1, Index c1, Indices sizes2,
+          Index c2>
+constexpr auto contraction_terms() {
+  constexpr int k_size = sizes1[c1];
+  constexpr int outer1 = product(sizes1, 0, c1);
+  constexpr int inner1 = product(sizes1, c1 + 1, sizes1.size());
+  constexpr int outer2 = product(sizes2, 0, c2);
+  constexpr int inner2 = product(sizes2, c2 + 1, sizes2.size());
+  Terms<outer1 * inner1 * outer2 * inner2, k_size> terms;
+  int dst = 0;
+  for (int o1 = 0; o1 < outer1; ++o1) {
+    for (int i1 = 0; i1 < inner1; ++i1) {
+      for (int o2 = 0; o2 < outer2; ++o2) {
+        for (int i2 = 0; i2 < inner2; ++i2) {
+          int n = 0;
+          for (int k = 0; k < k_size; ++k) {
+            int src1 = (o1 * k_size + k) * inner1 + i1;
+            int src2 = (o2 * k_size + k) * inner2 + i2;
+            if (t.bits[const_first ? src1 : src2]) {
+              terms.src[dst][n++] = const_first ? src2 : src1;
+            }
+          }
+          terms.count[dst++] = n;
+        }
+      }
+    }
+  }
+  return terms;
+}
+
+// Calls f(std::integral_constant<int, i>()) for i from 0 to n - 1, unrolled.
+template <int n, typename F> void unroll(F f) {
+  [&]<int... i>(std::integer_sequence<int, i...>) {
+    (f(std::integral_constant<int, i>()), ...);
+  }(std::make_integer_sequence<int, n>());
+}
+
+template <auto terms, int result_size, typename EType>
+void sum_terms(const EType *var, EType *result) {
+  unroll<result_size>([&](auto dst_constant) {
+    constexpr int dst = decltype(dst_constant)::value;
+    constexpr int n = terms.count[dst];
+    if constexpr (n == 0) {
+      result[dst] = EType::cst(0);
+    } else {
+      EType sum = var[terms.src[dst][0]];
+      unroll<n - 1>([&](auto j) {
+        sum = add(sum, var[terms.src[dst][decltype(j)::value + 1]]);
+      });
+      result[dst] = sum;
+    }
+  });
+}
+
+} // namespace const_tensor_internal
+
+template <Index c1, Index c2, auto t, typename EType, Indices sizes2>
+Vector<EType, concat(drop(ConstTensorOf<t>::shape, Indices{c1}),
+                     drop(sizes2, Indices{c2}))>
+contract(Constant<t>, Vector<EType, sizes2> v2) {
+  constexpr auto sizes1 = ConstTensorOf<t>::shape;
+  static_assert(sizes1[c1] == sizes2[c2]);
+  using ResultVector = Vector<EType, concat(drop(sizes1, Indices{c1}),
+                                            drop(sizes2, Indices{c2}))>;
+  ResultVector r;
+  const_tensor_internal::sum_terms<
+      const_tensor_internal::contraction_terms<t, true, sizes1, c1, sizes2,
+                                               c2>(),
+      ResultVector::flatSize>(v2.elems, r.elems);
+  return r;
+}
+
+template <Index c1, Index c2, typename EType, Indices sizes1, auto t>
+Vector<EType, concat(drop(sizes1, Indices{c1}),
+                     drop(ConstTensorOf<t>::shape, Indices{c2}))>
+contract(Vector<EType, sizes1> v1, Constant<t>) {
+  constexpr auto sizes2 = ConstTensorOf<t>::shape;
+  static_assert(sizes1[c1] == sizes2[c2]);
+  using ResultVector = Vector<EType, concat(drop(sizes1, Indices{c1}),
+                                            drop(sizes2, Indices{c2}))>;
+  ResultVector r;
+  const_tensor_internal::sum_terms<
+      const_tensor_internal::contraction_terms<t, false, sizes1, c1, sizes2,
+                                               c2>(),
+      ResultVector::flatSize>(v1.elems, r.elems);
+  return r;
+}
+
+template <auto t, typename EType, Indices sizes2>
+Vector<EType, {ConstTensorOf<t>::shape[0], sizes2[1]}>
+matmul(Constant<t> v1, Vector<EType, sizes2> v2) {
+  static_assert(ConstTensorOf<t>::order == 2);
+  static_assert(sizes2.size() == 2);
+  return contract<1, 0>(v1, v2);
+}
+
+template <typename EType, Indices sizes1, auto t>
+Vector<EType, {sizes1[0], ConstTensorOf<t>::shape[1]}>
+matmul(Vector<EType, sizes1> v1, Constant<t> v2) {
+  static_assert(sizes1.size() == 2);
+  static_assert(ConstTensorOf<t>::order == 2);
+  return contract<1, 0>(v1, v2);
+}
+
+#endif // HAY_CONST_TENSOR_H_
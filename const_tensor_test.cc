@@ -0,0 +1,111 @@
+// Copyright 2024 The Hay Authors
+//
+// Licensed under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#include "const_tensor.h"
+#include "matmul_tensor.h"
+#include "op_count.h"
+#include "testlib.h"
+
+#include <cstring>
+#include <random>
+
+// About a third of the bits set, from a fixed linear congruential sequence.
+template <Indices sizes> constexpr ConstTensor<sizes> pseudoRandomTensor() {
+  ConstTensor<sizes> t;
+  uint32_t state = 12345;
+  for (int i = 0; i < t.flatSize; ++i) {
+    state = state * 1103515245u + 12345u;
+    t.bits[i] = (state >> 16) % 3 == 0;
+  }
+  return t;
+}
+
+static constexpr ConstTensor<{3, 4, 5}> t345 = pseudoRandomTensor<{3, 4, 5}>();
+
+static constexpr ConstTensor<{4, 4}> identity4 = [] {
+  ConstTensor<{4, 4}> t;
+  for (int i = 0; i < 4; ++i) {
+    t.set({i, i});
+  }
+  return t;
+}();
+
+struct TestConstTensorContract {
+  static void Run() {
+    std::minstd_rand0 engine;
+    auto t = to_vector<Uint1xN>(constant<t345>);
+    auto y = getRandom<Vector<Uint1xN, {5, 2}>>(engine);
+    CHECK_EQ((contract<2, 0>(constant<t345>, y)), (contract<2, 0>(t, y)));
+    auto x = getRandom<Vector<Uint1xN, {2, 4, 3}>>(engine);
+    CHECK_EQ((contract<1, 1>(x, constant<t345>)), (contract<1, 1>(x, t)));
+    CHECK_EQ((contract<2, 0>(x, constant<t345>)), (contract<2, 0>(x, t)));
+    // Other element types, where the ones are 1.
+    auto ti = to_vector<Int64xN>(constant<t345>);
+    auto yi = getRandom<Vector<Int64xN, {4, 2}>>(engine);
+    CHECK_EQ((contract<1, 0>(constant<t345>, yi)), (contract<1, 0>(ti, yi)));
+  }
+};
+
+struct TestConstTensorMatmul {
+  static void Run() {
+    std::minstd_rand0 engine;
+    using V = Vector<Uint1xN, {4, 4}>;
+    V x = getRandom<V>(engine);
+    CHECK_EQ(matmul(constant<identity4>, x), x);
+    CHECK_EQ(matmul(x, constant<identity4>), x);
+    static constexpr ConstTensor<{4, 4}> zero;
+    CHECK_EQ(matmul(constant<zero>, x), V::cst(0));
+    V i = to_vector<Uint1xN>(constant<identity4>);
+    CHECK_EQ(matmul(constant<identity4>, i), i);
+  }
+};
+
+struct TestConstTensorMatmulTensor {
+  static void Run() {
+    using M = MatmulTensor<2, 2, 2, 7>;
+    static_assert(M::target_tensor.weight() == 8);
+    std::minstd_rand0 engine;
+    auto c = getRandom<Vector<Uint1xN, {M::c_size}>>(engine);
+    CHECK_EQ((contract<2, 0>(constant<M::target_tensor>, c)),
+             (contract<2, 0>(M::target(), c)));
+  }
+};
+
+// The counted ops are exactly the adds of the straight-line sums, and the
+// cst of the empty ones.
+struct TestConstTensorOpCounts {
+  static void Run() {
+    using C = Counted<Uint1xN>;
+    std::minstd_rand0 engine;
+    Vector<C, {5, 2}> y;
+    Vector<C, {2, 4, 3}> x;
+    auto py = getRandom<Vector<Uint1xN, {5, 2}>>(engine);
+    auto px = getRandom<Vector<Uint1xN, {2, 4, 3}>>(engine);
+    memcpy(&y, &py, sizeof y);
+    memcpy(&x, &px, sizeof x);
+    OpCounts counts = count_ops([&] { contract<2, 0>(constant<t345>, y); });
+    constexpr OpCounts expected =
+        const_contract_op_count<2, 0, t345, {5, 2}>();
+    CHECK_EQ(counts, expected);
+    // One add per one of t, less one per nonempty sum, of which there are at
+    // most 3 * 4 * 2.
+    static_assert(expected.mul == 0 && expected.madd == 0);
+    static_assert(expected.add + 3 * 4 * 2 - expected.cst ==
+                  2 * t345.weight());
+    counts = count_ops([&] { contract<1, 1>(x, constant<t345>); });
+    CHECK_EQ(counts, (const_contract_op_count<1, 1, t345, {2, 4, 3}, false>()));
+    Vector<C, {4, 4}> z;
+    memcpy(&z, &px, sizeof z);
+    CHECK_EQ(count_ops([&] { matmul(constant<identity4>, z); }), OpCounts{});
+  }
+};
+
+int main() {
+  TEST(TestConstTensorContract);
+  TEST(TestConstTensorMatmul);
+  TEST(TestConstTensorMatmulTensor);
+  TEST(TestConstTensorOpCounts);
+}
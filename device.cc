@@ -5,12 +5,31 @@
 // SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
 
 #include "device.h"
+#include "launch.h"
 
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <condition_variable>
+#include <cstdint>
 #include <cstring>
+#include <fmt/format.h>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifndef __HIP__
+#include <cerrno>
+#include <deque>
+#include <functional>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 
 #ifdef __HIP__
-#include <fmt/format.h>
 #include <hip/hip_runtime.h>
+#include <map>
 
 void hip_check_impl(hipError_t hip_error_code, const char *condstr,
                     const char *file, int line) {
@@ -24,25 +43,428 @@ void hip_check_impl(hipError_t hip_error_code, const char *condstr,
 #define HIP_CHECK(expr) hip_check_impl(expr, #expr, __FILE__, __LINE__)
 #endif
 
-DevicePtr<void> deviceAllocBytes(ssize_t size) {
-  void *ptr = nullptr;
+// Caching allocator behind deviceAllocBytes. Sizes are rounded up to a power
+// of two, the size class, of at least 64 bytes. Each thread keeps a cache of
+// free blocks per class and exchanges batches of them with a shared pool, so
+// that the common case takes no lock and no system call. Memory only goes back
+// to the system in deviceAllocatorTrim().
+//
+// Classes up to 1 MiB are carved from 2 MiB arenas, larger ones get an
+// allocation of their own. On the CPU backend, allocations are 2 MiB-aligned
+// anonymous mappings, backed by transparent huge pages where available and
+// first touched by the allocating thread, which places them on its NUMA node.
+// The page mapped just below each one records the size class, which
+// deviceDeallocBytes finds by aligning the pointer down, so that blocks span
+// the whole allocation. With HIP, a host-side map records it instead.
+namespace {
+
+constexpr int min_class = 6;
+constexpr int max_small_class = 20;
+constexpr int arena_class = 21;
+constexpr int class_count = 64;
+constexpr ssize_t arena_size = ssize_t{1} << arena_class;
+
+int sizeClass(ssize_t size) {
+  int k = std::bit_width(static_cast<uint64_t>(std::max<ssize_t>(size, 1) - 1));
+  return std::max(k, min_class);
+}
+
 #ifdef __HIP__
-  HIP_CHECK(hipMalloc(&ptr, size));
+
+struct Registry {
+  std::mutex mutex;
+  std::map<uintptr_t, int> size_classes;
+};
+
+Registry &registry() {
+  static Registry *r = new Registry;
+  return *r;
+}
+
+char *systemAlloc(ssize_t bytes, int size_class) {
+  void *ptr = nullptr;
+  HIP_CHECK(hipMalloc(&ptr, bytes));
+  Registry &r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  r.size_classes[reinterpret_cast<uintptr_t>(ptr)] = size_class;
+  return static_cast<char *>(ptr);
+}
+
+void systemFree(char *base, ssize_t) {
+  {
+    Registry &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    r.size_classes.erase(reinterpret_cast<uintptr_t>(base));
+  }
+  HIP_CHECK(hipFree(base));
+}
+
+// The allocation containing ptr, and the size class of its blocks.
+char *allocationOf(void *ptr, int &size_class) {
+  Registry &r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  auto it = r.size_classes.upper_bound(reinterpret_cast<uintptr_t>(ptr));
+  --it;
+  size_class = it->second;
+  return reinterpret_cast<char *>(it->first);
+}
+
 #else
-  ptr = malloc(size);
+
+// The page below each allocation, holding its size class.
+ssize_t headerSize() {
+  static const ssize_t size = sysconf(_SC_PAGESIZE);
+  return size;
+}
+
+int &headerOf(char *base) {
+  return *reinterpret_cast<int *>(base - headerSize());
+}
+
+char *systemAlloc(ssize_t bytes, int size_class) {
+  // Over-map, then unmap the ends to get a 2 MiB-aligned range preceded by
+  // the header page.
+  ssize_t header_size = headerSize();
+  ssize_t mapped = header_size + bytes + arena_size;
+  void *ptr = mmap(nullptr, mapped, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (ptr == MAP_FAILED) {
+    fmt::print(stderr, "deviceAllocBytes: mmap of {} bytes failed: {}\n",
+               mapped, strerror(errno));
+    exit(EXIT_FAILURE);
+  }
+  uintptr_t begin = reinterpret_cast<uintptr_t>(ptr);
+  uintptr_t base = (begin + header_size + arena_size - 1) &
+                   ~uintptr_t(arena_size - 1);
+  if (base - header_size > begin) {
+    munmap(ptr, base - header_size - begin);
+  }
+  if (base + bytes < begin + mapped) {
+    munmap(reinterpret_cast<void *>(base + bytes),
+           begin + mapped - base - bytes);
+  }
+#ifdef MADV_HUGEPAGE
+  madvise(reinterpret_cast<void *>(base), bytes, MADV_HUGEPAGE);
 #endif
-  return {ptr};
+  headerOf(reinterpret_cast<char *>(base)) = size_class;
+  return reinterpret_cast<char *>(base);
+}
+
+void systemFree(char *base, ssize_t bytes) {
+  munmap(base - headerSize(), headerSize() + bytes);
+}
+
+char *allocationOf(void *ptr, int &size_class) {
+  char *base = reinterpret_cast<char *>(reinterpret_cast<uintptr_t>(ptr) &
+                                        ~uintptr_t(arena_size - 1));
+  size_class = headerOf(base);
+  return base;
+}
+
+#endif // __HIP__
+
+// Bytes of the system allocation backing a block of the given class.
+ssize_t allocationBytes(int size_class) {
+  return size_class <= max_small_class ? arena_size
+                                       : ssize_t{1} << size_class;
+}
+
+ssize_t arenaBlockCount(int size_class) { return arena_size >> size_class; }
+
+// Counters are written by their own thread only and read by
+// deviceAllocatorStats(), so they need atomicity but no read-modify-write.
+void bump(std::atomic<int64_t> &counter, int64_t delta) {
+  counter.store(counter.load(std::memory_order_relaxed) + delta,
+                std::memory_order_relaxed);
+}
+
+class ThreadCache;
+
+struct SharedPool {
+  std::mutex mutex[class_count];
+  std::vector<void *> free_blocks[class_count];
+  std::atomic<int64_t> bytes_reserved{0};
+  std::atomic<int64_t> system_allocs{0};
+  // Live thread caches, and the counters of exited ones.
+  std::mutex caches_mutex;
+  std::vector<ThreadCache *> caches;
+  int64_t retired_allocs = 0;
+  int64_t retired_bytes_allocated = 0;
+  int64_t retired_bytes_freed = 0;
+};
+
+// Never destroyed, as thread caches flush into it at thread exit.
+SharedPool &sharedPool() {
+  static SharedPool *p = new SharedPool;
+  return *p;
+}
+
+// Returns a fresh block of the given class, with the class's lock held.
+void *newBlocks(SharedPool &pool, int size_class) {
+  ssize_t bytes = allocationBytes(size_class);
+  char *base = systemAlloc(bytes, size_class);
+  pool.bytes_reserved.fetch_add(bytes, std::memory_order_relaxed);
+  pool.system_allocs.fetch_add(1, std::memory_order_relaxed);
+  if (size_class > max_small_class) {
+    return base;
+  }
+  std::vector<void *> &free_blocks = pool.free_blocks[size_class];
+  ssize_t block_size = ssize_t{1} << size_class;
+  // Pushed in reverse so that blocks are handed out in address order.
+  for (ssize_t i = arenaBlockCount(size_class) - 1; i > 0; --i) {
+    free_blocks.push_back(base + i * block_size);
+  }
+  return base;
+}
+
+class ThreadCache {
+public:
+  ThreadCache() {
+    SharedPool &pool = sharedPool();
+    std::lock_guard<std::mutex> lock(pool.caches_mutex);
+    pool.caches.push_back(this);
+  }
+
+  ~ThreadCache() {
+    flush();
+    SharedPool &pool = sharedPool();
+    std::lock_guard<std::mutex> lock(pool.caches_mutex);
+    pool.caches.erase(std::find(pool.caches.begin(), pool.caches.end(), this));
+    pool.retired_allocs += allocs.load(std::memory_order_relaxed);
+    pool.retired_bytes_allocated +=
+        bytes_allocated.load(std::memory_order_relaxed);
+    pool.retired_bytes_freed += bytes_freed.load(std::memory_order_relaxed);
+  }
+
+  void *alloc(int size_class) {
+    bump(allocs, 1);
+    bump(bytes_allocated, int64_t{1} << size_class);
+    if (size_class > max_small_class) {
+      return takeShared(size_class);
+    }
+    std::vector<void *> &cached = blocks[size_class];
+    if (cached.empty()) {
+      refill(size_class);
+    }
+    void *ptr = cached.back();
+    cached.pop_back();
+    return ptr;
+  }
+
+  void dealloc(void *ptr, int size_class) {
+    bump(bytes_freed, int64_t{1} << size_class);
+    if (size_class > max_small_class) {
+      giveShared(size_class, &ptr, 1);
+      return;
+    }
+    std::vector<void *> &cached = blocks[size_class];
+    cached.push_back(ptr);
+    if (static_cast<int>(cached.size()) > limit(size_class)) {
+      int keep = limit(size_class) / 2;
+      giveShared(size_class, cached.data() + keep, cached.size() - keep);
+      cached.resize(keep);
+    }
+  }
+
+  void flush() {
+    for (int k = min_class; k <= max_small_class; ++k) {
+      giveShared(k, blocks[k].data(), blocks[k].size());
+      blocks[k].clear();
+    }
+  }
+
+  std::atomic<int64_t> allocs{0};
+  std::atomic<int64_t> bytes_allocated{0};
+  std::atomic<int64_t> bytes_freed{0};
+
+private:
+  // At most 512 KiB, and between 4 and 1024 blocks, per class.
+  static int limit(int size_class) {
+    return std::clamp(int{(1 << 19) >> size_class}, 4, 1024);
+  }
+
+  void refill(int size_class) {
+    SharedPool &pool = sharedPool();
+    std::lock_guard<std::mutex> lock(pool.mutex[size_class]);
+    std::vector<void *> &free_blocks = pool.free_blocks[size_class];
+    if (free_blocks.empty()) {
+      blocks[size_class].push_back(newBlocks(pool, size_class));
+    }
+    int count = std::min<int>(limit(size_class) / 2, free_blocks.size());
+    blocks[size_class].insert(blocks[size_class].end(),
+                              free_blocks.end() - count, free_blocks.end());
+    free_blocks.resize(free_blocks.size() - count);
+  }
+
+  static void *takeShared(int size_class) {
+    SharedPool &pool = sharedPool();
+    std::lock_guard<std::mutex> lock(pool.mutex[size_class]);
+    std::vector<void *> &free_blocks = pool.free_blocks[size_class];
+    if (free_blocks.empty()) {
+      return newBlocks(pool, size_class);
+    }
+    void *ptr = free_blocks.back();
+    free_blocks.pop_back();
+    return ptr;
+  }
+
+  static void giveShared(int size_class, void *const *ptrs, ssize_t count) {
+    if (count == 0) {
+      return;
+    }
+    SharedPool &pool = sharedPool();
+    std::lock_guard<std::mutex> lock(pool.mutex[size_class]);
+    pool.free_blocks[size_class].insert(pool.free_blocks[size_class].end(),
+                                        ptrs, ptrs + count);
+  }
+
+  std::vector<void *> blocks[max_small_class + 1];
+};
+
+ThreadCache &threadCache() {
+  thread_local ThreadCache cache;
+  return cache;
+}
+
+} // namespace
+
+DevicePtr<void> deviceAllocBytes(ssize_t size) {
+  return {threadCache().alloc(sizeClass(size))};
 }
 
 void deviceDeallocBytes(DevicePtr<void> ptr) {
+  if (!ptr.val) {
+    return;
+  }
+  int size_class;
+  allocationOf(ptr.val, size_class);
+  threadCache().dealloc(ptr.val, size_class);
+}
+
+DeviceAllocatorStats deviceAllocatorStats() {
+  SharedPool &pool = sharedPool();
+  DeviceAllocatorStats stats;
+  {
+    std::lock_guard<std::mutex> lock(pool.caches_mutex);
+    int64_t allocated = pool.retired_bytes_allocated;
+    int64_t freed = pool.retired_bytes_freed;
+    stats.allocs = pool.retired_allocs;
+    for (ThreadCache *cache : pool.caches) {
+      stats.allocs += cache->allocs.load(std::memory_order_relaxed);
+      allocated += cache->bytes_allocated.load(std::memory_order_relaxed);
+      freed += cache->bytes_freed.load(std::memory_order_relaxed);
+    }
+    stats.bytes_in_use = allocated - freed;
+  }
+  stats.bytes_reserved = pool.bytes_reserved.load(std::memory_order_relaxed);
+  stats.system_allocs = pool.system_allocs.load(std::memory_order_relaxed);
+  return stats;
+}
+
+void deviceAllocatorTrim() {
+  threadCache().flush();
+  SharedPool &pool = sharedPool();
+  for (int k = min_class; k < class_count; ++k) {
+    std::lock_guard<std::mutex> lock(pool.mutex[k]);
+    std::vector<void *> &free_blocks = pool.free_blocks[k];
+    if (free_blocks.empty()) {
+      continue;
+    }
+    ssize_t bytes = allocationBytes(k);
+    if (k > max_small_class) {
+      for (void *ptr : free_blocks) {
+        int size_class;
+        systemFree(allocationOf(ptr, size_class), bytes);
+      }
+      pool.bytes_reserved.fetch_sub(bytes * free_blocks.size(),
+                                    std::memory_order_relaxed);
+      free_blocks.clear();
+      continue;
+    }
+    // Release the arenas all of whose blocks are free. Sorting groups the
+    // blocks of each arena together.
+    std::sort(free_blocks.begin(), free_blocks.end());
+    std::vector<void *> kept;
+    for (size_t i = 0; i < free_blocks.size();) {
+      int size_class;
+      char *base = allocationOf(free_blocks[i], size_class);
+      size_t j = i;
+      while (j < free_blocks.size() &&
+             static_cast<char *>(free_blocks[j]) < base + arena_size) {
+        ++j;
+      }
+      if (static_cast<ssize_t>(j - i) == arenaBlockCount(k)) {
+        systemFree(base, bytes);
+        pool.bytes_reserved.fetch_sub(bytes, std::memory_order_relaxed);
+      } else {
+        kept.insert(kept.end(), free_blocks.begin() + i,
+                    free_blocks.begin() + j);
+      }
+      i = j;
+    }
+    free_blocks = std::move(kept);
+  }
+}
+
+DevicePtr<void> managedAllocBytes(ssize_t size) {
+#ifdef __HIP__
+  void *ptr = nullptr;
+  HIP_CHECK(hipMallocManaged(&ptr, size));
+  return {ptr};
+#else
+  return deviceAllocBytes(size);
+#endif
+}
+
+void managedDeallocBytes(DevicePtr<void> ptr) {
 #ifdef __HIP__
   HIP_CHECK(hipFree(ptr.val));
 #else
-  free(ptr.val);
+  deviceDeallocBytes(ptr);
+#endif
+}
+
+#ifdef __HIP__
+static bool isHostAccessible(const void *ptr) {
+  hipPointerAttribute_t attributes;
+  HIP_CHECK(hipPointerGetAttributes(&attributes, ptr));
+  return attributes.isManaged;
+}
+#endif
+
+void *mapBytes(DevicePtr<void> ptr, ssize_t size) {
+#ifdef __HIP__
+  if (isHostAccessible(ptr.val)) {
+    return ptr.val;
+  }
+  void *host = nullptr;
+  HIP_CHECK(hipHostMalloc(&host, size));
+  HIP_CHECK(hipMemcpy(host, ptr.val, size, hipMemcpyDeviceToHost));
+  return host;
+#else
+  (void)size;
+  return ptr.val;
+#endif
+}
+
+void unmapBytes(DevicePtr<void> ptr, void *host, ssize_t size) {
+#ifdef __HIP__
+  if (host == ptr.val) {
+    return;
+  }
+  HIP_CHECK(hipMemcpy(ptr.val, host, size, hipMemcpyHostToDevice));
+  HIP_CHECK(hipHostFree(host));
+#else
+  (void)ptr;
+  (void)host;
+  (void)size;
 #endif
 }
 
 void copyBytes(DevicePtr<void> dst, const void *src, ssize_t size) {
+  if (dst.val == src) {
+    return;
+  }
 #ifdef __HIP__
   HIP_CHECK(hipMemcpy(dst.val, src, size, hipMemcpyHostToDevice));
 #else
@@ -51,9 +473,455 @@ void copyBytes(DevicePtr<void> dst, const void *src, ssize_t size) {
 }
 
 void copyBytes(void *dst, const DevicePtr<const void> src, ssize_t size) {
+  if (dst == src.val) {
+    return;
+  }
 #ifdef __HIP__
   HIP_CHECK(hipMemcpy(dst, src.val, size, hipMemcpyDeviceToHost));
 #else
   memcpy(dst, src.val, size);
 #endif
 }
+
+#ifdef __HIP__
+
+static hipStream_t hipStream(Stream stream) {
+  return static_cast<hipStream_t>(stream.val);
+}
+
+static hipEvent_t hipEvent(Event event) {
+  return static_cast<hipEvent_t>(event.val);
+}
+
+Stream createStream() {
+  hipStream_t stream;
+  HIP_CHECK(hipStreamCreateWithFlags(&stream, hipStreamNonBlocking));
+  return {stream};
+}
+
+void destroyStream(Stream stream) {
+  synchronize(stream);
+  HIP_CHECK(hipStreamDestroy(hipStream(stream)));
+}
+
+void synchronize(Stream stream) {
+  HIP_CHECK(hipStreamSynchronize(hipStream(stream)));
+}
+
+Event createEvent() {
+  hipEvent_t event;
+  HIP_CHECK(hipEventCreateWithFlags(&event, hipEventDisableTiming));
+  return {event};
+}
+
+void destroyEvent(Event event) { HIP_CHECK(hipEventDestroy(hipEvent(event))); }
+
+void record(Event event, Stream stream) {
+  HIP_CHECK(hipEventRecord(hipEvent(event), hipStream(stream)));
+}
+
+void wait(Stream stream, Event event) {
+  HIP_CHECK(hipStreamWaitEvent(hipStream(stream), hipEvent(event), 0));
+}
+
+void synchronize(Event event) {
+  HIP_CHECK(hipEventSynchronize(hipEvent(event)));
+}
+
+bool query(Event event) {
+  hipError_t status = hipEventQuery(hipEvent(event));
+  if (status == hipErrorNotReady) {
+    return false;
+  }
+  HIP_CHECK(status);
+  return true;
+}
+
+void launchHostFunc(Stream stream, void (*fn)(void *), void *arg) {
+  HIP_CHECK(hipLaunchHostFunc(hipStream(stream), fn, arg));
+}
+
+void copyBytesAsync(DevicePtr<void> dst, const void *src, ssize_t size,
+                    Stream stream) {
+  if (dst.val == src) {
+    return;
+  }
+  HIP_CHECK(hipMemcpyAsync(dst.val, src, size, hipMemcpyHostToDevice,
+                           hipStream(stream)));
+}
+
+void copyBytesAsync(void *dst, const DevicePtr<const void> src, ssize_t size,
+                    Stream stream) {
+  if (dst == src.val) {
+    return;
+  }
+  HIP_CHECK(hipMemcpyAsync(dst, src.val, size, hipMemcpyDeviceToHost,
+                           hipStream(stream)));
+}
+
+void copy2DBytesAsync(DevicePtr<void> dst, ssize_t dst_pitch, const void *src,
+                      ssize_t src_pitch, ssize_t width, ssize_t height,
+                      Stream stream) {
+  HIP_CHECK(hipMemcpy2DAsync(dst.val, dst_pitch, src, src_pitch, width, height,
+                             hipMemcpyHostToDevice, hipStream(stream)));
+}
+
+void copy2DBytesAsync(void *dst, ssize_t dst_pitch,
+                      const DevicePtr<const void> src, ssize_t src_pitch,
+                      ssize_t width, ssize_t height, Stream stream) {
+  HIP_CHECK(hipMemcpy2DAsync(dst, dst_pitch, src.val, src_pitch, width, height,
+                             hipMemcpyDeviceToHost, hipStream(stream)));
+}
+
+void copyBatchAsync(const HostToDeviceCopy *copies, int count, Stream stream) {
+  for (int i = 0; i < count; ++i) {
+    copyBytesAsync(copies[i].dst, copies[i].src, copies[i].size, stream);
+  }
+}
+
+void copyBatchAsync(const DeviceToHostCopy *copies, int count, Stream stream) {
+  for (int i = 0; i < count; ++i) {
+    copyBytesAsync(copies[i].dst, copies[i].src, copies[i].size, stream);
+  }
+}
+
+#else // CPU backend: one worker thread per Stream.
+
+namespace {
+
+struct StreamImpl {
+  std::mutex mutex;
+  std::condition_variable work_available;
+  std::condition_variable work_done;
+  std::deque<std::function<void()>> queue;
+  int64_t enqueued = 0;
+  int64_t completed = 0;
+  bool stopping = false;
+  std::thread worker;
+
+  StreamImpl() : worker([this] { run(); }) {}
+
+  ~StreamImpl() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    work_available.notify_one();
+    worker.join();
+  }
+
+  void enqueue(std::function<void()> op) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      queue.push_back(std::move(op));
+      ++enqueued;
+    }
+    work_available.notify_one();
+  }
+
+  void synchronize() {
+    std::unique_lock<std::mutex> lock(mutex);
+    int64_t target = enqueued;
+    work_done.wait(lock, [&] { return completed >= target; });
+  }
+
+  void run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+      work_available.wait(lock, [&] { return stopping || !queue.empty(); });
+      if (queue.empty()) {
+        return;
+      }
+      std::function<void()> op = std::move(queue.front());
+      queue.pop_front();
+      lock.unlock();
+      op();
+      lock.lock();
+      ++completed;
+      work_done.notify_all();
+    }
+  }
+};
+
+// An Event counts how many times it was recorded and how many of those
+// records were reached by their stream.
+struct EventImpl {
+  std::mutex mutex;
+  std::condition_variable reached_cond;
+  int64_t recorded = 0;
+  int64_t reached = 0;
+
+  void reach(int64_t target) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      reached = std::max(reached, target);
+    }
+    reached_cond.notify_all();
+  }
+
+  void wait_for(int64_t target) {
+    std::unique_lock<std::mutex> lock(mutex);
+    reached_cond.wait(lock, [&] { return reached >= target; });
+  }
+};
+
+StreamImpl *impl(Stream stream) {
+  return static_cast<StreamImpl *>(stream.val);
+}
+
+EventImpl *impl(Event event) { return static_cast<EventImpl *>(event.val); }
+
+} // namespace
+
+Stream createStream() { return {new StreamImpl}; }
+
+void destroyStream(Stream stream) { delete impl(stream); }
+
+void synchronize(Stream stream) { impl(stream)->synchronize(); }
+
+Event createEvent() { return {new EventImpl}; }
+
+void destroyEvent(Event event) { delete impl(event); }
+
+void record(Event event, Stream stream) {
+  EventImpl *e = impl(event);
+  int64_t target;
+  {
+    std::lock_guard<std::mutex> lock(e->mutex);
+    target = ++e->recorded;
+  }
+  impl(stream)->enqueue([e, target] { e->reach(target); });
+}
+
+void wait(Stream stream, Event event) {
+  EventImpl *e = impl(event);
+  int64_t target;
+  {
+    std::lock_guard<std::mutex> lock(e->mutex);
+    target = e->recorded;
+  }
+  impl(stream)->enqueue([e, target] { e->wait_for(target); });
+}
+
+void synchronize(Event event) {
+  EventImpl *e = impl(event);
+  int64_t target;
+  {
+    std::lock_guard<std::mutex> lock(e->mutex);
+    target = e->recorded;
+  }
+  e->wait_for(target);
+}
+
+bool query(Event event) {
+  EventImpl *e = impl(event);
+  std::lock_guard<std::mutex> lock(e->mutex);
+  return e->reached >= e->recorded;
+}
+
+void launchHostFunc(Stream stream, void (*fn)(void *), void *arg) {
+  impl(stream)->enqueue([fn, arg] { fn(arg); });
+}
+
+void copyBytesAsync(DevicePtr<void> dst, const void *src, ssize_t size,
+                    Stream stream) {
+  if (dst.val == src) {
+    return;
+  }
+  impl(stream)->enqueue([=] { memcpy(dst.val, src, size); });
+}
+
+void copyBytesAsync(void *dst, const DevicePtr<const void> src, ssize_t size,
+                    Stream stream) {
+  if (dst == src.val) {
+    return;
+  }
+  impl(stream)->enqueue([=] { memcpy(dst, src.val, size); });
+}
+
+static void copy2DBytes(void *dst, ssize_t dst_pitch, const void *src,
+                        ssize_t src_pitch, ssize_t width, ssize_t height) {
+  for (ssize_t y = 0; y < height; ++y) {
+    memcpy(static_cast<char *>(dst) + y * dst_pitch,
+           static_cast<const char *>(src) + y * src_pitch, width);
+  }
+}
+
+void copy2DBytesAsync(DevicePtr<void> dst, ssize_t dst_pitch, const void *src,
+                      ssize_t src_pitch, ssize_t width, ssize_t height,
+                      Stream stream) {
+  impl(stream)->enqueue([=] {
+    copy2DBytes(dst.val, dst_pitch, src, src_pitch, width, height);
+  });
+}
+
+void copy2DBytesAsync(void *dst, ssize_t dst_pitch,
+                      const DevicePtr<const void> src, ssize_t src_pitch,
+                      ssize_t width, ssize_t height, Stream stream) {
+  impl(stream)->enqueue([=] {
+    copy2DBytes(dst, dst_pitch, src.val, src_pitch, width, height);
+  });
+}
+
+void copyBatchAsync(const HostToDeviceCopy *copies, int count, Stream stream) {
+  std::vector<HostToDeviceCopy> batch(copies, copies + count);
+  impl(stream)->enqueue([batch = std::move(batch)] {
+    for (const HostToDeviceCopy &c : batch) {
+      memcpy(c.dst.val, c.src, c.size);
+    }
+  });
+}
+
+void copyBatchAsync(const DeviceToHostCopy *copies, int count, Stream stream) {
+  std::vector<DeviceToHostCopy> batch(copies, copies + count);
+  impl(stream)->enqueue([batch = std::move(batch)] {
+    for (const DeviceToHostCopy &c : batch) {
+      memcpy(c.dst, c.src.val, c.size);
+    }
+  });
+}
+
+#endif // __HIP__
+
+namespace {
+
+// Runs one parallelFor job at a time over its worker threads plus the
+// calling thread.
+class ThreadPool {
+public:
+  explicit ThreadPool(int count) {
+    for (int i = 1; i < count; ++i) {
+      workers.emplace_back([this] { work(); });
+    }
+  }
+
+  ~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    start_cond.notify_all();
+    for (std::thread &worker : workers) {
+      worker.join();
+    }
+  }
+
+  int size() const { return workers.size() + 1; }
+
+  void run(int64_t count, void (*fn)(void *, int64_t, int64_t), void *ctx,
+           int64_t grain) {
+    std::lock_guard<std::mutex> job_lock(job_mutex);
+    if (grain <= 0) {
+      grain = std::max<int64_t>(1, count / (8 * size()));
+    }
+    Job j{fn, ctx, count, grain, {0}};
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      job = &j;
+      ++generation;
+      active = workers.size();
+    }
+    start_cond.notify_all();
+    // Nested parallelFor calls from this thread run serially too.
+    bool was_in_pool_thread = in_pool_thread;
+    in_pool_thread = true;
+    execute(j);
+    in_pool_thread = was_in_pool_thread;
+    std::unique_lock<std::mutex> lock(mutex);
+    done_cond.wait(lock, [&] { return active == 0; });
+    job = nullptr;
+  }
+
+  static thread_local bool in_pool_thread;
+
+private:
+  struct Job {
+    void (*fn)(void *, int64_t, int64_t);
+    void *ctx;
+    int64_t count;
+    int64_t chunk;
+    std::atomic<int64_t> next;
+  };
+
+  static void execute(Job &j) {
+    int64_t begin;
+    while ((begin = j.next.fetch_add(j.chunk)) < j.count) {
+      j.fn(j.ctx, begin, std::min(begin + j.chunk, j.count));
+    }
+  }
+
+  void work() {
+    in_pool_thread = true;
+    int64_t seen_generation = 0;
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+      start_cond.wait(lock, [&] {
+        return stopping || generation != seen_generation;
+      });
+      if (stopping) {
+        return;
+      }
+      seen_generation = generation;
+      Job *j = job;
+      lock.unlock();
+      execute(*j);
+      lock.lock();
+      if (--active == 0) {
+        done_cond.notify_one();
+      }
+    }
+  }
+
+  std::mutex job_mutex;
+  std::mutex mutex;
+  std::condition_variable start_cond;
+  std::condition_variable done_cond;
+  Job *job = nullptr;
+  int64_t generation = 0;
+  int active = 0;
+  bool stopping = false;
+  std::vector<std::thread> workers;
+};
+
+thread_local bool ThreadPool::in_pool_thread = false;
+
+std::mutex pool_mutex;
+std::unique_ptr<ThreadPool> pool;
+
+int defaultThreadCount() {
+  if (const char *env = getenv("HAY_NUM_THREADS")) {
+    int count = atoi(env);
+    if (count > 0) {
+      return count;
+    }
+  }
+  return std::max(1u, std::thread::hardware_concurrency());
+}
+
+ThreadPool &getPool() {
+  std::lock_guard<std::mutex> lock(pool_mutex);
+  if (!pool) {
+    pool = std::make_unique<ThreadPool>(defaultThreadCount());
+  }
+  return *pool;
+}
+
+} // namespace
+
+int hostThreadCount() { return getPool().size(); }
+
+void setHostThreadCount(int count) {
+  std::lock_guard<std::mutex> lock(pool_mutex);
+  pool.reset();
+  pool = std::make_unique<ThreadPool>(count > 0 ? count
+                                                : defaultThreadCount());
+}
+
+void parallelForImpl(int64_t count, void (*fn)(void *, int64_t, int64_t),
+                     void *ctx, int64_t grain) {
+  if (ThreadPool::in_pool_thread) {
+    fn(ctx, 0, count);
+    return;
+  }
+  getPool().run(count, fn, ctx, grain);
+}
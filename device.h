@@ -7,6 +7,7 @@
 #ifndef HAY_DEVICE_H_
 #define HAY_DEVICE_H_
 
+#include <cstdint>
 #include <cstdlib>
 
 template <typename T> struct DevicePtr { T *val; };
@@ -15,8 +16,30 @@ template <typename U, typename T> DevicePtr<U> cast(DevicePtr<T> ptr) {
   return DevicePtr<U>{static_cast<U *>(ptr.val)};
 }
 
+// Allocations are served by a caching allocator: sizes are rounded up to a
+// power of two of at least 64 bytes, blocks are 64-byte aligned, and freed
+// blocks are kept for reuse, first in a cache of the freeing thread, then in a
+// shared pool. deviceDeallocBytes may be called from any thread.
 DevicePtr<void> deviceAllocBytes(ssize_t size);
 void deviceDeallocBytes(DevicePtr<void> ptr);
+
+struct DeviceAllocatorStats {
+  // Rounded-up sizes of the blocks currently allocated.
+  int64_t bytes_in_use;
+  // Obtained from the system and not yet returned by deviceAllocatorTrim().
+  int64_t bytes_reserved;
+  int64_t allocs;
+  // Allocations that had to go to the system (mmap or hipMalloc).
+  int64_t system_allocs;
+};
+
+DeviceAllocatorStats deviceAllocatorStats();
+
+// Returns cached memory to the system: the blocks cached by the calling thread
+// and the shared pool, excluding arenas that still have blocks in use or in
+// the caches of other threads.
+void deviceAllocatorTrim();
+
 void copyBytes(DevicePtr<void> dst, const void *src, ssize_t size);
 void copyBytes(void *dst, const DevicePtr<const void> src, ssize_t size);
 
@@ -28,6 +51,37 @@ template <typename T> void deviceDealloc(DevicePtr<T> ptr) {
   deviceDeallocBytes(cast<void>(ptr));
 }
 
+// Memory accessible from both the host and the device: hipMallocManaged with
+// HIP. On the CPU backend all device memory is host memory, so this is
+// deviceAllocBytes.
+DevicePtr<void> managedAllocBytes(ssize_t size);
+void managedDeallocBytes(DevicePtr<void> ptr);
+
+template <typename T> DevicePtr<T> managedAlloc(ssize_t size) {
+  return cast<T>(managedAllocBytes(size * sizeof(T)));
+}
+
+template <typename T> void managedDealloc(DevicePtr<T> ptr) {
+  managedDeallocBytes(cast<void>(ptr));
+}
+
+// Host access to `size` bytes of device memory. On the CPU backend and for
+// managed memory, this returns the memory itself without copying. Otherwise,
+// with HIP, the contents are staged in pinned host memory, and unmapBytes
+// copies them back.
+void *mapBytes(DevicePtr<void> ptr, ssize_t size);
+void unmapBytes(DevicePtr<void> ptr, void *host, ssize_t size);
+
+template <typename T> T *map(DevicePtr<T> ptr, ssize_t size) {
+  return static_cast<T *>(mapBytes(cast<void>(ptr), size * sizeof(T)));
+}
+
+template <typename T> void unmap(DevicePtr<T> ptr, T *host, ssize_t size) {
+  unmapBytes(cast<void>(ptr), host, size * sizeof(T));
+}
+
+// Copies are no-ops when the source and destination are the same memory, as
+// after map() on the CPU backend.
 template <typename T> void copy(DevicePtr<T> dst, const T *src, ssize_t size) {
   copyBytes(cast<void>(dst), src, size * sizeof(T));
 }
@@ -41,4 +95,106 @@ template <typename T> void copy(T *dst, const DevicePtr<T> src, ssize_t size) {
   copy(dst, cast<const T>(src), size);
 }
 
+// Asynchronous operations are enqueued on a Stream and execute in submission
+// order, asynchronously with respect to the host. With HIP, a Stream is a
+// hipStream_t. On the CPU backend, each Stream has a worker thread draining
+// its queue, so that the same overlap logic can run on any host.
+struct Stream {
+  void *val;
+};
+
+// Marks a point in a Stream, to synchronize on or to make another Stream wait
+// for. Re-recording an Event moves that point.
+struct Event {
+  void *val;
+};
+
+Stream createStream();
+// Waits for the pending operations to complete first.
+void destroyStream(Stream stream);
+void synchronize(Stream stream);
+
+Event createEvent();
+void destroyEvent(Event event);
+void record(Event event, Stream stream);
+// Makes operations later enqueued on `stream` wait for `event`.
+void wait(Stream stream, Event event);
+void synchronize(Event event);
+// Whether the operations preceding the last record() have completed.
+bool query(Event event);
+
+// Enqueues a call to fn(arg) on the host, ordered with the stream's other
+// operations.
+void launchHostFunc(Stream stream, void (*fn)(void *), void *arg);
+
+void copyBytesAsync(DevicePtr<void> dst, const void *src, ssize_t size,
+                    Stream stream);
+void copyBytesAsync(void *dst, const DevicePtr<const void> src, ssize_t size,
+                    Stream stream);
+
+// Copies `height` rows of `width` bytes, rows being `pitch` bytes apart.
+void copy2DBytesAsync(DevicePtr<void> dst, ssize_t dst_pitch, const void *src,
+                      ssize_t src_pitch, ssize_t width, ssize_t height,
+                      Stream stream);
+void copy2DBytesAsync(void *dst, ssize_t dst_pitch,
+                      const DevicePtr<const void> src, ssize_t src_pitch,
+                      ssize_t width, ssize_t height, Stream stream);
+
+struct HostToDeviceCopy {
+  DevicePtr<void> dst;
+  const void *src;
+  ssize_t size;
+};
+
+struct DeviceToHostCopy {
+  void *dst;
+  DevicePtr<const void> src;
+  ssize_t size;
+};
+
+// Enqueues many copies at once, saving the per-operation enqueue cost.
+void copyBatchAsync(const HostToDeviceCopy *copies, int count, Stream stream);
+void copyBatchAsync(const DeviceToHostCopy *copies, int count, Stream stream);
+
+template <typename T>
+void copyAsync(DevicePtr<T> dst, const T *src, ssize_t size, Stream stream) {
+  copyBytesAsync(cast<void>(dst), src, size * sizeof(T), stream);
+}
+
+template <typename T>
+void copyAsync(T *dst, const DevicePtr<const T> src, ssize_t size,
+               Stream stream) {
+  copyBytesAsync(dst, cast<const void>(src), size * sizeof(T), stream);
+}
+
+template <typename T>
+void copyAsync(T *dst, const DevicePtr<T> src, ssize_t size, Stream stream) {
+  copyAsync(dst, cast<const T>(src), size, stream);
+}
+
+// As copy2DBytesAsync, with pitches and width counted in elements.
+template <typename T>
+void copy2DAsync(DevicePtr<T> dst, ssize_t dst_pitch, const T *src,
+                 ssize_t src_pitch, ssize_t width, ssize_t height,
+                 Stream stream) {
+  copy2DBytesAsync(cast<void>(dst), dst_pitch * sizeof(T), src,
+                   src_pitch * sizeof(T), width * sizeof(T), height, stream);
+}
+
+template <typename T>
+void copy2DAsync(T *dst, ssize_t dst_pitch, const DevicePtr<const T> src,
+                 ssize_t src_pitch, ssize_t width, ssize_t height,
+                 Stream stream) {
+  copy2DBytesAsync(dst, dst_pitch * sizeof(T), cast<const void>(src),
+                   src_pitch * sizeof(T), width * sizeof(T), height, stream);
+}
+
+template <typename T>
+void copy2DAsync(T *dst, ssize_t dst_pitch, const DevicePtr<T> src,
+                 ssize_t src_pitch, ssize_t width, ssize_t height,
+                 Stream stream) {
+  copy2DAsync(dst, dst_pitch, cast<const T>(src), src_pitch, width, height,
+              stream);
+}
+
 #endif // HAY_DEVICE_H_
\ No newline at end of file
@@ -7,6 +7,12 @@
 #include "device.h"
 #include "testlib.h"
 
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <vector>
+
 struct TestDeviceAlloc {
   static void Run() {
     DevicePtr<int> deviceBuf = deviceAlloc<int>(100);
@@ -16,6 +22,112 @@ struct TestDeviceAlloc {
   }
 };
 
+struct TestDeviceAllocSizes {
+  static void Run() {
+    const ssize_t sizes[] = {0,     1,      63,     64,      65,     1000,
+                             4096,  100000, 262144, 262145,  2 << 20,
+                             3 << 20};
+    std::vector<DevicePtr<char>> bufs;
+    for (ssize_t size : sizes) {
+      DevicePtr<char> buf = deviceAlloc<char>(size);
+      CHECK_EQ(reinterpret_cast<uintptr_t>(buf.val) % 64, uintptr_t{0});
+      memset(buf.val, 0x5A, size);
+      bufs.push_back(buf);
+    }
+    for (DevicePtr<char> buf : bufs) {
+      deviceDealloc(buf);
+    }
+  }
+};
+
+struct TestDeviceAllocReuse {
+  static void Run() {
+    DevicePtr<void> a = deviceAllocBytes(1000);
+    deviceDeallocBytes(a);
+    int64_t system_allocs = deviceAllocatorStats().system_allocs;
+    // Same size class, served from the thread cache.
+    DevicePtr<void> b = deviceAllocBytes(600);
+    CHECK_EQ(a.val, b.val);
+    CHECK_EQ(deviceAllocatorStats().system_allocs, system_allocs);
+    deviceDeallocBytes(b);
+  }
+};
+
+struct TestDeviceAllocThreads {
+  static void Run() {
+    const int threads = 4;
+    const int count = 5000;
+    std::vector<std::vector<DevicePtr<int>>> bufs(threads);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+      workers.emplace_back([&, t] {
+        for (int i = 0; i < count; ++i) {
+          DevicePtr<int> buf = deviceAlloc<int>(1 + i % 300);
+          buf.val[0] = t * count + i;
+          bufs[t].push_back(buf);
+        }
+      });
+    }
+    for (std::thread &worker : workers) {
+      worker.join();
+    }
+    // Freed by other threads than those that allocated.
+    workers.clear();
+    for (int t = 0; t < threads; ++t) {
+      workers.emplace_back([&, t] {
+        for (DevicePtr<int> buf : bufs[(t + 1) % threads]) {
+          CHECK_EQ(buf.val[0] / count, (t + 1) % threads);
+          deviceDealloc(buf);
+        }
+      });
+    }
+    for (std::thread &worker : workers) {
+      worker.join();
+    }
+  }
+};
+
+struct TestDeviceAllocArenaClasses {
+  static void Run() {
+    deviceAllocatorTrim();
+    DeviceAllocatorStats before = deviceAllocatorStats();
+    DevicePtr<void> bufs[6];
+    for (int i = 0; i < 6; ++i) {
+      bufs[i] = deviceAllocBytes(i < 4 ? (256 << 10) + 1 : (1 << 20));
+    }
+    DeviceAllocatorStats during = deviceAllocatorStats();
+    // 4 blocks of 512 KiB and 2 of 1 MiB, each class from one 2 MiB arena.
+    CHECK_EQ(during.bytes_in_use - before.bytes_in_use, int64_t{4} << 20);
+    CHECK_EQ(during.system_allocs - before.system_allocs, 2);
+    CHECK_EQ(during.bytes_reserved - before.bytes_reserved, 4 << 20);
+    for (DevicePtr<void> buf : bufs) {
+      deviceDeallocBytes(buf);
+    }
+  }
+};
+
+struct TestDeviceAllocatorStats {
+  static void Run() {
+    DeviceAllocatorStats before = deviceAllocatorStats();
+    DevicePtr<void> small = deviceAllocBytes(100);
+    DevicePtr<void> medium = deviceAllocBytes(2 << 20);
+    DevicePtr<void> large = deviceAllocBytes(5 << 20);
+    DeviceAllocatorStats during = deviceAllocatorStats();
+    CHECK_EQ(during.allocs, before.allocs + 3);
+    // 100 bytes round up to 128, 2 MiB stays 2 MiB and 5 MiB goes to 8 MiB.
+    CHECK_EQ(during.bytes_in_use,
+             before.bytes_in_use + 128 + (2 << 20) + (8 << 20));
+    deviceDeallocBytes(small);
+    deviceDeallocBytes(medium);
+    deviceDeallocBytes(large);
+    CHECK_EQ(deviceAllocatorStats().bytes_in_use, before.bytes_in_use);
+    // The other tests freed everything they allocated, and their threads
+    // exited, flushing their caches.
+    deviceAllocatorTrim();
+    CHECK_EQ(deviceAllocatorStats().bytes_reserved, 0);
+  }
+};
+
 struct TestDeviceCopyHostToDeviceToHost {
   static void Run() {
     int *hostBuf = new int[100];
@@ -33,7 +145,169 @@ struct TestDeviceCopyHostToDeviceToHost {
   }
 };
 
+struct TestDeviceMap {
+  static void Run() {
+    int hostBuf[100];
+    for (int i = 0; i < 100; ++i)
+      hostBuf[i] = i;
+    DevicePtr<int> deviceBuf = deviceAlloc<int>(100);
+    copy(deviceBuf, hostBuf, 100);
+    int *mapped = map(deviceBuf, 100);
+    for (int i = 0; i < 100; ++i) {
+      CHECK_EQ(mapped[i], i);
+      mapped[i] *= 2;
+    }
+    // Copying a mapped buffer onto itself is a no-op.
+    copy(mapped, deviceBuf, 100);
+    copy(deviceBuf, mapped, 100);
+    unmap(deviceBuf, mapped, 100);
+    copy(hostBuf, deviceBuf, 100);
+    for (int i = 0; i < 100; ++i)
+      CHECK_EQ(hostBuf[i], 2 * i);
+    deviceDealloc(deviceBuf);
+  }
+};
+
+struct TestManagedAlloc {
+  static void Run() {
+    DevicePtr<int> managedBuf = managedAlloc<int>(100);
+    int *mapped = map(managedBuf, 100);
+    CHECK(mapped == managedBuf.val);
+    for (int i = 0; i < 100; ++i)
+      mapped[i] = i;
+    unmap(managedBuf, mapped, 100);
+    int hostBuf[100];
+    copy(hostBuf, managedBuf, 100);
+    for (int i = 0; i < 100; ++i)
+      CHECK_EQ(hostBuf[i], i);
+    managedDealloc(managedBuf);
+  }
+};
+
+struct TestDeviceCopyAsync {
+  static void Run() {
+    int hostBuf[100];
+    int hostBuf2[100] = {0};
+    for (int i = 0; i < 100; ++i)
+      hostBuf[i] = i;
+    DevicePtr<int> deviceBuf = deviceAlloc<int>(100);
+    Stream stream = createStream();
+    copyAsync(deviceBuf, hostBuf, 100, stream);
+    copyAsync(hostBuf2, deviceBuf, 100, stream);
+    synchronize(stream);
+    for (int i = 0; i < 100; ++i)
+      CHECK_EQ(hostBuf2[i], i);
+    destroyStream(stream);
+    deviceDealloc(deviceBuf);
+  }
+};
+
+struct TestDeviceCopy2DAsync {
+  static void Run() {
+    // Copy the 3x4 top-left block of a 5x6 matrix into a 3x4 buffer, and
+    // back into the bottom-right block of a 5x6 matrix.
+    int hostBuf[5 * 6];
+    int hostBuf2[5 * 6] = {0};
+    for (int i = 0; i < 5 * 6; ++i)
+      hostBuf[i] = i;
+    DevicePtr<int> deviceBuf = deviceAlloc<int>(3 * 4);
+    Stream stream = createStream();
+    copy2DAsync(deviceBuf, 4, hostBuf, 6, 4, 3, stream);
+    copy2DAsync(hostBuf2 + 2 * 6 + 2, 6, deviceBuf, 4, 4, 3, stream);
+    synchronize(stream);
+    for (int y = 0; y < 5; ++y)
+      for (int x = 0; x < 6; ++x)
+        CHECK_EQ(hostBuf2[y * 6 + x],
+                 (y >= 2 && x >= 2) ? (y - 2) * 6 + (x - 2) : 0);
+    destroyStream(stream);
+    deviceDealloc(deviceBuf);
+  }
+};
+
+struct TestDeviceCopyBatchAsync {
+  static void Run() {
+    int hostBuf[4][10];
+    int hostBuf2[4][10];
+    for (int b = 0; b < 4; ++b)
+      for (int i = 0; i < 10; ++i)
+        hostBuf[b][i] = 10 * b + i;
+    DevicePtr<int> deviceBuf = deviceAlloc<int>(40);
+    HostToDeviceCopy to_device[4];
+    DeviceToHostCopy to_host[4];
+    for (int b = 0; b < 4; ++b) {
+      // Reverse the order of the batches on the device.
+      DevicePtr<int> slot{deviceBuf.val + 10 * (3 - b)};
+      to_device[b] = {cast<void>(slot), hostBuf[b], sizeof hostBuf[b]};
+      to_host[b] = {hostBuf2[b], cast<const void>(slot), sizeof hostBuf2[b]};
+    }
+    Stream stream = createStream();
+    copyBatchAsync(to_device, 4, stream);
+    copyBatchAsync(to_host, 4, stream);
+    synchronize(stream);
+    for (int b = 0; b < 4; ++b) {
+      for (int i = 0; i < 10; ++i) {
+        CHECK_EQ(hostBuf2[b][i], 10 * b + i);
+        CHECK_EQ(deviceBuf.val[10 * (3 - b) + i], 10 * b + i);
+      }
+    }
+    destroyStream(stream);
+    deviceDealloc(deviceBuf);
+  }
+};
+
+struct TestDeviceStreamEvents {
+  // Blocks its stream until the host opens the gate.
+  struct Gate {
+    std::atomic<bool> open{false};
+    static void wait(void *arg) {
+      while (!static_cast<Gate *>(arg)->open.load()) {
+        std::this_thread::yield();
+      }
+    }
+  };
+
+  static void Run() {
+    int hostBuf[100];
+    int hostBuf2[100] = {0};
+    for (int i = 0; i < 100; ++i)
+      hostBuf[i] = i;
+    DevicePtr<int> deviceBuf = deviceAlloc<int>(100);
+    Stream producer = createStream();
+    Stream consumer = createStream();
+    Event uploaded = createEvent();
+    Gate gate;
+    launchHostFunc(producer, Gate::wait, &gate);
+    copyAsync(deviceBuf, hostBuf, 100, producer);
+    record(uploaded, producer);
+    wait(consumer, uploaded);
+    copyAsync(hostBuf2, deviceBuf, 100, consumer);
+    // The host is not blocked by the gated stream.
+    CHECK(!query(uploaded));
+    gate.open = true;
+    synchronize(uploaded);
+    CHECK(query(uploaded));
+    synchronize(consumer);
+    for (int i = 0; i < 100; ++i)
+      CHECK_EQ(hostBuf2[i], i);
+    destroyEvent(uploaded);
+    destroyStream(producer);
+    destroyStream(consumer);
+    deviceDealloc(deviceBuf);
+  }
+};
+
 int main() {
   TEST(TestDeviceAlloc);
   TEST(TestDeviceCopyHostToDeviceToHost);
+  TEST(TestDeviceMap);
+  TEST(TestManagedAlloc);
+  TEST(TestDeviceCopyAsync);
+  TEST(TestDeviceCopy2DAsync);
+  TEST(TestDeviceCopyBatchAsync);
+  TEST(TestDeviceStreamEvents);
+  TEST(TestDeviceAllocSizes);
+  TEST(TestDeviceAllocReuse);
+  TEST(TestDeviceAllocThreads);
+  TEST(TestDeviceAllocArenaClasses);
+  TEST(TestDeviceAllocatorStats);
 }
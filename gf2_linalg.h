@@ -0,0 +1,163 @@
+// Copyright 2024 The Hay Authors
+//
+// Licensed under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#ifndef HAY_GF2_LINALG_H_
+#define HAY_GF2_LINALG_H_
+
+#include "simd.h"
+#include "sliced_int.h"
+#include "vector.h"
+
+#include <bit>
+
+// Linear algebra over GF(2) on a Vector<Uint1xN, {rows, cols}>, i.e. one
+// independent matrix per lane. Lanes pivot on different rows, so instead of
+// swapping rows, Gauss-Jordan elimination tracks per lane which row holds
+// each pivot, as masks. There are no data-dependent branches: the cost is
+// O(rows * cols * (cols + aug_cols)) ops whatever the matrices.
+
+template <Indices sizes, Indices aug_sizes> struct Gf2Elimination {
+  static constexpr int rows = sizes[0];
+  static constexpr int cols = sizes[1];
+  static constexpr int aug_cols = aug_sizes[1];
+
+  // Reduced row echelon form, up to row order: in each lane, column c is
+  // zero but for a 1 in its pivot row, if it has one.
+  Vector<Uint1xN, sizes> a;
+  // The augmented columns, after the same row operations.
+  Vector<Uint1xN, aug_sizes> aug;
+  // Lanes where row r holds the pivot of column c, at [c, r].
+  Vector<Uint1xN, {cols, rows}> pivot;
+  // Lanes where column c has a pivot.
+  Vector<Uint1xN, {cols}> has_pivot;
+  // Lanes where row r holds a pivot.
+  Vector<Uint1xN, {rows}> used;
+};
+
+// Row-reduces a, applying the same row operations to aug, which has as many
+// rows as a.
+template <Indices sizes, Indices aug_sizes>
+Gf2Elimination<sizes, aug_sizes> gf2_eliminate(Vector<Uint1xN, sizes> a,
+                                               Vector<Uint1xN, aug_sizes> aug) {
+  static_assert(sizes.size() == 2 && aug_sizes.size() == 2);
+  static_assert(sizes[0] == aug_sizes[0]);
+  using E = Gf2Elimination<sizes, aug_sizes>;
+  constexpr int rows = E::rows;
+  constexpr int cols = E::cols;
+  constexpr int aug_cols = E::aug_cols;
+  E e;
+  e.a = a;
+  e.aug = aug;
+  e.used = Vector<Uint1xN, {rows}>::cst(0);
+  for (int c = 0; c < cols; ++c) {
+    // The pivot is the first unused row with a 1 in column c.
+    Uint1xN found = Uint1xN::cst(0);
+    for (int r = 0; r < rows; ++r) {
+      Uint1xN p = mul(e.a.elems[r * cols + c],
+                      bit_not(bit_or(e.used.elems[r], found)));
+      e.pivot.elems[c * rows + r] = p;
+      found = add(found, p);
+    }
+    e.has_pivot.elems[c] = found;
+    // The pivot row. Columns before c are zero in it.
+    Uint1xN pivot_a[cols];
+    Uint1xN pivot_aug[aug_cols ? aug_cols : 1];
+    for (int j = c; j < cols; ++j) {
+      pivot_a[j] = Uint1xN::cst(0);
+      for (int r = 0; r < rows; ++r) {
+        pivot_a[j] = madd(pivot_a[j], e.pivot.elems[c * rows + r],
+                          e.a.elems[r * cols + j]);
+      }
+    }
+    for (int j = 0; j < aug_cols; ++j) {
+      pivot_aug[j] = Uint1xN::cst(0);
+      for (int r = 0; r < rows; ++r) {
+        pivot_aug[j] = madd(pivot_aug[j], e.pivot.elems[c * rows + r],
+                            e.aug.elems[r * aug_cols + j]);
+      }
+    }
+    // Clear column c in the other rows. Lanes without a pivot have a zero
+    // pivot row, so are left unchanged.
+    for (int r = 0; r < rows; ++r) {
+      Uint1xN eliminate =
+          mul(e.a.elems[r * cols + c], bit_not(e.pivot.elems[c * rows + r]));
+      for (int j = c; j < cols; ++j) {
+        e.a.elems[r * cols + j] =
+            madd(e.a.elems[r * cols + j], eliminate, pivot_a[j]);
+      }
+      for (int j = 0; j < aug_cols; ++j) {
+        e.aug.elems[r * aug_cols + j] =
+            madd(e.aug.elems[r * aug_cols + j], eliminate, pivot_aug[j]);
+      }
+      e.used.elems[r] = add(e.used.elems[r], e.pivot.elems[c * rows + r]);
+    }
+  }
+  return e;
+}
+
+// Bits of a per-lane rank of a matrix with these sizes.
+template <Indices sizes>
+inline constexpr int gf2_rank_bits =
+    std::bit_width(unsigned(sizes[0] < sizes[1] ? sizes[0] : sizes[1]));
+
+template <Indices sizes>
+UintKxN<gf2_rank_bits<sizes>> gf2_rank(Vector<Uint1xN, sizes> a) {
+  auto e = gf2_eliminate(a, Vector<Uint1xN, {sizes[0], 0}>());
+  return sliced_weight<gf2_rank_bits<sizes>>(e.has_pivot);
+}
+
+// The determinant, i.e. the mask of the lanes where a is invertible.
+template <Indices sizes> Uint1xN gf2_det(Vector<Uint1xN, sizes> a) {
+  static_assert(sizes[0] == sizes[1]);
+  auto e = gf2_eliminate(a, Vector<Uint1xN, {sizes[0], 0}>());
+  Uint1xN det = Uint1xN::cst(1);
+  for (int c = 0; c < sizes[1]; ++c) {
+    det = mul(det, e.has_pivot.elems[c]);
+  }
+  return det;
+}
+
+// Sets `inverse` to the inverse of a in the lanes where a is invertible,
+// which it returns the mask of. Other lanes of `inverse` are unspecified.
+template <Indices sizes>
+Uint1xN gf2_inverse(Vector<Uint1xN, sizes> a,
+                    Vector<Uint1xN, sizes> &inverse) {
+  static_assert(sizes[0] == sizes[1]);
+  constexpr int n = sizes[0];
+  Vector<Uint1xN, sizes> identity;
+  for (int i = 0; i < n * n; ++i) {
+    identity.elems[i] = Uint1xN::cst(i % (n + 1) == 0);
+  }
+  auto e = gf2_eliminate(a, identity);
+  // Row c of the inverse is the pivot row of column c.
+  inverse = matmul(e.pivot, e.aug);
+  Uint1xN det = Uint1xN::cst(1);
+  for (int c = 0; c < n; ++c) {
+    det = mul(det, e.has_pivot.elems[c]);
+  }
+  return det;
+}
+
+// Sets x to a solution of a x = b in the lanes where one exists, which it
+// returns the mask of. Free variables are set to 0. Other lanes of x are
+// unspecified.
+template <Indices sizes>
+Uint1xN gf2_solve(Vector<Uint1xN, sizes> a, Vector<Uint1xN, {sizes[0]}> b,
+                  Vector<Uint1xN, {sizes[1]}> &x) {
+  constexpr int rows = sizes[0];
+  constexpr int cols = sizes[1];
+  auto e = gf2_eliminate(a, reshape<{rows, 1}>(b));
+  x = reshape<{cols}>(matmul(e.pivot, e.aug));
+  // Consistent unless a zero row of the reduced a has a nonzero right-hand
+  // side.
+  Uint1xN solvable = Uint1xN::cst(1);
+  for (int r = 0; r < rows; ++r) {
+    solvable = mul(solvable, bit_or(e.used.elems[r], bit_not(e.aug.elems[r])));
+  }
+  return solvable;
+}
+
+#endif // HAY_GF2_LINALG_H_
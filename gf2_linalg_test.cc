@@ -0,0 +1,132 @@
+// Copyright 2024 The Hay Authors
+//
+// Licensed under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#include "gf2_linalg.h"
+#include "testlib.h"
+
+#include <cstdint>
+#include <utility>
+
+// Scalar reference: rank of the lane-l matrix, plus column `extra` if any.
+template <Indices sizes>
+int scalarRank(const Vector<Uint1xN, sizes> &a, int l, uint64_t extra = 0) {
+  constexpr int rows = sizes[0];
+  constexpr int cols = sizes[1];
+  uint64_t r[rows];
+  for (int i = 0; i < rows; ++i) {
+    r[i] = (extra >> i & 1) << cols;
+    for (int j = 0; j < cols; ++j) {
+      r[i] |= uint64_t{extract(a.elems[i * cols + j], l)} << j;
+    }
+  }
+  int rank = 0;
+  for (int j = 0; j <= cols; ++j) {
+    for (int i = rank; i < rows; ++i) {
+      if (r[i] >> j & 1) {
+        std::swap(r[i], r[rank]);
+        for (int k = 0; k < rows; ++k) {
+          if (k != rank && (r[k] >> j & 1)) {
+            r[k] ^= r[rank];
+          }
+        }
+        ++rank;
+        break;
+      }
+    }
+  }
+  return rank;
+}
+
+// Random matrices of rank at most k in every lane, as products.
+template <Indices sizes, int k>
+Vector<Uint1xN, sizes> lowRank(std::minstd_rand0 &engine) {
+  auto x = getRandom<Vector<Uint1xN, {sizes[0], k}>>(engine);
+  auto y = getRandom<Vector<Uint1xN, {k, sizes[1]}>>(engine);
+  return matmul(x, y);
+}
+
+template <Indices sizes> void checkRank(const Vector<Uint1xN, sizes> &a) {
+  auto rank = gf2_rank(a);
+  for (int l = 0; l < Uint1xN::elem_count; ++l) {
+    CHECK_EQ(extract_uint(rank, l), uint64_t(scalarRank(a, l)));
+  }
+}
+
+struct TestGf2Rank {
+  static void Run() {
+    std::minstd_rand0 engine;
+    checkRank(getRandom<Vector<Uint1xN, {1, 1}>>(engine));
+    checkRank(getRandom<Vector<Uint1xN, {4, 4}>>(engine));
+    checkRank(getRandom<Vector<Uint1xN, {3, 5}>>(engine));
+    checkRank(getRandom<Vector<Uint1xN, {6, 2}>>(engine));
+    checkRank(lowRank<{6, 6}, 3>(engine));
+    checkRank(lowRank<{8, 8}, 6>(engine));
+    checkRank(Vector<Uint1xN, {3, 3}>::cst(0));
+  }
+};
+
+template <Indices sizes> void checkInverse(const Vector<Uint1xN, sizes> &a) {
+  constexpr int n = sizes[0];
+  Vector<Uint1xN, sizes> inverse;
+  Uint1xN invertible = gf2_inverse(a, inverse);
+  CHECK_EQ(invertible, gf2_det(a));
+  Vector<Uint1xN, sizes> product = matmul(a, inverse);
+  for (int l = 0; l < Uint1xN::elem_count; ++l) {
+    CHECK_EQ(extract(invertible, l), uint8_t{scalarRank(a, l) == n});
+    if (!extract(invertible, l)) {
+      continue;
+    }
+    for (int i = 0; i < n * n; ++i) {
+      CHECK_EQ(extract(product.elems[i], l), uint8_t{i % (n + 1) == 0});
+    }
+  }
+}
+
+struct TestGf2Inverse {
+  static void Run() {
+    std::minstd_rand0 engine;
+    checkInverse(getRandom<Vector<Uint1xN, {1, 1}>>(engine));
+    checkInverse(getRandom<Vector<Uint1xN, {2, 2}>>(engine));
+    checkInverse(getRandom<Vector<Uint1xN, {5, 5}>>(engine));
+    checkInverse(lowRank<{4, 4}, 3>(engine));
+  }
+};
+
+template <Indices sizes>
+void checkSolve(const Vector<Uint1xN, sizes> &a,
+                const Vector<Uint1xN, {sizes[0]}> &b) {
+  Vector<Uint1xN, {sizes[1]}> x;
+  Uint1xN solvable = gf2_solve(a, b, x);
+  auto ax = reshape<{sizes[0]}>(matmul(a, reshape<{sizes[1], 1}>(x)));
+  for (int l = 0; l < Uint1xN::elem_count; ++l) {
+    uint64_t bits = extract_uint(b, l);
+    CHECK_EQ(extract(solvable, l),
+             uint8_t{scalarRank(a, l) == scalarRank(a, l, bits)});
+    if (extract(solvable, l)) {
+      CHECK_EQ(extract_uint(ax, l), bits);
+    }
+  }
+}
+
+struct TestGf2Solve {
+  static void Run() {
+    std::minstd_rand0 engine;
+    using B4 = Vector<Uint1xN, {4}>;
+    checkSolve(getRandom<Vector<Uint1xN, {4, 4}>>(engine),
+               getRandom<B4>(engine));
+    checkSolve(lowRank<{4, 4}, 2>(engine), getRandom<B4>(engine));
+    checkSolve(getRandom<Vector<Uint1xN, {4, 6}>>(engine),
+               getRandom<B4>(engine));
+    checkSolve(getRandom<Vector<Uint1xN, {6, 3}>>(engine),
+               getRandom<Vector<Uint1xN, {6}>>(engine));
+  }
+};
+
+int main() {
+  TEST(TestGf2Rank);
+  TEST(TestGf2Inverse);
+  TEST(TestGf2Solve);
+}
@@ -0,0 +1,245 @@
+// Copyright 2024 The Hay Authors
+//
+// Licensed under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#ifndef HAY_GF2K_H_
+#define HAY_GF2K_H_
+
+#include "simd.h"
+#include "sliced_int.h"
+#include "vector.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cassert>
+#include <cstdint>
+#include <fmt/format.h>
+#include <string>
+
+// Bitsliced GF(2^k) = GF(2)[x] / poly, one element per lane of a Uint1xN, as
+// a Vector element type like Uint1xN: planes[b] holds the coefficients of
+// x^b. Addition is k xors. Multiplication is a fixed xor/and network that
+// is generated at compile time for the modulus: a schoolbook product, then
+// whichever of two reduction schemes takes fewer xors for this poly.
+
+namespace gf2k_internal {
+
+constexpr int degree(uint32_t p) { return std::bit_width(p) - 1; }
+
+// Remainder of a by b in GF(2)[x].
+constexpr uint32_t poly_mod(uint32_t a, uint32_t b) {
+  while (a && degree(a) >= degree(b)) {
+    a ^= b << (degree(a) - degree(b));
+  }
+  return a;
+}
+
+// Whether p has no factor of degree 1 to degree(p) / 2.
+constexpr bool irreducible(uint32_t p) {
+  for (uint32_t d = 2; degree(d) <= degree(p) / 2; ++d) {
+    if (poly_mod(p, d) == 0) {
+      return false;
+    }
+  }
+  return degree(p) >= 1;
+}
+
+// The conventional modulus of each degree.
+constexpr uint32_t default_poly(int k) {
+  constexpr uint32_t polys[] = {0,       0b11,     0b111,    0b1011,
+                                0b10011, 0b100101, 0b1000011, 0b10000011,
+                                0x11B};
+  return polys[k];
+}
+
+} // namespace gf2k_internal
+
+template <int k, uint32_t poly = gf2k_internal::default_poly(k)>
+struct Gf2kxN {
+  static_assert(k >= 1 && k <= 8);
+  static_assert(gf2k_internal::degree(poly) == k);
+  static_assert(gf2k_internal::irreducible(poly));
+  static constexpr int elem_bits = k;
+  static constexpr int elem_count = Uint1xN::elem_count;
+  static constexpr int radix = 1 << k;
+  Uint1xN planes[k];
+
+  // Lane l is value(l), which may be called more than once per lane.
+  template <typename F> static Gf2kxN from_lanes(F value) {
+    Gf2kxN result;
+    for (int b = 0; b < k; ++b) {
+      result.planes[b] = lane_mask([&](int l) { return (value(l) >> b) & 1; });
+    }
+    return result;
+  }
+
+  static Gf2kxN cst(uint8_t c) {
+    assert(c < radix);
+    Gf2kxN result;
+    for (int b = 0; b < k; ++b) {
+      result.planes[b] = Uint1xN::cst((c >> b) & 1);
+    }
+    return result;
+  }
+  // Lane l is digit i of l in base 2^k, i.e. bits i*k to i*k + k - 1.
+  static Gf2kxN seq(int i) {
+    Gf2kxN result;
+    for (int b = 0; b < k; ++b) {
+      result.planes[b] = Uint1xN::seq(i * k + b);
+    }
+    return result;
+  }
+  static Gf2kxN load(const void *from) {
+    Gf2kxN result;
+    for (int b = 0; b < k; ++b) {
+      result.planes[b] = Uint1xN::load(static_cast<const uint8_t *>(from) +
+                                       b * sizeof(Uint1xN));
+    }
+    return result;
+  }
+  friend void store(void *to, Gf2kxN x) {
+    for (int b = 0; b < k; ++b) {
+      store(static_cast<uint8_t *>(to) + b * sizeof(Uint1xN), x.planes[b]);
+    }
+  }
+
+  friend Gf2kxN add(Gf2kxN x, Gf2kxN y) {
+    for (int b = 0; b < k; ++b) {
+      x.planes[b] = add(x.planes[b], y.planes[b]);
+    }
+    return x;
+  }
+  friend Gf2kxN sub(Gf2kxN x, Gf2kxN y) { return add(x, y); }
+  friend Gf2kxN mul(Gf2kxN x, Gf2kxN y) { return multiply<false>({}, x, y); }
+  // Accumulates the product into x's planes directly, saving k xors.
+  friend Gf2kxN madd(Gf2kxN x, Gf2kxN y, Gf2kxN z) {
+    return multiply<true>(x, y, z);
+  }
+
+  // Number of nonzero lanes.
+  friend Int64xN popcount(Gf2kxN x) {
+    Uint1xN nonzero = x.planes[0];
+    for (int b = 1; b < k; ++b) {
+      nonzero = bit_or(nonzero, x.planes[b]);
+    }
+    return popcount(nonzero);
+  }
+  friend uint8_t reduce_add(Gf2kxN x) {
+    uint8_t sum = 0;
+    for (int b = 0; b < k; ++b) {
+      sum |= (reduce_add(popcount(x.planes[b])) & 1) << b;
+    }
+    return sum;
+  }
+  friend uint8_t extract(Gf2kxN x, int i) {
+    uint8_t value = 0;
+    for (int b = 0; b < k; ++b) {
+      value |= extract(x.planes[b], i) << b;
+    }
+    return value;
+  }
+  friend bool operator==(Gf2kxN x, Gf2kxN y) {
+    for (int b = 0; b < k; ++b) {
+      if (!(x.planes[b] == y.planes[b])) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // x^m mod poly for each degree m of a product, as bit masks.
+  static constexpr std::array<uint32_t, 2 * k - 1> reductions = [] {
+    std::array<uint32_t, 2 * k - 1> r;
+    for (int m = 0; m < 2 * k - 1; ++m) {
+      r[m] = gf2k_internal::poly_mod(uint32_t{1} << m, poly);
+    }
+    return r;
+  }();
+  // Reducing all high coefficients at once, as linear combinations of the
+  // low ones, takes the weights of their reductions in xors...
+  static constexpr int direct_reduction_ops = [] {
+    int ops = 0;
+    for (int m = k; m < 2 * k - 1; ++m) {
+      ops += std::popcount(reductions[m]);
+    }
+    return ops;
+  }();
+  // ...while folding them one at a time from the top takes the weight of
+  // poly, less its leading term, per high coefficient.
+  static constexpr int folding_reduction_ops =
+      (k - 1) * (std::popcount(poly) - 1);
+  // Ops of mul: ands, fused into xors with madd, then reduction xors.
+  static constexpr int mul_op_count =
+      k * k + std::min(direct_reduction_ops, folding_reduction_ops);
+
+private:
+  template <bool accumulate>
+  static Gf2kxN multiply(Gf2kxN acc, Gf2kxN x, Gf2kxN y) {
+    Uint1xN c[2 * k - 1];
+    for (int m = 0; m < 2 * k - 1; ++m) {
+      int lo = std::max(0, m - k + 1);
+      int hi = std::min(m, k - 1);
+      if (accumulate && m < k) {
+        c[m] = madd(acc.planes[m], x.planes[lo], y.planes[m - lo]);
+      } else {
+        c[m] = mul(x.planes[lo], y.planes[m - lo]);
+      }
+      for (int i = lo + 1; i <= hi; ++i) {
+        c[m] = madd(c[m], x.planes[i], y.planes[m - i]);
+      }
+    }
+    Gf2kxN result;
+    if constexpr (folding_reduction_ops < direct_reduction_ops) {
+      for (int m = 2 * k - 2; m >= k; --m) {
+        for (int b = 0; b < k; ++b) {
+          if ((poly >> b) & 1) {
+            c[m - k + b] = add(c[m - k + b], c[m]);
+          }
+        }
+      }
+      for (int b = 0; b < k; ++b) {
+        result.planes[b] = c[b];
+      }
+    } else {
+      for (int b = 0; b < k; ++b) {
+        result.planes[b] = c[b];
+        for (int m = k; m < 2 * k - 1; ++m) {
+          if ((reductions[m] >> b) & 1) {
+            result.planes[b] = add(result.planes[b], c[m]);
+          }
+        }
+      }
+    }
+    return result;
+  }
+};
+
+using Gf4xN = Gf2kxN<2>;
+using Gf8xN = Gf2kxN<3>;
+using Gf16xN = Gf2kxN<4>;
+
+template <int k, uint32_t poly> struct ScalarTypeImpl<Gf2kxN<k, poly>> {
+  using Type = uint8_t;
+};
+
+template <int k, uint32_t poly> struct Int64EType<Gf2kxN<k, poly>> {
+  using Type = Int64xN;
+};
+
+// Formats the lanes as hexadecimal digits, lane 0 first.
+template <int k, uint32_t poly> struct fmt::formatter<Gf2kxN<k, poly>> {
+  template <typename FormatContext>
+  auto format(const Gf2kxN<k, poly> &x, FormatContext &ctx) const {
+    std::string digits;
+    for (int l = 0; l < Gf2kxN<k, poly>::elem_count; ++l) {
+      digits += fmt::format("{:0{}x}", extract(x, l), (k + 3) / 4);
+    }
+    return fmt::format_to(ctx.out(), "{{{}}}", digits);
+  }
+  constexpr auto parse(fmt::format_parse_context &ctx) { return ctx.begin(); }
+};
+
+#endif // HAY_GF2K_H_
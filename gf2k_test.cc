@@ -0,0 +1,137 @@
+// Copyright 2024 The Hay Authors
+//
+// Licensed under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#include "gf2k.h"
+#include "testlib.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+template <int k, uint32_t poly> struct GetRandomImpl<Gf2kxN<k, poly>> {
+  static Gf2kxN<k, poly> Run(std::minstd_rand0 &engine) {
+    Gf2kxN<k, poly> result;
+    for (int b = 0; b < k; ++b) {
+      result.planes[b] = getRandom<Uint1xN>(engine);
+    }
+    return result;
+  }
+};
+
+// Scalar reference: carry-less product reduced modulo poly.
+uint32_t scalarMul(uint32_t a, uint32_t b, uint32_t poly) {
+  uint32_t product = 0;
+  for (int i = 0; i < 16; ++i) {
+    if ((b >> i) & 1) {
+      product ^= a << i;
+    }
+  }
+  return gf2k_internal::poly_mod(product, poly);
+}
+
+template <typename E, uint32_t poly> void checkArithmetic() {
+  std::minstd_rand0 engine;
+  for (int iter = 0; iter < 10; ++iter) {
+    E x = getRandom<E>(engine);
+    E y = getRandom<E>(engine);
+    E z = getRandom<E>(engine);
+    E sum = add(x, y);
+    E product = mul(x, y);
+    E fused = madd(x, y, z);
+    uint32_t total = 0;
+    for (int l = 0; l < E::elem_count; ++l) {
+      uint32_t a = extract(x, l);
+      uint32_t b = extract(y, l);
+      uint32_t c = extract(z, l);
+      CHECK_EQ(extract(sum, l), uint8_t(a ^ b));
+      CHECK_EQ(extract(product, l), uint8_t(scalarMul(a, b, poly)));
+      CHECK_EQ(extract(fused, l), uint8_t(a ^ scalarMul(b, c, poly)));
+      total ^= a;
+    }
+    CHECK_EQ(reduce_add(x), uint8_t(total));
+    CHECK(mul(x, E::cst(1)) == x);
+    CHECK(sub(sum, y) == x);
+  }
+}
+
+struct TestGf2kArithmetic {
+  static void Run() {
+    checkArithmetic<Gf2kxN<1>, 0b11>();
+    checkArithmetic<Gf4xN, 0b111>();
+    checkArithmetic<Gf8xN, 0b1011>();
+    checkArithmetic<Gf16xN, 0b10011>();
+    checkArithmetic<Gf2kxN<4, 0b11001>, 0b11001>();
+    checkArithmetic<Gf2kxN<8>, 0x11B>();
+  }
+};
+
+struct TestGf2kOpCounts {
+  static void Run() {
+    // x^4 + x + 1: 16 ands, then 3 high coefficients to fold into 2 each.
+    CHECK_EQ(Gf16xN::mul_op_count, 16 + 6);
+    CHECK_EQ(Gf4xN::mul_op_count, 4 + 2);
+    // The AES modulus has weight 5, so folding takes 7 * 4 xors.
+    CHECK_EQ(Gf2kxN<8>::folding_reduction_ops, 28);
+    CHECK(Gf2kxN<8>::mul_op_count <= 64 + 28);
+    static_assert(gf2k_internal::irreducible(0x11B));
+    static_assert(!gf2k_internal::irreducible(0b10101));
+  }
+};
+
+// Vector::seq enumerates each vector of GF(4)^4 exactly once over the lanes
+// below 4^seq_lane_digits, and matmul agrees with a scalar reference.
+struct TestGf2kVector {
+  static void Run() {
+    using V = Vector<Gf4xN, {2, 2}>;
+    int lanes = std::min(Gf4xN::elem_count, 256);
+    std::vector<int> seen(256);
+    for (int i = 0; i < 256 / lanes; ++i) {
+      V x = V::seq(i);
+      for (int l = 0; l < lanes; ++l) {
+        int value = 0;
+        for (int j = V::flatSize - 1; j >= 0; --j) {
+          value = value * 4 + extract(x.elems[j], l);
+        }
+        ++seen[value];
+      }
+    }
+    for (int count : seen) {
+      CHECK_EQ(count, 1);
+    }
+
+    std::minstd_rand0 engine;
+    auto a = getRandom<Vector<Gf16xN, {2, 3}>>(engine);
+    auto b = getRandom<Vector<Gf16xN, {3, 2}>>(engine);
+    auto c = matmul(a, b);
+    for (int l = 0; l < Gf16xN::elem_count; ++l) {
+      for (int i = 0; i < 2; ++i) {
+        for (int j = 0; j < 2; ++j) {
+          uint32_t expected = 0;
+          for (int t = 0; t < 3; ++t) {
+            expected ^= scalarMul(extract(a.elems[i * 3 + t], l),
+                                  extract(b.elems[t * 2 + j], l), 0b10011);
+          }
+          CHECK_EQ(extract(c.elems[i * 2 + j], l), uint8_t(expected));
+        }
+      }
+    }
+  }
+};
+
+struct TestGf2kFormat {
+  static void Run() {
+    std::string s = fmt::format("{}", Gf16xN::cst(0xA));
+    CHECK_EQ(s, "{" + std::string(Gf16xN::elem_count, 'a') + "}");
+    CHECK(fmt::format("{}", Gf2kxN<8>::cst(0x1F)).starts_with("{1f1f"));
+  }
+};
+
+int main() {
+  TEST(TestGf2kArithmetic);
+  TEST(TestGf2kOpCounts);
+  TEST(TestGf2kVector);
+  TEST(TestGf2kFormat);
+}
@@ -0,0 +1,85 @@
+// Copyright 2024 The Hay Authors
+//
+// Licensed under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#include "hash_index.h"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <fmt/format.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+static void fatal_errno(const char *what, const char *path) {
+  fmt::print(stderr, "HashIndex: {} failed for \"{}\": {}\n", what,
+             path ? path : "(anonymous)", strerror(errno));
+  exit(EXIT_FAILURE);
+}
+
+HashIndex::HashIndex(int64_t capacity, const char *spill_path) {
+  // Keep the load factor at most 3/4.
+  int64_t min_buckets = (capacity * 4 / 3 + slots - 1) / slots;
+  int64_t bucket_count =
+      std::bit_ceil(static_cast<uint64_t>(std::max<int64_t>(min_buckets, 2)));
+  bucket_mask = bucket_count - 1;
+  hash_shift = 64 - std::countr_zero(static_cast<uint64_t>(bucket_count));
+  mapped_bytes = bucket_count * sizeof(Bucket);
+  int flags = MAP_SHARED;
+  if (spill_path) {
+    fd = open(spill_path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+      fatal_errno("open", spill_path);
+    }
+    if (ftruncate(fd, mapped_bytes) != 0) {
+      fatal_errno("ftruncate", spill_path);
+    }
+  } else {
+    flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE;
+  }
+  void *ptr =
+      mmap(nullptr, mapped_bytes, PROT_READ | PROT_WRITE, flags, fd, 0);
+  if (ptr == MAP_FAILED) {
+    fatal_errno("mmap", spill_path);
+  }
+#ifdef MADV_HUGEPAGE
+  if (!spill_path) {
+    madvise(ptr, mapped_bytes, MADV_HUGEPAGE);
+  }
+#endif
+  // Fresh pages, of either mapping, are zeros: all slots are empty.
+  buckets = static_cast<Bucket *>(ptr);
+}
+
+HashIndex::~HashIndex() {
+  munmap(buckets, mapped_bytes);
+  if (fd >= 0) {
+    close(fd);
+  }
+}
+
+void HashIndex::insert(uint64_t key, uint64_t value) {
+  assert(key != empty_key);
+  // Lookups stop at the first empty slot, so never fill the last one.
+  if (count + 1 == (bucket_mask + 1) * slots) {
+    fmt::print(stderr, "HashIndex: capacity of {} entries exceeded\n", count);
+    exit(EXIT_FAILURE);
+  }
+  for (int64_t b = home(key);; b = (b + 1) & bucket_mask) {
+    Bucket &bucket = buckets[b];
+    for (int s = 0; s < slots; ++s) {
+      if (bucket.keys[s] == 0) {
+        bucket.keys[s] = key + 1;
+        bucket.values[s] = value;
+        ++count;
+        return;
+      }
+    }
+  }
+}
@@ -0,0 +1,75 @@
+// Copyright 2024 The Hay Authors
+//
+// Licensed under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#ifndef HAY_HASH_INDEX_H_
+#define HAY_HASH_INDEX_H_
+
+#include <cstddef>
+#include <cstdint>
+
+// Open-addressing multimap from keys to values, both uint64_t. Buckets are one
+// cache line each, holding 4 keys followed by their 4 values, and are probed
+// linearly so that a lookup usually touches a single cache line.
+//
+// The table is mmap'ed: anonymously by default, or backed by the file at
+// `spill_path` when that is not null, so that it can exceed RAM. Slots hold
+// key + 1, so that the zero pages of a fresh mapping are empty slots and only
+// the pages that inserts touch are ever committed or written back.
+class HashIndex {
+public:
+  // The all-ones key is reserved: stored as key + 1, it would read as empty.
+  static constexpr uint64_t empty_key = ~uint64_t{0};
+
+  explicit HashIndex(int64_t capacity, const char *spill_path = nullptr);
+  ~HashIndex();
+  HashIndex(const HashIndex &) = delete;
+  HashIndex &operator=(const HashIndex &) = delete;
+
+  void insert(uint64_t key, uint64_t value);
+
+  // Calls f(value) for each value inserted with `key`.
+  template <typename F> void find(uint64_t key, F f) const {
+    uint64_t stored = key + 1;
+    for (int64_t b = home(key);; b = (b + 1) & bucket_mask) {
+      const Bucket &bucket = buckets[b];
+      for (int s = 0; s < slots; ++s) {
+        if (bucket.keys[s] == stored) {
+          f(bucket.values[s]);
+        } else if (bucket.keys[s] == 0) {
+          return;
+        }
+      }
+    }
+  }
+
+  void prefetch(uint64_t key) const {
+    __builtin_prefetch(&buckets[home(key)]);
+  }
+
+  int64_t size() const { return count; }
+
+private:
+  static constexpr int slots = 4;
+  struct alignas(64) Bucket {
+    // key + 1 of each slot, 0 if empty.
+    uint64_t keys[slots];
+    uint64_t values[slots];
+  };
+
+  int64_t home(uint64_t key) const {
+    // Fibonacci hashing: the high bits of the product are well mixed.
+    return (key * 0x9E3779B97F4A7C15u) >> hash_shift;
+  }
+
+  Bucket *buckets = nullptr;
+  int64_t bucket_mask = 0;
+  int hash_shift = 64;
+  int64_t count = 0;
+  size_t mapped_bytes = 0;
+  int fd = -1;
+};
+
+#endif // HAY_HASH_INDEX_H_
@@ -0,0 +1,75 @@
+// Copyright 2024 The Hay Authors
+//
+// Licensed under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#include "hash_index.h"
+#include "testlib.h"
+
+#include <cstdlib>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static void checkMultimap(HashIndex &index, int n) {
+  // Key k gets the values k, k + n, k + 2n, ..., k % 7 + 1 of them.
+  for (int k = 0; k < n; ++k) {
+    for (int v = 0; v <= k % 7; ++v) {
+      index.insert(uint64_t(k) * 0x10001, k + v * n);
+    }
+  }
+  for (int k = 0; k < n; ++k) {
+    uint64_t seen = 0;
+    index.find(uint64_t(k) * 0x10001, [&](uint64_t value) {
+      CHECK_EQ(value % n, uint64_t(k));
+      seen |= uint64_t{1} << (value / n);
+    });
+    CHECK_EQ(seen, (uint64_t{2} << (k % 7)) - 1);
+  }
+  int found = 0;
+  index.find(uint64_t(n) * 0x10001, [&](uint64_t) { ++found; });
+  CHECK_EQ(found, 0);
+}
+
+struct TestHashIndexAnonymous {
+  static void Run() {
+    const int n = 10000;
+    HashIndex index(4 * n);
+    checkMultimap(index, n);
+    int64_t expected_size = 0;
+    for (int k = 0; k < n; ++k) {
+      expected_size += k % 7 + 1;
+    }
+    CHECK_EQ(index.size(), expected_size);
+  }
+};
+
+struct TestHashIndexSpilled {
+  static void Run() {
+    char path[] = "/tmp/hash_index_test_XXXXXX";
+    int fd = mkstemp(path);
+    CHECK(fd >= 0);
+    close(fd);
+    {
+      HashIndex index(4000, path);
+      checkMultimap(index, 1000);
+    }
+    {
+      // 64MiB of buckets, of which a few inserts dirty a few pages only.
+      HashIndex index(int64_t{3} << 20, path);
+      for (uint64_t k = 0; k < 16; ++k) {
+        index.insert(k, k);
+      }
+    }
+    struct stat st;
+    CHECK_EQ(stat(path, &st), 0);
+    CHECK(st.st_size >= int64_t{64} << 20);
+    CHECK(int64_t{st.st_blocks} * 512 < int64_t{1} << 20);
+    unlink(path);
+  }
+};
+
+int main() {
+  TEST(TestHashIndexAnonymous);
+  TEST(TestHashIndexSpilled);
+}
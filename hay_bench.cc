@@ -0,0 +1,517 @@
+// Copyright 2024 The Hay Authors
+//
+// Licensed under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+// Benchmarks the SIMD primitives of simd.h and the Vector ops of vector.h,
+// on the backend selected at compile time.
+//
+//   hay_bench [--filter=SUBSTRING] [--min-time=SECONDS] [--out=FILE]
+//       Runs the benchmarks and writes the results as JSON, by default to
+//       stdout.
+//   hay_bench --compare OLD.json NEW.json [--threshold=FRACTION]
+//       Compares two runs and fails if any benchmark slowed down by more than
+//       the threshold, 5% by default.
+//
+// An op is one EType primitive, e.g. one Uint1xN madd or, for data movement
+// such as transpose, one EType moved. lanes/s counts the lanes ops process.
+
+#include "lut.h"
+#include "simd.h"
+#include "truth_table.h"
+#include "vector.h"
+
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fmt/format.h>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+// Makes the compiler assume that all memory was read and written, so that
+// benchmarked computations are neither hoisted out of loops nor removed.
+inline void clobber(const void *p) { asm volatile("" : : "r"(p) : "memory"); }
+
+static constexpr uint64_t nextRandom(uint64_t &state) {
+  state = state * 6364136223846793005u + 1442695040888963407u;
+  return state >> 32;
+}
+
+template <typename T> void randomize(T &x, uint64_t &state) {
+  if constexpr (std::is_integral_v<T>) {
+    x = nextRandom(state) & 0xFFFF;
+  } else {
+    uint8_t bytes[sizeof(T)];
+    for (uint8_t &byte : bytes) {
+      byte = nextRandom(state);
+    }
+    x = T::load(bytes);
+  }
+}
+
+struct Benchmark {
+  std::string name;
+  // Ops, and lanes per op, of one call of run().
+  int64_t ops;
+  int lanes;
+  void (*run)(int64_t calls);
+};
+
+// Each call applies Op to `n` independent sets of random operands. Operands
+// are static as some Vectors are too large for the stack.
+template <int n, typename Op, typename... Args> void runOp(int64_t calls) {
+  using Result = std::invoke_result_t<Op, Args...>;
+  static std::tuple<Args...> args[n];
+  static Result results[n];
+  uint64_t state = 1;
+  for (auto &a : args) {
+    std::apply([&](auto &...x) { (randomize(x, state), ...); }, a);
+  }
+  Op op;
+  for (int64_t c = 0; c < calls; ++c) {
+    for (int i = 0; i < n; ++i) {
+      results[i] = std::apply(op, args[i]);
+    }
+    clobber(results);
+  }
+}
+
+// `ops` and `lanes` are per call of op.
+template <int n, typename... Args, typename Op>
+Benchmark makeBenchmark(std::string name, int64_t ops, int lanes, Op) {
+  return {std::move(name), n * ops, lanes, runOp<n, Op, Args...>};
+}
+
+template <int order> std::string shapeName(Indices<order> sizes) {
+  std::string name;
+  for (int i = 0; i < order; ++i) {
+    name += fmt::format("{}{}", i ? "x" : "", sizes[i]);
+  }
+  return name;
+}
+
+static void addPrimitiveBenchmarks(std::vector<Benchmark> &list) {
+  using U = Uint1xN;
+  using I = Int64xN;
+  constexpr int lu = U::elem_count;
+  constexpr int li = I::elem_count;
+  // Enough independent ops to fill the pipelines.
+  constexpr int n = 16;
+  list.push_back(makeBenchmark<n, U, U>("uint1/add", 1, lu,
+                                        [](U x, U y) { return add(x, y); }));
+  list.push_back(makeBenchmark<n, U, U>("uint1/mul", 1, lu,
+                                        [](U x, U y) { return mul(x, y); }));
+  list.push_back(makeBenchmark<n, U, U, U>(
+      "uint1/madd", 1, lu, [](U x, U y, U z) { return madd(x, y, z); }));
+  list.push_back(makeBenchmark<n, U>("uint1/popcount", 1, lu,
+                                     [](U x) { return popcount(x); }));
+  list.push_back(makeBenchmark<n, U, int>(
+      "uint1/extract", 1, 1, [](U x, int i) { return extract(x, i % lu); }));
+  list.push_back(makeBenchmark<n, U>(
+      "uint1/lane_xor_permute", 1, lu,
+      [](U x) { return lane_xor_permute<2>(x); }));
+  list.push_back(makeBenchmark<n, U, int>(
+      "uint1/lane_shift", 1, lu,
+      [](U x, int i) { return lane_shift(x, i % lu); }));
+  list.push_back(makeBenchmark<n, U, int>(
+      "uint1/lane_rotate", 1, lu,
+      [](U x, int i) { return lane_rotate(x, i); }));
+  list.push_back(makeBenchmark<n, U>("uint1/lane_permute", 1, lu, [](U x) {
+    static const LanePermutation reversal = [] {
+      uint16_t indices[lu];
+      for (int l = 0; l < lu; ++l) {
+        indices[l] = lu - 1 - l;
+      }
+      return LanePermutation::from_indices(indices);
+    }();
+    return lane_permute(x, reversal);
+  }));
+  list.push_back(makeBenchmark<n, I, I>("int64/add", 1, li,
+                                        [](I x, I y) { return add(x, y); }));
+  list.push_back(makeBenchmark<n, I, I>("int64/sub", 1, li,
+                                        [](I x, I y) { return sub(x, y); }));
+  list.push_back(makeBenchmark<n, I, I>("int64/min", 1, li,
+                                        [](I x, I y) { return min(x, y); }));
+  list.push_back(makeBenchmark<n, I, I>("int64/max", 1, li,
+                                        [](I x, I y) { return max(x, y); }));
+  list.push_back(makeBenchmark<n, I, I>("int64/mul", 1, li,
+                                        [](I x, I y) { return mul(x, y); }));
+  list.push_back(makeBenchmark<n, I, I, I>(
+      "int64/madd", 1, li, [](I x, I y, I z) { return madd(x, y, z); }));
+  list.push_back(makeBenchmark<n, I, I, I>(
+      "int64/madd_lo32", 1, li,
+      [](I x, I y, I z) { return madd_lo32(x, y, z); }));
+  list.push_back(makeBenchmark<n, I>("int64/reduce_add", 1, li,
+                                     [](I x) { return reduce_add(x); }));
+  list.push_back(makeBenchmark<n, I, int>(
+      "int64/extract", 1, 1, [](I x, int i) { return extract(x, i % li); }));
+}
+
+template <Indices sizes>
+void addElementwiseBenchmarks(std::vector<Benchmark> &list) {
+  using V = Vector<Uint1xN, sizes>;
+  using W = Vector<Int64xN, sizes>;
+  constexpr int lu = Uint1xN::elem_count;
+  constexpr int li = Int64xN::elem_count;
+  std::string shape = shapeName(sizes);
+  list.push_back(makeBenchmark<1, V, V>(
+      "vector_u1/add/" + shape, V::flatSize, lu,
+      [](V x, V y) { return add(x, y); }));
+  list.push_back(makeBenchmark<1, V, V, V>(
+      "vector_u1/madd/" + shape, V::flatSize, lu,
+      [](V x, V y, V z) { return madd(x, y, z); }));
+  list.push_back(makeBenchmark<1, V>("vector_u1/popcount/" + shape,
+                                     V::flatSize, lu,
+                                     [](V x) { return popcount(x); }));
+  list.push_back(makeBenchmark<1, W, W>(
+      "vector_i64/add/" + shape, W::flatSize, li,
+      [](W x, W y) { return add(x, y); }));
+}
+
+// Vector::seq shifts the chunk index by up to flatSize bits, so shapes stay
+// small.
+template <int n> void addSeqBenchmark(std::vector<Benchmark> &list) {
+  using V = Vector<Uint1xN, {n}>;
+  list.push_back(makeBenchmark<1, int>(fmt::format("vector_u1/seq/{}", n),
+                                       n, Uint1xN::elem_count,
+                                       [](int i) { return V::seq(i); }));
+}
+
+template <int a, int b, int c>
+void addMatmulBenchmark(std::vector<Benchmark> &list) {
+  using X = Vector<Uint1xN, {a, b}>;
+  using Y = Vector<Uint1xN, {b, c}>;
+  list.push_back(makeBenchmark<1, X, Y>(
+      fmt::format("vector_u1/matmul/{}x{}x{}", a, b, c), a * b * c,
+      Uint1xN::elem_count, [](X x, Y y) { return matmul(x, y); }));
+}
+
+// Over Z, with full 64-bit products and, as the bound allows, 32-bit ones.
+template <int a, int b, int c>
+void addInt64MatmulBenchmarks(std::vector<Benchmark> &list) {
+  using X = Vector<Int64xN, {a, b}>;
+  using Y = Vector<Int64xN, {b, c}>;
+  list.push_back(makeBenchmark<1, X, Y>(
+      fmt::format("vector_i64/matmul/{}x{}x{}", a, b, c), a * b * c,
+      Int64xN::elem_count, [](X x, Y y) { return matmul(x, y); }));
+  list.push_back(makeBenchmark<1, X, Y>(
+      fmt::format("vector_i64/matmul_bounded/{}x{}x{}", a, b, c), a * b * c,
+      Int64xN::elem_count, [](X x, Y y) {
+        return matmul_bounded<INT32_MAX, INT32_MAX>(x, y);
+      }));
+}
+
+template <int n> void addContractBenchmark(std::vector<Benchmark> &list) {
+  using V = Vector<Uint1xN, {n, n}>;
+  list.push_back(makeBenchmark<1, V>(
+      fmt::format("vector_u1/contract01/{}x{}", n, n), n, Uint1xN::elem_count,
+      [](V x) { return contract<0, 1>(x); }));
+}
+
+template <Indices sizes, Indices permutation>
+void addTransposeBenchmark(std::vector<Benchmark> &list) {
+  using V = Vector<Uint1xN, sizes>;
+  list.push_back(makeBenchmark<1, V>(
+      fmt::format("vector_u1/transpose{}/{}", shapeName(permutation),
+                  shapeName(sizes)),
+      V::flatSize, Uint1xN::elem_count,
+      [](V x) { return transpose<permutation>(x); }));
+}
+
+template <Indices sizes, Indices newSizes>
+void addReshapeBenchmark(std::vector<Benchmark> &list) {
+  using V = Vector<Uint1xN, sizes>;
+  list.push_back(makeBenchmark<1, V>(
+      fmt::format("vector_u1/reshape/{}->{}", shapeName(sizes),
+                  shapeName(newSizes)),
+      V::flatSize, Uint1xN::elem_count,
+      [](V x) { return reshape<newSizes>(x); }));
+}
+
+// Packed tables of `bits` bits, and batched ones of `size` inputs. An op is
+// one Uint1xN of table transformed.
+template <int bits, int size>
+void addTruthTableBenchmarks(std::vector<Benchmark> &list) {
+  using T = Vector<Uint1xN, {bits / Uint1xN::elem_count}>;
+  using V = Vector<Uint1xN, {size}>;
+  constexpr int lu = Uint1xN::elem_count;
+  list.push_back(makeBenchmark<1, T>(
+      fmt::format("truth_table/moebius_packed/{}", bits), T::flatSize, lu,
+      [](T f) { return moebius_packed(f); }));
+  list.push_back(makeBenchmark<1, T>(
+      fmt::format("truth_table/walsh_packed/{}", bits), T::flatSize, lu,
+      [](T f) { return walsh_packed(f); }));
+  list.push_back(makeBenchmark<1, V>(
+      fmt::format("truth_table/moebius/{}", size), size, lu,
+      [](V f) { return moebius(f); }));
+  list.push_back(makeBenchmark<1, V>(fmt::format("truth_table/walsh/{}", size),
+                                     size, lu,
+                                     [](V f) { return walsh(f); }));
+}
+
+// The S-box of PRESENT, and a pseudorandom 6-bit to 4-bit table.
+static constexpr LookupTable<4, 4> present_sbox = {
+    {0xC, 0x5, 0x6, 0xB, 0x9, 0x0, 0xA, 0xD, 0x3, 0xE, 0xF, 0x8, 0x4, 0x7,
+     0x1, 0x2}};
+static constexpr LookupTable<6, 4> random_6x4 = [] {
+  LookupTable<6, 4> t;
+  uint64_t state = 1;
+  for (uint64_t &v : t.values) {
+    v = nextRandom(state) & 0xF;
+  }
+  return t;
+}();
+
+// The network of lut against the sum of minterms. An op is one table lookup
+// in every lane.
+template <auto table> void addLutBenchmarks(std::vector<Benchmark> &list) {
+  using X = Vector<Uint1xN, {table.in_bits}>;
+  constexpr int lu = Uint1xN::elem_count;
+  std::string shape = fmt::format("{}x{}", table.in_bits, table.out_bits);
+  list.push_back(makeBenchmark<16, X>("lut/network/" + shape, 1, lu,
+                                      [](X x) { return lut<table>(x); }));
+  list.push_back(makeBenchmark<16, X>(
+      "lut/minterms/" + shape, 1, lu,
+      [](X x) { return lut_minterms<table>(x); }));
+}
+
+static std::vector<Benchmark> allBenchmarks() {
+  std::vector<Benchmark> list;
+  addPrimitiveBenchmarks(list);
+  addElementwiseBenchmarks<{8}>(list);
+  addElementwiseBenchmarks<{64}>(list);
+  addElementwiseBenchmarks<{16, 16}>(list);
+  addSeqBenchmark<8>(list);
+  addSeqBenchmark<16>(list);
+  addSeqBenchmark<32>(list);
+  addMatmulBenchmark<4, 4, 4>(list);
+  addMatmulBenchmark<8, 8, 8>(list);
+  addMatmulBenchmark<16, 16, 16>(list);
+  addMatmulBenchmark<4, 32, 4>(list);
+  addInt64MatmulBenchmarks<4, 4, 4>(list);
+  addInt64MatmulBenchmarks<8, 8, 8>(list);
+  addContractBenchmark<8>(list);
+  addContractBenchmark<16>(list);
+  addContractBenchmark<32>(list);
+  addTransposeBenchmark<{8, 8}, {1, 0}>(list);
+  addTransposeBenchmark<{32, 32}, {1, 0}>(list);
+  addTransposeBenchmark<{4, 64}, {1, 0}>(list);
+  addTransposeBenchmark<{4, 8, 16}, {2, 0, 1}>(list);
+  addReshapeBenchmark<{16, 16}, {256}>(list);
+  addReshapeBenchmark<{4, 4, 4, 4}, {16, 16}>(list);
+  addTruthTableBenchmarks<1 << 16, 256>(list);
+  addLutBenchmarks<present_sbox>(list);
+  addLutBenchmarks<random_6x4>(list);
+  return list;
+}
+
+static double timeCalls(const Benchmark &benchmark, int64_t calls) {
+  auto start = std::chrono::steady_clock::now();
+  benchmark.run(calls);
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+
+struct Result {
+  double ops_per_s;
+  double lanes_per_s;
+  double ns_per_call;
+};
+
+// Best of a few repetitions, each taking about min_time / repetitions.
+static Result measure(const Benchmark &benchmark, double min_time) {
+  constexpr int repetitions = 3;
+  double target = min_time / repetitions;
+  int64_t calls = 1;
+  double seconds = timeCalls(benchmark, calls);
+  while (seconds < target / 8) {
+    calls *= 2;
+    seconds = timeCalls(benchmark, calls);
+  }
+  double best = seconds / calls;
+  if (seconds < target) {
+    calls = static_cast<int64_t>(calls * target / seconds) + 1;
+  }
+  for (int r = 0; r < repetitions; ++r) {
+    best = std::min(best, timeCalls(benchmark, calls) / calls);
+  }
+  double ops_per_s = benchmark.ops / best;
+  return {ops_per_s, ops_per_s * benchmark.lanes, best * 1e9};
+}
+
+static int run(std::string_view filter, double min_time, const char *out_path) {
+  FILE *out = stdout;
+  if (out_path && !(out = fopen(out_path, "w"))) {
+    fmt::print(stderr, "Could not open {} for writing: {}\n", out_path,
+               strerror(errno));
+    return EXIT_FAILURE;
+  }
+  fmt::print(out,
+             "{{\n  \"backend\": \"{}\",\n  \"uint1_lanes\": {},\n  "
+             "\"int64_lanes\": {},\n  \"benchmarks\": [\n",
+             simd_backend_name, Uint1xN::elem_count, Int64xN::elem_count);
+  bool first = true;
+  for (const Benchmark &benchmark : allBenchmarks()) {
+    if (benchmark.name.find(filter) == std::string::npos) {
+      continue;
+    }
+    Result r = measure(benchmark, min_time);
+    // One benchmark per line, which --compare relies on.
+    fmt::print(out,
+               "{}    {{\"name\": \"{}\", \"ops_per_s\": {:.6g}, "
+               "\"lanes_per_s\": {:.6g}, \"ns_per_call\": {:.6g}}}",
+               first ? "" : ",\n", benchmark.name, r.ops_per_s, r.lanes_per_s,
+               r.ns_per_call);
+    first = false;
+    fflush(out);
+  }
+  fmt::print(out, "\n  ]\n}}\n");
+  if (out != stdout) {
+    fclose(out);
+  }
+  return EXIT_SUCCESS;
+}
+
+struct Entry {
+  std::string name;
+  double ops_per_s;
+};
+
+static std::string readFile(const char *path) {
+  FILE *file = fopen(path, "r");
+  if (!file) {
+    fmt::print(stderr, "Could not open {}: {}\n", path, strerror(errno));
+    exit(EXIT_FAILURE);
+  }
+  std::string contents;
+  char buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof buf, file)) > 0) {
+    contents.append(buf, n);
+  }
+  fclose(file);
+  return contents;
+}
+
+// Returns the string value following `"key": "` at or after pos.
+static std::string_view stringValue(std::string_view json, std::string_view key,
+                                    size_t pos = 0) {
+  std::string pattern = fmt::format("\"{}\": \"", key);
+  size_t begin = json.find(pattern, pos);
+  if (begin == std::string_view::npos) {
+    return {};
+  }
+  begin += pattern.size();
+  return json.substr(begin, json.find('"', begin) - begin);
+}
+
+static std::vector<Entry> parseResults(std::string_view json) {
+  std::vector<Entry> entries;
+  for (size_t pos = 0; (pos = json.find("{\"name\": ", pos)) !=
+                       std::string_view::npos;
+       ++pos) {
+    size_t line_end = json.find('\n', pos);
+    std::string_view line = json.substr(pos, line_end - pos);
+    size_t value = line.find("\"ops_per_s\": ");
+    if (value == std::string_view::npos) {
+      continue;
+    }
+    entries.push_back({std::string(stringValue(line, "name")),
+                       strtod(line.data() + value + 13, nullptr)});
+  }
+  return entries;
+}
+
+static int compare(const char *old_path, const char *new_path,
+                   double threshold) {
+  std::string old_json = readFile(old_path);
+  std::string new_json = readFile(new_path);
+  std::string_view old_backend = stringValue(old_json, "backend");
+  std::string_view new_backend = stringValue(new_json, "backend");
+  if (old_backend != new_backend) {
+    fmt::print("Warning: comparing backend {} to backend {}\n", old_backend,
+               new_backend);
+  }
+  std::vector<Entry> old_entries = parseResults(old_json);
+  int regressions = 0;
+  for (const Entry &e : parseResults(new_json)) {
+    const Entry *old = nullptr;
+    for (const Entry &o : old_entries) {
+      if (o.name == e.name) {
+        old = &o;
+      }
+    }
+    if (!old) {
+      fmt::print("{:<40} {:>12} {:>12.4g}        (new)\n", e.name, "",
+                 e.ops_per_s);
+      continue;
+    }
+    double change = e.ops_per_s / old->ops_per_s - 1;
+    bool regressed = change < -threshold;
+    regressions += regressed;
+    fmt::print("{:<40} {:>12.4g} {:>12.4g} {:>+7.1f}%{}\n", e.name,
+               old->ops_per_s, e.ops_per_s, 100 * change,
+               regressed ? "  REGRESSION" : "");
+  }
+  fmt::print("{} regression(s) beyond {:.1f}%\n", regressions,
+             100 * threshold);
+  return regressions ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+static int usage(const char *argv0) {
+  fmt::print(stderr,
+             "Usage: {} [--filter=SUBSTRING] [--min-time=SECONDS] "
+             "[--out=FILE]\n"
+             "       {} --compare OLD.json NEW.json [--threshold=FRACTION]\n",
+             argv0, argv0);
+  return EXIT_FAILURE;
+}
+
+int main(int argc, char *argv[]) {
+  std::string_view filter;
+  double min_time = 0.3;
+  const char *out_path = nullptr;
+  bool compare_mode = false;
+  double threshold = 0.05;
+  const char *positional[2];
+  int positional_count = 0;
+  for (int i = 1; i < argc; ++i) {
+    std::string_view arg = argv[i];
+    auto value = [&](std::string_view flag) -> const char * {
+      return arg.starts_with(flag) ? argv[i] + flag.size() : nullptr;
+    };
+    if (const char *v = value("--filter=")) {
+      filter = v;
+    } else if (const char *v = value("--min-time=")) {
+      min_time = strtod(v, nullptr);
+    } else if (const char *v = value("--out=")) {
+      out_path = v;
+    } else if (arg == "--compare") {
+      compare_mode = true;
+    } else if (const char *v = value("--threshold=")) {
+      threshold = strtod(v, nullptr);
+    } else if (positional_count < 2 && !arg.starts_with("-")) {
+      positional[positional_count++] = argv[i];
+    } else {
+      return usage(argv[0]);
+    }
+  }
+  if (compare_mode) {
+    if (positional_count != 2) {
+      return usage(argv[0]);
+    }
+    return compare(positional[0], positional[1], threshold);
+  }
+  if (positional_count != 0) {
+    return usage(argv[0]);
+  }
+  return run(filter, min_time, out_path);
+}
@@ -0,0 +1,496 @@
+// Copyright 2024 The Hay Authors
+//
+// Licensed under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+// Searches for rank-r decompositions of the n x m x p matrix multiplication
+// tensor over GF(2), see matmul_tensor.h. Two modes:
+//
+//   enumerate: exhaustively visits all factor triples, up to reordering of
+//              the r rank-1 terms, for shapes small enough. Runs on the host
+//              thread pool with a launch config and cost kernel benchmarked
+//              on first use for each shape and host, then cached, see
+//              autotune.h.
+//   walk:      runs one local search walker per lane, with a cost kernel
+//              tuned the same way.
+//
+// Reports all decompositions found and the throughput in candidates/s. With
+// --perf, also reports hardware counters per search region, see
+// perf_counters.h. With --telemetry, reports progress periodically to stderr
+// or, given a path, to a Prometheus text file, see telemetry.h.
+
+#include "autotune.h"
+#include "launch.h"
+#include "local_search.h"
+#include "matmul_tensor.h"
+#include "perf_counters.h"
+#include "simd.h"
+#include "sliced_int.h"
+#include "symmetry.h"
+#include "telemetry.h"
+#include "vector.h"
+#include "vector_file.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fmt/format.h>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct SearchOptions {
+  int n = 0;
+  int m = 0;
+  int p = 0;
+  int r = 0;
+  std::string_view mode = "walk";
+  int64_t steps = 1 << 16;
+  uint64_t seed = 0;
+  int max_print = 4;
+  bool perf = false;
+  bool telemetry = false;
+  std::string telemetry_path;
+  double telemetry_interval = 10;
+  // Where to write every solution found, as a vector file of Factors.
+  std::string save_path;
+  // Launch config and MatmulTensor::cost_kernel, tuned per host and shape
+  // unless given.
+  int threads = 0;
+  int grain = 0;
+  int kernel = -1;
+  bool retune = false;
+};
+
+static TelemetryOptions telemetryOptions(const SearchOptions &options,
+                                         int64_t total_chunks,
+                                         std::vector<std::string> stages) {
+  TelemetryOptions t;
+  t.total_chunks = total_chunks;
+  t.stages = std::move(stages);
+  t.interval_seconds = options.telemetry_interval;
+  t.path = options.telemetry_path;
+  return t;
+}
+
+// Search regions, for --perf. Counter reads cost about a microsecond, so
+// regions span whole ranges of chunks rather than single chunks: the whole
+// search, and the ranges of canonical chunks that enumerate hands to each
+// thread, covering chunk generation, contraction, filtering and extraction.
+static PerfRegion search_region("search");
+static PerfRegion canonical_region("canonical");
+
+class Stopwatch {
+public:
+  double seconds() const {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                         start)
+        .count();
+  }
+
+private:
+  std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+};
+
+static void printThroughput(int64_t candidates, double seconds) {
+  fmt::print("{} candidates in {:.3f} s: {:.4g} candidates/s\n", candidates,
+             seconds, candidates / seconds);
+}
+
+// Prints the solutions in the lanes of `mask` while `budget` lasts, and saves
+// all of them if `save` is not null.
+template <typename M>
+void printSolutions(const typename M::Factors &f, Uint1xN mask, int &budget,
+                    VectorFileWriter *save) {
+  typename M::FactorA a;
+  typename M::FactorB b;
+  typename M::FactorC c;
+  M::split(f, a, b, c);
+  for (int l = 0; l < Uint1xN::elem_count; ++l) {
+    if (!extract(mask, l)) {
+      continue;
+    }
+    if (save) {
+      save->writeLane(f, l);
+    }
+    if (budget > 0) {
+      fmt::print("A = {}\nB = {}\nC = {}\n\n", extract(a, l), extract(b, l),
+                 extract(c, l));
+      --budget;
+    }
+  }
+}
+
+template <typename M>
+std::unique_ptr<VectorFileWriter> solutionWriter(const SearchOptions &options) {
+  if (options.save_path.empty()) {
+    return nullptr;
+  }
+  return std::make_unique<VectorFileWriter>(
+      options.save_path, vectorFileHeader<Uint1xN, M::factor_sizes>());
+}
+
+static bool finishSolutions(VectorFileWriter *save,
+                            const SearchOptions &options) {
+  if (!save) {
+    return true;
+  }
+  if (!save->finish()) {
+    return false;
+  }
+  fmt::print("{} solutions saved to {}\n", save->lanes(), options.save_path);
+  return true;
+}
+
+// Telemetry counters of the calling thread, registered on first use.
+static TelemetryCounters *threadProgress(Telemetry *telemetry) {
+  thread_local Telemetry *owner = nullptr;
+  thread_local TelemetryCounters *counters = nullptr;
+  if (!telemetry) {
+    return nullptr;
+  }
+  if (owner != telemetry) {
+    owner = telemetry;
+    counters = &telemetry->registerThread();
+  }
+  return counters;
+}
+
+// Returns the launch config for `shape` on this host: the parameters given
+// on the command line, and the best of `candidates` for the others,
+// benchmarking measure(config) on first use.
+template <typename Measure>
+TuneConfig tuneConfig(const SearchOptions &options, std::string shape,
+                      const std::vector<TuneConfig> &candidates,
+                      Measure measure) {
+  // Given parameters replace those of the candidates, and key their own
+  // cache entry.
+  std::vector<TuneConfig> constrained;
+  for (TuneConfig config : candidates) {
+    if (options.threads > 0) {
+      config.threads = options.threads;
+    }
+    if (options.grain > 0) {
+      config.grain = options.grain;
+    }
+    if (options.kernel >= 0) {
+      config.kernel = options.kernel;
+    }
+    if (std::find(constrained.begin(), constrained.end(), config) ==
+        constrained.end()) {
+      constrained.push_back(config);
+    }
+  }
+  if (constrained.size() == 1) {
+    return constrained[0];
+  }
+  if (options.threads > 0) {
+    shape += fmt::format(" threads {}", options.threads);
+  }
+  if (options.grain > 0) {
+    shape += fmt::format(" grain {}", options.grain);
+  }
+  if (options.kernel >= 0) {
+    shape += fmt::format(" kernel {}", options.kernel);
+  }
+  TuneCache cache(defaultTuneCachePath());
+  TuneOptions tune_options;
+  tune_options.force = options.retune;
+  tune_options.verbose = options.retune;
+  bool tuning = false;
+  return autotune(
+      cache, tuneKey(shape), constrained,
+      [&](const TuneConfig &config) {
+        if (!tuning) {
+          fmt::print("Tuning launch config for this host...\n");
+          tuning = true;
+        }
+        return measure(config);
+      },
+      tune_options);
+}
+
+template <int n, int m, int p, int r>
+int enumerate(const SearchOptions &options) {
+  using M = MatmulTensor<n, m, p, r>;
+  if constexpr (M::Factors::flatSize > 40) {
+    fmt::print(stderr, "{} factor bits are too many to enumerate\n",
+               M::Factors::flatSize);
+    return EXIT_FAILURE;
+  } else {
+    // Reordering the rank-1 terms does not change the decomposition.
+    using Group = PermutationGroup<M::factor_sizes>;
+    Group group = Group::generated_by(Group::relabelings(0));
+    typename M::Tensor target = M::target();
+    constexpr int64_t total_chunks = seq_chunk_count<M::factor_sizes>();
+    std::atomic<int64_t> solutions{0};
+    std::atomic<int64_t> solutions_with_orbits{0};
+    std::atomic<int64_t> chunks{0};
+    std::atomic<int64_t> representatives{0};
+    std::atomic<int64_t> candidates{0};
+    std::mutex print_mutex;
+    int budget = options.max_print;
+    std::unique_ptr<VectorFileWriter> save = solutionWriter<M>(options);
+    std::unique_ptr<Telemetry> telemetry;
+
+    // Enumerates the first `count` chunks with `config`, over the host thread
+    // pool. Only reports solutions when `report` is set.
+    auto run = [&](int64_t count, const TuneConfig &config, bool report) {
+      if (hostThreadCount() != config.threads) {
+        setHostThreadCount(config.threads);
+      }
+      typename M::CostKernel cost_kernel = M::cost_kernel(config.kernel);
+      parallelFor(
+          count,
+          [&](int64_t begin, int64_t end) {
+            TelemetryCounters *progress =
+                report ? threadProgress(telemetry.get()) : nullptr;
+            int64_t visited = 0;
+            int64_t hits = 0;
+            int64_t hits_with_orbits = 0;
+            PerfScope scope(canonical_region,
+                            (end - begin) * Uint1xN::elem_count);
+            OrbitCounts counts = enumerate_canonical(
+                group, begin, end,
+                [&](int64_t, const typename M::Factors &f,
+                    const CanonicalInfo &info) {
+                  ++visited;
+                  typename M::Cost cost = cost_kernel(f, target);
+                  Uint1xN solved = mul(info.mask, sliced_equal(cost, 0));
+                  if (is_zero(solved)) {
+                    return;
+                  }
+                  hits += reduce_add(popcount(solved));
+                  hits_with_orbits += orbit_total(group.order(), info, solved);
+                  if (report) {
+                    std::lock_guard<std::mutex> lock(print_mutex);
+                    printSolutions<M>(f, solved, budget, save.get());
+                  }
+                });
+            if (progress) {
+              progress->addChunks(end - begin);
+              progress->addLanes((end - begin) * Uint1xN::elem_count);
+              progress->addSurvivors(0, counts.representatives);
+              progress->addHits(hits);
+            }
+            if (report) {
+              chunks += visited;
+              solutions += hits;
+              solutions_with_orbits += hits_with_orbits;
+              representatives += counts.representatives;
+              candidates += counts.candidates;
+            }
+          },
+          config.grain);
+    };
+
+    TuneConfig config = tuneConfig(
+        options, fmt::format("enumerate {}x{}x{} r{}", n, m, p, r),
+        tuneCandidates(hostThreadCount(), M::cost_kernel_count),
+        [&](const TuneConfig &c) {
+          // A sample large enough to keep every thread busy for a while.
+          Stopwatch stopwatch;
+          run(std::min<int64_t>(total_chunks, 1 << 14), c, false);
+          return stopwatch.seconds();
+        });
+    if (options.perf) {
+      resetPerfCounters();
+    }
+    fmt::print("Launch config: {} threads, grain {}, {} cost kernel\n",
+               config.threads, config.grain,
+               M::cost_kernel_name(config.kernel));
+    if (options.telemetry) {
+      telemetry = std::make_unique<Telemetry>(
+          telemetryOptions(options, total_chunks, {"canonical"}));
+    }
+    Stopwatch stopwatch;
+    {
+      PerfScope search_scope(search_region,
+                             total_chunks * Uint1xN::elem_count);
+      run(total_chunks, config, true);
+    }
+    double seconds = stopwatch.seconds();
+    fmt::print("{} decompositions up to term order ({} counting all term "
+               "orders)\n",
+               solutions.load(), solutions_with_orbits.load());
+    fmt::print("{} orbit representatives covering {} candidates\n",
+               representatives.load(), candidates.load());
+    printThroughput(chunks * Uint1xN::elem_count, seconds);
+    return finishSolutions(save.get(), options) ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+}
+
+template <int n, int m, int p, int r> int walk(const SearchOptions &options) {
+  using M = MatmulTensor<n, m, p, r>;
+  typename M::Tensor target = M::target();
+  LocalSearchOptions walk_options;
+  walk_options.seed = options.seed;
+  walk_options.max_steps = options.steps;
+  TuneConfig config = tuneConfig(
+      options, fmt::format("walk {}x{}x{} r{}", n, m, p, r),
+      tuneKernelCandidates(M::cost_kernel_count), [&](const TuneConfig &c) {
+        typename M::CostKernel cost_kernel = M::cost_kernel(c.kernel);
+        LocalSearchOptions sample_options = walk_options;
+        sample_options.max_steps = 1 << 10;
+        Stopwatch stopwatch;
+        local_search<M::factor_sizes>(
+            [&](const typename M::Factors &f) {
+              return cost_kernel(f, target);
+            },
+            sample_options, [](const typename M::Factors &, Uint1xN) {});
+        return stopwatch.seconds();
+      });
+  typename M::CostKernel cost_kernel = M::cost_kernel(config.kernel);
+  fmt::print("Cost kernel: {}\n", M::cost_kernel_name(config.kernel));
+  if (options.perf) {
+    resetPerfCounters();
+  }
+  int budget = options.max_print;
+  std::unique_ptr<VectorFileWriter> save = solutionWriter<M>(options);
+  std::unique_ptr<Telemetry> telemetry;
+  TelemetryCounters *progress = nullptr;
+  if (options.telemetry) {
+    // A chunk is one step of all walkers.
+    telemetry = std::make_unique<Telemetry>(
+        telemetryOptions(options, options.steps, {}));
+    progress = &telemetry->registerThread();
+  }
+  Stopwatch stopwatch;
+  PerfScope search_scope(search_region, options.steps * Uint1xN::elem_count);
+  LocalSearchStats stats = local_search<M::factor_sizes>(
+      [&](const typename M::Factors &f) { return cost_kernel(f, target); },
+      walk_options,
+      [&](const typename M::Factors &f, Uint1xN solved) {
+        if (progress) {
+          progress->addHits(reduce_add(popcount(solved)));
+        }
+        printSolutions<M>(f, solved, budget, save.get());
+      },
+      [&](const LocalSearchStats &) {
+        if (progress) {
+          progress->addChunks(1);
+          progress->addLanes(Uint1xN::elem_count);
+        }
+      });
+  double seconds = stopwatch.seconds();
+  fmt::print("{} decompositions found, {} restarts, {} accepted moves\n",
+             stats.solutions, stats.restarts, stats.accepted_moves);
+  printThroughput(stats.steps * Uint1xN::elem_count, seconds);
+  return finishSolutions(save.get(), options) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+template <int n, int m, int p, int r> int search(const SearchOptions &options) {
+  using M = MatmulTensor<n, m, p, r>;
+  if (options.kernel >= M::cost_kernel_count) {
+    fmt::print(stderr, "--kernel must be below {}\n", M::cost_kernel_count);
+    return EXIT_FAILURE;
+  }
+  int status = options.mode == "enumerate" ? enumerate<n, m, p, r>(options)
+                                           : walk<n, m, p, r>(options);
+  if (options.perf) {
+    printPerfReport(stdout);
+  }
+  return status;
+}
+
+struct Shape {
+  int n, m, p, r;
+  int (*search)(const SearchOptions &);
+};
+
+// Every shape is a separate instantiation of the whole stack, so only a
+// selection is compiled in.
+static constexpr Shape shapes[] = {
+    {1, 1, 2, 2, search<1, 1, 2, 2>},   {1, 1, 3, 3, search<1, 1, 3, 3>},
+    {1, 2, 2, 4, search<1, 2, 2, 4>},   {2, 2, 2, 7, search<2, 2, 2, 7>},
+    {2, 2, 2, 8, search<2, 2, 2, 8>},   {2, 2, 3, 11, search<2, 2, 3, 11>},
+    {2, 3, 3, 15, search<2, 3, 3, 15>}, {3, 3, 3, 23, search<3, 3, 3, 23>},
+};
+
+static int usage(const char *argv0) {
+  fmt::print(stderr,
+             "Usage: {} N M P R [--mode=enumerate|walk] [--steps=S] "
+             "[--seed=S] [--max-print=K] [--perf]\n"
+             "       [--telemetry[=PATH]] [--telemetry-interval=SECONDS]\n"
+             "       [--threads=T] [--grain=G] [--kernel=K] [--retune] "
+             "[--save=PATH]\n\n"
+             "Supported N M P R:\n",
+             argv0);
+  for (const Shape &shape : shapes) {
+    fmt::print(stderr, "  {} {} {} {}\n", shape.n, shape.m, shape.p, shape.r);
+  }
+  return EXIT_FAILURE;
+}
+
+int main(int argc, char *argv[]) {
+  SearchOptions options;
+  int positional[4];
+  int positional_count = 0;
+  for (int i = 1; i < argc; ++i) {
+    std::string_view arg = argv[i];
+    auto value = [&](std::string_view flag) -> const char * {
+      return arg.starts_with(flag) ? argv[i] + flag.size() : nullptr;
+    };
+    if (const char *v = value("--mode=")) {
+      options.mode = v;
+      if (options.mode != "enumerate" && options.mode != "walk") {
+        return usage(argv[0]);
+      }
+    } else if (const char *v = value("--steps=")) {
+      options.steps = strtoll(v, nullptr, 0);
+    } else if (const char *v = value("--seed=")) {
+      options.seed = strtoull(v, nullptr, 0);
+    } else if (const char *v = value("--max-print=")) {
+      options.max_print = atoi(v);
+    } else if (arg == "--telemetry") {
+      options.telemetry = true;
+    } else if (const char *v = value("--telemetry=")) {
+      options.telemetry = true;
+      options.telemetry_path = v;
+    } else if (const char *v = value("--telemetry-interval=")) {
+      options.telemetry_interval = strtod(v, nullptr);
+    } else if (const char *v = value("--threads=")) {
+      options.threads = atoi(v);
+    } else if (const char *v = value("--grain=")) {
+      options.grain = atoi(v);
+    } else if (const char *v = value("--kernel=")) {
+      options.kernel = atoi(v);
+    } else if (const char *v = value("--save=")) {
+      options.save_path = v;
+    } else if (arg == "--retune") {
+      options.retune = true;
+    } else if (arg == "--perf") {
+      options.perf = true;
+      enablePerfCounters();
+    } else if (positional_count < 4 && !arg.starts_with("-")) {
+      positional[positional_count++] = atoi(argv[i]);
+    } else {
+      return usage(argv[0]);
+    }
+  }
+  if (positional_count != 4) {
+    return usage(argv[0]);
+  }
+  options.n = positional[0];
+  options.m = positional[1];
+  options.p = positional[2];
+  options.r = positional[3];
+  for (const Shape &shape : shapes) {
+    if (shape.n == options.n && shape.m == options.m &&
+        shape.p == options.p && shape.r == options.r) {
+      fmt::print("Searching rank-{} decompositions of the {}x{}x{} matmul "
+                 "tensor, mode {}, {} lanes\n",
+                 options.r, options.n, options.m, options.p, options.mode,
+                 Uint1xN::elem_count);
+      return shape.search(options);
+    }
+  }
+  return usage(argv[0]);
+}
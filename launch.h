@@ -0,0 +1,122 @@
+// Copyright 2024 The Hay Authors
+//
+// Licensed under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#ifndef HAY_LAUNCH_H_
+#define HAY_LAUNCH_H_
+
+#include "device.h"
+
+#include <cstdint>
+
+#ifdef __HIP__
+#include <hip/hip_runtime.h>
+#define HAY_DEVICE __host__ __device__
+#else
+#define HAY_DEVICE
+#endif
+
+// Position of the calling thread within a launch: `grid` blocks of `block`
+// threads each.
+struct LaunchIndex {
+  int block_idx;
+  int thread_idx;
+  int grid;
+  int block;
+  HAY_DEVICE int64_t global() const {
+    return int64_t{block_idx} * block + thread_idx;
+  }
+};
+
+// Host thread pool, used by the CPU backend of launch() and available to host
+// code directly.
+int hostThreadCount();
+// Resizes the pool. 0 means the default: $HAY_NUM_THREADS if set, else one
+// thread per hardware thread. Must not race with parallelFor.
+void setHostThreadCount(int count);
+
+// Calls fn(ctx, begin, end) on disjoint ranges covering [0, count), in
+// parallel over the host thread pool, and returns when all are done. Ranges
+// are handed out dynamically, `grain` indices at a time, or by default about
+// count / (8 * hostThreadCount()). When called from a pool thread, runs
+// serially on that thread.
+void parallelForImpl(int64_t count, void (*fn)(void *, int64_t, int64_t),
+                     void *ctx, int64_t grain = 0);
+
+template <typename F> void parallelFor(int64_t count, F f, int64_t grain = 0) {
+  parallelForImpl(
+      count,
+      [](void *ctx, int64_t begin, int64_t end) {
+        (*static_cast<F *>(ctx))(begin, end);
+      },
+      &f, grain);
+}
+
+// Launches kernel(index, args...) for every LaunchIndex of a grid of `grid`
+// blocks of `block` threads. Kernels are written once, as function objects
+// whose call operator is HAY_DEVICE, typically looping over Vector chunks
+// indexed by index.global().
+//
+// With HIP this is hipLaunchKernelGGL. On the CPU backend, blocks are spread
+// over the host thread pool and the threads of a block run one after the
+// other, with the best host SIMD backend from simd.h.
+#ifdef __HIP__
+
+template <typename Kernel, typename... Args>
+__global__ void launchTrampoline(Kernel kernel, Args... args) {
+  kernel(LaunchIndex{static_cast<int>(blockIdx.x),
+                     static_cast<int>(threadIdx.x),
+                     static_cast<int>(gridDim.x),
+                     static_cast<int>(blockDim.x)},
+         args...);
+}
+
+template <typename Kernel, typename... Args>
+void launchAsync(Stream stream, int grid, int block, Kernel kernel,
+                 Args... args) {
+  hipLaunchKernelGGL(launchTrampoline<Kernel, Args...>, dim3(grid),
+                     dim3(block), 0, static_cast<hipStream_t>(stream.val),
+                     kernel, args...);
+}
+
+template <typename Kernel, typename... Args>
+void launch(int grid, int block, Kernel kernel, Args... args) {
+  // The null stream is HIP's default stream.
+  launchAsync(Stream{nullptr}, grid, block, kernel, args...);
+  synchronize(Stream{nullptr});
+}
+
+#else
+
+template <typename Kernel, typename... Args>
+void launch(int grid, int block, Kernel kernel, Args... args) {
+  parallelFor(grid, [&](int64_t begin, int64_t end) {
+    for (int64_t b = begin; b < end; ++b) {
+      for (int t = 0; t < block; ++t) {
+        kernel(LaunchIndex{static_cast<int>(b), t, grid, block}, args...);
+      }
+    }
+  });
+}
+
+// As launch(), but ordered with the other operations of `stream` and
+// asynchronous with respect to the host. Arguments are captured by value.
+template <typename Kernel, typename... Args>
+void launchAsync(Stream stream, int grid, int block, Kernel kernel,
+                 Args... args) {
+  auto *l = new auto([=] { launch(grid, block, kernel, args...); });
+  launchHostFunc(
+      stream,
+      [](void *arg) {
+        auto *f = static_cast<decltype(l)>(arg);
+        (*f)();
+        delete f;
+      },
+      l);
+}
+
+#endif // __HIP__
+
+#endif // HAY_LAUNCH_H_
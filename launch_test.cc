@@ -0,0 +1,128 @@
+// Copyright 2024 The Hay Authors
+//
+// Licensed under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#include "launch.h"
+#include "simd.h"
+#include "testlib.h"
+#include "vector.h"
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+struct TestParallelFor {
+  static void Run() {
+    const int count = 100000;
+    std::vector<std::atomic<int>> hits(count);
+    parallelFor(count, [&](int64_t begin, int64_t end) {
+      CHECK(0 <= begin && begin < end && end <= count);
+      for (int64_t i = begin; i < end; ++i) {
+        hits[i]++;
+      }
+    });
+    for (int i = 0; i < count; ++i) {
+      CHECK_EQ(hits[i].load(), 1);
+    }
+  }
+};
+
+struct TestParallelForGrain {
+  static void Run() {
+    const int count = 1000;
+    std::vector<std::atomic<int>> hits(count);
+    parallelFor(
+        count,
+        [&](int64_t begin, int64_t end) {
+          CHECK_EQ(begin % 7, int64_t{0});
+          CHECK_EQ(end - begin, std::min<int64_t>(7, count - begin));
+          for (int64_t i = begin; i < end; ++i) {
+            hits[i]++;
+          }
+        },
+        7);
+    for (int i = 0; i < count; ++i) {
+      CHECK_EQ(hits[i].load(), 1);
+    }
+  }
+};
+
+struct TestParallelForNested {
+  static void Run() {
+    std::atomic<int64_t> sum{0};
+    parallelFor(10, [&](int64_t begin, int64_t end) {
+      for (int64_t i = begin; i < end; ++i) {
+        parallelFor(100, [&](int64_t b, int64_t e) {
+          for (int64_t j = b; j < e; ++j) {
+            sum += i * 100 + j;
+          }
+        });
+      }
+    });
+    CHECK_EQ(sum.load(), int64_t{999 * 1000 / 2});
+  }
+};
+
+struct TestHostThreadCount {
+  static void Run() {
+    setHostThreadCount(3);
+    CHECK_EQ(hostThreadCount(), 3);
+    TestParallelFor::Run();
+    setHostThreadCount(0);
+    CHECK(hostThreadCount() >= 1);
+  }
+};
+
+// Each thread counts the set bits of one Vector::seq chunk.
+struct TestLaunch {
+  using V = Vector<Uint1xN, {4, 4}>;
+  struct Kernel {
+    HAY_DEVICE void operator()(LaunchIndex index, int64_t *out,
+                               int64_t base) const {
+      auto counts = popcount(V::seq(index.global()));
+      int64_t total = 0;
+      for (int i = 0; i < V::flatSize; ++i) {
+        total += reduce_add(counts.elems[i]);
+      }
+      out[index.global()] = base + total;
+    }
+  };
+
+  static int64_t expected(int64_t chunk) {
+    auto counts = popcount(V::seq(chunk));
+    int64_t total = 0;
+    for (int i = 0; i < V::flatSize; ++i) {
+      total += reduce_add(counts.elems[i]);
+    }
+    return total;
+  }
+
+  static void Run() {
+    const int grid = 7;
+    const int block = 5;
+    std::vector<int64_t> out(grid * block, -1);
+    launch(grid, block, Kernel{}, out.data(), int64_t{1000});
+    for (int i = 0; i < grid * block; ++i) {
+      CHECK_EQ(out[i], 1000 + expected(i));
+    }
+
+    std::vector<int64_t> out2(grid * block, -1);
+    Stream stream = createStream();
+    launchAsync(stream, grid, block, Kernel{}, out2.data(), int64_t{0});
+    synchronize(stream);
+    destroyStream(stream);
+    for (int i = 0; i < grid * block; ++i) {
+      CHECK_EQ(out2[i], expected(i));
+    }
+  }
+};
+
+int main() {
+  TEST(TestParallelFor);
+  TEST(TestParallelForGrain);
+  TEST(TestParallelForNested);
+  TEST(TestHostThreadCount);
+  TEST(TestLaunch);
+}
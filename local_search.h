@@ -0,0 +1,102 @@
+// Copyright 2024 The Hay Authors
+//
+// Licensed under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#ifndef HAY_LOCAL_SEARCH_H_
+#define HAY_LOCAL_SEARCH_H_
+
+#include "random.h"
+#include "simd.h"
+#include "sliced_int.h"
+#include "vector.h"
+
+#include <cassert>
+#include <cstdint>
+
+struct LocalSearchOptions {
+  uint64_t seed = 0;
+  int64_t max_steps = 1 << 20;
+  // Walkers that have not strictly improved their cost for this many steps
+  // since they last did or restarted restart from a random state. Below
+  // 2^local_search_stall_bits.
+  int64_t restart_interval = 1 << 12;
+  // Moves that keep the cost unchanged are accepted with probability
+  // 2^-plateau_log2.
+  int plateau_log2 = 1;
+};
+
+// Bits of the per-walker count of steps without improvement.
+constexpr int local_search_stall_bits = 32;
+
+struct LocalSearchStats {
+  int64_t steps = 0;
+  int64_t accepted_moves = 0;
+  // Walker restarts, including those following a solution.
+  int64_t restarts = 0;
+  int64_t solutions = 0;
+};
+
+// Stochastic local search running one independent walker per lane of a
+// Vector<Uint1xN, sizes>. Each step flips one random element per walker and
+// accepts the move in the lanes where it lowers the cost, or keeps it equal
+// and a plateau coin says so.
+//
+// `cost` maps a state to a bitsliced unsigned integer (a UintKxN) per lane;
+// zero means solved. Whenever walkers reach zero, calls
+// on_solution(state, mask) with the mask of those lanes, then restarts them.
+// After each step, calls on_step(stats), e.g. to report progress, as `cost`
+// also runs on restarts.
+template <Indices sizes, typename Cost, typename OnSolution, typename OnStep>
+LocalSearchStats local_search(Cost cost, const LocalSearchOptions &options,
+                              OnSolution on_solution, OnStep on_step) {
+  using State = Vector<Uint1xN, sizes>;
+  using Stall = UintKxN<local_search_stall_bits>;
+  assert(options.restart_interval > 0 &&
+         options.restart_interval < int64_t{1} << local_search_stall_bits);
+  RandomUint1xN random(options.seed);
+  LocalSearchStats stats;
+  State x = random.template vector<sizes>();
+  auto cx = cost(x);
+  // Steps since each walker last improved or restarted.
+  Stall stall = Stall::cst(0);
+  for (stats.steps = 0; stats.steps < options.max_steps;) {
+    State y = add(x, random.template one_hot<sizes>());
+    auto cy = cost(y);
+    Uint1xN better = sliced_less(cy, cx);
+    Uint1xN worse = sliced_less(cx, cy);
+    Uint1xN plateau = mul(bit_not(add(better, worse)),
+                          random.bernoulli(options.plateau_log2));
+    Uint1xN accept = add(better, plateau);
+    x = select(accept, y, x);
+    cx = select(accept, cy, cx);
+    stall = sliced_increment(stall, Uint1xN::cst(1));
+    stats.accepted_moves += reduce_add(popcount(accept));
+    ++stats.steps;
+
+    Uint1xN restart = sliced_equal(cx, 0);
+    if (!is_zero(restart)) {
+      on_solution(x, restart);
+      stats.solutions += reduce_add(popcount(restart));
+    }
+    restart = bit_or(restart, sliced_equal(stall, options.restart_interval));
+    stall = select(bit_or(better, restart), Stall::cst(0), stall);
+    if (!is_zero(restart)) {
+      stats.restarts += reduce_add(popcount(restart));
+      x = select(restart, random.template vector<sizes>(), x);
+      cx = cost(x);
+    }
+    on_step(stats);
+  }
+  return stats;
+}
+
+template <Indices sizes, typename Cost, typename OnSolution>
+LocalSearchStats local_search(Cost cost, const LocalSearchOptions &options,
+                              OnSolution on_solution) {
+  return local_search<sizes>(cost, options, on_solution,
+                             [](const LocalSearchStats &) {});
+}
+
+#endif // HAY_LOCAL_SEARCH_H_
@@ -0,0 +1,120 @@
+// Copyright 2024 The Hay Authors
+//
+// Licensed under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#include "local_search.h"
+#include "testlib.h"
+
+#include <algorithm>
+
+// Walkers look for the x such that x * m == t for a fixed invertible m, the
+// cost being the number of wrong entries of x * m.
+struct TestLocalSearchMatmul {
+  using State = Vector<Uint1xN, {3, 4}>;
+  using Matrix = Vector<Uint1xN, {4, 4}>;
+
+  static void Run() {
+    // Upper unitriangular, hence invertible.
+    Matrix m = Matrix::cst(0);
+    std::minstd_rand0 engine;
+    for (int i = 0; i < 4; ++i) {
+      for (int j = i; j < 4; ++j) {
+        m.elems[4 * i + j] = Uint1xN::cst(i == j ? 1 : engine() & 1);
+      }
+    }
+    State t;
+    for (int i = 0; i < t.flatSize; ++i) {
+      t.elems[i] = Uint1xN::cst(engine() & 1);
+    }
+    auto cost = [&](State x) { return sliced_weight<4>(add(matmul(x, m), t)); };
+    LocalSearchOptions options;
+    options.max_steps = 2000;
+    options.restart_interval = 100;
+    int64_t solutions = 0;
+    LocalSearchStats stats =
+        local_search<{3, 4}>(cost, options, [&](State x, Uint1xN mask) {
+          CHECK(!is_zero(mask));
+          CHECK(is_zero(mul(mask, bit_not(sliced_equal(cost(x), 0)))));
+          solutions += reduce_add(popcount(mask));
+        });
+    CHECK_EQ(stats.steps, options.max_steps);
+    CHECK_EQ(stats.solutions, solutions);
+    // Every walker solves this many times over in 2000 steps.
+    CHECK(stats.solutions > Uint1xN::elem_count);
+    CHECK(stats.restarts >= stats.solutions);
+    CHECK(stats.accepted_moves > 0);
+  }
+};
+
+// With plateau moves disabled, no walker can cross a cost that is flat
+// everywhere except at the solution, so nothing gets solved by walking; with
+// plateau moves always on, walkers diffuse until they hit it.
+struct TestLocalSearchPlateau {
+  using State = Vector<Uint1xN, {6}>;
+  static void Run() {
+    auto cost = [](State x) {
+      Uint1xN all_set = Uint1xN::cst(1);
+      for (int i = 0; i < x.flatSize; ++i) {
+        all_set = mul(all_set, x.elems[i]);
+      }
+      UintKxN<1> c;
+      c.elems[0] = bit_not(all_set);
+      return c;
+    };
+    LocalSearchOptions options;
+    options.max_steps = 500;
+    options.restart_interval = 1 << 30;
+    auto ignore = [](State, Uint1xN) {};
+    options.plateau_log2 = 0;
+    int64_t diffusing = local_search<{6}>(cost, options, ignore).solutions;
+    options.plateau_log2 = 30;
+    int64_t stuck = local_search<{6}>(cost, options, ignore).solutions;
+    CHECK(diffusing > Uint1xN::elem_count);
+    // Only walkers that happened to start next to the solution.
+    CHECK(stuck < diffusing / 4);
+  }
+};
+
+// Walkers restart restart_interval steps after their own last improvement.
+// The low lanes improve at each of the first 5 steps and the others never
+// do, so that within 16 steps the others restart at step 10 and the low lanes
+// at step 15, and none of them twice.
+struct TestLocalSearchStallRestarts {
+  using State = Vector<Uint1xN, {4}>;
+  static void Run() {
+    int64_t calls = 0;
+    uint8_t low_bytes[sizeof(Uint1xN)] = {};
+    std::fill_n(low_bytes, sizeof low_bytes / 2, 0xFF);
+    Uint1xN low = Uint1xN::load(low_bytes);
+    auto cost = [&](State) {
+      ++calls;
+      return select(low, sliced_cst<7>(100 - std::min<int64_t>(calls, 6)),
+                    sliced_cst<7>(100));
+    };
+    LocalSearchOptions options;
+    options.max_steps = 16;
+    options.restart_interval = 10;
+    options.plateau_log2 = 30;
+    // Restarts evaluate the cost again, but on_step runs once per step.
+    int64_t steps = 0;
+    LocalSearchStats stats = local_search<{4}>(
+        cost, options, [](State, Uint1xN) {},
+        [&](const LocalSearchStats &s) { CHECK_EQ(s.steps, ++steps); });
+    CHECK_EQ(stats.solutions, 0);
+    CHECK_EQ(stats.restarts, Uint1xN::elem_count);
+    CHECK_EQ(steps, 16);
+    CHECK_EQ(calls, 19);
+    options.max_steps = 14;
+    calls = 0;
+    stats = local_search<{4}>(cost, options, [](State, Uint1xN) {});
+    CHECK_EQ(stats.restarts, Uint1xN::elem_count / 2);
+  }
+};
+
+int main() {
+  TEST(TestLocalSearchMatmul);
+  TEST(TestLocalSearchPlateau);
+  TEST(TestLocalSearchStallRestarts);
+}
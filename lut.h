@@ -0,0 +1,225 @@
+// Copyright 2024 The Hay Authors
+//
+// Licensed under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#ifndef HAY_LUT_H_
+#define HAY_LUT_H_
+
+#include "vector.h"
+
+#include <cstdint>
+#include <utility>
+
+// Lane-parallel evaluation of lookup tables known at compile time, on
+// bitsliced integers such as UintKxN: lane l of the result is table[x] for
+// the integer x in lane l of the input.
+//
+//   static constexpr LookupTable<4, 4> sbox = {{0xC, 0x5, 0x6, ...}};
+//   Vector<Uint1xN, {4}> y = lut<sbox>(x);
+//
+// Each output bit f of n input bits splits on its highest input as
+// f = f0 + x_{n-1} * (f0 + f1), f0 and f1 being its halves, recursively down
+// to constants. Subfunctions are shared across levels and output bits, so
+// that the network has one add, mul or madd per distinct one, and none for
+// those that do not depend on their highest input.
+
+template <int in_bits_, int out_bits_> struct LookupTable {
+  static constexpr int in_bits = in_bits_;
+  static constexpr int out_bits = out_bits_;
+  static_assert(in_bits >= 1 && in_bits <= 8);
+  static_assert(out_bits >= 1 && out_bits <= 64);
+  uint64_t values[1 << in_bits] = {};
+};
+
+namespace lut_internal {
+
+enum class Op : uint8_t { kInput, kZero, kOne, kAdd, kMul, kMadd };
+
+// Node i of a network computes op of the values of earlier nodes a, b and c,
+// or input a.
+struct Node {
+  Op op = Op::kZero;
+  int a = 0, b = 0, c = 0;
+};
+
+// A truth table of 2^level entries, bit i of words[i / 64] holding entry i.
+struct SubTable {
+  int level = 0;
+  uint64_t words[4] = {};
+
+  constexpr bool at(int i) const { return (words[i / 64] >> (i % 64)) & 1; }
+  constexpr void set(int i) { words[i / 64] |= uint64_t{1} << (i % 64); }
+  constexpr bool is_const(bool c) const {
+    for (int i = 0; i < (1 << level); ++i) {
+      if (at(i) != c) {
+        return false;
+      }
+    }
+    return true;
+  }
+  constexpr bool operator==(const SubTable &) const = default;
+};
+
+template <int max_nodes, int out_bits> struct Network {
+  Node nodes[max_nodes] = {};
+  int node_count = 0;
+  int input_count = 0;
+  int outputs[out_bits] = {};
+  // The subfunction that each node computes, while building.
+  SubTable functions[max_nodes] = {};
+
+  constexpr int push(Node node, SubTable f) {
+    nodes[node_count] = node;
+    functions[node_count] = f;
+    return node_count++;
+  }
+
+  // The node computing f, with inputs at nodes 0 to `level` - 1 and the
+  // constants 0 and 1 at the next two.
+  constexpr int build(SubTable f) {
+    if (f.is_const(false)) {
+      return const_node(false);
+    }
+    if (f.is_const(true)) {
+      return const_node(true);
+    }
+    // Halves f0 and f1, and their difference d.
+    int half = 1 << (f.level - 1);
+    SubTable f0{f.level - 1}, d{f.level - 1};
+    for (int i = 0; i < half; ++i) {
+      if (f.at(i)) {
+        f0.set(i);
+      }
+      if (f.at(i) != f.at(i + half)) {
+        d.set(i);
+      }
+    }
+    if (d.is_const(false)) {
+      return build(f0);
+    }
+    for (int i = input_count + 2; i < node_count; ++i) {
+      if (functions[i] == f) {
+        return i;
+      }
+    }
+    int x = f.level - 1;
+    int f0_node = build(f0);
+    int d_node = build(d);
+    if (f0.is_const(false)) {
+      if (d.is_const(true)) {
+        return x;
+      }
+      return push({Op::kMul, x, d_node}, f);
+    }
+    if (d.is_const(true)) {
+      return push({Op::kAdd, f0_node, x}, f);
+    }
+    return push({Op::kMadd, f0_node, x, d_node}, f);
+  }
+
+  constexpr int const_node(bool c) const { return input_count + c; }
+};
+
+template <auto table> constexpr auto build_network() {
+  constexpr int in_bits = table.in_bits;
+  constexpr int out_bits = table.out_bits;
+  Network<in_bits + 2 + 2 * out_bits * (1 << in_bits), out_bits> net;
+  net.input_count = in_bits;
+  for (int i = 0; i < in_bits; ++i) {
+    net.push({Op::kInput, i}, {});
+  }
+  net.push({Op::kZero}, {});
+  net.push({Op::kOne}, {});
+  for (int o = 0; o < out_bits; ++o) {
+    SubTable f{in_bits};
+    for (int i = 0; i < (1 << in_bits); ++i) {
+      if ((table.values[i] >> o) & 1) {
+        f.set(i);
+      }
+    }
+    net.outputs[o] = net.build(f);
+  }
+  return net;
+}
+
+// The network of `table`, with no room to spare.
+template <auto table> constexpr auto network() {
+  constexpr auto built = build_network<table>();
+  Network<built.node_count, table.out_bits> net;
+  net.node_count = built.node_count;
+  net.input_count = built.input_count;
+  for (int i = 0; i < built.node_count; ++i) {
+    net.nodes[i] = built.nodes[i];
+  }
+  for (int o = 0; o < table.out_bits; ++o) {
+    net.outputs[o] = built.outputs[o];
+  }
+  return net;
+}
+
+} // namespace lut_internal
+
+template <auto table, typename EType, Indices sizes>
+Vector<EType, {table.out_bits}> lut(Vector<EType, sizes> x) {
+  static_assert(sizes.size() == 1 && sizes[0] == table.in_bits);
+  using lut_internal::Op;
+  static constexpr auto net = lut_internal::network<table>();
+  EType values[net.node_count];
+  [&]<int... i>(std::integer_sequence<int, i...>) {
+    (
+        [&] {
+          constexpr lut_internal::Node node = net.nodes[i];
+          if constexpr (node.op == Op::kInput) {
+            values[i] = x.elems[node.a];
+          } else if constexpr (node.op == Op::kZero) {
+            values[i] = EType::cst(0);
+          } else if constexpr (node.op == Op::kOne) {
+            values[i] = EType::cst(1);
+          } else if constexpr (node.op == Op::kAdd) {
+            values[i] = add(values[node.a], values[node.b]);
+          } else if constexpr (node.op == Op::kMul) {
+            values[i] = mul(values[node.a], values[node.b]);
+          } else {
+            values[i] = madd(values[node.a], values[node.b], values[node.c]);
+          }
+        }(),
+        ...);
+  }(std::make_integer_sequence<int, net.node_count>());
+  Vector<EType, {table.out_bits}> y;
+  for (int o = 0; o < table.out_bits; ++o) {
+    y.elems[o] = values[net.outputs[o]];
+  }
+  return y;
+}
+
+// The same as lut, as the sum of the minterms of the inputs where each
+// output bit is set, e.g. to compare with.
+template <auto table, typename EType, Indices sizes>
+Vector<EType, {table.out_bits}> lut_minterms(Vector<EType, sizes> x) {
+  static_assert(sizes.size() == 1 && sizes[0] == table.in_bits);
+  constexpr int in_bits = table.in_bits;
+  EType not_x[in_bits];
+  for (int b = 0; b < in_bits; ++b) {
+    not_x[b] = add(x.elems[b], EType::cst(1));
+  }
+  Vector<EType, {table.out_bits}> y = decltype(y)::cst(0);
+  for (int i = 0; i < (1 << in_bits); ++i) {
+    if (table.values[i] == 0) {
+      continue;
+    }
+    EType minterm = i & 1 ? x.elems[0] : not_x[0];
+    for (int b = 1; b < in_bits; ++b) {
+      minterm = mul(minterm, (i >> b) & 1 ? x.elems[b] : not_x[b]);
+    }
+    for (int o = 0; o < table.out_bits; ++o) {
+      if ((table.values[i] >> o) & 1) {
+        y.elems[o] = add(y.elems[o], minterm);
+      }
+    }
+  }
+  return y;
+}
+
+#endif // HAY_LUT_H_
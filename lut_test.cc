@@ -0,0 +1,94 @@
+// Copyright 2024 The Hay Authors
+//
+// Licensed under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#include "lut.h"
+#include "op_count.h"
+#include "sliced_int.h"
+#include "testlib.h"
+
+#include <cstring>
+#include <random>
+
+// The S-box of PRESENT.
+static constexpr LookupTable<4, 4> present = {
+    {0xC, 0x5, 0x6, 0xB, 0x9, 0x0, 0xA, 0xD, 0x3, 0xE, 0xF, 0x8, 0x4, 0x7,
+     0x1, 0x2}};
+
+// S1 of DES, indexed by its 6 input bits as an integer.
+static constexpr LookupTable<6, 4> des_s1 = [] {
+  constexpr uint8_t rows[4][16] = {
+      {14, 4, 13, 1, 2, 15, 11, 8, 3, 10, 6, 12, 5, 9, 0, 7},
+      {0, 15, 7, 4, 14, 2, 13, 1, 10, 6, 12, 11, 9, 5, 3, 8},
+      {4, 1, 14, 8, 13, 6, 2, 11, 15, 12, 9, 7, 3, 10, 5, 0},
+      {15, 12, 8, 2, 4, 9, 1, 7, 5, 11, 3, 14, 10, 0, 6, 13}};
+  LookupTable<6, 4> t;
+  for (int i = 0; i < 64; ++i) {
+    t.values[i] = rows[(i >> 4 & 2) | (i & 1)][i >> 1 & 15];
+  }
+  return t;
+}();
+
+static constexpr LookupTable<3, 3> identity = {{0, 1, 2, 3, 4, 5, 6, 7}};
+
+// Constant, and wider out than in.
+static constexpr LookupTable<2, 9> wide = {{0x100, 0x1FF, 0x155, 0x0AA}};
+
+template <auto table> void checkLut() {
+  constexpr int in_bits = table.in_bits;
+  std::minstd_rand0 engine;
+  for (int iter = 0; iter < 4; ++iter) {
+    auto x = getRandom<UintKxN<in_bits>>(engine);
+    auto y = lut<table>(x);
+    CHECK_EQ(y, lut_minterms<table>(x));
+    for (int l = 0; l < Uint1xN::elem_count; ++l) {
+      CHECK_EQ(extract_uint(y, l), table.values[extract_uint(x, l)]);
+    }
+  }
+}
+
+struct TestLut {
+  static void Run() {
+    checkLut<present>();
+    checkLut<des_s1>();
+    checkLut<identity>();
+    checkLut<wide>();
+  }
+};
+
+template <auto table> OpCounts countLut(bool minterms) {
+  using C = Counted<Uint1xN>;
+  std::minstd_rand0 engine;
+  auto px = getRandom<UintKxN<table.in_bits>>(engine);
+  Vector<C, {table.in_bits}> x;
+  memcpy(&x, &px, sizeof x);
+  return count_ops([&] {
+    if (minterms) {
+      lut_minterms<table>(x);
+    } else {
+      lut<table>(x);
+    }
+  });
+}
+
+struct TestLutOpCounts {
+  static void Run() {
+    CHECK_EQ(countLut<present>(false), lut_op_count<present>());
+    CHECK_EQ(countLut<des_s1>(false), lut_op_count<des_s1>());
+    // The identity is its inputs.
+    constexpr OpCounts identity_count = lut_op_count<identity>();
+    static_assert(identity_count.total() == identity_count.cst);
+    // Far fewer ops than the sums of minterms.
+    CHECK(2 * lut_op_count<present>().total() <
+          countLut<present>(true).total());
+    CHECK(2 * lut_op_count<des_s1>().total() <
+          countLut<des_s1>(true).total());
+  }
+};
+
+int main() {
+  TEST(TestLut);
+  TEST(TestLutOpCounts);
+}
@@ -0,0 +1,177 @@
+// Copyright 2024 The Hay Authors
+//
+// Licensed under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#ifndef HAY_MATMUL_TENSOR_H_
+#define HAY_MATMUL_TENSOR_H_
+
+#include "const_tensor.h"
+#include "simd.h"
+#include "sliced_int.h"
+#include "vector.h"
+
+#include <algorithm>
+#include <bit>
+
+// The n x m x p matrix multiplication tensor over GF(2) and its rank-r
+// decompositions, in the cyclic convention: T[a, b, c] = 1 iff a = (i, j),
+// b = (j, k) and c = (k, i) for some i < n, j < m, k < p, where pairs are
+// flattened row-major. A rank-r decomposition is a triple of factor matrices
+// A, B, C of shapes {r, n*m}, {r, m*p}, {r, p*n} such that
+// T = sum over l of A[l] (x) B[l] (x) C[l].
+template <int n, int m, int p, int r> struct MatmulTensor {
+  static constexpr int a_size = n * m;
+  static constexpr int b_size = m * p;
+  static constexpr int c_size = p * n;
+
+  using Tensor = Vector<Uint1xN, {a_size, b_size, c_size}>;
+  using FactorA = Vector<Uint1xN, {r, a_size}>;
+  using FactorB = Vector<Uint1xN, {r, b_size}>;
+  using FactorC = Vector<Uint1xN, {r, c_size}>;
+  // A, B and C side by side, as enumerated or walked by searches.
+  static constexpr Indices<2> factor_sizes{r, a_size + b_size + c_size};
+  using Factors = Vector<Uint1xN, factor_sizes>;
+
+  static constexpr int cost_bits =
+      std::bit_width(unsigned{a_size * b_size * c_size});
+  using Cost = UintKxN<cost_bits>;
+
+  // The tensor as compile-time constants, for contract(constant<...>, v).
+  static constexpr ConstTensor<{a_size, b_size, c_size}> target_tensor = [] {
+    ConstTensor<{a_size, b_size, c_size}> t;
+    for (int i = 0; i < n; ++i) {
+      for (int j = 0; j < m; ++j) {
+        for (int k = 0; k < p; ++k) {
+          t.set({i * m + j, j * p + k, k * n + i});
+        }
+      }
+    }
+    return t;
+  }();
+
+  static Tensor target() { return to_vector<Uint1xN>(constant<target_tensor>); }
+
+  static void split(const Factors &f, FactorA &a, FactorB &b, FactorC &c) {
+    for (int l = 0; l < r; ++l) {
+      auto fl = row(f, l);
+      for (int x = 0; x < a_size; ++x) {
+        a.elems[l * a_size + x] = fl.elems[x];
+      }
+      for (int y = 0; y < b_size; ++y) {
+        b.elems[l * b_size + y] = fl.elems[a_size + y];
+      }
+      for (int z = 0; z < c_size; ++z) {
+        c.elems[l * c_size + z] = fl.elems[a_size + b_size + z];
+      }
+    }
+  }
+
+  static Tensor reconstruct(const FactorA &a, const FactorB &b,
+                            const FactorC &c) {
+    // Khatri-Rao product of A and B: row l is the outer product of A[l] and
+    // B[l], computed as a matmul of a column by a row.
+    Vector<Uint1xN, {r, a_size * b_size}> ab;
+    for (int l = 0; l < r; ++l) {
+      auto outer = matmul(reshape<{a_size, 1}>(row(a, l)),
+                          reshape<{1, b_size}>(row(b, l)));
+      insert_row(ab, reshape<{a_size * b_size}>(outer), l);
+    }
+    return reshape<{a_size, b_size, c_size}>(
+        matmul(transpose<{1, 0}>(ab), c));
+  }
+
+  static Tensor reconstruct(const Factors &f) {
+    FactorA a;
+    FactorB b;
+    FactorC c;
+    split(f, a, b, c);
+    return reconstruct(a, b, c);
+  }
+
+  // Per-lane number of entries where the decomposition is wrong.
+  static Cost cost(const Factors &f, const Tensor &target) {
+    return cost_khatri_rao(f, target);
+  }
+
+  // Variants of cost, which the auto-tuner picks from per shape and host, by
+  // their index in cost_kernel().
+  using CostKernel = Cost (*)(const Factors &, const Tensor &);
+  static constexpr int cost_kernel_count = 3;
+
+  static CostKernel cost_kernel(int kernel) {
+    static constexpr CostKernel kernels[cost_kernel_count] = {
+        cost_khatri_rao, cost_sliced, cost_blocked};
+    return kernels[kernel];
+  }
+
+  static const char *cost_kernel_name(int kernel) {
+    static constexpr const char *names[cost_kernel_count] = {
+        "khatri_rao", "sliced", "blocked"};
+    return names[kernel];
+  }
+
+  // Reconstructs the whole tensor through the Khatri-Rao product of A and B,
+  // as one large matmul.
+  static Cost cost_khatri_rao(const Factors &f, const Tensor &target) {
+    return sliced_weight<cost_bits>(add(reconstruct(f), target));
+  }
+
+  // Reconstructs the tensor one slice T[a] = (A[:, a] * B)^T C at a time,
+  // accumulating the cost, so that the working set is a slice.
+  static Cost cost_sliced(const Factors &f, const Tensor &target) {
+    FactorA a;
+    FactorB b;
+    FactorC c;
+    split(f, a, b, c);
+    constexpr int slice_size = b_size * c_size;
+    Cost total = Cost::cst(0);
+    for (int x = 0; x < a_size; ++x) {
+      Vector<Uint1xN, {b_size, r}> scaled;
+      for (int y = 0; y < b_size; ++y) {
+        for (int l = 0; l < r; ++l) {
+          scaled.elems[y * r + l] =
+              mul(a.elems[l * a_size + x], b.elems[l * b_size + y]);
+        }
+      }
+      Vector<Uint1xN, {b_size, c_size}> slice = matmul(scaled, c);
+      Vector<Uint1xN, {slice_size}> wrong;
+      for (int i = 0; i < slice_size; ++i) {
+        wrong.elems[i] =
+            add(slice.elems[i], target.elems[x * slice_size + i]);
+      }
+      total = sliced_add(total, sliced_weight<cost_bits>(wrong));
+    }
+    return total;
+  }
+
+  // Accumulates each fibre T[a, b, :] of the wrong entries in registers,
+  // starting from the target, over the rank-1 terms.
+  static Cost cost_blocked(const Factors &f, const Tensor &target) {
+    FactorA a;
+    FactorB b;
+    FactorC c;
+    split(f, a, b, c);
+    Tensor wrong;
+    for (int x = 0; x < a_size; ++x) {
+      for (int y = 0; y < b_size; ++y) {
+        Uint1xN *fibre = wrong.elems + (x * b_size + y) * c_size;
+        Uint1xN acc[c_size];
+        for (int z = 0; z < c_size; ++z) {
+          acc[z] = target.elems[(x * b_size + y) * c_size + z];
+        }
+        for (int l = 0; l < r; ++l) {
+          Uint1xN ab = mul(a.elems[l * a_size + x], b.elems[l * b_size + y]);
+          for (int z = 0; z < c_size; ++z) {
+            acc[z] = madd(acc[z], ab, c.elems[l * c_size + z]);
+          }
+        }
+        std::copy_n(acc, c_size, fibre);
+      }
+    }
+    return sliced_weight<cost_bits>(wrong);
+  }
+};
+
+#endif // HAY_MATMUL_TENSOR_H_
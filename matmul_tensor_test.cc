@@ -0,0 +1,117 @@
+// Copyright 2024 The Hay Authors
+//
+// Licensed under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#include "matmul_tensor.h"
+#include "testlib.h"
+
+struct TestMatmulTensorTarget {
+  static void Run() {
+    using M = MatmulTensor<2, 3, 4, 1>;
+    M::Tensor t = M::target();
+    CHECK_EQ(extract_uint(sliced_weight<8>(t), 0), uint64_t{2 * 3 * 4});
+    // a = (1, 2), b = (2, 3), c = (3, 1).
+    CHECK_EQ(t.elems[M::Tensor::flatten_indices({1 * 3 + 2, 2 * 4 + 3,
+                                                 3 * 2 + 1})],
+             Uint1xN::cst(1));
+    CHECK_EQ(t.elems[M::Tensor::flatten_indices({1 * 3 + 2, 2 * 4 + 3,
+                                                 3 * 2 + 0})],
+             Uint1xN::cst(0));
+  }
+};
+
+// The rank-nmp decomposition with one term per (i, j, k).
+struct TestMatmulTensorNaive {
+  static void Run() {
+    constexpr int n = 2, m = 2, p = 3;
+    using M = MatmulTensor<n, m, p, n * m * p>;
+    M::Factors f = M::Factors::cst(0);
+    int l = 0;
+    for (int i = 0; i < n; ++i) {
+      for (int j = 0; j < m; ++j) {
+        for (int k = 0; k < p; ++k, ++l) {
+          f.elems[M::Factors::flatten_indices({l, i * m + j})] =
+              Uint1xN::cst(1);
+          f.elems[M::Factors::flatten_indices({l, M::a_size + j * p + k})] =
+              Uint1xN::cst(1);
+          f.elems[M::Factors::flatten_indices(
+              {l, M::a_size + M::b_size + k * n + i})] = Uint1xN::cst(1);
+        }
+      }
+    }
+    CHECK_EQ(M::reconstruct(f), M::target());
+    CHECK_EQ(M::cost(f, M::target()), M::Cost::cst(0));
+  }
+};
+
+// Strassen's rank-7 decomposition of 2x2 matrix multiplication. Signs vanish
+// over GF(2).
+struct TestMatmulTensorStrassen {
+  using M = MatmulTensor<2, 2, 2, 7>;
+  static void set(M::Factors &f, int l, int offset, int i, int j) {
+    f.elems[M::Factors::flatten_indices({l, offset + 2 * i + j})] =
+        Uint1xN::cst(1);
+  }
+  static void Run() {
+    constexpr int a = 0, b = M::a_size, c = M::a_size + M::b_size;
+    M::Factors f = M::Factors::cst(0);
+    // Factors of C are indexed by (k, i) for the entry C_ik.
+    // M1 = (A11 + A22)(B11 + B22) -> C11, C22
+    set(f, 0, a, 0, 0), set(f, 0, a, 1, 1), set(f, 0, b, 0, 0);
+    set(f, 0, b, 1, 1), set(f, 0, c, 0, 0), set(f, 0, c, 1, 1);
+    // M2 = (A21 + A22) B11 -> C21, C22
+    set(f, 1, a, 1, 0), set(f, 1, a, 1, 1), set(f, 1, b, 0, 0);
+    set(f, 1, c, 0, 1), set(f, 1, c, 1, 1);
+    // M3 = A11 (B12 + B22) -> C12, C22
+    set(f, 2, a, 0, 0), set(f, 2, b, 0, 1), set(f, 2, b, 1, 1);
+    set(f, 2, c, 1, 0), set(f, 2, c, 1, 1);
+    // M4 = A22 (B21 + B11) -> C11, C21
+    set(f, 3, a, 1, 1), set(f, 3, b, 1, 0), set(f, 3, b, 0, 0);
+    set(f, 3, c, 0, 0), set(f, 3, c, 0, 1);
+    // M5 = (A11 + A12) B22 -> C11, C12
+    set(f, 4, a, 0, 0), set(f, 4, a, 0, 1), set(f, 4, b, 1, 1);
+    set(f, 4, c, 0, 0), set(f, 4, c, 1, 0);
+    // M6 = (A21 + A11)(B11 + B12) -> C22
+    set(f, 5, a, 1, 0), set(f, 5, a, 0, 0), set(f, 5, b, 0, 0);
+    set(f, 5, b, 0, 1), set(f, 5, c, 1, 1);
+    // M7 = (A12 + A22)(B21 + B22) -> C11
+    set(f, 6, a, 0, 1), set(f, 6, a, 1, 1), set(f, 6, b, 1, 0);
+    set(f, 6, b, 1, 1), set(f, 6, c, 0, 0);
+    CHECK_EQ(M::reconstruct(f), M::target());
+    // Breaking any single entry breaks the decomposition.
+    f.elems[0] = add(f.elems[0], Uint1xN::cst(1));
+    CHECK_NE(M::cost(f, M::target()), M::Cost::cst(0));
+  }
+};
+
+// Every cost kernel computes the same cost, on random factors, which are
+// mostly wrong, and on a solution.
+template <int n, int m, int p, int r> void checkCostKernels() {
+  using M = MatmulTensor<n, m, p, r>;
+  std::minstd_rand0 engine;
+  typename M::Tensor target = M::target();
+  for (int iter = 0; iter < 4; ++iter) {
+    auto f = getRandom<typename M::Factors>(engine);
+    typename M::Cost expected = M::cost(f, target);
+    for (int k = 0; k < M::cost_kernel_count; ++k) {
+      CHECK_EQ(M::cost_kernel(k)(f, target), expected);
+    }
+  }
+}
+
+struct TestMatmulTensorCostKernels {
+  static void Run() {
+    checkCostKernels<2, 2, 2, 7>();
+    checkCostKernels<2, 2, 3, 11>();
+    checkCostKernels<1, 2, 3, 5>();
+  }
+};
+
+int main() {
+  TEST(TestMatmulTensorTarget);
+  TEST(TestMatmulTensorNaive);
+  TEST(TestMatmulTensorStrassen);
+  TEST(TestMatmulTensorCostKernels);
+}
@@ -0,0 +1,90 @@
+// Copyright 2024 The Hay Authors
+//
+// Licensed under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#ifndef HAY_MITM_H_
+#define HAY_MITM_H_
+
+#include "hash_index.h"
+#include "simd.h"
+#include "slicing.h"
+#include "vector.h"
+
+#include <algorithm>
+#include <cstdint>
+
+struct MitmStats {
+  int64_t inserted = 0;
+  int64_t probed = 0;
+  int64_t matches = 0;
+};
+
+// Number of distinct candidates per chunk of Vector<Uint1xN, sizes>::seq:
+// when there are fewer candidates than lanes, the lanes past that are
+// repeats.
+template <Indices sizes> int seq_chunk_lanes() {
+  constexpr int flat_size = product(sizes);
+  return flat_size >= 31 ? Uint1xN::elem_count
+                         : std::min(Uint1xN::elem_count, 1 << flat_size);
+}
+
+// Meet-in-the-middle search for all pairs (a, b) of candidates such that
+// add(f(a), g(b)) == target, where a and b range over all of
+// Vector<Uint1xN, sizesA> and Vector<Uint1xN, sizesB>, as enumerated by
+// Vector::seq. This takes 2^|a| + 2^|b| evaluations instead of 2^(|a|+|b|).
+//
+// The f(a) are moved out of sliced form and inserted into a HashIndex, which
+// is then probed with the add(g(b), target), one chunk of lanes at a time.
+// For each match, calls on_match(a, b), where bit j of a is a.elems[j], and
+// likewise for b.
+template <Indices sizesA, Indices sizesB, Indices outSizes, typename F,
+          typename G, typename OnMatch>
+MitmStats mitm_search(F f, G g, Vector<uint8_t, outSizes> target,
+                      OnMatch on_match, const char *spill_path = nullptr) {
+  using VA = Vector<Uint1xN, sizesA>;
+  using VB = Vector<Uint1xN, sizesB>;
+  using VOut = Vector<Uint1xN, outSizes>;
+  static_assert(VA::flatSize < 63 && VB::flatSize < 63);
+  static_assert(VOut::flatSize < 64, "keys must leave HashIndex::empty_key");
+  constexpr int lanes = Uint1xN::elem_count;
+
+  MitmStats stats;
+  uint64_t keys[lanes];
+
+  int64_t chunks_a = seq_chunk_count<sizesA>();
+  int lanes_a = seq_chunk_lanes<sizesA>();
+  HashIndex index(int64_t{1} << VA::flatSize, spill_path);
+  for (int64_t i = 0; i < chunks_a; ++i) {
+    unslice(f(VA::seq(i)), keys);
+    for (int l = 0; l < lanes_a; ++l) {
+      index.insert(keys[l], i * lanes + l);
+    }
+    stats.inserted += lanes_a;
+  }
+
+  VOut target_sliced;
+  for (int j = 0; j < VOut::flatSize; ++j) {
+    target_sliced.elems[j] = Uint1xN::cst(target.elems[j]);
+  }
+  int64_t chunks_b = seq_chunk_count<sizesB>();
+  int lanes_b = seq_chunk_lanes<sizesB>();
+  for (int64_t i = 0; i < chunks_b; ++i) {
+    unslice(add(g(VB::seq(i)), target_sliced), keys);
+    for (int l = 0; l < lanes_b; ++l) {
+      index.prefetch(keys[l]);
+    }
+    for (int l = 0; l < lanes_b; ++l) {
+      uint64_t b = i * lanes + l;
+      index.find(keys[l], [&](uint64_t a) {
+        on_match(a, b);
+        ++stats.matches;
+      });
+    }
+    stats.probed += lanes_b;
+  }
+  return stats;
+}
+
+#endif // HAY_MITM_H_
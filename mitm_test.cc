@@ -0,0 +1,85 @@
+// Copyright 2024 The Hay Authors
+//
+// Licensed under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#include "mitm.h"
+#include "testlib.h"
+
+#include <set>
+#include <utility>
+#include <vector>
+
+// Bit j of `bits` as the flat element j of a scalar Vector.
+template <Indices sizes> Vector<uint8_t, sizes> unpack(uint64_t bits) {
+  Vector<uint8_t, sizes> result;
+  for (int j = 0; j < result.flatSize; ++j) {
+    result.elems[j] = (bits >> j) & 1;
+  }
+  return result;
+}
+
+template <Indices sizes> Vector<Uint1xN, sizes> broadcast(uint64_t bits) {
+  Vector<Uint1xN, sizes> result;
+  for (int j = 0; j < result.flatSize; ++j) {
+    result.elems[j] = Uint1xN::cst((bits >> j) & 1);
+  }
+  return result;
+}
+
+// Finds the pairs of a 2xn matrix a and an nx2 matrix b such that
+// a * k1 + k2 * b equals a given 2x2 target, for fixed k1 and k2.
+template <int n> struct TestMitmMatmul {
+  static constexpr int m = 2;
+  using A = Vector<Uint1xN, {2, n}>;
+  using B = Vector<Uint1xN, {n, m}>;
+  using Out = Vector<Uint1xN, {2, m}>;
+
+  static void Run() {
+    std::minstd_rand0 engine;
+    const uint64_t k1_bits = engine();
+    const uint64_t k2_bits = engine();
+    const uint64_t target_bits = engine() & 0xF;
+    auto k1 = broadcast<{n, m}>(k1_bits);
+    auto k2 = broadcast<{2, n}>(k2_bits);
+    auto f = [&](A a) -> Out { return matmul(a, k1); };
+    auto g = [&](B b) -> Out { return matmul(k2, b); };
+    std::set<std::pair<uint64_t, uint64_t>> found;
+    MitmStats stats = mitm_search<{2, n}, {n, m}>(
+        f, g, unpack<{2, m}>(target_bits),
+        [&](uint64_t a, uint64_t b) { found.insert({a, b}); });
+    CHECK_EQ(stats.inserted, int64_t{1} << A::flatSize);
+    CHECK_EQ(stats.probed, int64_t{1} << B::flatSize);
+    CHECK_EQ(stats.matches, static_cast<int64_t>(found.size()));
+
+    // Brute force on lane 0, with f and g outputs packed as bits.
+    auto pack = [](Vector<uint8_t, {2, m}> x) {
+      uint64_t bits = 0;
+      for (int j = 0; j < x.flatSize; ++j) {
+        bits |= uint64_t{x.elems[j]} << j;
+      }
+      return bits;
+    };
+    std::vector<uint64_t> gb(uint64_t{1} << B::flatSize);
+    for (uint64_t b = 0; b < gb.size(); ++b) {
+      gb[b] = pack(extract(g(broadcast<{n, m}>(b)), 0));
+    }
+    int64_t expected = 0;
+    for (uint64_t a = 0; a < (uint64_t{1} << A::flatSize); ++a) {
+      uint64_t fa = pack(extract(f(broadcast<{2, n}>(a)), 0));
+      for (uint64_t b = 0; b < gb.size(); ++b) {
+        if ((fa ^ gb[b]) == target_bits) {
+          ++expected;
+          CHECK(found.count({a, b}));
+        }
+      }
+    }
+    CHECK_EQ(static_cast<int64_t>(found.size()), expected);
+  }
+};
+
+int main() {
+  TEST(TestMitmMatmul<2>);
+  TEST(TestMitmMatmul<5>);
+}
@@ -0,0 +1,369 @@
+// Copyright 2024 The Hay Authors
+//
+// Licensed under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#ifndef HAY_OP_COUNT_H_
+#define HAY_OP_COUNT_H_
+
+#include "const_tensor.h"
+#include "lut.h"
+#include "simd.h"
+#include "vector.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <fmt/format.h>
+#include <mutex>
+#include <source_location>
+#include <string>
+#include <vector>
+
+// Op-count profiling of Vector kernels. Instantiating a kernel with
+// Counted<Uint1xN> and Counted<Int64xN> instead of Uint1xN and Int64xN counts
+// the primitive ops it executes, per thread, and OpCountScope attributes them
+// to call sites:
+//
+//   using V = Vector<Counted<Uint1xN>, {8, 8}>;
+//   {
+//     OpCountScope scope("matmul 8x8x8");
+//     matmul(x, y);
+//   }
+//   print_op_counts();
+//
+// For static shapes, the *_op_count functions below compute the same counts
+// at compile time, so that kernel variants can be compared without timing.
+
+struct OpCounts {
+  int64_t cst = 0;
+  int64_t seq = 0;
+  int64_t load = 0;
+  int64_t store = 0;
+  int64_t add = 0;
+  int64_t sub = 0;
+  int64_t min = 0;
+  int64_t max = 0;
+  int64_t mul = 0;
+  int64_t madd = 0;
+  int64_t popcount = 0;
+  int64_t reduce_add = 0;
+  int64_t extract = 0;
+  int64_t compare = 0;
+
+  constexpr int64_t total() const {
+    return cst + seq + load + store + add + sub + min + max + mul + madd +
+           popcount + reduce_add + extract + compare;
+  }
+
+  friend constexpr OpCounts operator+(OpCounts x, OpCounts y) {
+    return {x.cst + y.cst,           x.seq + y.seq,
+            x.load + y.load,         x.store + y.store,
+            x.add + y.add,           x.sub + y.sub,
+            x.min + y.min,           x.max + y.max,
+            x.mul + y.mul,           x.madd + y.madd,
+            x.popcount + y.popcount, x.reduce_add + y.reduce_add,
+            x.extract + y.extract,   x.compare + y.compare};
+  }
+
+  friend constexpr OpCounts operator-(OpCounts x, OpCounts y) {
+    return {x.cst - y.cst,           x.seq - y.seq,
+            x.load - y.load,         x.store - y.store,
+            x.add - y.add,           x.sub - y.sub,
+            x.min - y.min,           x.max - y.max,
+            x.mul - y.mul,           x.madd - y.madd,
+            x.popcount - y.popcount, x.reduce_add - y.reduce_add,
+            x.extract - y.extract,   x.compare - y.compare};
+  }
+
+  friend constexpr bool operator==(const OpCounts &,
+                                   const OpCounts &) = default;
+};
+
+template <> struct fmt::formatter<OpCounts> {
+  template <typename FormatContext>
+  auto format(const OpCounts &c, FormatContext &ctx) const {
+    return fmt::format_to(
+        ctx.out(),
+        "{{cst: {}, seq: {}, load: {}, store: {}, add: {}, sub: {}, min: {}, "
+        "max: {}, mul: {}, madd: {}, popcount: {}, reduce_add: {}, "
+        "extract: {}, compare: {}}}",
+        c.cst, c.seq, c.load, c.store, c.add, c.sub, c.min, c.max, c.mul,
+        c.madd, c.popcount, c.reduce_add, c.extract, c.compare);
+  }
+  constexpr auto parse(fmt::format_parse_context &ctx) { return ctx.begin(); }
+};
+
+// Ops executed so far by Counted types on this thread.
+inline thread_local OpCounts thread_op_counts;
+
+// Wraps an EType, counting each primitive op in thread_op_counts. Has the
+// same size and layout as E.
+template <typename E> struct Counted {
+  static constexpr int elem_bits = E::elem_bits;
+  static constexpr int elem_count = E::elem_count;
+  static constexpr int radix = seq_radix<E>;
+  E val;
+
+  static Counted cst(ScalarType<E> c) {
+    ++thread_op_counts.cst;
+    return {E::cst(c)};
+  }
+  static Counted seq(int i) {
+    ++thread_op_counts.seq;
+    return {E::seq(i)};
+  }
+  static Counted load(const void *from) {
+    ++thread_op_counts.load;
+    return {E::load(from)};
+  }
+  friend void store(void *to, Counted x) {
+    ++thread_op_counts.store;
+    store(to, x.val);
+  }
+  friend Counted add(Counted x, Counted y) {
+    ++thread_op_counts.add;
+    return {add(x.val, y.val)};
+  }
+  friend Counted sub(Counted x, Counted y) {
+    ++thread_op_counts.sub;
+    return {sub(x.val, y.val)};
+  }
+  friend Counted min(Counted x, Counted y) {
+    ++thread_op_counts.min;
+    return {min(x.val, y.val)};
+  }
+  friend Counted max(Counted x, Counted y) {
+    ++thread_op_counts.max;
+    return {max(x.val, y.val)};
+  }
+  friend Counted mul(Counted x, Counted y) {
+    ++thread_op_counts.mul;
+    return {mul(x.val, y.val)};
+  }
+  friend Counted madd(Counted x, Counted y, Counted z) {
+    ++thread_op_counts.madd;
+    return {madd(x.val, y.val, z.val)};
+  }
+  friend Counted<typename Int64EType<E>::Type> popcount(Counted x) {
+    ++thread_op_counts.popcount;
+    return {popcount(x.val)};
+  }
+  // Returns what E's reduce_add does, which widens for narrow types.
+  friend auto reduce_add(Counted x) {
+    ++thread_op_counts.reduce_add;
+    return reduce_add(x.val);
+  }
+  friend ScalarType<E> extract(Counted x, int i) {
+    ++thread_op_counts.extract;
+    return extract(x.val, i);
+  }
+  friend bool operator==(Counted x, Counted y) {
+    ++thread_op_counts.compare;
+    return x.val == y.val;
+  }
+};
+
+template <typename E> struct ScalarTypeImpl<Counted<E>> {
+  using Type = ScalarType<E>;
+};
+
+template <typename E> struct Int64EType<Counted<E>> {
+  using Type = Counted<typename Int64EType<E>::Type>;
+};
+
+template <typename E> struct fmt::formatter<Counted<E>> : fmt::formatter<E> {
+  template <typename FormatContext>
+  auto format(const Counted<E> &x, FormatContext &ctx) const {
+    return fmt::formatter<E>::format(x.val, ctx);
+  }
+};
+
+// Returns the ops that f() executes on this thread.
+template <typename F> OpCounts count_ops(F f) {
+  OpCounts start = thread_op_counts;
+  f();
+  return thread_op_counts - start;
+}
+
+struct OpCountSite {
+  std::string label;
+  std::string file;
+  int line;
+  int64_t calls;
+  OpCounts counts;
+};
+
+struct OpCountRegistry {
+  std::mutex mutex;
+  std::vector<OpCountSite> sites;
+};
+
+inline OpCountRegistry &op_count_registry() {
+  static OpCountRegistry registry;
+  return registry;
+}
+
+// Attributes the ops executed on this thread during its lifetime to its call
+// site and label. Nested scopes count inclusively.
+class OpCountScope {
+public:
+  explicit OpCountScope(
+      const char *label = "",
+      std::source_location location = std::source_location::current())
+      : label(label), location(location), start(thread_op_counts) {}
+
+  ~OpCountScope() {
+    OpCounts counts = thread_op_counts - start;
+    OpCountRegistry &r = op_count_registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    for (OpCountSite &site : r.sites) {
+      if (site.line == static_cast<int>(location.line()) &&
+          site.label == label && site.file == location.file_name()) {
+        ++site.calls;
+        site.counts = site.counts + counts;
+        return;
+      }
+    }
+    r.sites.push_back({label, location.file_name(),
+                       static_cast<int>(location.line()), 1, counts});
+  }
+
+  OpCountScope(const OpCountScope &) = delete;
+  OpCountScope &operator=(const OpCountScope &) = delete;
+
+private:
+  const char *label;
+  std::source_location location;
+  OpCounts start;
+};
+
+inline std::vector<OpCountSite> op_count_sites() {
+  OpCountRegistry &r = op_count_registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  return r.sites;
+}
+
+inline void reset_op_counts() {
+  OpCountRegistry &r = op_count_registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  r.sites.clear();
+}
+
+// Prints, per call site, the ops per call of each kind executed at least
+// once.
+inline void print_op_counts(FILE *out = stdout) {
+  for (const OpCountSite &site : op_count_sites()) {
+    std::string file = site.file.substr(site.file.rfind('/') + 1);
+    fmt::print(out, "{}:{} {} ({} calls):", file, site.line, site.label,
+               site.calls);
+    const OpCounts &c = site.counts;
+    const std::pair<const char *, int64_t> kinds[] = {
+        {"cst", c.cst},           {"seq", c.seq},
+        {"load", c.load},         {"store", c.store},
+        {"add", c.add},           {"sub", c.sub},
+        {"min", c.min},           {"max", c.max},
+        {"mul", c.mul},           {"madd", c.madd},
+        {"popcount", c.popcount}, {"reduce_add", c.reduce_add},
+        {"extract", c.extract},   {"compare", c.compare}};
+    for (const auto &[name, count] : kinds) {
+      if (count) {
+        fmt::print(out, " {} {:.6g}", name, double(count) / site.calls);
+      }
+    }
+    fmt::print(out, "\n");
+  }
+}
+
+// Compile-time op counts of the vector.h implementations, for EType ops.
+
+template <Indices sizes> constexpr OpCounts cst_op_count() {
+  OpCounts c;
+  c.cst = product(sizes);
+  return c;
+}
+
+template <typename EType, Indices sizes> constexpr OpCounts seq_op_count() {
+  int flat_size = product(sizes);
+  int lane_digits = std::min<int>(flat_size, seq_lane_digits<EType>());
+  OpCounts c;
+  c.seq = lane_digits;
+  c.cst = flat_size - lane_digits;
+  return c;
+}
+
+// Elementwise ops (add, mul, madd, popcount...) execute one EType op per
+// element.
+template <Indices sizes> constexpr int64_t elementwise_op_count() {
+  return product(sizes);
+}
+
+template <Indices sizes, Indices permutation>
+constexpr OpCounts transpose_op_count() {
+  return {};
+}
+
+template <Indices sizes, Indices newSizes>
+constexpr OpCounts reshape_op_count() {
+  return {};
+}
+
+// contract<c0, c1>(x).
+template <Index c0, Index c1, Indices sizes>
+constexpr OpCounts contract_op_count() {
+  OpCounts c = cst_op_count<drop(sizes, Indices{c0, c1})>();
+  c.add = product(sizes) / sizes[c0];
+  return c;
+}
+
+// contract<c1, c2>(x, y).
+template <Index c1, Index c2, Indices sizes1, Indices sizes2>
+constexpr OpCounts contract_op_count() {
+  OpCounts c = cst_op_count<concat(drop(sizes1, Indices{c1}),
+                                   drop(sizes2, Indices{c2}))>();
+  c.madd = int64_t{product(sizes1)} * product(sizes2) / sizes1[c1];
+  return c;
+}
+
+template <Indices sizes1, Indices sizes2>
+constexpr OpCounts matmul_op_count() {
+  return contract_op_count<1, 0, sizes1, sizes2>();
+}
+
+// contract<c1, c2>(constant<t>, y) for y of sizes var_sizes, or, if not
+// const_first, contract<c1, c2>(x, constant<t>) for x of sizes var_sizes.
+template <Index c1, Index c2, auto t, Indices var_sizes,
+          bool const_first = true>
+constexpr OpCounts const_contract_op_count() {
+  constexpr auto const_sizes = ConstTensorOf<t>::shape;
+  constexpr auto terms = [] {
+    if constexpr (const_first) {
+      return const_tensor_internal::contraction_terms<t, true, const_sizes, c1,
+                                                      var_sizes, c2>();
+    } else {
+      return const_tensor_internal::contraction_terms<t, false, var_sizes, c1,
+                                                      const_sizes, c2>();
+    }
+  }();
+  OpCounts c;
+  c.cst = terms.zero_count();
+  c.add = terms.add_count();
+  return c;
+}
+
+// lut<table>(x), including the cst of its 0 and 1 nodes.
+template <auto table> constexpr OpCounts lut_op_count() {
+  constexpr auto net = lut_internal::network<table>();
+  OpCounts c;
+  for (int i = 0; i < net.node_count; ++i) {
+    c.cst += net.nodes[i].op == lut_internal::Op::kZero ||
+             net.nodes[i].op == lut_internal::Op::kOne;
+    c.add += net.nodes[i].op == lut_internal::Op::kAdd;
+    c.mul += net.nodes[i].op == lut_internal::Op::kMul;
+    c.madd += net.nodes[i].op == lut_internal::Op::kMadd;
+  }
+  return c;
+}
+
+#endif // HAY_OP_COUNT_H_
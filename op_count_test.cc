@@ -0,0 +1,120 @@
+// Copyright 2024 The Hay Authors
+//
+// Licensed under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#include "op_count.h"
+#include "testlib.h"
+
+#include <cstring>
+#include <random>
+#include <type_traits>
+
+using CUint1xN = Counted<Uint1xN>;
+using CInt64xN = Counted<Int64xN>;
+
+template <typename E> struct GetRandomImpl<Counted<E>> {
+  static Counted<E> Run(std::minstd_rand0 &engine) {
+    return {getRandom<E>(engine)};
+  }
+};
+
+struct TestCountedMatchesUncounted {
+  static void Run() {
+    std::minstd_rand0 engine;
+    using V = Vector<CUint1xN, {4, 6}>;
+    using W = Vector<CUint1xN, {6, 5}>;
+    using PlainV = Vector<Uint1xN, {4, 6}>;
+    using PlainW = Vector<Uint1xN, {6, 5}>;
+    V x = getRandom<V>(engine);
+    W y = getRandom<W>(engine);
+    PlainV px;
+    PlainW py;
+    memcpy(&px, &x, sizeof px);
+    memcpy(&py, &y, sizeof py);
+    auto z = matmul(x, y);
+    auto pz = matmul(px, py);
+    CHECK_EQ(memcmp(&z, &pz, sizeof z), 0);
+  }
+};
+
+struct TestOpCountEstimates {
+  static void Run() {
+    std::minstd_rand0 engine;
+    {
+      auto x = getRandom<Vector<CUint1xN, {8, 8}>>(engine);
+      auto y = getRandom<Vector<CUint1xN, {8, 8}>>(engine);
+      OpCounts counts = count_ops([&] { matmul(x, y); });
+      constexpr OpCounts expected = matmul_op_count<{8, 8}, {8, 8}>();
+      static_assert(expected.madd == 8 * 8 * 8);
+      CHECK_EQ(counts, expected);
+    }
+    {
+      auto x = getRandom<Vector<CUint1xN, {3, 4, 5}>>(engine);
+      auto y = getRandom<Vector<CUint1xN, {5, 2}>>(engine);
+      OpCounts counts = count_ops([&] { contract<2, 0>(x, y); });
+      CHECK_EQ(counts, (contract_op_count<2, 0, {3, 4, 5}, {5, 2}>()));
+    }
+    {
+      auto x = getRandom<Vector<CUint1xN, {4, 3, 4}>>(engine);
+      OpCounts counts = count_ops([&] { contract<0, 2>(x); });
+      CHECK_EQ(counts, (contract_op_count<0, 2, {4, 3, 4}>()));
+    }
+    {
+      auto x = getRandom<Vector<CUint1xN, {4, 8}>>(engine);
+      OpCounts counts = count_ops([&] { transpose<{1, 0}>(x); });
+      CHECK_EQ(counts, (transpose_op_count<{4, 8}, {1, 0}>()));
+      CHECK_EQ(counts.total(), 0);
+    }
+    {
+      OpCounts counts = count_ops([&] { Vector<CUint1xN, {16}>::seq(3); });
+      CHECK_EQ(counts, (seq_op_count<Uint1xN, {16}>()));
+    }
+    {
+      auto x = getRandom<Vector<CUint1xN, {5, 3}>>(engine);
+      OpCounts counts = count_ops([&] { reduce_add(popcount(x)); });
+      CHECK_EQ(counts.popcount, (elementwise_op_count<{5, 3}>()));
+      CHECK_EQ(counts.reduce_add, (elementwise_op_count<{5, 3}>()));
+    }
+  }
+};
+
+struct TestCountedReduceAddWidens {
+  static void Run() {
+    using CInt8xN = Counted<Int8xN>;
+    auto x = CInt8xN::cst(100);
+    auto sum = reduce_add(x);
+    static_assert(std::is_same_v<decltype(sum), decltype(reduce_add(x.val))>);
+    CHECK_EQ(sum, int64_t{100} * Int8xN::elem_count);
+    CHECK_EQ(reduce_add(Counted<Int16xN>::cst(-30000)),
+             int64_t{-30000} * Int16xN::elem_count);
+  }
+};
+
+struct TestOpCountScope {
+  static void Run() {
+    reset_op_counts();
+    auto x = Vector<CInt64xN, {10}>::cst(1);
+    for (int i = 0; i < 3; ++i) {
+      OpCountScope scope("add");
+      x = add(x, x);
+    }
+    std::vector<OpCountSite> sites = op_count_sites();
+    CHECK_EQ(sites.size(), size_t{1});
+    CHECK_EQ(sites[0].label, std::string("add"));
+    CHECK_EQ(sites[0].calls, 3);
+    CHECK_EQ(sites[0].counts.add, 30);
+    CHECK_EQ(sites[0].counts.total(), 30);
+    CHECK(sites[0].file.ends_with("op_count_test.cc"));
+    reset_op_counts();
+    CHECK(op_count_sites().empty());
+  }
+};
+
+int main() {
+  TEST(TestCountedMatchesUncounted);
+  TEST(TestOpCountEstimates);
+  TEST(TestCountedReduceAddWidens);
+  TEST(TestOpCountScope);
+}
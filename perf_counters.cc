@@ -0,0 +1,399 @@
+// Copyright 2024 The Hay Authors
+//
+// Licensed under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#include "perf_counters.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fmt/format.h>
+#include <mutex>
+#include <string_view>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+using perf_counters_internal::max_counters;
+using perf_counters_internal::sample_size;
+
+namespace perf_counters_internal {
+std::atomic<bool> enabled{false};
+} // namespace perf_counters_internal
+
+namespace {
+
+struct CounterSpec {
+  std::string name;
+  uint32_t type;
+  uint64_t config;
+};
+
+struct RegionTotals {
+  int64_t calls = 0;
+  int64_t lanes = 0;
+  int64_t nanoseconds = 0;
+  int64_t counters[max_counters] = {};
+
+  void add(const RegionTotals &other) {
+    calls += other.calls;
+    lanes += other.lanes;
+    nanoseconds += other.nanoseconds;
+    for (int i = 0; i < max_counters; ++i) {
+      counters[i] += other.counters[i];
+    }
+  }
+};
+
+class ThreadCounters;
+
+struct Registry {
+  std::mutex mutex;
+  std::vector<std::string> region_names;
+  // Decided by enablePerfCounters(); threads open them lazily.
+  std::vector<CounterSpec> specs;
+  std::atomic<int64_t> specs_generation{0};
+  std::vector<ThreadCounters *> threads;
+  // Totals of exited threads.
+  std::vector<RegionTotals> retired;
+};
+
+// Never destroyed, as thread exit and static initialization use it.
+Registry &registry() {
+  static Registry *r = new Registry;
+  return *r;
+}
+
+#ifdef __linux__
+
+int openCounter(const CounterSpec &spec, int group_fd) {
+  perf_event_attr attr;
+  memset(&attr, 0, sizeof attr);
+  attr.size = sizeof attr;
+  attr.type = spec.type;
+  attr.config = spec.config;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                     PERF_FORMAT_TOTAL_TIME_RUNNING;
+  return syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0);
+}
+
+void closeCounter(int fd) { close(fd); }
+
+std::vector<CounterSpec> candidateSpecs() {
+  std::vector<CounterSpec> specs = {
+      {"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+      {"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+      {"l1d_read_misses", PERF_TYPE_HW_CACHE,
+       PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+           (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+  };
+  // name=config pairs, e.g. HAY_PERF_RAW=port0=0x1a1,port1=0x2a1.
+  if (const char *raw = getenv("HAY_PERF_RAW")) {
+    std::string_view list = raw;
+    while (!list.empty()) {
+      std::string_view item = list.substr(0, list.find(','));
+      list.remove_prefix(std::min(list.size(), item.size() + 1));
+      size_t eq = item.find('=');
+      if (eq == std::string_view::npos) {
+        fmt::print(stderr, "HAY_PERF_RAW: expected name=config, got {}\n",
+                   item);
+        continue;
+      }
+      std::string config(item.substr(eq + 1));
+      specs.push_back({std::string(item.substr(0, eq)), PERF_TYPE_RAW,
+                       strtoull(config.c_str(), nullptr, 0)});
+    }
+  }
+  return specs;
+}
+
+#else
+
+int openCounter(const CounterSpec &, int) {
+  errno = ENOSYS;
+  return -1;
+}
+
+void closeCounter(int) {}
+
+std::vector<CounterSpec> candidateSpecs() {
+  return {{"cycles", 0, 0}};
+}
+
+#endif // __linux__
+
+// The counters of one thread, as a perf event group led by cycles, and the
+// totals of the regions it entered.
+class ThreadCounters {
+public:
+  ThreadCounters() {
+    Registry &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    r.threads.push_back(this);
+  }
+
+  ~ThreadCounters() {
+    close();
+    Registry &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    r.threads.erase(std::find(r.threads.begin(), r.threads.end(), this));
+    if (r.retired.size() < regions.size()) {
+      r.retired.resize(regions.size());
+    }
+    for (size_t i = 0; i < regions.size(); ++i) {
+      r.retired[i].add(regions[i]);
+    }
+  }
+
+  void read(uint64_t *values) {
+    std::fill(values, values + max_counters, 0);
+    values[max_counters] =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    if (generation != registry().specs_generation) {
+      open();
+    }
+    if (fds.empty() || fds[0] < 0) {
+      return;
+    }
+    struct {
+      uint64_t nr;
+      uint64_t time_enabled;
+      uint64_t time_running;
+      uint64_t values[max_counters];
+    } data;
+    if (::read(fds[0], &data, sizeof data) <= 0) {
+      return;
+    }
+    // Scale up if the kernel multiplexed the group with other events.
+    double scale =
+        data.time_running > 0 && data.time_running < data.time_enabled
+            ? double(data.time_enabled) / data.time_running
+            : 1.0;
+    for (size_t i = 0; i < fds.size(); ++i) {
+      if (slots[i] >= 0) {
+        values[i] = data.values[slots[i]] * scale;
+      }
+    }
+  }
+
+  void add(int region, const uint64_t *start, const uint64_t *end,
+           int64_t lanes) {
+    if (static_cast<int>(regions.size()) <= region) {
+      regions.resize(region + 1);
+    }
+    RegionTotals &totals = regions[region];
+    ++totals.calls;
+    totals.lanes += lanes;
+    totals.nanoseconds += end[max_counters] - start[max_counters];
+    for (int i = 0; i < max_counters; ++i) {
+      totals.counters[i] += end[i] - start[i];
+    }
+  }
+
+  std::vector<RegionTotals> regions;
+
+private:
+  void open() {
+    close();
+    std::vector<CounterSpec> specs;
+    {
+      Registry &r = registry();
+      std::lock_guard<std::mutex> lock(r.mutex);
+      specs = r.specs;
+      generation = r.specs_generation.load();
+    }
+    // Counters failing to open in this thread read as 0.
+    int opened = 0;
+    for (const CounterSpec &spec : specs) {
+      int fd = openCounter(spec, fds.empty() ? -1 : fds[0]);
+      fds.push_back(fd);
+      slots.push_back(fd >= 0 ? opened++ : -1);
+      if (fds[0] < 0) {
+        break;
+      }
+    }
+  }
+
+  void close() {
+    for (int fd : fds) {
+      if (fd >= 0) {
+        closeCounter(fd);
+      }
+    }
+    fds.clear();
+    slots.clear();
+  }
+
+  int64_t generation = 0;
+  std::vector<int> fds;
+  // Position of each counter in the group read, or -1.
+  std::vector<int> slots;
+};
+
+ThreadCounters &threadCounters() {
+  thread_local ThreadCounters counters;
+  return counters;
+}
+
+// Honors $HAY_PERF at startup.
+[[maybe_unused]] bool enabled_from_env =
+    getenv("HAY_PERF") && enablePerfCounters();
+
+} // namespace
+
+PerfRegion::PerfRegion(const char *name) {
+  Registry &r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  index = r.region_names.size();
+  r.region_names.push_back(name);
+}
+
+void perf_counters_internal::begin(uint64_t *start) {
+  threadCounters().read(start);
+}
+
+void perf_counters_internal::end(int region, const uint64_t *start,
+                                 int64_t lanes) {
+  uint64_t now[sample_size];
+  ThreadCounters &counters = threadCounters();
+  counters.read(now);
+  counters.add(region, start, now, lanes);
+}
+
+bool enablePerfCounters() {
+  // Keep the counters that open in this thread. Without cycles, the group
+  // leader, there are none.
+  std::vector<CounterSpec> specs;
+  int leader = -1;
+  for (const CounterSpec &spec : candidateSpecs()) {
+    int fd = openCounter(spec, leader);
+    if (fd < 0) {
+      fmt::print(stderr, "perf counter {} unavailable: {}\n", spec.name,
+                 strerror(errno));
+      if (leader < 0) {
+        break;
+      }
+      continue;
+    }
+    if (leader < 0) {
+      leader = fd;
+    } else {
+      closeCounter(fd);
+    }
+    specs.push_back(spec);
+    if (static_cast<int>(specs.size()) == max_counters) {
+      break;
+    }
+  }
+  if (leader >= 0) {
+    closeCounter(leader);
+  }
+  bool available = !specs.empty();
+  {
+    Registry &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    r.specs = std::move(specs);
+    ++r.specs_generation;
+  }
+  perf_counters_internal::enabled.store(true, std::memory_order_relaxed);
+  return available;
+}
+
+void disablePerfCounters() {
+  perf_counters_internal::enabled.store(false, std::memory_order_relaxed);
+}
+
+bool perfCountersEnabled() {
+  return perf_counters_internal::enabled.load(std::memory_order_relaxed);
+}
+
+std::vector<std::string> perfCounterNames() {
+  Registry &r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  std::vector<std::string> names;
+  for (const CounterSpec &spec : r.specs) {
+    names.push_back(spec.name);
+  }
+  return names;
+}
+
+std::vector<PerfRegionStats> perfRegionStats() {
+  Registry &r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  std::vector<RegionTotals> totals = r.retired;
+  totals.resize(r.region_names.size());
+  for (ThreadCounters *t : r.threads) {
+    for (size_t i = 0; i < t->regions.size(); ++i) {
+      totals[i].add(t->regions[i]);
+    }
+  }
+  std::vector<PerfRegionStats> stats;
+  for (size_t i = 0; i < totals.size(); ++i) {
+    PerfRegionStats s;
+    s.name = r.region_names[i];
+    s.calls = totals[i].calls;
+    s.lanes = totals[i].lanes;
+    s.nanoseconds = totals[i].nanoseconds;
+    std::copy(totals[i].counters, totals[i].counters + max_counters,
+              s.counters);
+    stats.push_back(s);
+  }
+  return stats;
+}
+
+void resetPerfCounters() {
+  Registry &r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  r.retired.clear();
+  for (ThreadCounters *t : r.threads) {
+    t->regions.clear();
+  }
+}
+
+void printPerfReport(FILE *out) {
+  std::vector<std::string> names = perfCounterNames();
+  bool have_cycles = !names.empty();
+  bool have_ipc = names.size() > 1 && names[1] == "instructions";
+  fmt::print(out, "{:<24} {:>10} {:>10}", "region", "calls", "ms");
+  for (const std::string &name : names) {
+    fmt::print(out, " {:>16}", name);
+  }
+  if (have_ipc) {
+    fmt::print(out, " {:>6}", "IPC");
+  }
+  fmt::print(out, " {:>12}\n", have_cycles ? "cycles/lane" : "ns/lane");
+  // Three orders of magnitude above the cost of the counter reads.
+  constexpr int64_t min_call_nanoseconds = 1000000;
+  for (const PerfRegionStats &s : perfRegionStats()) {
+    if (s.calls == 0) {
+      continue;
+    }
+    fmt::print(out, "{:<24} {:>10} {:>10.3f}", s.name, s.calls,
+               s.nanoseconds * 1e-6);
+    if (have_cycles && s.nanoseconds < s.calls * min_call_nanoseconds) {
+      fmt::print(out, " (too short to count)\n");
+      continue;
+    }
+    for (size_t i = 0; i < names.size(); ++i) {
+      fmt::print(out, " {:>16}", s.counters[i]);
+    }
+    double cycles = s.counters[0];
+    if (have_ipc) {
+      fmt::print(out, " {:>6.2f}", cycles > 0 ? s.counters[1] / cycles : 0);
+    }
+    double per_lane_cost = have_cycles ? cycles : s.nanoseconds;
+    fmt::print(out, " {:>12.4g}\n",
+               s.lanes > 0 ? per_lane_cost / s.lanes : 0.0);
+  }
+}
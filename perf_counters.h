@@ -0,0 +1,110 @@
+// Copyright 2024 The Hay Authors
+//
+// Licensed under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#ifndef HAY_PERF_COUNTERS_H_
+#define HAY_PERF_COUNTERS_H_
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Hardware performance counters around named regions of code, read with
+// perf_event_open on Linux: cycles, instructions and L1D read misses, plus
+// any raw events listed in $HAY_PERF_RAW as comma-separated name=config pairs
+// (e.g. port utilization events, whose codes are microarchitecture-specific).
+//
+//   static PerfRegion contraction("contraction");
+//   ...
+//   {
+//     PerfScope scope(contraction, Uint1xN::elem_count);
+//     ...
+//   }
+//   printPerfReport();
+//
+// Counting is off unless enablePerfCounters() was called or $HAY_PERF is set,
+// and then a PerfScope costs one predictable branch. When on, each PerfScope
+// reads the counters of the calling thread twice, about a microsecond each,
+// so regions should be coarse: the report leaves out the counters of regions
+// averaging under a millisecond per call. Nested regions count inclusively.
+// Regions are also timed, which works where counters are unavailable.
+
+class PerfRegion {
+public:
+  explicit PerfRegion(const char *name);
+  int id() const { return index; }
+
+private:
+  int index;
+};
+
+namespace perf_counters_internal {
+extern std::atomic<bool> enabled;
+void begin(uint64_t *start);
+void end(int region, const uint64_t *start, int64_t lanes);
+constexpr int max_counters = 8;
+// Counter values, then a timestamp in nanoseconds.
+constexpr int sample_size = max_counters + 1;
+} // namespace perf_counters_internal
+
+class PerfScope {
+public:
+  // `lanes` is the amount of work in the region, for the cycles/lane column.
+  explicit PerfScope(const PerfRegion &region, int64_t lanes = 0)
+      : region(region.id()), lanes(lanes),
+        active(perf_counters_internal::enabled.load(
+            std::memory_order_relaxed)) {
+    if (active) {
+      perf_counters_internal::begin(start);
+    }
+  }
+
+  ~PerfScope() {
+    if (active) {
+      perf_counters_internal::end(region, start, lanes);
+    }
+  }
+
+  PerfScope(const PerfScope &) = delete;
+  PerfScope &operator=(const PerfScope &) = delete;
+
+private:
+  int region;
+  int64_t lanes;
+  bool active;
+  uint64_t start[perf_counters_internal::sample_size];
+};
+
+// Returns false, with a message on stderr, if hardware counters are
+// unavailable, e.g. because of /proc/sys/kernel/perf_event_paranoid. Regions
+// are then only timed.
+bool enablePerfCounters();
+void disablePerfCounters();
+bool perfCountersEnabled();
+
+struct PerfRegionStats {
+  std::string name;
+  int64_t calls;
+  int64_t lanes;
+  int64_t nanoseconds;
+  // Indexed like perfCounterNames().
+  int64_t counters[perf_counters_internal::max_counters];
+};
+
+// Names of the counters opened by enablePerfCounters(), cycles first, if any.
+std::vector<std::string> perfCounterNames();
+// Stats of each region, summed over threads. Call while instrumented threads
+// are quiescent.
+std::vector<PerfRegionStats> perfRegionStats();
+void resetPerfCounters();
+
+// Prints calls, time, counters, IPC and cycles (or nanoseconds) per lane for
+// each region entered. Only calls and time are printed for regions too short
+// to dominate the counter reads.
+void printPerfReport(FILE *out = stderr);
+
+#endif // HAY_PERF_COUNTERS_H_
@@ -0,0 +1,79 @@
+// Copyright 2024 The Hay Authors
+//
+// Licensed under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#include "perf_counters.h"
+#include "testlib.h"
+
+#include <thread>
+
+static PerfRegion outer_region("outer");
+static PerfRegion inner_region("inner");
+
+static int64_t work(int64_t n) {
+  volatile int64_t sum = 0;
+  for (int64_t i = 0; i < n; ++i) {
+    sum = sum + i;
+  }
+  return sum;
+}
+
+static int64_t regionCalls(const char *name) {
+  for (const PerfRegionStats &s : perfRegionStats()) {
+    if (s.name == name) {
+      return s.calls;
+    }
+  }
+  return -1;
+}
+
+struct TestPerfCountersDisabled {
+  static void Run() {
+    disablePerfCounters();
+    resetPerfCounters();
+    {
+      PerfScope scope(outer_region);
+      work(1000);
+    }
+    CHECK_EQ(regionCalls("outer"), 0);
+  }
+};
+
+struct TestPerfCountersEnabled {
+  static void Run() {
+    resetPerfCounters();
+    // Counters may be unavailable, e.g. in containers. Regions are still
+    // counted and timed.
+    bool available = enablePerfCounters();
+    for (int i = 0; i < 3; ++i) {
+      PerfScope scope(outer_region, 100);
+      work(100000);
+      PerfScope inner(inner_region, 10);
+      work(1000);
+    }
+    std::thread([] {
+      PerfScope scope(inner_region, 10);
+      work(1000);
+    }).join();
+    CHECK_EQ(regionCalls("outer"), 3);
+    CHECK_EQ(regionCalls("inner"), 4);
+    std::vector<PerfRegionStats> stats = perfRegionStats();
+    CHECK_EQ(stats[outer_region.id()].lanes, 300);
+    CHECK(stats[outer_region.id()].nanoseconds >=
+          stats[inner_region.id()].nanoseconds);
+    if (available) {
+      CHECK_EQ(perfCounterNames()[0], std::string("cycles"));
+      // Regions count inclusively.
+      CHECK(stats[outer_region.id()].counters[0] > 0);
+    }
+    printPerfReport(stdout);
+    disablePerfCounters();
+  }
+};
+
+int main() {
+  TEST(TestPerfCountersDisabled);
+  TEST(TestPerfCountersEnabled);
+}
@@ -0,0 +1,241 @@
+// Copyright 2024 The Hay Authors
+//
+// Licensed under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#ifndef HAY_PRIME_FIELD_H_
+#define HAY_PRIME_FIELD_H_
+
+#include "simd.h"
+#include "sliced_int.h"
+#include "vector.h"
+
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <fmt/format.h>
+#include <string>
+
+// Bitsliced elements of small prime fields, one per lane of a Uint1xN, as
+// Vector element types: contract, matmul and Vector::seq work on them as on
+// Uint1xN, at the same lane count. Each value is stored across bit planes:
+//
+//   Gf3xN:      GF(3) in two one-hot planes, with a 7-op add and a mul
+//               taking a Uint1xN mul and madd per plane.
+//   GfpxN<p>:   GF(p) for any prime p < 8, as a 3-bit unsigned value per
+//               lane.
+//
+// Vector::seq enumerates base-p digits; see seq_lane_digits.
+
+namespace prime_field_internal {
+
+// Digit j of l in base radix.
+constexpr int digit(int l, int radix, int j) {
+  for (int k = 0; k < j; ++k) {
+    l /= radix;
+  }
+  return l % radix;
+}
+
+// E::from_lanes of the base-radix digits of the lane indices, computed once.
+template <typename E> E lane_digits(int i) {
+  static const auto digits = [] {
+    std::array<E, 16> d;
+    for (int j = 0; j < 16; ++j) {
+      d[j] = E::from_lanes([&](int l) { return digit(l, E::radix, j); });
+    }
+    return d;
+  }();
+  assert(i < 16);
+  return digits[i];
+}
+
+// Prints the lanes of x as a string of digits, lane 0 first.
+template <typename E, typename FormatContext>
+auto format_lanes(const E &x, FormatContext &ctx) {
+  std::string digits(E::elem_count, '0');
+  for (int l = 0; l < E::elem_count; ++l) {
+    digits[l] += extract(x, l);
+  }
+  return fmt::format_to(ctx.out(), "{{{}}}", digits);
+}
+
+} // namespace prime_field_internal
+
+// GF(3): `lo` has the lanes equal to 1, `hi` those equal to 2.
+struct Gf3xN {
+  static constexpr int elem_bits = 2;
+  static constexpr int elem_count = Uint1xN::elem_count;
+  static constexpr int radix = 3;
+  Uint1xN lo;
+  Uint1xN hi;
+
+  // Lane l is value(l), which may be called more than once per lane.
+  template <typename F> static Gf3xN from_lanes(F value) {
+    return {lane_mask([&](int l) { return value(l) == 1; }),
+            lane_mask([&](int l) { return value(l) == 2; })};
+  }
+
+  static Gf3xN cst(uint8_t c) {
+    assert(c < 3);
+    return {Uint1xN::cst(c == 1), Uint1xN::cst(c == 2)};
+  }
+  // Lane l is digit i of l in base 3.
+  static Gf3xN seq(int i) {
+    return prime_field_internal::lane_digits<Gf3xN>(i);
+  }
+  static Gf3xN load(const void *from) {
+    auto *bytes = static_cast<const uint8_t *>(from);
+    return {Uint1xN::load(bytes), Uint1xN::load(bytes + sizeof(Uint1xN))};
+  }
+  friend void store(void *to, Gf3xN x) {
+    auto *bytes = static_cast<uint8_t *>(to);
+    store(bytes, x.lo);
+    store(bytes + sizeof(Uint1xN), x.hi);
+  }
+
+  // Kawahara, Aoki and Takagi's formula.
+  friend Gf3xN add(Gf3xN x, Gf3xN y) {
+    Uint1xN t = add(bit_or(x.lo, y.hi), bit_or(x.hi, y.lo));
+    return {add(bit_or(x.hi, y.hi), t), add(bit_or(x.lo, y.lo), t)};
+  }
+  friend Gf3xN neg(Gf3xN x) { return {x.hi, x.lo}; }
+  friend Gf3xN sub(Gf3xN x, Gf3xN y) { return add(x, neg(y)); }
+  // The two products making up each plane are exclusive, so are added with
+  // xor rather than or.
+  friend Gf3xN mul(Gf3xN x, Gf3xN y) {
+    return {madd(mul(x.lo, y.lo), x.hi, y.hi),
+            madd(mul(x.lo, y.hi), x.hi, y.lo)};
+  }
+  // Writing the sum directly on the planes of x, y and z takes as many ops
+  // as the add of the mul, so madd composes them.
+  friend Gf3xN madd(Gf3xN x, Gf3xN y, Gf3xN z) { return add(x, mul(y, z)); }
+
+  // Number of nonzero lanes.
+  friend Int64xN popcount(Gf3xN x) { return popcount(add(x.lo, x.hi)); }
+  friend uint8_t reduce_add(Gf3xN x) {
+    return (reduce_add(popcount(x.lo)) + 2 * reduce_add(popcount(x.hi))) % 3;
+  }
+  friend uint8_t extract(Gf3xN x, int i) {
+    return extract(x.lo, i) + 2 * extract(x.hi, i);
+  }
+  friend bool operator==(Gf3xN x, Gf3xN y) {
+    return x.lo == y.lo && x.hi == y.hi;
+  }
+};
+
+// GF(p): lane l holds the integer in [0, p) whose bit b is lane l of
+// v.elems[b]. Sums are reduced by a conditional subtraction of p, products
+// by shift and add.
+template <int p> struct GfpxN {
+  static_assert(p == 2 || p == 3 || p == 5 || p == 7,
+                "GF(p) needs a prime p, here below 8");
+  static constexpr int elem_bits = 3;
+  static constexpr int elem_count = Uint1xN::elem_count;
+  static constexpr int radix = p;
+  UintKxN<3> v;
+
+  // Lane l is value(l), which may be called more than once per lane.
+  template <typename F> static GfpxN from_lanes(F value) {
+    GfpxN result;
+    for (int b = 0; b < 3; ++b) {
+      result.v.elems[b] = lane_mask([&](int l) { return (value(l) >> b) & 1; });
+    }
+    return result;
+  }
+
+  static GfpxN cst(uint8_t c) {
+    assert(c < p);
+    return {sliced_cst<3>(c)};
+  }
+  // Lane l is digit i of l in base p.
+  static GfpxN seq(int i) {
+    return prime_field_internal::lane_digits<GfpxN>(i);
+  }
+  static GfpxN load(const void *from) {
+    return {UintKxN<3>::load(from)};
+  }
+  friend void store(void *to, GfpxN x) { store(to, x.v); }
+
+  friend GfpxN add(GfpxN x, GfpxN y) {
+    UintKxN<4> sum = sliced_add(widen(x), widen(y));
+    return reduce(sum);
+  }
+  friend GfpxN neg(GfpxN x) {
+    // p - x, which is p rather than 0 where x is 0.
+    return reduce(sliced_sub(sliced_cst<4>(p), widen(x)));
+  }
+  friend GfpxN sub(GfpxN x, GfpxN y) { return add(x, neg(y)); }
+  friend GfpxN mul(GfpxN x, GfpxN y) { return madd(cst(0), x, y); }
+  // Accumulates into x directly, saving the reductions of a separate mul.
+  friend GfpxN madd(GfpxN x, GfpxN y, GfpxN z) {
+    for (int b = 0; b < 3; ++b) {
+      if ((1 << b) >= p) {
+        break;
+      }
+      GfpxN term = {select(z.v.elems[b], y.v, UintKxN<3>::cst(0))};
+      x = add(x, term);
+      y = add(y, y);
+    }
+    return x;
+  }
+
+  // Number of nonzero lanes.
+  friend Int64xN popcount(GfpxN x) {
+    return popcount(
+        bit_or(x.v.elems[0], bit_or(x.v.elems[1], x.v.elems[2])));
+  }
+  friend uint8_t reduce_add(GfpxN x) {
+    int64_t sum = 0;
+    for (int b = 0; b < 3; ++b) {
+      sum += reduce_add(popcount(x.v.elems[b])) << b;
+    }
+    return sum % p;
+  }
+  friend uint8_t extract(GfpxN x, int i) { return extract_uint(x.v, i); }
+  friend bool operator==(GfpxN x, GfpxN y) { return x.v == y.v; }
+
+private:
+  static UintKxN<4> widen(GfpxN x) {
+    return {x.v.elems[0], x.v.elems[1], x.v.elems[2], Uint1xN::cst(0)};
+  }
+  // x mod p for x < 2p.
+  static GfpxN reduce(UintKxN<4> x) {
+    UintKxN<4> p4 = sliced_cst<4>(p);
+    UintKxN<4> r = select(bit_not(sliced_less(x, p4)), sliced_sub(x, p4), x);
+    return {{r.elems[0], r.elems[1], r.elems[2]}};
+  }
+};
+
+template <> struct ScalarTypeImpl<Gf3xN> {
+  using Type = uint8_t;
+};
+template <int p> struct ScalarTypeImpl<GfpxN<p>> {
+  using Type = uint8_t;
+};
+
+template <> struct Int64EType<Gf3xN> {
+  using Type = Int64xN;
+};
+template <int p> struct Int64EType<GfpxN<p>> {
+  using Type = Int64xN;
+};
+
+template <> struct fmt::formatter<Gf3xN> {
+  template <typename FormatContext>
+  auto format(const Gf3xN &x, FormatContext &ctx) const {
+    return prime_field_internal::format_lanes(x, ctx);
+  }
+  constexpr auto parse(fmt::format_parse_context &ctx) { return ctx.begin(); }
+};
+
+template <int p> struct fmt::formatter<GfpxN<p>> {
+  template <typename FormatContext>
+  auto format(const GfpxN<p> &x, FormatContext &ctx) const {
+    return prime_field_internal::format_lanes(x, ctx);
+  }
+  constexpr auto parse(fmt::format_parse_context &ctx) { return ctx.begin(); }
+};
+
+#endif // HAY_PRIME_FIELD_H_
@@ -0,0 +1,165 @@
+// Copyright 2024 The Hay Authors
+//
+// Licensed under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#include "prime_field.h"
+#include "testlib.h"
+
+#include <algorithm>
+#include <bit>
+#include <string>
+#include <vector>
+
+template <typename E> E randomElements(std::minstd_rand0 &engine) {
+  int values[E::elem_count];
+  for (int &value : values) {
+    value = engine() % E::radix;
+  }
+  return E::from_lanes([&](int l) { return values[l]; });
+}
+
+template <> struct GetRandomImpl<Gf3xN> {
+  static Gf3xN Run(std::minstd_rand0 &engine) {
+    return randomElements<Gf3xN>(engine);
+  }
+};
+
+template <int p> struct GetRandomImpl<GfpxN<p>> {
+  static GfpxN<p> Run(std::minstd_rand0 &engine) {
+    return randomElements<GfpxN<p>>(engine);
+  }
+};
+
+template <typename E> void checkArithmetic() {
+  constexpr int p = E::radix;
+  std::minstd_rand0 engine;
+  for (int iter = 0; iter < 10; ++iter) {
+    E x = getRandom<E>(engine);
+    E y = getRandom<E>(engine);
+    E z = getRandom<E>(engine);
+    E sum = add(x, y);
+    E diff = sub(x, y);
+    E product = mul(x, y);
+    E fused = madd(x, y, z);
+    E negated = neg(x);
+    int64_t total = 0;
+    int64_t nonzero = 0;
+    for (int l = 0; l < E::elem_count; ++l) {
+      int a = extract(x, l);
+      int b = extract(y, l);
+      int c = extract(z, l);
+      CHECK(a < p && b < p && c < p);
+      CHECK_EQ(extract(sum, l), uint8_t((a + b) % p));
+      CHECK_EQ(extract(diff, l), uint8_t((a - b + p) % p));
+      CHECK_EQ(extract(product, l), uint8_t(a * b % p));
+      CHECK_EQ(extract(fused, l), uint8_t((a + b * c) % p));
+      CHECK_EQ(extract(negated, l), uint8_t((p - a) % p));
+      total += a;
+      nonzero += a != 0;
+    }
+    CHECK_EQ(reduce_add(x), uint8_t(total % p));
+    CHECK_EQ(reduce_add(popcount(x)), nonzero);
+    CHECK(add(x, E::cst(0)) == x);
+    CHECK(mul(x, E::cst(1)) == x);
+    CHECK(add(x, negated) == E::cst(0));
+  }
+}
+
+struct TestPrimeFieldArithmetic {
+  static void Run() {
+    checkArithmetic<Gf3xN>();
+    checkArithmetic<GfpxN<2>>();
+    checkArithmetic<GfpxN<3>>();
+    checkArithmetic<GfpxN<5>>();
+    checkArithmetic<GfpxN<7>>();
+  }
+};
+
+// Vector::seq enumerates each vector of GF(p)^6 exactly once over the lanes
+// below p^seq_lane_digits.
+template <typename E> void checkSeq() {
+  constexpr int p = E::radix;
+  using V = Vector<E, {2, 3}>;
+  constexpr int lane_digits = std::min(seq_lane_digits<E>(), V::flatSize);
+  int lanes = 1;
+  for (int j = 0; j < lane_digits; ++j) {
+    lanes *= p;
+  }
+  int total = 1;
+  for (int j = 0; j < V::flatSize; ++j) {
+    total *= p;
+  }
+  std::vector<int> seen(total);
+  for (int i = 0; i < total / lanes; ++i) {
+    V x = V::seq(i);
+    for (int l = 0; l < lanes; ++l) {
+      int value = 0;
+      for (int j = V::flatSize - 1; j >= 0; --j) {
+        value = value * p + extract(x.elems[j], l);
+      }
+      ++seen[value];
+    }
+  }
+  for (int count : seen) {
+    CHECK_EQ(count, 1);
+  }
+}
+
+struct TestPrimeFieldSeq {
+  static void Run() {
+    CHECK_EQ(seq_lane_digits<Uint1xN>(),
+             std::countr_zero(unsigned{Uint1xN::elem_count}));
+    checkSeq<Gf3xN>();
+    checkSeq<GfpxN<5>>();
+    checkSeq<GfpxN<7>>();
+  }
+};
+
+// matmul over GF(p) against a scalar reference.
+template <typename E> void checkMatmul() {
+  constexpr int p = E::radix;
+  std::minstd_rand0 engine;
+  auto x = getRandom<Vector<E, {3, 4}>>(engine);
+  auto y = getRandom<Vector<E, {4, 2}>>(engine);
+  auto z = matmul(x, y);
+  for (int l = 0; l < E::elem_count; ++l) {
+    for (int i = 0; i < 3; ++i) {
+      for (int j = 0; j < 2; ++j) {
+        int expected = 0;
+        for (int k = 0; k < 4; ++k) {
+          expected += extract(x.elems[i * 4 + k], l) *
+                      extract(y.elems[k * 2 + j], l);
+        }
+        CHECK_EQ(extract(z.elems[i * 2 + j], l), uint8_t(expected % p));
+      }
+    }
+  }
+}
+
+struct TestPrimeFieldMatmul {
+  static void Run() {
+    checkMatmul<Gf3xN>();
+    checkMatmul<GfpxN<5>>();
+  }
+};
+
+struct TestPrimeFieldFormat {
+  static void Run() {
+    std::string s = fmt::format("{}", Gf3xN::cst(2));
+    CHECK_EQ(s, "{" + std::string(Gf3xN::elem_count, '2') + "}");
+    std::vector<uint8_t> buf(sizeof(GfpxN<5>));
+    GfpxN<5> x = GfpxN<5>::seq(0);
+    store(buf.data(), x);
+    CHECK(GfpxN<5>::load(buf.data()) == x);
+    CHECK(fmt::format("{}", x).starts_with("{0123401234"));
+  }
+};
+
+int main() {
+  TEST(TestPrimeFieldArithmetic);
+  TEST(TestPrimeFieldSeq);
+  TEST(TestPrimeFieldMatmul);
+  TEST(TestPrimeFieldFormat);
+}
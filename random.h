@@ -0,0 +1,103 @@
+// Copyright 2024 The Hay Authors
+//
+// Licensed under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#ifndef HAY_RANDOM_H_
+#define HAY_RANDOM_H_
+
+#include "simd.h"
+#include "sliced_int.h"
+#include "vector.h"
+
+#include <bit>
+#include <cstdint>
+
+// Random source for bitsliced code: one xoshiro256** generator per 64-bit word
+// of a Uint1xN, all stepped together so that the compiler vectorizes them.
+// Each call to next() returns a Uint1xN whose bits are all independent and
+// uniform.
+class RandomUint1xN {
+public:
+  explicit RandomUint1xN(uint64_t seed) {
+    // Seed each word's generator with splitmix64, as recommended for xoshiro.
+    uint64_t x = seed;
+    for (int w = 0; w < words; ++w) {
+      for (int i = 0; i < 4; ++i) {
+        x += 0x9E3779B97F4A7C15u;
+        uint64_t z = x;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9u;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBu;
+        s[i][w] = z ^ (z >> 31);
+      }
+    }
+  }
+
+  Uint1xN next() {
+    uint64_t out[words];
+    for (int w = 0; w < words; ++w) {
+      out[w] = std::rotl(s[1][w] * 5, 7) * 9;
+      uint64_t t = s[1][w] << 17;
+      s[2][w] ^= s[0][w];
+      s[3][w] ^= s[1][w];
+      s[1][w] ^= s[2][w];
+      s[0][w] ^= s[3][w];
+      s[2][w] ^= t;
+      s[3][w] = std::rotl(s[3][w], 45);
+    }
+    return Uint1xN::load(out);
+  }
+
+  // Each bit is set with probability 2^-k.
+  Uint1xN bernoulli(int k) {
+    Uint1xN result = Uint1xN::cst(1);
+    for (int i = 0; i < k; ++i) {
+      result = mul(result, next());
+    }
+    return result;
+  }
+
+  template <Indices sizes> Vector<Uint1xN, sizes> vector() {
+    Vector<Uint1xN, sizes> result;
+    for (int i = 0; i < result.flatSize; ++i) {
+      result.elems[i] = next();
+    }
+    return result;
+  }
+
+  // In each lane, exactly one element is set, chosen uniformly.
+  template <Indices sizes> Vector<Uint1xN, sizes> one_hot() {
+    using V = Vector<Uint1xN, sizes>;
+    if constexpr (V::flatSize == 1) {
+      return V::cst(1);
+    }
+    constexpr int index_bits = std::bit_width(unsigned(V::flatSize - 1));
+    Vector<Uint1xN, {index_bits}> index = vector<{index_bits}>();
+    V result = V::cst(0);
+    // Lanes whose index is out of range draw again.
+    Uint1xN pending = Uint1xN::cst(1);
+    while (!is_zero(pending)) {
+      Uint1xN hit = Uint1xN::cst(0);
+      for (int j = 0; j < V::flatSize; ++j) {
+        Uint1xN e = pending;
+        for (int b = 0; b < index_bits; ++b) {
+          e = mul(e, add(index.elems[b], Uint1xN::cst(((j >> b) & 1) ^ 1)));
+        }
+        result.elems[j] = add(result.elems[j], e);
+        hit = add(hit, e);
+      }
+      pending = mul(pending, bit_not(hit));
+      for (int b = 0; b < index_bits; ++b) {
+        index.elems[b] = select(pending, next(), index.elems[b]);
+      }
+    }
+    return result;
+  }
+
+private:
+  static constexpr int words = (sizeof(Uint1xN) + 7) / 8;
+  uint64_t s[4][words];
+};
+
+#endif // HAY_RANDOM_H_
@@ -0,0 +1,94 @@
+// Copyright 2024 The Hay Authors
+//
+// Licensed under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#include "random.h"
+#include "testlib.h"
+
+#include <cmath>
+
+// Checks that `count` successes out of `trials` is within 6 standard
+// deviations of the expected probability.
+static void checkProportion(int64_t count, int64_t trials, double p) {
+  double sigma = std::sqrt(trials * p * (1 - p));
+  CHECK(std::abs(count - trials * p) <= 6 * sigma);
+}
+
+struct TestRandomUint1xNBits {
+  static void Run() {
+    RandomUint1xN random(1);
+    const int draws = 1000;
+    int64_t ones = 0;
+    int64_t agreements = 0;
+    Uint1xN previous = random.next();
+    for (int i = 0; i < draws; ++i) {
+      Uint1xN x = random.next();
+      ones += reduce_add(popcount(x));
+      agreements += reduce_add(popcount(bit_not(add(x, previous))));
+      previous = x;
+    }
+    checkProportion(ones, int64_t{draws} * Uint1xN::elem_count, 0.5);
+    checkProportion(agreements, int64_t{draws} * Uint1xN::elem_count, 0.5);
+  }
+};
+
+struct TestRandomUint1xNSeeding {
+  static void Run() {
+    RandomUint1xN a(123);
+    RandomUint1xN b(123);
+    RandomUint1xN c(124);
+    Uint1xN x = a.next();
+    CHECK_EQ(x, b.next());
+    CHECK_NE(x, c.next());
+  }
+};
+
+struct TestRandomUint1xNBernoulli {
+  static void Run() {
+    RandomUint1xN random(2);
+    const int draws = 1000;
+    for (int k = 0; k < 4; ++k) {
+      int64_t ones = 0;
+      for (int i = 0; i < draws; ++i) {
+        ones += reduce_add(popcount(random.bernoulli(k)));
+      }
+      checkProportion(ones, int64_t{draws} * Uint1xN::elem_count,
+                      1.0 / (1 << k));
+    }
+  }
+};
+
+struct TestRandomUint1xNOneHot {
+  template <Indices sizes> static void Run() {
+    using V = Vector<Uint1xN, sizes>;
+    RandomUint1xN random(3);
+    const int draws = 200;
+    int64_t counts[V::flatSize] = {0};
+    for (int i = 0; i < draws; ++i) {
+      V x = random.one_hot<sizes>();
+      CHECK_EQ(sliced_weight<8>(x), sliced_cst<8>(1));
+      for (int j = 0; j < V::flatSize; ++j) {
+        counts[j] += reduce_add(popcount(x.elems[j]));
+      }
+    }
+    for (int j = 0; j < V::flatSize; ++j) {
+      checkProportion(counts[j], int64_t{draws} * Uint1xN::elem_count,
+                      1.0 / V::flatSize);
+    }
+  }
+  static void Run() {
+    Run<{1}>();
+    Run<{2}>();
+    Run<{5}>();
+    Run<{3, 3}>();
+  }
+};
+
+int main() {
+  TEST(TestRandomUint1xNBits);
+  TEST(TestRandomUint1xNSeeding);
+  TEST(TestRandomUint1xNBernoulli);
+  TEST(TestRandomUint1xNOneHot);
+}
@@ -8,6 +8,7 @@
 #define HAY_SIMD_H_
 
 #include <fmt/format.h>
+#include <type_traits>
 
 #if defined __HIP_DEVICE_COMPILE__
 #include "simd_u32_u64.h"
@@ -28,6 +29,18 @@ template <> struct ScalarTypeImpl<Uint1xN> {
 template <> struct ScalarTypeImpl<Int64xN> {
   using Type = int64_t;
 };
+template <> struct ScalarTypeImpl<Int8xN> {
+  using Type = int8_t;
+};
+template <> struct ScalarTypeImpl<Int16xN> {
+  using Type = int16_t;
+};
+template <> struct ScalarTypeImpl<Int32xN> {
+  using Type = int32_t;
+};
+template <> struct ScalarTypeImpl<Poly64xN> {
+  using Type = uint64_t;
+};
 template <typename T> using ScalarType = ScalarTypeImpl<T>::Type;
 
 template <> struct fmt::formatter<Uint1xN> {
@@ -67,4 +80,42 @@ template <> struct fmt::formatter<Int64xN> {
   constexpr auto parse(fmt::format_parse_context &ctx) { return ctx.begin(); }
 };
 
+// Int8xN, Int16xN and Int32xN format like Int64xN.
+template <typename T>
+  requires std::is_same_v<T, Int8xN> || std::is_same_v<T, Int16xN> ||
+           std::is_same_v<T, Int32xN>
+struct fmt::formatter<T> {
+  template <typename FormatContext>
+  auto format(const T &x, FormatContext &ctx) const {
+    auto it = ctx.out();
+    it = fmt::format_to(it, "{{");
+    for (int i = 0; i < T::elem_count; ++i) {
+      if (i > 0) {
+        it = fmt::format_to(it, ", ");
+      }
+      it = fmt::format_to(it, "{}", int64_t{extract(x, i)});
+    }
+    it = fmt::format_to(it, "}}");
+    return it;
+  }
+  constexpr auto parse(fmt::format_parse_context &ctx) { return ctx.begin(); }
+};
+
+template <> struct fmt::formatter<Poly64xN> {
+  template <typename FormatContext>
+  auto format(const Poly64xN &x, FormatContext &ctx) const {
+    auto it = ctx.out();
+    it = fmt::format_to(it, "{{");
+    for (int i = 0; i < Poly64xN::elem_count; ++i) {
+      if (i > 0) {
+        it = fmt::format_to(it, ", ");
+      }
+      it = fmt::format_to(it, "0x{:016x}", extract(x, i));
+    }
+    it = fmt::format_to(it, "}}");
+    return it;
+  }
+  constexpr auto parse(fmt::format_parse_context &ctx) { return ctx.begin(); }
+};
+
 #endif // HAY_SIMD_H_
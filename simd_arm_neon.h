@@ -7,15 +7,44 @@
 #ifndef HAY_SIMD_ARM_NEON_H_
 #define HAY_SIMD_ARM_NEON_H_
 
+#include <algorithm>
 #include <arm_neon.h>
 #include <bit>
 #include <cassert>
+#include <cstdint>
+#include <limits>
+
+inline constexpr char simd_backend_name[] = "arm_neon";
+
 struct Int64xN {
   static constexpr int elem_bits = 64;
   static constexpr int elem_count = 2;
   int64x2_t val;
   friend Int64xN add(Int64xN x, Int64xN y) { return {vaddq_s64(x.val, y.val)}; }
   friend Int64xN sub(Int64xN x, Int64xN y) { return {vsubq_s64(x.val, y.val)}; }
+  // There is no 64-bit multiply: combines the products of the 32-bit halves,
+  // modulo 2^64.
+  friend Int64xN mul(Int64xN x, Int64xN y) {
+    uint64x2_t a = vreinterpretq_u64_s64(x.val);
+    uint64x2_t b = vreinterpretq_u64_s64(y.val);
+    uint32x2_t a_lo = vmovn_u64(a);
+    uint32x2_t b_lo = vmovn_u64(b);
+    uint64x2_t cross = vmull_u32(a_lo, vshrn_n_u64(b, 32));
+    cross = vmlal_u32(cross, vshrn_n_u64(a, 32), b_lo);
+    return {vreinterpretq_s64_u64(
+        vmlal_u32(vshlq_n_u64(cross, 32), a_lo, b_lo))};
+  }
+  friend Int64xN madd(Int64xN x, Int64xN y, Int64xN z) {
+    return add(x, mul(y, z));
+  }
+  // Products of the low 32 bits of the lanes, sign-extended: exact where the
+  // lanes are in the int32 range, and a single smull or smlal.
+  friend Int64xN mul_lo32(Int64xN x, Int64xN y) {
+    return {vmull_s32(vmovn_s64(x.val), vmovn_s64(y.val))};
+  }
+  friend Int64xN madd_lo32(Int64xN x, Int64xN y, Int64xN z) {
+    return {vmlal_s32(x.val, vmovn_s64(y.val), vmovn_s64(z.val))};
+  }
   friend Int64xN min(Int64xN x, Int64xN y) {
     return {vbslq_s64(vcleq_s64(x.val, y.val), x.val, y.val)};
   }
@@ -42,6 +71,182 @@ struct Int64xN {
   }
 };
 
+// Narrow integers: more lanes than Int64xN, with wrapping and saturating
+// arithmetic. reduce_add widens, so it does not overflow. Conversions to and
+// from Int64xN go through int64_parts Int64xN values, part p holding lanes
+// p * Int64xN::elem_count and up.
+
+struct Int8xN {
+  static constexpr int elem_bits = 8;
+  static constexpr int elem_count = 16;
+  static constexpr int int64_parts = elem_count / Int64xN::elem_count;
+  int8x16_t val;
+  friend Int8xN add(Int8xN x, Int8xN y) { return {vaddq_s8(x.val, y.val)}; }
+  friend Int8xN sub(Int8xN x, Int8xN y) { return {vsubq_s8(x.val, y.val)}; }
+  friend Int8xN add_sat(Int8xN x, Int8xN y) {
+    return {vqaddq_s8(x.val, y.val)};
+  }
+  friend Int8xN sub_sat(Int8xN x, Int8xN y) {
+    return {vqsubq_s8(x.val, y.val)};
+  }
+  friend Int8xN min(Int8xN x, Int8xN y) { return {vminq_s8(x.val, y.val)}; }
+  friend Int8xN max(Int8xN x, Int8xN y) { return {vmaxq_s8(x.val, y.val)}; }
+  // The widening sum of 16 int8 fits in 16 bits.
+  friend int64_t reduce_add(Int8xN x) { return vaddlvq_s8(x.val); }
+  static Int8xN load(const void *from) {
+    return {vld1q_s8(static_cast<const int8_t *>(from))};
+  }
+  friend void store(void *to, Int8xN x) {
+    vst1q_s8(static_cast<int8_t *>(to), x.val);
+  }
+  friend bool operator==(Int8xN x, Int8xN y) {
+    return vminvq_u8(vceqq_s8(x.val, y.val)) == 0xFF;
+  }
+  static Int8xN cst(int8_t c) { return {vdupq_n_s8(c)}; }
+  friend int8_t extract(Int8xN x, int i) {
+    assert(i < elem_count);
+    int8_t buf[elem_count];
+    store(buf, x);
+    return buf[i];
+  }
+  friend Int64xN to_int64(Int8xN x, int part) {
+    assert(part < int64_parts);
+    int64_t wide[2] = {extract(x, 2 * part), extract(x, 2 * part + 1)};
+    return Int64xN::load(wide);
+  }
+  // Truncating.
+  static Int8xN from_int64(const Int64xN *parts) {
+    int8_t buf[elem_count];
+    for (int i = 0; i < elem_count; ++i) {
+      buf[i] = static_cast<int8_t>(extract(parts[i / 2], i % 2));
+    }
+    return load(buf);
+  }
+  static Int8xN from_int64_sat(const Int64xN *parts) {
+    int8_t buf[elem_count];
+    for (int i = 0; i < elem_count; ++i) {
+      buf[i] = std::clamp<int64_t>(extract(parts[i / 2], i % 2),
+                                   std::numeric_limits<int8_t>::min(),
+                                   std::numeric_limits<int8_t>::max());
+    }
+    return load(buf);
+  }
+};
+
+struct Int16xN {
+  static constexpr int elem_bits = 16;
+  static constexpr int elem_count = 8;
+  static constexpr int int64_parts = elem_count / Int64xN::elem_count;
+  int16x8_t val;
+  friend Int16xN add(Int16xN x, Int16xN y) { return {vaddq_s16(x.val, y.val)}; }
+  friend Int16xN sub(Int16xN x, Int16xN y) { return {vsubq_s16(x.val, y.val)}; }
+  friend Int16xN add_sat(Int16xN x, Int16xN y) {
+    return {vqaddq_s16(x.val, y.val)};
+  }
+  friend Int16xN sub_sat(Int16xN x, Int16xN y) {
+    return {vqsubq_s16(x.val, y.val)};
+  }
+  friend Int16xN min(Int16xN x, Int16xN y) { return {vminq_s16(x.val, y.val)}; }
+  friend Int16xN max(Int16xN x, Int16xN y) { return {vmaxq_s16(x.val, y.val)}; }
+  // The widening sum of 8 int16 fits in 32 bits.
+  friend int64_t reduce_add(Int16xN x) { return vaddlvq_s16(x.val); }
+  static Int16xN load(const void *from) {
+    return {vld1q_s16(static_cast<const int16_t *>(from))};
+  }
+  friend void store(void *to, Int16xN x) {
+    vst1q_s16(static_cast<int16_t *>(to), x.val);
+  }
+  friend bool operator==(Int16xN x, Int16xN y) {
+    return vminvq_u16(vceqq_s16(x.val, y.val)) == 0xFFFF;
+  }
+  static Int16xN cst(int16_t c) { return {vdupq_n_s16(c)}; }
+  friend int16_t extract(Int16xN x, int i) {
+    assert(i < elem_count);
+    int16_t buf[elem_count];
+    store(buf, x);
+    return buf[i];
+  }
+  friend Int64xN to_int64(Int16xN x, int part) {
+    assert(part < int64_parts);
+    int64_t wide[2] = {extract(x, 2 * part), extract(x, 2 * part + 1)};
+    return Int64xN::load(wide);
+  }
+  // Truncating.
+  static Int16xN from_int64(const Int64xN *parts) {
+    int16_t buf[elem_count];
+    for (int i = 0; i < elem_count; ++i) {
+      buf[i] = static_cast<int16_t>(extract(parts[i / 2], i % 2));
+    }
+    return load(buf);
+  }
+  static Int16xN from_int64_sat(const Int64xN *parts) {
+    int16_t buf[elem_count];
+    for (int i = 0; i < elem_count; ++i) {
+      buf[i] = std::clamp<int64_t>(extract(parts[i / 2], i % 2),
+                                   std::numeric_limits<int16_t>::min(),
+                                   std::numeric_limits<int16_t>::max());
+    }
+    return load(buf);
+  }
+};
+
+struct Int32xN {
+  static constexpr int elem_bits = 32;
+  static constexpr int elem_count = 4;
+  static constexpr int int64_parts = elem_count / Int64xN::elem_count;
+  int32x4_t val;
+  friend Int32xN add(Int32xN x, Int32xN y) { return {vaddq_s32(x.val, y.val)}; }
+  friend Int32xN sub(Int32xN x, Int32xN y) { return {vsubq_s32(x.val, y.val)}; }
+  friend Int32xN add_sat(Int32xN x, Int32xN y) {
+    return {vqaddq_s32(x.val, y.val)};
+  }
+  friend Int32xN sub_sat(Int32xN x, Int32xN y) {
+    return {vqsubq_s32(x.val, y.val)};
+  }
+  friend Int32xN min(Int32xN x, Int32xN y) { return {vminq_s32(x.val, y.val)}; }
+  friend Int32xN max(Int32xN x, Int32xN y) { return {vmaxq_s32(x.val, y.val)}; }
+  // The widening sum of 4 int32 fits in 64 bits.
+  friend int64_t reduce_add(Int32xN x) { return vaddlvq_s32(x.val); }
+  static Int32xN load(const void *from) {
+    return {vld1q_s32(static_cast<const int32_t *>(from))};
+  }
+  friend void store(void *to, Int32xN x) {
+    vst1q_s32(static_cast<int32_t *>(to), x.val);
+  }
+  friend bool operator==(Int32xN x, Int32xN y) {
+    return vminvq_u32(vceqq_s32(x.val, y.val)) == 0xFFFFFFFFu;
+  }
+  static Int32xN cst(int32_t c) { return {vdupq_n_s32(c)}; }
+  friend int32_t extract(Int32xN x, int i) {
+    assert(i < elem_count);
+    int32_t buf[elem_count];
+    store(buf, x);
+    return buf[i];
+  }
+  friend Int64xN to_int64(Int32xN x, int part) {
+    assert(part < int64_parts);
+    int64_t wide[2] = {extract(x, 2 * part), extract(x, 2 * part + 1)};
+    return Int64xN::load(wide);
+  }
+  // Truncating.
+  static Int32xN from_int64(const Int64xN *parts) {
+    int32_t buf[elem_count];
+    for (int i = 0; i < elem_count; ++i) {
+      buf[i] = static_cast<int32_t>(extract(parts[i / 2], i % 2));
+    }
+    return load(buf);
+  }
+  static Int32xN from_int64_sat(const Int64xN *parts) {
+    int32_t buf[elem_count];
+    for (int i = 0; i < elem_count; ++i) {
+      buf[i] = std::clamp<int64_t>(extract(parts[i / 2], i % 2),
+                                   std::numeric_limits<int32_t>::min(),
+                                   std::numeric_limits<int32_t>::max());
+    }
+    return load(buf);
+  }
+};
+
 struct Uint1xN {
   static constexpr int elem_bits = 1;
   static constexpr int elem_count = 128;
@@ -97,4 +302,191 @@ struct Uint1xN {
   }
 };
 
+// The 3-input function of x, y and z whose value at x = a, y = b, z = c is bit
+// 4a + 2b + c of imm, as vpternlogq: the or of the minterms it selects.
+template <int imm> Uint1xN ternary(Uint1xN x, Uint1xN y, Uint1xN z) {
+  Uint1xN r = {x.val ^ x.val};
+  for (int m = 0; m < 8; ++m) {
+    if ((imm >> m) & 1) {
+      r.val |= ((m & 4) ? x.val : ~x.val) & ((m & 2) ? y.val : ~y.val) &
+               ((m & 1) ? z.val : ~z.val);
+    }
+  }
+  return r;
+}
+inline constexpr bool uint1_native_ternary = false;
+
+// Lane l of the result is lane l ^ 2^j of x, for 2^j < Uint1xN::elem_count.
+template <int j> Uint1xN lane_xor_permute(Uint1xN x) {
+  static_assert(j >= 0 && (1 << j) < Uint1xN::elem_count);
+  if constexpr (j < 6) {
+    return {vbslq_u64(Uint1xN::seq(j).val, vshlq_n_u64(x.val, 1 << j),
+                      vshrq_n_u64(x.val, 1 << j))};
+  } else {
+    return {vextq_u64(x.val, x.val, 1)};
+  }
+}
+
+// The lanes of x as bits of a 128-bit integer, lane l being bit l.
+inline unsigned __int128 lanes_as_uint128(Uint1xN x) {
+  return static_cast<unsigned __int128>(vgetq_lane_u64(x.val, 1)) << 64 |
+         vgetq_lane_u64(x.val, 0);
+}
+
+inline Uint1xN uint128_as_lanes(unsigned __int128 v) {
+  return {vcombine_u64(vcreate_u64(static_cast<uint64_t>(v)),
+                       vcreate_u64(static_cast<uint64_t>(v >> 64)))};
+}
+
+// Lane l of the result is lane l - n of x, or 0 if there is none, for
+// -elem_count < n < elem_count.
+inline Uint1xN lane_shift(Uint1xN x, int n) {
+  assert(n > -Uint1xN::elem_count && n < Uint1xN::elem_count);
+  unsigned __int128 v = lanes_as_uint128(x);
+  return uint128_as_lanes(n >= 0 ? v << n : v >> -n);
+}
+
+// Lane l of the result is lane (l - n) mod elem_count of x.
+inline Uint1xN lane_rotate(Uint1xN x, int n) {
+  n &= Uint1xN::elem_count - 1;
+  if (n == 0) {
+    return x;
+  }
+  unsigned __int128 v = lanes_as_uint128(x);
+  return uint128_as_lanes(v << n | v >> (Uint1xN::elem_count - n));
+}
+
+// A gather of lanes for lane_permute, which takes lane indices[l] of x to
+// lane l, for any indices below elem_count, repeated or not. Building one
+// costs much more than applying it.
+struct LanePermutation {
+  // For each bit t of the bytes of the result, the vtbl gathering into byte
+  // b the byte of x that holds the source of lane 8 b + t, and the shift
+  // moving that source to bit t.
+  uint8x16_t bytes[8];
+  int8x16_t shifts[8];
+
+  static LanePermutation from_indices(const uint16_t *indices) {
+    LanePermutation p;
+    for (int t = 0; t < 8; ++t) {
+      uint8_t bytes[16];
+      int8_t shifts[16];
+      for (int b = 0; b < 16; ++b) {
+        int src = indices[8 * b + t];
+        assert(src < Uint1xN::elem_count);
+        bytes[b] = src / 8;
+        shifts[b] = t - src % 8;
+      }
+      p.bytes[t] = vld1q_u8(bytes);
+      p.shifts[t] = vld1q_s8(shifts);
+    }
+    return p;
+  }
+};
+
+inline Uint1xN lane_permute(Uint1xN x, const LanePermutation &p) {
+  uint8x16_t in = vreinterpretq_u8_u64(x.val);
+  uint8x16_t out = vdupq_n_u8(0);
+  for (int t = 0; t < 8; ++t) {
+    uint8x16_t moved = vshlq_u8(vqtbl1q_u8(in, p.bytes[t]), p.shifts[t]);
+    out = vorrq_u8(out, vandq_u8(moved, vdupq_n_u8(1 << t)));
+  }
+  return {vreinterpretq_u64_u8(out)};
+}
+
+// Elements of GF(2^64) = GF(2)[x] / (x^64 + x^4 + x^3 + x + 1), one per
+// 64-bit lane, bit b holding the coefficient of x^b.
+struct Poly64xN {
+  static constexpr int elem_bits = 64;
+  static constexpr int elem_count = 2;
+  // The modulus less its leading term. Its square has degree below 64, so
+  // Barrett's constant floor(x^128 / modulus) is x^64 + low_modulus too.
+  static constexpr uint64_t low_modulus = 0x1B;
+  uint64x2_t val;
+
+  // The carry-less product of x and y: the low 64 coefficients, and the high
+  // ones into *hi.
+  friend Poly64xN clmul(Poly64xN x, Poly64xN y, Poly64xN *hi) {
+#ifdef __ARM_FEATURE_AES
+    poly64x2_t a = vreinterpretq_p64_u64(x.val);
+    poly64x2_t b = vreinterpretq_p64_u64(y.val);
+    uint64x2_t p0 = vreinterpretq_u64_p128(
+        vmull_p64(vgetq_lane_p64(a, 0), vgetq_lane_p64(b, 0)));
+    uint64x2_t p1 = vreinterpretq_u64_p128(vmull_high_p64(a, b));
+    hi->val = vzip2q_u64(p0, p1);
+    return {vzip1q_u64(p0, p1)};
+#else
+    uint64_t h0, h1;
+    uint64_t l0 = clmul_lane(vgetq_lane_u64(x.val, 0), vgetq_lane_u64(y.val, 0),
+                             &h0);
+    uint64_t l1 = clmul_lane(vgetq_lane_u64(x.val, 1), vgetq_lane_u64(y.val, 1),
+                             &h1);
+    hi->val = vcombine_u64(vdup_n_u64(h0), vdup_n_u64(h1));
+    return {vcombine_u64(vdup_n_u64(l0), vdup_n_u64(l1))};
+#endif
+  }
+  friend Poly64xN add(Poly64xN x, Poly64xN y) {
+    return {veorq_u64(x.val, y.val)};
+  }
+  friend Poly64xN sub(Poly64xN x, Poly64xN y) { return add(x, y); }
+  friend Poly64xN mul(Poly64xN x, Poly64xN y) {
+    Poly64xN hi;
+    Poly64xN lo = clmul(x, y, &hi);
+    return reduce(lo, hi);
+  }
+  // Adds x before the reduction, which is linear.
+  friend Poly64xN madd(Poly64xN x, Poly64xN y, Poly64xN z) {
+    Poly64xN hi;
+    Poly64xN lo = clmul(y, z, &hi);
+    return reduce(add(lo, x), hi);
+  }
+  friend uint64_t reduce_add(Poly64xN x) {
+    return vgetq_lane_u64(x.val, 0) ^ vgetq_lane_u64(x.val, 1);
+  }
+  static Poly64xN load(const void *from) {
+    return {vld1q_u64(static_cast<const uint64_t *>(from))};
+  }
+  friend void store(void *to, Poly64xN x) {
+    vst1q_u64(static_cast<uint64_t *>(to), x.val);
+  }
+  friend bool operator==(Poly64xN x, Poly64xN y) {
+    uint64x2_t c = vceqq_u64(x.val, y.val);
+    return vgetq_lane_u64(c, 0) && vgetq_lane_u64(c, 1);
+  }
+  static Poly64xN cst(uint64_t c) { return {vdupq_n_u64(c)}; }
+  // Lane l is bit i of l, as the polynomial 0 or 1.
+  static Poly64xN seq(int i) {
+    return i == 0 ? Poly64xN{vcombine_u64(vdup_n_u64(0), vdup_n_u64(1))}
+                  : cst(0);
+  }
+  friend uint64_t extract(Poly64xN x, int i) {
+    assert(i < elem_count);
+    return i == 0 ? vgetq_lane_u64(x.val, 0) : vgetq_lane_u64(x.val, 1);
+  }
+
+private:
+  // Barrett reduction of hi * x^64 + lo: the quotient is
+  // q = floor(hi * (x^64 + low_modulus) / x^64), and the remainder is
+  // lo + q * low_modulus mod x^64. Two carry-less products.
+  static Poly64xN reduce(Poly64xN lo, Poly64xN hi) {
+    Poly64xN m = cst(low_modulus);
+    Poly64xN q_hi, unused;
+    clmul(hi, m, &q_hi);
+    return add(lo, clmul(add(hi, q_hi), m, &unused));
+  }
+#ifndef __ARM_FEATURE_AES
+  // Without PMULL: shift and add.
+  static uint64_t clmul_lane(uint64_t a, uint64_t b, uint64_t *hi) {
+    uint64_t lo = a & -(b & 1);
+    *hi = 0;
+    for (int i = 1; i < 64; ++i) {
+      uint64_t m = -((b >> i) & 1);
+      lo ^= (a << i) & m;
+      *hi ^= (a >> (64 - i)) & m;
+    }
+    return lo;
+  }
+#endif
+};
+
 #endif // HAY_SIMD_ARM_NEON_H_
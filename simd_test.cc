@@ -7,7 +7,10 @@
 #include "simd.h"
 #include "testlib.h"
 
+#include <algorithm>
 #include <cstring>
+#include <limits>
+#include <utility>
 
 struct TestInt64xNLoadStore {
   static void Run() {
@@ -74,6 +77,23 @@ struct TestInt64xNArithmetic {
     }
     CHECK_EQ(r, reduce_add(x));
     CHECK_EQ(reduce_add(add(x, y)), reduce_add(x) + reduce_add(y));
+    CHECK_EQ(mul(x, Int64xN::cst(1)), x);
+    CHECK_EQ(mul(x, Int64xN::cst(-1)), sub(Int64xN::cst(0), x));
+    CHECK_EQ(mul(x, y), mul(y, x));
+    CHECK_EQ(mul(x, add(y, z)), add(mul(x, y), mul(x, z)));
+    CHECK_EQ(madd(x, y, z), add(x, mul(y, z)));
+    // Random lanes are in the int32 range.
+    CHECK_EQ(mul_lo32(y, z), mul(y, z));
+    CHECK_EQ(madd_lo32(x, y, z), madd(x, y, z));
+    // Products past 64 bits wrap.
+    Int64xN big = Int64xN::cst(int64_t{3} << 40);
+    CHECK_EQ(mul(big, big), Int64xN::cst(0));
+    CHECK_EQ(mul(big, Int64xN::cst(-1000000007)),
+             Int64xN::cst(static_cast<int64_t>((uint64_t{3} << 40) *
+                                               uint64_t(-1000000007))));
+    for (int i = 0; i < Int64xN::elem_count; ++i) {
+      CHECK_EQ(extract(mul(x, y), i), extract(x, i) * extract(y, i));
+    }
   }
 };
 
@@ -101,6 +121,124 @@ struct TestUint1xNArithmetic {
   }
 };
 
+template <typename E> void checkNarrowIntArithmetic() {
+  using S = ScalarType<E>;
+  constexpr int64_t lo = std::numeric_limits<S>::min();
+  constexpr int64_t hi = std::numeric_limits<S>::max();
+  std::minstd_rand0 engine;
+  for (int iter = 0; iter < 20; ++iter) {
+    E x = getRandom<E>(engine);
+    E y = getRandom<E>(engine);
+    int64_t sum = 0;
+    for (int i = 0; i < E::elem_count; ++i) {
+      int64_t a = extract(x, i);
+      int64_t b = extract(y, i);
+      CHECK_EQ(extract(add(x, y), i), static_cast<S>(a + b));
+      CHECK_EQ(extract(sub(x, y), i), static_cast<S>(a - b));
+      CHECK_EQ(int64_t{extract(add_sat(x, y), i)}, std::clamp(a + b, lo, hi));
+      CHECK_EQ(int64_t{extract(sub_sat(x, y), i)}, std::clamp(a - b, lo, hi));
+      CHECK_EQ(int64_t{extract(min(x, y), i)}, std::min(a, b));
+      CHECK_EQ(int64_t{extract(max(x, y), i)}, std::max(a, b));
+      sum += a;
+    }
+    CHECK_EQ(reduce_add(x), sum);
+    Int64xN parts[E::int64_parts];
+    for (int p = 0; p < E::int64_parts; ++p) {
+      parts[p] = to_int64(x, p);
+      for (int j = 0; j < Int64xN::elem_count; ++j) {
+        CHECK_EQ(extract(parts[p], j),
+                 int64_t{extract(x, p * Int64xN::elem_count + j)});
+      }
+    }
+    CHECK_EQ(E::from_int64(parts), x);
+    CHECK_EQ(E::from_int64_sat(parts), x);
+  }
+  CHECK_EQ(reduce_add(E::cst(hi)), hi * E::elem_count);
+  CHECK_EQ(reduce_add(E::cst(lo)), lo * E::elem_count);
+  CHECK_EQ(add_sat(E::cst(hi), E::cst(1)), E::cst(hi));
+  CHECK_EQ(sub_sat(E::cst(lo), E::cst(1)), E::cst(lo));
+  CHECK_EQ(add(E::cst(hi), E::cst(1)), E::cst(lo));
+  Int64xN big[E::int64_parts];
+  for (Int64xN &part : big) {
+    part = Int64xN::cst(hi + 2);
+  }
+  CHECK_EQ(E::from_int64(big), E::cst(lo + 1));
+  CHECK_EQ(E::from_int64_sat(big), E::cst(hi));
+}
+
+struct TestInt8xNArithmetic {
+  static void Run() { checkNarrowIntArithmetic<Int8xN>(); }
+};
+
+struct TestInt16xNArithmetic {
+  static void Run() { checkNarrowIntArithmetic<Int16xN>(); }
+};
+
+struct TestInt32xNArithmetic {
+  static void Run() { checkNarrowIntArithmetic<Int32xN>(); }
+};
+
+// x * y in GF(2^64), one coefficient of y at a time.
+static uint64_t referencePoly64Mul(uint64_t x, uint64_t y) {
+  uint64_t product = 0;
+  for (int i = 0; i < 64; ++i) {
+    if ((y >> i) & 1) {
+      product ^= x;
+    }
+    x = (x << 1) ^ ((x >> 63) ? Poly64xN::low_modulus : 0);
+  }
+  return product;
+}
+
+struct TestPoly64xNArithmetic {
+  static void Run() {
+    std::minstd_rand0 engine;
+    Poly64xN zero = Poly64xN::cst(0);
+    Poly64xN one = Poly64xN::cst(1);
+    for (int iter = 0; iter < 100; ++iter) {
+      Poly64xN x = getRandom<Poly64xN>(engine);
+      Poly64xN y = getRandom<Poly64xN>(engine);
+      Poly64xN z = getRandom<Poly64xN>(engine);
+      CHECK_EQ(add(x, x), zero);
+      CHECK_EQ(sub(x, y), add(x, y));
+      CHECK_EQ(mul(x, one), x);
+      CHECK_EQ(mul(x, zero), zero);
+      CHECK_EQ(mul(x, y), mul(y, x));
+      CHECK_EQ(mul(mul(x, y), z), mul(x, mul(y, z)));
+      CHECK_EQ(mul(x, add(y, z)), add(mul(x, y), mul(x, z)));
+      CHECK_EQ(madd(x, y, z), add(x, mul(y, z)));
+      Poly64xN hi;
+      Poly64xN lo = clmul(x, y, &hi);
+      uint64_t sum = 0;
+      for (int i = 0; i < Poly64xN::elem_count; ++i) {
+        uint64_t a = extract(x, i);
+        uint64_t b = extract(y, i);
+        CHECK_EQ(extract(mul(x, y), i), referencePoly64Mul(a, b));
+        // The carry-less product's halves, against shift and add.
+        uint64_t ref_lo = 0, ref_hi = 0;
+        for (int j = 0; j < 64; ++j) {
+          if ((b >> j) & 1) {
+            ref_lo ^= a << j;
+            ref_hi ^= j ? a >> (64 - j) : 0;
+          }
+        }
+        CHECK_EQ(extract(lo, i), ref_lo);
+        CHECK_EQ(extract(hi, i), ref_hi);
+        sum ^= a;
+      }
+      CHECK_EQ(reduce_add(x), sum);
+    }
+    // x^63 * x = x^64 = x^4 + x^3 + x + 1.
+    CHECK_EQ(mul(Poly64xN::cst(uint64_t{1} << 63), Poly64xN::cst(2)),
+             Poly64xN::cst(Poly64xN::low_modulus));
+    for (int i = 0; (1 << i) < Poly64xN::elem_count; ++i) {
+      for (int l = 0; l < Poly64xN::elem_count; ++l) {
+        CHECK_EQ(extract(Poly64xN::seq(i), l), uint64_t((l >> i) & 1));
+      }
+    }
+  }
+};
+
 struct TestUint1xNBitcounts {
   static void Run() {
     const int bits = Uint1xN::elem_count;
@@ -151,6 +289,77 @@ struct TestUint1xNSeq {
   }
 };
 
+struct TestUint1xNLaneXorPermute {
+  static void Run() {
+    std::minstd_rand0 engine;
+    Uint1xN x = getRandom<Uint1xN>(engine);
+    [&]<int... j>(std::integer_sequence<int, j...>) {
+      (
+          [&] {
+            Uint1xN y = lane_xor_permute<j>(x);
+            for (int l = 0; l < Uint1xN::elem_count; ++l) {
+              CHECK_EQ(extract(y, l), extract(x, l ^ (1 << j)));
+            }
+          }(),
+          ...);
+    }(std::make_integer_sequence<int, __builtin_ctz(Uint1xN::elem_count)>());
+  }
+};
+
+struct TestUint1xNLaneShiftRotate {
+  static void Run() {
+    constexpr int lanes = Uint1xN::elem_count;
+    std::minstd_rand0 engine;
+    Uint1xN x = getRandom<Uint1xN>(engine);
+    for (int n : {0, 1, 5, 31, 32, 63, 64, 65, 100, lanes / 2 + 3, lanes - 1}) {
+      if (n >= lanes) {
+        continue;
+      }
+      Uint1xN up = lane_shift(x, n);
+      Uint1xN down = lane_shift(x, -n);
+      Uint1xN rotated = lane_rotate(x, n);
+      for (int l = 0; l < lanes; ++l) {
+        CHECK_EQ(extract(up, l), l >= n ? extract(x, l - n) : 0);
+        CHECK_EQ(extract(down, l), l + n < lanes ? extract(x, l + n) : 0);
+        CHECK_EQ(extract(rotated, l), extract(x, (l - n + lanes) % lanes));
+      }
+      CHECK_EQ(lane_rotate(x, -n), lane_rotate(x, lanes - n));
+    }
+  }
+};
+
+struct TestUint1xNLanePermute {
+  static void Run() {
+    constexpr int lanes = Uint1xN::elem_count;
+    std::minstd_rand0 engine;
+    uint16_t indices[lanes];
+    for (int iter = 0; iter < 10; ++iter) {
+      for (int l = 0; l < lanes; ++l) {
+        // The reversal, then random permutations.
+        indices[l] = lanes - 1 - l;
+      }
+      if (iter > 0) {
+        std::shuffle(indices, indices + lanes, engine);
+      }
+      // Then gathers that repeat lanes: a broadcast of one lane, and random
+      // indices.
+      if (iter == 8) {
+        std::fill_n(indices, lanes, lanes / 2 + 1);
+      } else if (iter == 9) {
+        for (int l = 0; l < lanes; ++l) {
+          indices[l] = engine() % lanes;
+        }
+      }
+      LanePermutation p = LanePermutation::from_indices(indices);
+      Uint1xN x = getRandom<Uint1xN>(engine);
+      Uint1xN y = lane_permute(x, p);
+      for (int l = 0; l < lanes; ++l) {
+        CHECK_EQ(extract(y, l), extract(x, indices[l]));
+      }
+    }
+  }
+};
+
 struct TestInt64xNFormat {
   static void Run() {
     static constexpr int elems = Int64xN::elem_count;
@@ -192,13 +401,36 @@ struct TestUint1xNFormat {
   }
 };
 
+struct TestInt8xNFormat {
+  static void Run() {
+    std::string actual = fmt::format("{}", Int8xN::cst(-5));
+    CHECK(actual.starts_with("{-5"));
+  }
+};
+
+struct TestPoly64xNFormat {
+  static void Run() {
+    std::string actual = fmt::format("{}", Poly64xN::cst(0x1B));
+    CHECK(actual.starts_with("{0x000000000000001b"));
+  }
+};
+
 int main() {
   TEST(TestInt64xNLoadStore);
   TEST(TestUint1xNLoadStore);
   TEST(TestInt64xNArithmetic);
   TEST(TestUint1xNArithmetic);
+  TEST(TestInt8xNArithmetic);
+  TEST(TestInt16xNArithmetic);
+  TEST(TestInt32xNArithmetic);
+  TEST(TestPoly64xNArithmetic);
   TEST(TestUint1xNBitcounts);
   TEST(TestUint1xNSeq);
+  TEST(TestUint1xNLaneXorPermute);
+  TEST(TestUint1xNLaneShiftRotate);
+  TEST(TestUint1xNLanePermute);
   TEST(TestInt64xNFormat);
   TEST(TestUint1xNFormat);
+  TEST(TestInt8xNFormat);
+  TEST(TestPoly64xNFormat);
 }
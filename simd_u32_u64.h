@@ -11,6 +11,7 @@
 #include <bit>
 #include <cassert>
 #include <cstdint>
+#include <limits>
 
 struct Int64xN {
   static constexpr int elem_bits = 64;
@@ -18,6 +19,22 @@ struct Int64xN {
   int64_t val;
   friend Int64xN add(Int64xN x, Int64xN y) { return {x.val + y.val}; }
   friend Int64xN sub(Int64xN x, Int64xN y) { return {x.val - y.val}; }
+  // Modulo 2^64, like the vector backends.
+  friend Int64xN mul(Int64xN x, Int64xN y) {
+    return {static_cast<int64_t>(static_cast<uint64_t>(x.val) *
+                                 static_cast<uint64_t>(y.val))};
+  }
+  friend Int64xN madd(Int64xN x, Int64xN y, Int64xN z) {
+    return add(x, mul(y, z));
+  }
+  // Products of the low 32 bits of the lanes, sign-extended: exact where the
+  // lanes are in the int32 range.
+  friend Int64xN mul_lo32(Int64xN x, Int64xN y) {
+    return {int64_t{static_cast<int32_t>(x.val)} * static_cast<int32_t>(y.val)};
+  }
+  friend Int64xN madd_lo32(Int64xN x, Int64xN y, Int64xN z) {
+    return add(x, mul_lo32(y, z));
+  }
   friend Int64xN min(Int64xN x, Int64xN y) { return {std::min(x.val, y.val)}; }
   friend Int64xN max(Int64xN x, Int64xN y) { return {std::max(x.val, y.val)}; }
   friend int64_t reduce_add(Int64xN x) { return x.val; }
@@ -36,8 +53,144 @@ struct Int64xN {
   }
 };
 
+// Narrow integers, with wrapping and saturating arithmetic. reduce_add
+// widens, so it does not overflow. Conversions to and from Int64xN go through
+// int64_parts Int64xN values, part p holding lanes p * Int64xN::elem_count
+// and up. Here, one lane each.
+template <typename T> struct NarrowIntxN {
+  static constexpr int elem_bits = 8 * sizeof(T);
+  static constexpr int elem_count = 1;
+  static constexpr int int64_parts = 1;
+  T val;
+  friend NarrowIntxN add(NarrowIntxN x, NarrowIntxN y) {
+    return {static_cast<T>(int64_t{x.val} + y.val)};
+  }
+  friend NarrowIntxN sub(NarrowIntxN x, NarrowIntxN y) {
+    return {static_cast<T>(int64_t{x.val} - y.val)};
+  }
+  friend NarrowIntxN add_sat(NarrowIntxN x, NarrowIntxN y) {
+    return {saturate(int64_t{x.val} + y.val)};
+  }
+  friend NarrowIntxN sub_sat(NarrowIntxN x, NarrowIntxN y) {
+    return {saturate(int64_t{x.val} - y.val)};
+  }
+  friend NarrowIntxN min(NarrowIntxN x, NarrowIntxN y) {
+    return {std::min(x.val, y.val)};
+  }
+  friend NarrowIntxN max(NarrowIntxN x, NarrowIntxN y) {
+    return {std::max(x.val, y.val)};
+  }
+  friend int64_t reduce_add(NarrowIntxN x) { return x.val; }
+  static NarrowIntxN load(const void *from) {
+    return {*static_cast<const T *>(from)};
+  }
+  friend void store(void *to, NarrowIntxN x) {
+    *static_cast<T *>(to) = x.val;
+  }
+  friend bool operator==(NarrowIntxN x, NarrowIntxN y) {
+    return x.val == y.val;
+  }
+  static NarrowIntxN cst(T c) { return {c}; }
+  friend T extract(NarrowIntxN x, int i) {
+    assert(i == 0);
+    (void)i;
+    return x.val;
+  }
+  friend Int64xN to_int64(NarrowIntxN x, int part) {
+    assert(part == 0);
+    (void)part;
+    return {x.val};
+  }
+  // Truncating.
+  static NarrowIntxN from_int64(const Int64xN *parts) {
+    return {static_cast<T>(parts[0].val)};
+  }
+  static NarrowIntxN from_int64_sat(const Int64xN *parts) {
+    return {saturate(parts[0].val)};
+  }
+
+private:
+  static T saturate(int64_t x) {
+    return std::clamp<int64_t>(x, std::numeric_limits<T>::min(),
+                               std::numeric_limits<T>::max());
+  }
+};
+
+using Int8xN = NarrowIntxN<int8_t>;
+using Int16xN = NarrowIntxN<int16_t>;
+using Int32xN = NarrowIntxN<int32_t>;
+
+// Elements of GF(2^64) = GF(2)[x] / (x^64 + x^4 + x^3 + x + 1), bit b
+// holding the coefficient of x^b. Portable, so without a carry-less multiply
+// instruction.
+struct Poly64xN {
+  static constexpr int elem_bits = 64;
+  static constexpr int elem_count = 1;
+  // The modulus less its leading term. Its square has degree below 64, so
+  // Barrett's constant floor(x^128 / modulus) is x^64 + low_modulus too.
+  static constexpr uint64_t low_modulus = 0x1B;
+  uint64_t val;
+
+  // The carry-less product of x and y: the low 64 coefficients, and the high
+  // ones into *hi. Shift and add, without branches on the operands.
+  friend Poly64xN clmul(Poly64xN x, Poly64xN y, Poly64xN *hi) {
+    uint64_t lo = x.val & -(y.val & 1);
+    hi->val = 0;
+    for (int i = 1; i < 64; ++i) {
+      uint64_t m = -((y.val >> i) & 1);
+      lo ^= (x.val << i) & m;
+      hi->val ^= (x.val >> (64 - i)) & m;
+    }
+    return {lo};
+  }
+  friend Poly64xN add(Poly64xN x, Poly64xN y) { return {x.val ^ y.val}; }
+  friend Poly64xN sub(Poly64xN x, Poly64xN y) { return add(x, y); }
+  friend Poly64xN mul(Poly64xN x, Poly64xN y) {
+    Poly64xN hi;
+    Poly64xN lo = clmul(x, y, &hi);
+    return reduce(lo, hi);
+  }
+  // Adds x before the reduction, which is linear.
+  friend Poly64xN madd(Poly64xN x, Poly64xN y, Poly64xN z) {
+    Poly64xN hi;
+    Poly64xN lo = clmul(y, z, &hi);
+    return reduce(add(lo, x), hi);
+  }
+  friend uint64_t reduce_add(Poly64xN x) { return x.val; }
+  static Poly64xN load(const void *from) {
+    return {*static_cast<const uint64_t *>(from)};
+  }
+  friend void store(void *to, Poly64xN x) {
+    *static_cast<uint64_t *>(to) = x.val;
+  }
+  friend bool operator==(Poly64xN x, Poly64xN y) { return x.val == y.val; }
+  static Poly64xN cst(uint64_t c) { return {c}; }
+  // Lane 0 is bit i of 0.
+  static Poly64xN seq(int) { return {0}; }
+  friend uint64_t extract(Poly64xN x, int i) {
+    assert(i == 0);
+    (void)i;
+    return x.val;
+  }
+
+private:
+  // Barrett reduction of hi * x^64 + lo: the quotient is
+  // q = floor(hi * (x^64 + low_modulus) / x^64), and the remainder is
+  // lo + q * low_modulus mod x^64. With a low modulus this sparse, the
+  // products take a few shifts each.
+  static Poly64xN reduce(Poly64xN lo, Poly64xN hi) {
+    uint64_t q = hi.val ^ times_low_modulus_hi(hi.val);
+    return {lo.val ^ q ^ (q << 1) ^ (q << 3) ^ (q << 4)};
+  }
+  static uint64_t times_low_modulus_hi(uint64_t a) {
+    return (a >> 63) ^ (a >> 61) ^ (a >> 60);
+  }
+};
+
 #if defined __HIP_PLATFORM_AMD__ // u32 case
 
+inline constexpr char simd_backend_name[] = "u32";
+
 struct Uint1xN {
   static constexpr int elem_bits = 1;
   static constexpr int elem_count = 32;
@@ -85,6 +238,8 @@ struct Uint1xN {
 
 #else // u64 case
 
+inline constexpr char simd_backend_name[] = "u64";
+
 struct Uint1xN {
   static constexpr int elem_bits = 1;
   static constexpr int elem_count = 64;
@@ -133,4 +288,137 @@ struct Uint1xN {
 
 #endif // u32 or u64
 
+// The 3-input function of x, y and z whose value at x = a, y = b, z = c is bit
+// 4a + 2b + c of imm, as vpternlogq: the or of the minterms it selects.
+template <int imm> Uint1xN ternary(Uint1xN x, Uint1xN y, Uint1xN z) {
+  Uint1xN r = {x.val ^ x.val};
+  for (int m = 0; m < 8; ++m) {
+    if ((imm >> m) & 1) {
+      r.val |= ((m & 4) ? x.val : ~x.val) & ((m & 2) ? y.val : ~y.val) &
+               ((m & 1) ? z.val : ~z.val);
+    }
+  }
+  return r;
+}
+inline constexpr bool uint1_native_ternary = false;
+
+// Lane l of the result is lane l ^ 2^j of x, for 2^j < Uint1xN::elem_count.
+template <int j> Uint1xN lane_xor_permute(Uint1xN x) {
+  static_assert(j >= 0 && (1 << j) < Uint1xN::elem_count);
+  auto high = Uint1xN::seq(j).val;
+  return {((x.val << (1 << j)) & high) | ((x.val >> (1 << j)) & ~high)};
+}
+
+// Lane l of the result is lane l - n of x, or 0 if there is none, for
+// -elem_count < n < elem_count.
+inline Uint1xN lane_shift(Uint1xN x, int n) {
+  assert(n > -Uint1xN::elem_count && n < Uint1xN::elem_count);
+  return {n >= 0 ? x.val << n : x.val >> -n};
+}
+
+// Lane l of the result is lane (l - n) mod elem_count of x.
+inline Uint1xN lane_rotate(Uint1xN x, int n) {
+  n &= Uint1xN::elem_count - 1;
+  if (n == 0) {
+    return x;
+  }
+  return {(x.val << n) | (x.val >> (Uint1xN::elem_count - n))};
+}
+
+// A gather of lanes for lane_permute, which takes lane indices[l] of x to
+// lane l, for any indices below elem_count. Permutations are the delta swaps
+// of a Benes network; other indices, which repeat lanes, gather lane by lane.
+// Building one costs much more than applying it.
+struct LanePermutation {
+  using Word = decltype(Uint1xN::val);
+  static constexpr int n = Uint1xN::elem_count;
+  static constexpr int lane_bits = std::countr_zero(unsigned{n});
+  // The stages swap lanes l and l + 2^b where bit l of the mask is set, for
+  // b from lane_bits - 1 down to 0 and back up.
+  Word masks[2 * lane_bits - 1];
+  // Whether the indices are not a permutation, and then the indices.
+  bool gather;
+  uint8_t indices[n];
+
+  static constexpr int stageBit(int stage) {
+    return stage < lane_bits ? lane_bits - 1 - stage : stage - lane_bits + 1;
+  }
+
+  // Routes each group of 2h lanes at level b, where h = 2^b, by the looping
+  // algorithm: the pairs of inputs and of outputs 2^b apart are split between
+  // the subnetworks of lanes with bit b clear and set, which then route
+  // recursively.
+  static LanePermutation from_indices(const uint16_t *indices) {
+    LanePermutation p = {};
+    int perm[n];
+    bool seen[n] = {};
+    for (int l = 0; l < n; ++l) {
+      assert(indices[l] < n);
+      perm[l] = indices[l];
+      p.indices[l] = indices[l];
+      p.gather |= seen[perm[l]];
+      seen[perm[l]] = true;
+    }
+    if (p.gather) {
+      return p;
+    }
+    for (int b = lane_bits - 1; b >= 1; --b) {
+      int h = 1 << b;
+      int next[n];
+      for (int base = 0; base < n; base += 2 * h) {
+        const int *pi = perm + base;
+        int inverse[n], side[n];
+        bool swap_in[n] = {};
+        for (int o = 0; o < 2 * h; ++o) {
+          assert(pi[o] >= base && pi[o] < base + 2 * h);
+          inverse[pi[o] - base] = o;
+          side[o] = -1;
+        }
+        for (int start = 0; start < h; ++start) {
+          int o = start;
+          while (side[o] < 0) {
+            side[o] = 0;
+            side[o ^ h] = 1;
+            int i = pi[o] - base;
+            swap_in[i % h] = i >= h;
+            int i2 = pi[o ^ h] - base;
+            swap_in[i2 % h] = i2 < h;
+            o = inverse[i2 ^ h];
+          }
+        }
+        for (int o = 0; o < 2 * h; ++o) {
+          int i = pi[o] - base;
+          // The subnetwork side[o] takes input i to its position o % h.
+          next[base + side[o] * h + o % h] = base + side[o] * h + i % h;
+          if (o < h) {
+            p.masks[lane_bits - 1 - b] |= Word{swap_in[o]} << (base + o);
+            p.masks[lane_bits - 1 + b] |= Word{side[o] == 1} << (base + o);
+          }
+        }
+      }
+      std::copy(next, next + n, perm);
+    }
+    for (int l = 0; l < n; l += 2) {
+      p.masks[lane_bits - 1] |= Word{perm[l] != l} << l;
+    }
+    return p;
+  }
+};
+
+inline Uint1xN lane_permute(Uint1xN x, const LanePermutation &p) {
+  if (p.gather) {
+    LanePermutation::Word y = 0;
+    for (int l = 0; l < LanePermutation::n; ++l) {
+      y |= ((x.val >> p.indices[l]) & 1) << l;
+    }
+    return {y};
+  }
+  for (int stage = 0; stage < 2 * LanePermutation::lane_bits - 1; ++stage) {
+    int shift = 1 << LanePermutation::stageBit(stage);
+    auto t = ((x.val >> shift) ^ x.val) & p.masks[stage];
+    x.val ^= t ^ (t << shift);
+  }
+  return x;
+}
+
 #endif // HAY_SIMD_U32_U64_H_
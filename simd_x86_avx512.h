@@ -8,8 +8,11 @@
 #define HAY_SIMD_X86_AVX512_H_
 
 #include <cassert>
+#include <cstdint>
 #include <immintrin.h>
 
+inline constexpr char simd_backend_name[] = "x86_avx512";
+
 struct Int64xN {
   static constexpr int elem_bits = 64;
   static constexpr int elem_count = 8;
@@ -20,6 +23,21 @@ struct Int64xN {
   friend Int64xN sub(Int64xN x, Int64xN y) {
     return {_mm512_sub_epi64(x.val, y.val)};
   }
+  friend Int64xN mul(Int64xN x, Int64xN y) {
+    return {_mm512_mullo_epi64(x.val, y.val)};
+  }
+  friend Int64xN madd(Int64xN x, Int64xN y, Int64xN z) {
+    return add(x, mul(y, z));
+  }
+  // Products of the low 32 bits of the lanes, sign-extended: exact where the
+  // lanes are in the int32 range, and one vpmuldq rather than the three uops
+  // of vpmullq.
+  friend Int64xN mul_lo32(Int64xN x, Int64xN y) {
+    return {_mm512_mul_epi32(x.val, y.val)};
+  }
+  friend Int64xN madd_lo32(Int64xN x, Int64xN y, Int64xN z) {
+    return add(x, mul_lo32(y, z));
+  }
   friend Int64xN min(Int64xN x, Int64xN y) {
     return {_mm512_min_epi64(x.val, y.val)};
   }
@@ -43,6 +61,216 @@ struct Int64xN {
   }
 };
 
+// Narrow integers: more lanes than Int64xN, with wrapping and saturating
+// arithmetic. reduce_add widens, so it does not overflow. Conversions to and
+// from Int64xN go through int64_parts Int64xN values, part p holding lanes
+// p * Int64xN::elem_count and up.
+
+struct Int8xN {
+  static constexpr int elem_bits = 8;
+  static constexpr int elem_count = 64;
+  static constexpr int int64_parts = elem_count / Int64xN::elem_count;
+  __m512i val;
+  friend Int8xN add(Int8xN x, Int8xN y) {
+    return {_mm512_add_epi8(x.val, y.val)};
+  }
+  friend Int8xN sub(Int8xN x, Int8xN y) {
+    return {_mm512_sub_epi8(x.val, y.val)};
+  }
+  friend Int8xN add_sat(Int8xN x, Int8xN y) {
+    return {_mm512_adds_epi8(x.val, y.val)};
+  }
+  friend Int8xN sub_sat(Int8xN x, Int8xN y) {
+    return {_mm512_subs_epi8(x.val, y.val)};
+  }
+  friend Int8xN min(Int8xN x, Int8xN y) {
+    return {_mm512_min_epi8(x.val, y.val)};
+  }
+  friend Int8xN max(Int8xN x, Int8xN y) {
+    return {_mm512_max_epi8(x.val, y.val)};
+  }
+  // Biases the lanes to unsigned for vpsadbw, which sums groups of 8.
+  friend int64_t reduce_add(Int8xN x) {
+    __m512i biased = _mm512_xor_si512(x.val, _mm512_set1_epi8(-128));
+    __m512i sums = _mm512_sad_epu8(biased, _mm512_setzero_si512());
+    return _mm512_reduce_add_epi64(sums) - 128 * elem_count;
+  }
+  static Int8xN load(const void *from) { return {_mm512_loadu_si512(from)}; }
+  friend void store(void *to, Int8xN x) { _mm512_storeu_si512(to, x.val); }
+  friend bool operator==(Int8xN x, Int8xN y) {
+    return _mm512_cmpneq_epi8_mask(x.val, y.val) == 0;
+  }
+  static Int8xN cst(int8_t c) { return {_mm512_set1_epi8(c)}; }
+  friend int8_t extract(Int8xN x, int i) {
+    assert(i < elem_count);
+    int8_t buf[elem_count];
+    store(buf, x);
+    return buf[i];
+  }
+  friend Int64xN to_int64(Int8xN x, int part) {
+    assert(part < int64_parts);
+    __m512i q = _mm512_permutexvar_epi64(_mm512_set1_epi64(part), x.val);
+    return {_mm512_cvtepi8_epi64(_mm512_castsi512_si128(q))};
+  }
+  // Truncating.
+  static Int8xN from_int64(const Int64xN *parts) {
+    alignas(64) int8_t buf[elem_count];
+    for (int p = 0; p < int64_parts; ++p) {
+      _mm_storel_epi64(reinterpret_cast<__m128i *>(buf + 8 * p),
+                       _mm512_cvtepi64_epi8(parts[p].val));
+    }
+    return load(buf);
+  }
+  static Int8xN from_int64_sat(const Int64xN *parts) {
+    alignas(64) int8_t buf[elem_count];
+    for (int p = 0; p < int64_parts; ++p) {
+      _mm_storel_epi64(reinterpret_cast<__m128i *>(buf + 8 * p),
+                       _mm512_cvtsepi64_epi8(parts[p].val));
+    }
+    return load(buf);
+  }
+};
+
+struct Int16xN {
+  static constexpr int elem_bits = 16;
+  static constexpr int elem_count = 32;
+  static constexpr int int64_parts = elem_count / Int64xN::elem_count;
+  __m512i val;
+  friend Int16xN add(Int16xN x, Int16xN y) {
+    return {_mm512_add_epi16(x.val, y.val)};
+  }
+  friend Int16xN sub(Int16xN x, Int16xN y) {
+    return {_mm512_sub_epi16(x.val, y.val)};
+  }
+  friend Int16xN add_sat(Int16xN x, Int16xN y) {
+    return {_mm512_adds_epi16(x.val, y.val)};
+  }
+  friend Int16xN sub_sat(Int16xN x, Int16xN y) {
+    return {_mm512_subs_epi16(x.val, y.val)};
+  }
+  friend Int16xN min(Int16xN x, Int16xN y) {
+    return {_mm512_min_epi16(x.val, y.val)};
+  }
+  friend Int16xN max(Int16xN x, Int16xN y) {
+    return {_mm512_max_epi16(x.val, y.val)};
+  }
+  // Sums pairs into 32 bits first, which 16 sums of pairs cannot overflow.
+  friend int64_t reduce_add(Int16xN x) {
+    return _mm512_reduce_add_epi32(
+        _mm512_madd_epi16(x.val, _mm512_set1_epi16(1)));
+  }
+  static Int16xN load(const void *from) { return {_mm512_loadu_si512(from)}; }
+  friend void store(void *to, Int16xN x) { _mm512_storeu_si512(to, x.val); }
+  friend bool operator==(Int16xN x, Int16xN y) {
+    return _mm512_cmpneq_epi16_mask(x.val, y.val) == 0;
+  }
+  static Int16xN cst(int16_t c) { return {_mm512_set1_epi16(c)}; }
+  friend int16_t extract(Int16xN x, int i) {
+    assert(i < elem_count);
+    int16_t buf[elem_count];
+    store(buf, x);
+    return buf[i];
+  }
+  friend Int64xN to_int64(Int16xN x, int part) {
+    assert(part < int64_parts);
+    __m512i q = _mm512_permutexvar_epi64(
+        _mm512_setr_epi64(2 * part, 2 * part + 1, 0, 0, 0, 0, 0, 0), x.val);
+    return {_mm512_cvtepi16_epi64(_mm512_castsi512_si128(q))};
+  }
+  // Truncating.
+  static Int16xN from_int64(const Int64xN *parts) {
+    alignas(64) int16_t buf[elem_count];
+    for (int p = 0; p < int64_parts; ++p) {
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(buf + 8 * p),
+                       _mm512_cvtepi64_epi16(parts[p].val));
+    }
+    return load(buf);
+  }
+  static Int16xN from_int64_sat(const Int64xN *parts) {
+    alignas(64) int16_t buf[elem_count];
+    for (int p = 0; p < int64_parts; ++p) {
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(buf + 8 * p),
+                       _mm512_cvtsepi64_epi16(parts[p].val));
+    }
+    return load(buf);
+  }
+};
+
+struct Int32xN {
+  static constexpr int elem_bits = 32;
+  static constexpr int elem_count = 16;
+  static constexpr int int64_parts = elem_count / Int64xN::elem_count;
+  __m512i val;
+  friend Int32xN add(Int32xN x, Int32xN y) {
+    return {_mm512_add_epi32(x.val, y.val)};
+  }
+  friend Int32xN sub(Int32xN x, Int32xN y) {
+    return {_mm512_sub_epi32(x.val, y.val)};
+  }
+  // There is no saturating 32-bit add: a sum overflowed where it has the
+  // other sign than both operands.
+  friend Int32xN add_sat(Int32xN x, Int32xN y) {
+    __m512i sum = _mm512_add_epi32(x.val, y.val);
+    __m512i overflow = _mm512_and_si512(_mm512_xor_si512(x.val, sum),
+                                        _mm512_xor_si512(y.val, sum));
+    return {saturate(sum, x.val, overflow)};
+  }
+  // ...and a difference where x has the other sign than both y and it.
+  friend Int32xN sub_sat(Int32xN x, Int32xN y) {
+    __m512i diff = _mm512_sub_epi32(x.val, y.val);
+    __m512i overflow = _mm512_and_si512(_mm512_xor_si512(x.val, y.val),
+                                        _mm512_xor_si512(x.val, diff));
+    return {saturate(diff, x.val, overflow)};
+  }
+  friend Int32xN min(Int32xN x, Int32xN y) {
+    return {_mm512_min_epi32(x.val, y.val)};
+  }
+  friend Int32xN max(Int32xN x, Int32xN y) {
+    return {_mm512_max_epi32(x.val, y.val)};
+  }
+  friend int64_t reduce_add(Int32xN x) {
+    return reduce_add(add(to_int64(x, 0), to_int64(x, 1)));
+  }
+  static Int32xN load(const void *from) { return {_mm512_loadu_si512(from)}; }
+  friend void store(void *to, Int32xN x) { _mm512_storeu_si512(to, x.val); }
+  friend bool operator==(Int32xN x, Int32xN y) {
+    return _mm512_cmpneq_epi32_mask(x.val, y.val) == 0;
+  }
+  static Int32xN cst(int32_t c) { return {_mm512_set1_epi32(c)}; }
+  friend int32_t extract(Int32xN x, int i) {
+    assert(i < elem_count);
+    int32_t buf[elem_count];
+    store(buf, x);
+    return buf[i];
+  }
+  friend Int64xN to_int64(Int32xN x, int part) {
+    assert(part < int64_parts);
+    __m256i half = part == 0 ? _mm512_castsi512_si256(x.val)
+                             : _mm512_extracti64x4_epi64(x.val, 1);
+    return {_mm512_cvtepi32_epi64(half)};
+  }
+  // Truncating.
+  static Int32xN from_int64(const Int64xN *parts) {
+    return {_mm512_inserti64x4(
+        _mm512_castsi256_si512(_mm512_cvtepi64_epi32(parts[0].val)),
+        _mm512_cvtepi64_epi32(parts[1].val), 1)};
+  }
+  static Int32xN from_int64_sat(const Int64xN *parts) {
+    return {_mm512_inserti64x4(
+        _mm512_castsi256_si512(_mm512_cvtsepi64_epi32(parts[0].val)),
+        _mm512_cvtsepi64_epi32(parts[1].val), 1)};
+  }
+
+private:
+  // result, but the limit of x's sign where overflow's sign bit is set.
+  static __m512i saturate(__m512i result, __m512i x, __m512i overflow) {
+    __m512i limit = _mm512_xor_si512(_mm512_srai_epi32(x, 31),
+                                     _mm512_set1_epi32(INT32_MAX));
+    return _mm512_mask_mov_epi32(result, _mm512_movepi32_mask(overflow),
+                                 limit);
+  }
+};
+
 struct Uint1xN {
   static constexpr int elem_bits = 1;
   static constexpr int elem_count = 512;
@@ -103,4 +331,220 @@ struct Uint1xN {
   }
 };
 
+// The 3-input function of x, y and z whose value at x = a, y = b, z = c is bit
+// 4a + 2b + c of imm, as vpternlogq.
+template <int imm> Uint1xN ternary(Uint1xN x, Uint1xN y, Uint1xN z) {
+  return {_mm512_ternarylogic_epi64(x.val, y.val, z.val, imm)};
+}
+inline constexpr bool uint1_native_ternary = true;
+
+// Lane l of the result is lane l ^ 2^j of x, for 2^j < Uint1xN::elem_count.
+template <int j> Uint1xN lane_xor_permute(Uint1xN x) {
+  static_assert(j >= 0 && (1 << j) < Uint1xN::elem_count);
+  if constexpr (j < 6) {
+    return {_mm512_ternarylogic_epi64(Uint1xN::seq(j).val,
+                                      _mm512_slli_epi64(x.val, 1 << j),
+                                      _mm512_srli_epi64(x.val, 1 << j), 0xCA)};
+  } else if constexpr (j == 6) {
+    return {_mm512_shuffle_epi32(x.val, _MM_PERM_BADC)};
+  } else if constexpr (j == 7) {
+    return {_mm512_shuffle_i64x2(x.val, x.val, 0xB1)};
+  } else {
+    return {_mm512_shuffle_i64x2(x.val, x.val, 0x4E)};
+  }
+}
+
+// Lane l of the result is lane l - n of x, or 0 if there is none, for
+// -elem_count < n < elem_count.
+inline Uint1xN lane_shift(Uint1xN x, int n) {
+  assert(n > -Uint1xN::elem_count && n < Uint1xN::elem_count);
+  const __m512i iota = _mm512_setr_epi64(0, 1, 2, 3, 4, 5, 6, 7);
+  int q = (n < 0 ? -n : n) / 64;
+  __m512i r = _mm512_set1_epi64((n < 0 ? -n : n) % 64);
+  __m512i r_complement = _mm512_sub_epi64(_mm512_set1_epi64(64), r);
+  if (n >= 0) {
+    // Qword i is the top of qword i - q shifted up, and the bottom of
+    // qword i - q - 1 shifted in, each 0 if out of range.
+    __m512i near = _mm512_maskz_permutexvar_epi64(
+        _cvtu32_mask8(0xFFu << q), _mm512_sub_epi64(iota, _mm512_set1_epi64(q)),
+        x.val);
+    __m512i far = _mm512_maskz_permutexvar_epi64(
+        _cvtu32_mask8(0xFFu << (q + 1)),
+        _mm512_sub_epi64(iota, _mm512_set1_epi64(q + 1)), x.val);
+    return {_mm512_or_si512(_mm512_sllv_epi64(near, r),
+                            _mm512_srlv_epi64(far, r_complement))};
+  }
+  __m512i near = _mm512_maskz_permutexvar_epi64(
+      _cvtu32_mask8(0xFFu >> q), _mm512_add_epi64(iota, _mm512_set1_epi64(q)),
+      x.val);
+  __m512i far = _mm512_maskz_permutexvar_epi64(
+      _cvtu32_mask8(0xFFu >> (q + 1)),
+      _mm512_add_epi64(iota, _mm512_set1_epi64(q + 1)), x.val);
+  return {_mm512_or_si512(_mm512_srlv_epi64(near, r),
+                          _mm512_sllv_epi64(far, r_complement))};
+}
+
+// Lane l of the result is lane (l - n) mod elem_count of x.
+inline Uint1xN lane_rotate(Uint1xN x, int n) {
+  n &= Uint1xN::elem_count - 1;
+  const __m512i iota = _mm512_setr_epi64(0, 1, 2, 3, 4, 5, 6, 7);
+  __m512i q = _mm512_set1_epi64(n / 64);
+  __m512i r = _mm512_set1_epi64(n % 64);
+  __m512i near = _mm512_permutexvar_epi64(_mm512_sub_epi64(iota, q), x.val);
+  __m512i far = _mm512_permutexvar_epi64(
+      _mm512_sub_epi64(_mm512_sub_epi64(iota, q), _mm512_set1_epi64(1)),
+      x.val);
+  return {_mm512_or_si512(
+      _mm512_sllv_epi64(near, r),
+      _mm512_srlv_epi64(far, _mm512_sub_epi64(_mm512_set1_epi64(64), r)))};
+}
+
+// A gather of lanes for lane_permute, which takes lane indices[l] of x to
+// lane l, for any indices below elem_count, repeated or not. Building one
+// costs much more than applying it.
+struct LanePermutation {
+#if defined(__AVX512VBMI__) && defined(__AVX512BITALG__)
+  // For each qword k of the result, the vpermb gathering into byte b the
+  // byte of x that holds the source of lane 64 k + b, and the vpshufbitqmb
+  // picking that lane out.
+  __m512i bytes[8];
+  __m512i bits[8];
+
+  static LanePermutation from_indices(const uint16_t *indices) {
+    LanePermutation p;
+    for (int k = 0; k < 8; ++k) {
+      alignas(64) uint8_t bytes[64], bits[64];
+      for (int b = 0; b < 64; ++b) {
+        int src = indices[64 * k + b];
+        assert(src < Uint1xN::elem_count);
+        bytes[b] = src / 8;
+        bits[b] = 8 * (b % 8) + src % 8;
+      }
+      p.bytes[k] = _mm512_load_si512(bytes);
+      p.bits[k] = _mm512_load_si512(bits);
+    }
+    return p;
+  }
+#else
+  uint16_t indices[Uint1xN::elem_count];
+
+  static LanePermutation from_indices(const uint16_t *indices) {
+    LanePermutation p;
+    for (int l = 0; l < Uint1xN::elem_count; ++l) {
+      assert(indices[l] < Uint1xN::elem_count);
+      p.indices[l] = indices[l];
+    }
+    return p;
+  }
+#endif
+};
+
+inline Uint1xN lane_permute(Uint1xN x, const LanePermutation &p) {
+#if defined(__AVX512VBMI__) && defined(__AVX512BITALG__)
+  uint64_t q[8];
+  for (int k = 0; k < 8; ++k) {
+    __m512i gathered = _mm512_permutexvar_epi8(p.bytes[k], x.val);
+    q[k] = _cvtmask64_u64(_mm512_bitshuffle_epi64_mask(gathered, p.bits[k]));
+  }
+  return {_mm512_setr_epi64(q[0], q[1], q[2], q[3], q[4], q[5], q[6], q[7])};
+#else
+  alignas(64) uint8_t in[64], out[64] = {};
+  _mm512_store_si512(in, x.val);
+  for (int l = 0; l < Uint1xN::elem_count; ++l) {
+    int src = p.indices[l];
+    out[l / 8] |= ((in[src / 8] >> (src % 8)) & 1) << (l % 8);
+  }
+  return {_mm512_load_si512(out)};
+#endif
+}
+
+// Elements of GF(2^64) = GF(2)[x] / (x^64 + x^4 + x^3 + x + 1), one per
+// 64-bit lane, bit b holding the coefficient of x^b.
+struct Poly64xN {
+  static constexpr int elem_bits = 64;
+  static constexpr int elem_count = 8;
+  // The modulus less its leading term. Its square has degree below 64, so
+  // Barrett's constant floor(x^128 / modulus) is x^64 + low_modulus too.
+  static constexpr uint64_t low_modulus = 0x1B;
+  __m512i val;
+
+  // The carry-less product of x and y: the low 64 coefficients, and the high
+  // ones into *hi.
+  friend Poly64xN clmul(Poly64xN x, Poly64xN y, Poly64xN *hi) {
+#ifdef __VPCLMULQDQ__
+    // Products of the even lanes, then of the odd lanes, as 128-bit lanes.
+    __m512i even = _mm512_clmulepi64_epi128(x.val, y.val, 0x00);
+    __m512i odd = _mm512_clmulepi64_epi128(x.val, y.val, 0x11);
+    hi->val = _mm512_unpackhi_epi64(even, odd);
+    return {_mm512_unpacklo_epi64(even, odd)};
+#else
+    alignas(64) uint64_t a[elem_count], b[elem_count];
+    alignas(64) uint64_t lo[elem_count], h[elem_count];
+    _mm512_store_si512(a, x.val);
+    _mm512_store_si512(b, y.val);
+    for (int i = 0; i < elem_count; ++i) {
+      __m128i p = _mm_clmulepi64_si128(_mm_cvtsi64_si128(a[i]),
+                                       _mm_cvtsi64_si128(b[i]), 0x00);
+      lo[i] = _mm_cvtsi128_si64(p);
+      h[i] = _mm_extract_epi64(p, 1);
+    }
+    hi->val = _mm512_load_si512(h);
+    return {_mm512_load_si512(lo)};
+#endif
+  }
+  friend Poly64xN add(Poly64xN x, Poly64xN y) {
+    return {_mm512_xor_si512(x.val, y.val)};
+  }
+  friend Poly64xN sub(Poly64xN x, Poly64xN y) { return add(x, y); }
+  friend Poly64xN mul(Poly64xN x, Poly64xN y) {
+    Poly64xN hi;
+    Poly64xN lo = clmul(x, y, &hi);
+    return reduce(lo, hi);
+  }
+  // Adds x before the reduction, which is linear.
+  friend Poly64xN madd(Poly64xN x, Poly64xN y, Poly64xN z) {
+    Poly64xN hi;
+    Poly64xN lo = clmul(y, z, &hi);
+    return reduce(add(lo, x), hi);
+  }
+  friend uint64_t reduce_add(Poly64xN x) {
+    alignas(64) uint64_t buf[elem_count];
+    _mm512_store_si512(buf, x.val);
+    uint64_t sum = 0;
+    for (int i = 0; i < elem_count; ++i) {
+      sum ^= buf[i];
+    }
+    return sum;
+  }
+  static Poly64xN load(const void *from) { return {_mm512_loadu_si512(from)}; }
+  friend void store(void *to, Poly64xN x) { _mm512_storeu_si512(to, x.val); }
+  friend bool operator==(Poly64xN x, Poly64xN y) {
+    return _mm512_cmp_epi64_mask(x.val, y.val, _MM_CMPINT_EQ) == 0xFF;
+  }
+  static Poly64xN cst(uint64_t c) { return {_mm512_set1_epi64(c)}; }
+  // Lane l is bit i of l, as the polynomial 0 or 1.
+  static Poly64xN seq(int i) {
+    __m512i lanes = _mm512_setr_epi64(0, 1, 2, 3, 4, 5, 6, 7);
+    return {_mm512_and_si512(_mm512_srlv_epi64(lanes, _mm512_set1_epi64(i)),
+                             _mm512_set1_epi64(1))};
+  }
+  friend uint64_t extract(Poly64xN x, int i) {
+    assert(i < elem_count);
+    return _mm256_extract_epi64(_mm512_castsi512_si256(_mm512_permutexvar_epi64(
+                                    _mm512_set1_epi64(i), x.val)),
+                                0);
+  }
+
+private:
+  // Barrett reduction of hi * x^64 + lo: the quotient is
+  // q = floor(hi * (x^64 + low_modulus) / x^64), and the remainder is
+  // lo + q * low_modulus mod x^64. Two carry-less products.
+  static Poly64xN reduce(Poly64xN lo, Poly64xN hi) {
+    Poly64xN m = cst(low_modulus);
+    Poly64xN q_hi, unused;
+    clmul(hi, m, &q_hi);
+    return add(lo, clmul(add(hi, q_hi), m, &unused));
+  }
+};
+
 #endif // HAY_SIMD_X86_AVX512_H_
@@ -0,0 +1,153 @@
+// Copyright 2024 The Hay Authors
+//
+// Licensed under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#ifndef HAY_SLICED_INT_H_
+#define HAY_SLICED_INT_H_
+
+#include "simd.h"
+#include "vector.h"
+
+#include <cstdint>
+
+// Bitsliced unsigned integers: lane l of a UintKxN<bits> holds the integer
+// whose bit b is lane l of elems[b]. Arithmetic is modulo 2^bits.
+//
+// The functions below take Vector<Uint1xN, sizes> rather than UintKxN<bits>
+// so that `bits` gets deduced; they require a 1-D shape.
+template <int bits> using UintKxN = Vector<Uint1xN, {bits}>;
+
+inline Uint1xN bit_not(Uint1xN x) { return add(x, Uint1xN::cst(1)); }
+
+inline Uint1xN bit_or(Uint1xN x, Uint1xN y) { return madd(add(x, y), x, y); }
+
+// Lanes of x where mask is set, lanes of y elsewhere.
+inline Uint1xN select(Uint1xN mask, Uint1xN x, Uint1xN y) {
+  return madd(y, mask, add(x, y));
+}
+
+inline bool is_zero(Uint1xN x) { return x == Uint1xN::cst(0); }
+
+// The Uint1xN whose lane l is bit(l), e.g. to build per-lane constants.
+template <typename F> Uint1xN lane_mask(F bit) {
+  uint8_t bytes[sizeof(Uint1xN)] = {};
+  for (int l = 0; l < Uint1xN::elem_count; ++l) {
+    bytes[l / 8] |= (bit(l) ? 1 : 0) << (l % 8);
+  }
+  return Uint1xN::load(bytes);
+}
+
+template <typename EType, Indices sizes>
+Vector<EType, sizes> select(Uint1xN mask, Vector<EType, sizes> x,
+                            Vector<EType, sizes> y) {
+  Vector<EType, sizes> result;
+  for (int i = 0; i < result.flatSize; ++i) {
+    result.elems[i] = select(mask, x.elems[i], y.elems[i]);
+  }
+  return result;
+}
+
+template <int bits> UintKxN<bits> sliced_cst(uint64_t c) {
+  UintKxN<bits> result;
+  for (int b = 0; b < bits; ++b) {
+    result.elems[b] = Uint1xN::cst((c >> b) & 1);
+  }
+  return result;
+}
+
+template <Indices sizes>
+Vector<Uint1xN, sizes> sliced_add(Vector<Uint1xN, sizes> x,
+                                  Vector<Uint1xN, sizes> y) {
+  static_assert(sizes.size() == 1);
+  constexpr int bits = sizes[0];
+  Vector<Uint1xN, sizes> result;
+  Uint1xN carry = Uint1xN::cst(0);
+  for (int b = 0; b < bits; ++b) {
+    Uint1xN t = add(x.elems[b], y.elems[b]);
+    result.elems[b] = add(t, carry);
+    carry = madd(mul(x.elems[b], y.elems[b]), carry, t);
+  }
+  return result;
+}
+
+template <Indices sizes>
+Vector<Uint1xN, sizes> sliced_sub(Vector<Uint1xN, sizes> x,
+                                  Vector<Uint1xN, sizes> y) {
+  static_assert(sizes.size() == 1);
+  constexpr int bits = sizes[0];
+  Vector<Uint1xN, sizes> result;
+  Uint1xN borrow = Uint1xN::cst(0);
+  for (int b = 0; b < bits; ++b) {
+    Uint1xN t = add(x.elems[b], y.elems[b]);
+    result.elems[b] = add(t, borrow);
+    borrow = madd(mul(bit_not(x.elems[b]), y.elems[b]), borrow, bit_not(t));
+  }
+  return result;
+}
+
+// Adds 1 to the lanes selected by `mask`.
+template <Indices sizes>
+Vector<Uint1xN, sizes> sliced_increment(Vector<Uint1xN, sizes> x,
+                                        Uint1xN mask) {
+  static_assert(sizes.size() == 1);
+  constexpr int bits = sizes[0];
+  Uint1xN carry = mask;
+  for (int b = 0; b < bits; ++b) {
+    Uint1xN t = x.elems[b];
+    x.elems[b] = add(t, carry);
+    carry = mul(t, carry);
+  }
+  return x;
+}
+
+// Mask of the lanes where x < y.
+template <Indices sizes>
+Uint1xN sliced_less(Vector<Uint1xN, sizes> x, Vector<Uint1xN, sizes> y) {
+  static_assert(sizes.size() == 1);
+  constexpr int bits = sizes[0];
+  Uint1xN lt = Uint1xN::cst(0);
+  Uint1xN eq = Uint1xN::cst(1);
+  for (int b = bits - 1; b >= 0; --b) {
+    Uint1xN d = add(x.elems[b], y.elems[b]);
+    lt = madd(lt, eq, mul(d, y.elems[b]));
+    eq = mul(eq, bit_not(d));
+  }
+  return lt;
+}
+
+// Mask of the lanes where x == c.
+template <Indices sizes>
+Uint1xN sliced_equal(Vector<Uint1xN, sizes> x, uint64_t c) {
+  static_assert(sizes.size() == 1);
+  constexpr int bits = sizes[0];
+  Uint1xN eq = Uint1xN::cst(1);
+  for (int b = 0; b < bits; ++b) {
+    eq = mul(eq, add(x.elems[b], Uint1xN::cst(((c >> b) & 1) ^ 1)));
+  }
+  return eq;
+}
+
+// Per-lane count of the set elements of x. The count wraps modulo 2^bits.
+template <int bits, typename EType, Indices sizes>
+UintKxN<bits> sliced_weight(Vector<EType, sizes> x) {
+  UintKxN<bits> result = UintKxN<bits>::cst(0);
+  for (int i = 0; i < x.flatSize; ++i) {
+    result = sliced_increment(result, x.elems[i]);
+  }
+  return result;
+}
+
+template <Indices sizes>
+uint64_t extract_uint(Vector<Uint1xN, sizes> x, int lane) {
+  static_assert(sizes.size() == 1);
+  constexpr int bits = sizes[0];
+  uint64_t result = 0;
+  for (int b = 0; b < bits; ++b) {
+    result |= uint64_t{extract(x.elems[b], lane)} << b;
+  }
+  return result;
+}
+
+#endif // HAY_SLICED_INT_H_
@@ -0,0 +1,71 @@
+// Copyright 2024 The Hay Authors
+//
+// Licensed under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#include "sliced_int.h"
+#include "testlib.h"
+
+struct TestSlicedIntArithmetic {
+  static void Run() {
+    using U = UintKxN<8>;
+    std::minstd_rand0 engine;
+    U x = getRandom<U>(engine);
+    U y = getRandom<U>(engine);
+    Uint1xN m = getRandom<Uint1xN>(engine);
+    U sum = sliced_add(x, y);
+    U diff = sliced_sub(x, y);
+    U inc = sliced_increment(x, m);
+    Uint1xN lt = sliced_less(x, y);
+    for (int l = 0; l < Uint1xN::elem_count; ++l) {
+      uint64_t a = extract_uint(x, l);
+      uint64_t b = extract_uint(y, l);
+      CHECK_EQ(extract_uint(sum, l), (a + b) & 0xFF);
+      CHECK_EQ(extract_uint(diff, l), (a - b) & 0xFF);
+      CHECK_EQ(extract_uint(inc, l), (a + extract(m, l)) & 0xFF);
+      CHECK_EQ(extract(lt, l), uint8_t{a < b});
+      CHECK_EQ(extract(sliced_equal(x, a), l), 1);
+    }
+    CHECK_EQ(sliced_sub(sum, y), x);
+    CHECK_EQ(sliced_less(x, x), Uint1xN::cst(0));
+    CHECK_EQ(extract_uint(sliced_cst<8>(0xA5), 0), uint64_t{0xA5});
+  }
+};
+
+struct TestSlicedIntWeight {
+  static void Run() {
+    using V = Vector<Uint1xN, {3, 5}>;
+    std::minstd_rand0 engine;
+    V x = getRandom<V>(engine);
+    UintKxN<4> w = sliced_weight<4>(x);
+    for (int l = 0; l < Uint1xN::elem_count; ++l) {
+      auto e = extract(x, l);
+      uint64_t expected = 0;
+      for (int i = 0; i < V::flatSize; ++i) {
+        expected += e.elems[i];
+      }
+      CHECK_EQ(extract_uint(w, l), expected);
+    }
+  }
+};
+
+struct TestSlicedIntSelect {
+  static void Run() {
+    std::minstd_rand0 engine;
+    Uint1xN m = getRandom<Uint1xN>(engine);
+    Uint1xN x = getRandom<Uint1xN>(engine);
+    Uint1xN y = getRandom<Uint1xN>(engine);
+    Uint1xN s = select(m, x, y);
+    for (int l = 0; l < Uint1xN::elem_count; ++l) {
+      CHECK_EQ(extract(s, l), extract(m, l) ? extract(x, l) : extract(y, l));
+      CHECK_EQ(extract(bit_or(x, y), l), extract(x, l) | extract(y, l));
+    }
+  }
+};
+
+int main() {
+  TEST(TestSlicedIntArithmetic);
+  TEST(TestSlicedIntWeight);
+  TEST(TestSlicedIntSelect);
+}
@@ -0,0 +1,74 @@
+// Copyright 2024 The Hay Authors
+//
+// Licensed under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#ifndef HAY_SLICING_H_
+#define HAY_SLICING_H_
+
+#include "simd.h"
+#include "vector.h"
+
+#include <cstdint>
+#include <cstring>
+
+// Transposes a 64x64 bit matrix in place: bit j of rows[i] is exchanged with
+// bit i of rows[j].
+inline void transpose_64x64(uint64_t rows[64]) {
+  uint64_t m = 0x00000000FFFFFFFFu;
+  for (int j = 32; j != 0; j >>= 1, m ^= m << j) {
+    for (int k = 0; k < 64; k = ((k | j) + 1) & ~j) {
+      uint64_t t = ((rows[k] >> j) ^ rows[k | j]) & m;
+      rows[k] ^= t << j;
+      rows[k | j] ^= t;
+    }
+  }
+}
+
+// Moves x out of sliced form: for each lane l, bit j of keys[l] is lane l of
+// x.elems[j]. keys must have room for Uint1xN::elem_count entries.
+template <Indices sizes>
+void unslice(const Vector<Uint1xN, sizes> &x, uint64_t *keys) {
+  using V = Vector<Uint1xN, sizes>;
+  static_assert(V::flatSize <= 64);
+  constexpr int blocks = (Uint1xN::elem_count + 63) / 64;
+  uint64_t words[V::flatSize][blocks];
+  for (int j = 0; j < V::flatSize; ++j) {
+    store(words[j], x.elems[j]);
+  }
+  for (int b = 0; b < blocks; ++b) {
+    uint64_t rows[64] = {0};
+    for (int j = 0; j < V::flatSize; ++j) {
+      rows[j] = words[j][b];
+    }
+    transpose_64x64(rows);
+    int lanes = Uint1xN::elem_count - 64 * b;
+    memcpy(keys + 64 * b, rows, sizeof(uint64_t) * (lanes < 64 ? lanes : 64));
+  }
+}
+
+// Inverse of unslice.
+template <Indices sizes>
+Vector<Uint1xN, sizes> slice(const uint64_t *keys) {
+  using V = Vector<Uint1xN, sizes>;
+  static_assert(V::flatSize <= 64);
+  constexpr int blocks = (Uint1xN::elem_count + 63) / 64;
+  uint64_t words[V::flatSize][blocks];
+  for (int b = 0; b < blocks; ++b) {
+    uint64_t rows[64] = {0};
+    int lanes = Uint1xN::elem_count - 64 * b;
+    memcpy(rows, keys + 64 * b, sizeof(uint64_t) * (lanes < 64 ? lanes : 64));
+    transpose_64x64(rows);
+    for (int j = 0; j < V::flatSize; ++j) {
+      words[j][b] = rows[j];
+    }
+  }
+  V result;
+  for (int j = 0; j < V::flatSize; ++j) {
+    result.elems[j] = Uint1xN::load(words[j]);
+  }
+  return result;
+}
+
+#endif // HAY_SLICING_H_
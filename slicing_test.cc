@@ -0,0 +1,55 @@
+// Copyright 2024 The Hay Authors
+//
+// Licensed under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#include "slicing.h"
+#include "testlib.h"
+
+struct TestTranspose64x64 {
+  static void Run() {
+    std::minstd_rand0 engine;
+    uint64_t rows[64];
+    uint64_t original[64];
+    for (int i = 0; i < 64; ++i) {
+      rows[i] = original[i] = (uint64_t{engine()} << 32) ^ engine();
+    }
+    transpose_64x64(rows);
+    for (int i = 0; i < 64; ++i) {
+      for (int j = 0; j < 64; ++j) {
+        CHECK_EQ((rows[i] >> j) & 1, (original[j] >> i) & 1);
+      }
+    }
+  }
+};
+
+struct TestUnsliceSlice {
+  template <Indices sizes> static void Run() {
+    using V = Vector<Uint1xN, sizes>;
+    std::minstd_rand0 engine;
+    V x = getRandom<V>(engine);
+    uint64_t keys[Uint1xN::elem_count];
+    unslice(x, keys);
+    for (int l = 0; l < Uint1xN::elem_count; ++l) {
+      auto e = extract(x, l);
+      uint64_t expected = 0;
+      for (int j = 0; j < V::flatSize; ++j) {
+        expected |= uint64_t{e.elems[j]} << j;
+      }
+      CHECK_EQ(keys[l], expected);
+    }
+    CHECK_EQ(slice<sizes>(keys), x);
+  }
+  static void Run() {
+    Run<{1}>();
+    Run<{3, 3}>();
+    Run<{2, 3, 5}>();
+    Run<{64}>();
+  }
+};
+
+int main() {
+  TEST(TestTranspose64x64);
+  TEST(TestUnsliceSlice);
+}
@@ -0,0 +1,236 @@
+// Copyright 2024 The Hay Authors
+//
+// Licensed under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#ifndef HAY_SYMMETRY_H_
+#define HAY_SYMMETRY_H_
+
+#include "simd.h"
+#include "sliced_int.h"
+#include "vector.h"
+
+#include <array>
+#include <bit>
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+// A permutation of the flat elements of a Vector of the given shape. Applying
+// it moves element j to position map[j].
+template <Indices sizes> struct FlatPermutation {
+  static constexpr int flatSize = product(sizes);
+  std::array<Index, flatSize> map;
+
+  static FlatPermutation identity() {
+    FlatPermutation result;
+    for (int j = 0; j < flatSize; ++j) {
+      result.map[j] = j;
+    }
+    return result;
+  }
+
+  friend bool operator==(const FlatPermutation &x, const FlatPermutation &y) {
+    return x.map == y.map;
+  }
+
+  // The permutation applying first x, then y.
+  friend FlatPermutation compose(const FlatPermutation &x,
+                                 const FlatPermutation &y) {
+    FlatPermutation result;
+    for (int j = 0; j < flatSize; ++j) {
+      result.map[j] = y.map[x.map[j]];
+    }
+    return result;
+  }
+
+  template <typename EType>
+  friend Vector<EType, sizes> apply(const FlatPermutation &p,
+                                    Vector<EType, sizes> x) {
+    Vector<EType, sizes> result;
+    for (int j = 0; j < flatSize; ++j) {
+      result.elems[p.map[j]] = x.elems[j];
+    }
+    return result;
+  }
+};
+
+// The action of transpose<permutation> on a Vector whose shape it preserves,
+// i.e. which only swaps axes of equal sizes.
+template <Indices sizes>
+FlatPermutation<sizes> axis_permutation(Indices<sizes.size()> permutation) {
+  using V = Vector<Uint1xN, sizes>;
+  assert(permute(sizes, permutation) == sizes);
+  FlatPermutation<sizes> result;
+  for (int j = 0; j < V::flatSize; ++j) {
+    result.map[j] =
+        V::flatten_indices(permute(V::unflatten_index(j), permutation));
+  }
+  return result;
+}
+
+// Relabels index `a` as `b` and vice versa along `axis`, i.e. swaps two rows
+// when axis == 0, two columns when axis == 1, etc.
+template <Indices sizes>
+FlatPermutation<sizes> index_swap(int axis, Index a, Index b) {
+  using V = Vector<Uint1xN, sizes>;
+  FlatPermutation<sizes> result;
+  for (int j = 0; j < V::flatSize; ++j) {
+    auto ind = V::unflatten_index(j);
+    if (ind[axis] == a) {
+      ind[axis] = b;
+    } else if (ind[axis] == b) {
+      ind[axis] = a;
+    }
+    result.map[j] = V::flatten_indices(ind);
+  }
+  return result;
+}
+
+// A finite group of FlatPermutations, stored as the full list of its
+// elements. The identity is always elements[0].
+template <Indices sizes> struct PermutationGroup {
+  using Permutation = FlatPermutation<sizes>;
+  std::vector<Permutation> elements;
+
+  int order() const { return elements.size(); }
+
+  static PermutationGroup
+  generated_by(const std::vector<Permutation> &generators) {
+    PermutationGroup group;
+    group.elements.push_back(Permutation::identity());
+    for (int i = 0; i < group.order(); ++i) {
+      for (const Permutation &g : generators) {
+        Permutation p = compose(group.elements[i], g);
+        bool found = false;
+        for (const Permutation &e : group.elements) {
+          if (e == p) {
+            found = true;
+            break;
+          }
+        }
+        if (!found) {
+          group.elements.push_back(p);
+        }
+      }
+    }
+    return group;
+  }
+
+  // The symmetric group relabeling the indices along `axis`.
+  static std::vector<Permutation> relabelings(int axis) {
+    std::vector<Permutation> generators;
+    for (Index i = 0; i + 1 < sizes[axis]; ++i) {
+      generators.push_back(index_swap<sizes>(axis, i, i + 1));
+    }
+    return generators;
+  }
+};
+
+// Bitsliced lexicographic comparison, elems[0] being most significant.
+// Returns the mask of lanes where x < y and sets `eq` to the mask of lanes
+// where x == y.
+template <Indices sizes>
+Uint1xN lex_less(Vector<Uint1xN, sizes> x, Vector<Uint1xN, sizes> y,
+                 Uint1xN &eq) {
+  Uint1xN lt = Uint1xN::cst(0);
+  eq = Uint1xN::cst(1);
+  for (int i = 0; i < x.flatSize; ++i) {
+    Uint1xN d = add(x.elems[i], y.elems[i]);
+    lt = madd(lt, eq, mul(d, y.elems[i]));
+    eq = mul(eq, bit_not(d));
+  }
+  return lt;
+}
+
+// Per-lane canonicality of a chunk of candidates under a group.
+struct CanonicalInfo {
+  // Wide enough to count up to the order of any group we can enumerate.
+  static constexpr int stabilizer_bits = 32;
+  // Lanes holding the lexicographic minimum of their orbit.
+  Uint1xN mask;
+  // Per-lane number of group elements fixing the candidate. The orbit size is
+  // the group order divided by this.
+  UintKxN<stabilizer_bits> stabilizer;
+};
+
+template <Indices sizes>
+CanonicalInfo canonical_info(const PermutationGroup<sizes> &group,
+                             Vector<Uint1xN, sizes> x) {
+  using Info = CanonicalInfo;
+  Info info{Uint1xN::cst(1), sliced_cst<Info::stabilizer_bits>(1)};
+  for (int g = 1; g < group.order(); ++g) {
+    Uint1xN eq;
+    Uint1xN lt = lex_less(apply(group.elements[g], x), x, eq);
+    info.mask = mul(info.mask, bit_not(lt));
+    info.stabilizer = sliced_increment(info.stabilizer, eq);
+  }
+  return info;
+}
+
+inline int64_t orbit_size(int group_order, const CanonicalInfo &info,
+                          int lane) {
+  return group_order / extract_uint(info.stabilizer, lane);
+}
+
+// Sum of the orbit sizes of the lanes selected by `mask`. Stabilizer orders
+// divide the group order, so we only need to count lanes per divisor.
+inline int64_t orbit_total(int group_order, const CanonicalInfo &info,
+                           Uint1xN mask) {
+  int64_t total = 0;
+  for (int d = 1; d <= group_order; ++d) {
+    if (group_order % d == 0) {
+      Uint1xN lanes = mul(mask, sliced_equal(info.stabilizer, d));
+      total += reduce_add(popcount(lanes)) * (group_order / d);
+    }
+  }
+  return total;
+}
+
+struct OrbitCounts {
+  // Canonical representatives visited, i.e. number of orbits.
+  int64_t representatives = 0;
+  // Candidates covered by those orbits, i.e. what a brute-force enumeration
+  // would have visited.
+  int64_t candidates = 0;
+};
+
+// Enumerates chunks [begin, end) of Vector<Uint1xN, sizes>, as in
+// Vector::seq, calling visit(chunk_index, x, info) on the chunks that
+// contain at least one canonical representative. Only lanes in info.mask are
+// meant to be evaluated. Disjoint ranges may be enumerated concurrently.
+template <Indices sizes, typename Visitor>
+OrbitCounts enumerate_canonical(const PermutationGroup<sizes> &group,
+                                int64_t begin, int64_t end, Visitor visit) {
+  using V = Vector<Uint1xN, sizes>;
+  constexpr int lane_bits = std::countr_zero(unsigned{Uint1xN::elem_count});
+  // When there are fewer candidates than lanes, Vector::seq repeats them, so
+  // only keep the lanes whose higher lane-index bits are zero.
+  Uint1xN valid = Uint1xN::cst(1);
+  for (int j = V::flatSize; j < lane_bits; ++j) {
+    valid = mul(valid, bit_not(Uint1xN::seq(j)));
+  }
+  OrbitCounts counts;
+  for (int64_t i = begin; i < end; ++i) {
+    V x = V::seq(i);
+    CanonicalInfo info = canonical_info(group, x);
+    info.mask = mul(info.mask, valid);
+    if (is_zero(info.mask)) {
+      continue;
+    }
+    counts.representatives += reduce_add(popcount(info.mask));
+    counts.candidates += orbit_total(group.order(), info, info.mask);
+    visit(i, x, info);
+  }
+  return counts;
+}
+
+// Enumerates all of Vector<Uint1xN, sizes>.
+template <Indices sizes, typename Visitor>
+OrbitCounts enumerate_canonical(const PermutationGroup<sizes> &group,
+                                Visitor visit) {
+  return enumerate_canonical(group, 0, seq_chunk_count<sizes>(), visit);
+}
+
+#endif // HAY_SYMMETRY_H_
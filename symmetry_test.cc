@@ -0,0 +1,122 @@
+// Copyright 2024 The Hay Authors
+//
+// Licensed under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#include "symmetry.h"
+#include "testlib.h"
+
+#include <algorithm>
+#include <array>
+
+template <Indices sizes>
+void checkAgainstScalar(const PermutationGroup<sizes> &group,
+                        int64_t expected_orbits) {
+  constexpr int flatSize = product(sizes);
+  OrbitCounts counts = enumerate_canonical(
+      group, [&](int64_t chunk, Vector<Uint1xN, sizes>,
+                 const CanonicalInfo &info) {
+        for (int l = 0; l < Uint1xN::elem_count; ++l) {
+          uint64_t value = chunk * Uint1xN::elem_count + l;
+          if (value >> flatSize) {
+            CHECK_EQ(extract(info.mask, l), 0);
+            continue;
+          }
+          // Scalar reference, comparing flat bits with elems[0] first.
+          std::array<uint8_t, flatSize> bits;
+          for (int j = 0; j < flatSize; ++j) {
+            bits[j] = (value >> j) & 1;
+          }
+          bool canonical = true;
+          int64_t stabilizer = 0;
+          for (const auto &g : group.elements) {
+            std::array<uint8_t, flatSize> image;
+            for (int j = 0; j < flatSize; ++j) {
+              image[g.map[j]] = bits[j];
+            }
+            canonical &= !(image < bits);
+            stabilizer += image == bits;
+          }
+          CHECK_EQ(extract(info.mask, l), uint8_t{canonical});
+          if (canonical) {
+            CHECK_EQ(orbit_size(group.order(), info, l),
+                     group.order() / stabilizer);
+          }
+        }
+      });
+  CHECK_EQ(counts.representatives, expected_orbits);
+  CHECK_EQ(counts.candidates, int64_t{1} << flatSize);
+}
+
+struct TestSymmetryTranspose {
+  static void Run() {
+    using G = PermutationGroup<{3, 3}>;
+    G group = G::generated_by({axis_permutation<{3, 3}>({1, 0})});
+    CHECK_EQ(group.order(), 2);
+    // Symmetric 3x3 matrices are fixed, the others come in pairs.
+    checkAgainstScalar(group, (512 + 64) / 2);
+  }
+};
+
+struct TestSymmetryRowsAndColumns {
+  static void Run() {
+    using G = PermutationGroup<{3, 3}>;
+    auto generators = G::relabelings(0);
+    for (const auto &g : G::relabelings(1)) {
+      generators.push_back(g);
+    }
+    G group = G::generated_by(generators);
+    CHECK_EQ(group.order(), 36);
+    // 3x3 binary matrices up to row and column permutations.
+    checkAgainstScalar(group, 36);
+  }
+};
+
+struct TestSymmetryAxes {
+  static void Run() {
+    using G = PermutationGroup<{2, 2, 2}>;
+    G group = G::generated_by({axis_permutation<{2, 2, 2}>({1, 0, 2}),
+                               axis_permutation<{2, 2, 2}>({1, 2, 0})});
+    CHECK_EQ(group.order(), 6);
+    // Fewer candidates than lanes: exercises the masking of repeated lanes.
+    // 2x2x2 binary tensors up to axis permutations.
+    checkAgainstScalar(group, 80);
+  }
+};
+
+struct TestSymmetryChunkRanges {
+  static void Run() {
+    using G = PermutationGroup<{4, 4}>;
+    G group = G::generated_by(G::relabelings(0));
+    constexpr int64_t chunks = seq_chunk_count<{4, 4}>();
+    CHECK_EQ(chunks * Uint1xN::elem_count, int64_t{1} << 16);
+    auto ignore = [](int64_t, Vector<Uint1xN, {4, 4}>, const CanonicalInfo &) {
+    };
+    OrbitCounts whole = enumerate_canonical(group, ignore);
+    // Splitting into ranges visits the same chunks.
+    OrbitCounts split;
+    int64_t next = 0;
+    for (int64_t begin = 0; begin < chunks; begin += 5) {
+      int64_t end = std::min(begin + 5, chunks);
+      OrbitCounts part = enumerate_canonical(
+          group, begin, end,
+          [&](int64_t chunk, Vector<Uint1xN, {4, 4}>, const CanonicalInfo &) {
+            CHECK(chunk >= next && chunk < end);
+            next = chunk + 1;
+          });
+      split.representatives += part.representatives;
+      split.candidates += part.candidates;
+    }
+    CHECK_EQ(split.representatives, whole.representatives);
+    CHECK_EQ(split.candidates, whole.candidates);
+    CHECK_EQ(whole.candidates, int64_t{1} << 16);
+  }
+};
+
+int main() {
+  TEST(TestSymmetryTranspose);
+  TEST(TestSymmetryRowsAndColumns);
+  TEST(TestSymmetryAxes);
+  TEST(TestSymmetryChunkRanges);
+}
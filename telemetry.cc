@@ -0,0 +1,186 @@
+// Copyright 2024 The Hay Authors
+//
+// Licensed under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#include "telemetry.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fmt/format.h>
+
+Telemetry::Telemetry(TelemetryOptions options)
+    : options(std::move(options)),
+      counters(new TelemetryCounters[max_threads]),
+      start(std::chrono::steady_clock::now()) {
+  if (static_cast<int>(this->options.stages.size()) >
+      TelemetryCounters::max_stages) {
+    fmt::print(stderr, "Telemetry: at most {} filter stages are supported\n",
+               TelemetryCounters::max_stages);
+    exit(EXIT_FAILURE);
+  }
+  reporter = std::thread([this] { run(); });
+}
+
+Telemetry::~Telemetry() {
+  {
+    std::lock_guard<std::mutex> lock(stop_mutex);
+    stopping = true;
+  }
+  stop_cond.notify_one();
+  reporter.join();
+  report();
+}
+
+TelemetryCounters &Telemetry::registerThread() {
+  int index = thread_count.fetch_add(1);
+  if (index >= max_threads) {
+    fmt::print(stderr, "Telemetry: more than {} threads registered\n",
+               max_threads);
+    exit(EXIT_FAILURE);
+  }
+  return counters[index];
+}
+
+TelemetrySnapshot Telemetry::snapshot() {
+  TelemetrySnapshot s;
+  s.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                            start)
+                  .count();
+  s.chunks = 0;
+  s.lanes = 0;
+  s.hits = 0;
+  s.survivors.assign(options.stages.size(), 0);
+  int threads = std::min(thread_count.load(), max_threads);
+  for (int t = 0; t < threads; ++t) {
+    const TelemetryCounters &c = counters[t];
+    int64_t lanes = c.lanes.load(std::memory_order_relaxed);
+    s.chunks += c.chunks.load(std::memory_order_relaxed);
+    s.lanes += lanes;
+    s.hits += c.hits.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < s.survivors.size(); ++i) {
+      s.survivors[i] += c.survivors[i].load(std::memory_order_relaxed);
+    }
+    s.thread_lanes.push_back(lanes);
+  }
+  {
+    std::lock_guard<std::mutex> lock(report_mutex);
+    double dt = s.seconds - last_seconds;
+    s.lanes_per_second = dt > 0 ? (s.lanes - last_lanes) / dt : 0;
+    last_seconds = s.seconds;
+    last_lanes = s.lanes;
+  }
+  s.eta_seconds = -1;
+  if (options.total_chunks > 0 && s.chunks > 0) {
+    int64_t remaining = std::max<int64_t>(options.total_chunks - s.chunks, 0);
+    s.eta_seconds = s.seconds * remaining / double(s.chunks);
+  }
+  s.imbalance = 1;
+  if (threads > 0 && s.lanes > 0) {
+    int64_t busiest = *std::max_element(s.thread_lanes.begin(),
+                                        s.thread_lanes.end());
+    s.imbalance = busiest * double(threads) / s.lanes;
+  }
+  return s;
+}
+
+void Telemetry::report() { write(snapshot()); }
+
+static std::string formatDuration(double seconds) {
+  if (seconds < 0) {
+    return "?";
+  }
+  int64_t s = seconds;
+  if (s >= 86400) {
+    return fmt::format("{}d{:02}h", s / 86400, s % 86400 / 3600);
+  }
+  if (s >= 3600) {
+    return fmt::format("{}h{:02}m", s / 3600, s % 3600 / 60);
+  }
+  return fmt::format("{}m{:02}s", s / 60, s % 60);
+}
+
+void Telemetry::write(const TelemetrySnapshot &s) {
+  if (options.path.empty()) {
+    std::string line = fmt::format("[telemetry] {} elapsed, {} chunks",
+                                   formatDuration(s.seconds), s.chunks);
+    if (options.total_chunks > 0) {
+      line +=
+          fmt::format(" ({:.2f}%)", 100.0 * s.chunks / options.total_chunks);
+    }
+    line += fmt::format(", {:.4g} candidates/s, ETA {}, imbalance {:.2f}, "
+                        "{} hits",
+                        s.lanes_per_second, formatDuration(s.eta_seconds),
+                        s.imbalance, s.hits);
+    for (size_t i = 0; i < s.survivors.size(); ++i) {
+      line += fmt::format(", {} {}", options.stages[i], s.survivors[i]);
+    }
+    fmt::print(stderr, "{}\n", line);
+    return;
+  }
+  std::string text;
+  auto metric = [&](const char *name, const char *type, const char *help) {
+    text += fmt::format("# HELP hay_{} {}\n# TYPE hay_{} {}\n", name, help,
+                        name, type);
+  };
+  metric("elapsed_seconds", "gauge", "Time since the search started.");
+  text += fmt::format("hay_elapsed_seconds {:.3f}\n", s.seconds);
+  metric("chunks_total", "counter", "Chunks processed.");
+  text += fmt::format("hay_chunks_total {}\n", s.chunks);
+  if (options.total_chunks > 0) {
+    metric("chunks_expected", "gauge", "Chunks in the whole search.");
+    text += fmt::format("hay_chunks_expected {}\n", options.total_chunks);
+  }
+  metric("lanes_total", "counter", "Candidates evaluated.");
+  text += fmt::format("hay_lanes_total {}\n", s.lanes);
+  metric("hits_total", "counter", "Candidates passing all filters.");
+  text += fmt::format("hay_hits_total {}\n", s.hits);
+  metric("survivors_total", "counter", "Candidates passing a filter stage.");
+  for (size_t i = 0; i < s.survivors.size(); ++i) {
+    text += fmt::format("hay_survivors_total{{stage=\"{}\"}} {}\n",
+                        options.stages[i], s.survivors[i]);
+  }
+  metric("candidates_per_second", "gauge",
+         "Candidates per second since the previous report.");
+  text += fmt::format("hay_candidates_per_second {:.6g}\n",
+                      s.lanes_per_second);
+  metric("eta_seconds", "gauge",
+         "Estimated time to completion, -1 if unknown.");
+  text += fmt::format("hay_eta_seconds {:.0f}\n", s.eta_seconds);
+  metric("thread_imbalance", "gauge",
+         "Busiest thread's candidates over the mean.");
+  text += fmt::format("hay_thread_imbalance {:.4f}\n", s.imbalance);
+  metric("thread_lanes_total", "counter", "Candidates evaluated per thread.");
+  for (size_t t = 0; t < s.thread_lanes.size(); ++t) {
+    text += fmt::format("hay_thread_lanes_total{{thread=\"{}\"}} {}\n", t,
+                        s.thread_lanes[t]);
+  }
+  // Write then rename, so that scrapers never see a partial file.
+  std::string tmp_path = options.path + ".tmp";
+  FILE *file = fopen(tmp_path.c_str(), "w");
+  if (!file) {
+    fmt::print(stderr, "Telemetry: could not open {}: {}\n", tmp_path,
+               strerror(errno));
+    return;
+  }
+  fwrite(text.data(), 1, text.size(), file);
+  fclose(file);
+  if (rename(tmp_path.c_str(), options.path.c_str()) != 0) {
+    fmt::print(stderr, "Telemetry: could not rename {} to {}: {}\n", tmp_path,
+               options.path, strerror(errno));
+  }
+}
+
+void Telemetry::run() {
+  std::unique_lock<std::mutex> lock(stop_mutex);
+  auto interval = std::chrono::duration<double>(options.interval_seconds);
+  while (!stop_cond.wait_for(lock, interval, [&] { return stopping; })) {
+    lock.unlock();
+    report();
+    lock.lock();
+  }
+}
@@ -0,0 +1,112 @@
+// Copyright 2024 The Hay Authors
+//
+// Licensed under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#ifndef HAY_TELEMETRY_H_
+#define HAY_TELEMETRY_H_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Progress counters of one search thread. Only that thread writes them, with
+// plain relaxed stores, and the reporter only loads them, so neither ever
+// waits. Each thread's counters sit on their own cache lines.
+class alignas(64) TelemetryCounters {
+public:
+  static constexpr int max_stages = 6;
+
+  void addChunks(int64_t n) { bump(chunks, n); }
+  void addLanes(int64_t n) { bump(lanes, n); }
+  void addHits(int64_t n) { bump(hits, n); }
+  // Candidates surviving filter stage `stage`, in Telemetry's stage order.
+  void addSurvivors(int stage, int64_t n) { bump(survivors[stage], n); }
+
+private:
+  friend class Telemetry;
+
+  static void bump(std::atomic<int64_t> &counter, int64_t n) {
+    counter.store(counter.load(std::memory_order_relaxed) + n,
+                  std::memory_order_relaxed);
+  }
+
+  std::atomic<int64_t> chunks{0};
+  std::atomic<int64_t> lanes{0};
+  std::atomic<int64_t> hits{0};
+  std::atomic<int64_t> survivors[max_stages] = {};
+};
+
+struct TelemetryOptions {
+  // Total chunks of the search, for the ETA, or 0 if unknown.
+  int64_t total_chunks = 0;
+  // Names of the filter stages counted by addSurvivors.
+  std::vector<std::string> stages;
+  double interval_seconds = 10;
+  // Where periodic reports go: a Prometheus text file, replaced atomically
+  // at each report as node_exporter's textfile collector expects, or stderr
+  // when empty.
+  std::string path;
+};
+
+struct TelemetrySnapshot {
+  double seconds;
+  int64_t chunks;
+  int64_t lanes;
+  int64_t hits;
+  std::vector<int64_t> survivors;
+  std::vector<int64_t> thread_lanes;
+  // Lanes per second since the previous snapshot.
+  double lanes_per_second;
+  // Seconds to go at the average rate so far, or -1 if unknown.
+  double eta_seconds;
+  // Busiest thread's lanes over the mean, 1 when balanced.
+  double imbalance;
+};
+
+// Aggregates the counters of the registered threads and reports them every
+// options.interval_seconds from a background thread, and once more on
+// destruction.
+class Telemetry {
+public:
+  explicit Telemetry(TelemetryOptions options);
+  ~Telemetry();
+  Telemetry(const Telemetry &) = delete;
+  Telemetry &operator=(const Telemetry &) = delete;
+
+  // Returns counters for the calling thread to update. Thread-safe; the
+  // counters live as long as the Telemetry.
+  TelemetryCounters &registerThread();
+
+  TelemetrySnapshot snapshot();
+  // Writes a report now.
+  void report();
+
+private:
+  void run();
+  void write(const TelemetrySnapshot &s);
+
+  static constexpr int max_threads = 1024;
+
+  TelemetryOptions options;
+  std::unique_ptr<TelemetryCounters[]> counters;
+  std::atomic<int> thread_count{0};
+  std::chrono::steady_clock::time_point start;
+  // Snapshot state, under report_mutex.
+  std::mutex report_mutex;
+  double last_seconds = 0;
+  int64_t last_lanes = 0;
+  std::mutex stop_mutex;
+  std::condition_variable stop_cond;
+  bool stopping = false;
+  std::thread reporter;
+};
+
+#endif // HAY_TELEMETRY_H_
@@ -0,0 +1,83 @@
+// Copyright 2024 The Hay Authors
+//
+// Licensed under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#include "telemetry.h"
+#include "testlib.h"
+
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct TestTelemetrySnapshot {
+  static void Run() {
+    TelemetryOptions options;
+    options.total_chunks = 1000;
+    options.stages = {"canonical", "cost"};
+    options.interval_seconds = 3600;
+    Telemetry telemetry(options);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+      threads.emplace_back([&, t] {
+        TelemetryCounters &counters = telemetry.registerThread();
+        // Thread t does t + 1 times the work of thread 0.
+        for (int i = 0; i < 50 * (t + 1); ++i) {
+          counters.addChunks(1);
+          counters.addLanes(64);
+          counters.addSurvivors(0, 10);
+          counters.addSurvivors(1, 1);
+        }
+        counters.addHits(t);
+      });
+    }
+    for (std::thread &thread : threads) {
+      thread.join();
+    }
+    TelemetrySnapshot s = telemetry.snapshot();
+    CHECK_EQ(s.chunks, 500);
+    CHECK_EQ(s.lanes, 500 * 64);
+    CHECK_EQ(s.hits, 6);
+    CHECK_EQ(s.survivors[0], 5000);
+    CHECK_EQ(s.survivors[1], 500);
+    CHECK_EQ(s.thread_lanes.size(), size_t{4});
+    // The busiest thread did 200 of the mean 125 chunks.
+    CHECK(s.imbalance > 1.59 && s.imbalance < 1.61);
+    CHECK(s.eta_seconds >= 0);
+  }
+};
+
+struct TestTelemetryPrometheusFile {
+  static void Run() {
+    const char *path = "telemetry_test.prom";
+    {
+      TelemetryOptions options;
+      options.stages = {"cost"};
+      options.path = path;
+      Telemetry telemetry(options);
+      TelemetryCounters &counters = telemetry.registerThread();
+      counters.addChunks(3);
+      counters.addLanes(3 * 512);
+      counters.addSurvivors(0, 7);
+    }
+    // The final report was written on destruction.
+    FILE *file = fopen(path, "r");
+    CHECK(file != nullptr);
+    std::string text(4096, '\0');
+    text.resize(fread(text.data(), 1, text.size(), file));
+    fclose(file);
+    remove(path);
+    CHECK(text.find("hay_chunks_total 3\n") != std::string::npos);
+    CHECK(text.find("hay_lanes_total 1536\n") != std::string::npos);
+    CHECK(text.find("hay_survivors_total{stage=\"cost\"} 7\n") !=
+          std::string::npos);
+    CHECK(text.find("hay_eta_seconds -1\n") != std::string::npos);
+  }
+};
+
+int main() {
+  TEST(TestTelemetrySnapshot);
+  TEST(TestTelemetryPrometheusFile);
+}
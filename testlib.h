@@ -16,6 +16,7 @@
 #include <fmt/format.h>
 #include <random>
 #include <string_view>
+#include <type_traits>
 
 void check_fail_impl(std::string_view condstr, const char *file, int line);
 
@@ -76,6 +77,29 @@ template <> struct GetRandomImpl<Int64xN> {
   }
 };
 
+template <typename E>
+  requires std::is_same_v<E, Int8xN> || std::is_same_v<E, Int16xN> ||
+           std::is_same_v<E, Int32xN>
+struct GetRandomImpl<E> {
+  static E Run(std::minstd_rand0 &engine) {
+    ScalarType<E> buf[E::elem_count];
+    for (auto &val : buf) {
+      val = static_cast<ScalarType<E>>(engine());
+    }
+    return E::load(buf);
+  }
+};
+
+template <> struct GetRandomImpl<Poly64xN> {
+  static Poly64xN Run(std::minstd_rand0 &engine) {
+    uint64_t buf[Poly64xN::elem_count];
+    for (uint64_t &val : buf) {
+      val = (uint64_t{engine()} << 33) ^ (uint64_t{engine()} << 16) ^ engine();
+    }
+    return Poly64xN::load(buf);
+  }
+};
+
 template <typename EType, Indices sizes>
 struct GetRandomImpl<Vector<EType, sizes>> {
   using V = Vector<EType, sizes>;
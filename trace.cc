@@ -0,0 +1,657 @@
+// Copyright 2024 The Hay Authors
+//
+// Licensed under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#include "trace.h"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <climits>
+#include <fmt/format.h>
+#include <set>
+#include <utility>
+
+int Trace::intern(TraceNode node) {
+  auto key = std::make_tuple(node.op, node.imm, node.args[0], node.args[1],
+                             node.args[2]);
+  auto [it, inserted] = index.try_emplace(key, static_cast<int>(graph.size()));
+  if (inserted) {
+    graph.push_back(node);
+  }
+  return it->second;
+}
+
+int Trace::input() { return intern({TraceOp::kInput, 0, {inputs++, -1, -1}}); }
+
+int Trace::constant(bool c) {
+  return intern({c ? TraceOp::kOne : TraceOp::kZero});
+}
+
+int Trace::seq(int i) { return intern({TraceOp::kSeq, 0, {i, -1, -1}}); }
+
+int Trace::bitXor(int a, int b) {
+  if (a == b) {
+    return constant(false);
+  }
+  if (graph[a].op == TraceOp::kZero) {
+    return b;
+  }
+  if (graph[b].op == TraceOp::kZero) {
+    return a;
+  }
+  return intern({TraceOp::kXor, 0, {std::min(a, b), std::max(a, b), -1}});
+}
+
+int Trace::bitAnd(int a, int b) {
+  if (a == b || graph[a].op == TraceOp::kZero || graph[b].op == TraceOp::kOne) {
+    return a;
+  }
+  if (graph[b].op == TraceOp::kZero || graph[a].op == TraceOp::kOne) {
+    return b;
+  }
+  return intern({TraceOp::kAnd, 0, {std::min(a, b), std::max(a, b), -1}});
+}
+
+int Trace::ternary(uint8_t imm, int a, int b, int c) {
+  return intern({TraceOp::kTernary, imm, {a, b, c}});
+}
+
+namespace {
+
+int argCount(TraceOp op) {
+  switch (op) {
+  case TraceOp::kXor:
+  case TraceOp::kAnd:
+    return 2;
+  case TraceOp::kTernary:
+    return 3;
+  default:
+    return 0;
+  }
+}
+
+// Nodes that the outputs depend on.
+std::vector<bool> liveNodes(const std::vector<TraceNode> &nodes,
+                            const std::vector<int> &outputs) {
+  std::vector<bool> live(nodes.size());
+  for (int o : outputs) {
+    live[o] = true;
+  }
+  for (int v = static_cast<int>(nodes.size()) - 1; v >= 0; --v) {
+    if (live[v]) {
+      for (int i = 0; i < argCount(nodes[v].op); ++i) {
+        live[nodes[v].args[i]] = true;
+      }
+    }
+  }
+  return live;
+}
+
+// Copies `node` into `out`, with its args mapped.
+int copyNode(const TraceNode &node, const std::vector<int> &map, Trace &out) {
+  const int *a = node.args;
+  switch (node.op) {
+  case TraceOp::kInput:
+    return out.input();
+  case TraceOp::kZero:
+    return out.constant(false);
+  case TraceOp::kOne:
+    return out.constant(true);
+  case TraceOp::kSeq:
+    return out.seq(a[0]);
+  case TraceOp::kXor:
+    return out.bitXor(map[a[0]], map[a[1]]);
+  case TraceOp::kAnd:
+    return out.bitAnd(map[a[0]], map[a[1]]);
+  case TraceOp::kTernary:
+    return out.ternary(node.imm, map[a[0]], map[a[1]], map[a[2]]);
+  }
+  return -1;
+}
+
+// Pair counts of Paar's algorithm, with the most frequent pair at hand.
+class PairCounts {
+public:
+  void adjust(int a, int b, int delta) {
+    auto key = std::minmax(a, b);
+    int &count = counts[key];
+    by_count.erase({count, key});
+    count += delta;
+    if (count > 0) {
+      by_count.insert({count, key});
+    }
+  }
+  // The most frequent pair, and its count, lowest pairs first on ties.
+  std::pair<int, std::pair<int, int>> top() const {
+    if (by_count.empty()) {
+      return {0, {-1, -1}};
+    }
+    auto last = std::prev(by_count.end());
+    auto first = by_count.lower_bound({last->first, {INT_MIN, INT_MIN}});
+    return *first;
+  }
+
+private:
+  std::map<std::pair<int, int>, int> counts;
+  std::set<std::pair<int, std::pair<int, int>>> by_count;
+};
+
+// Pairs counted up front at most, beyond which Paar's pairing is skipped.
+constexpr int64_t max_paar_pairs = int64_t{1} << 22;
+
+// Rewrites the xor sums that non-xor ops and outputs use, as sums over the
+// non-xor nodes, with Paar's greedy pairing. Returns false, leaving `out`
+// alone, if that does not take fewer xors than `nodes`.
+bool paarRewrite(const std::vector<TraceNode> &nodes,
+                 std::vector<int> &outputs, Trace &out) {
+  const int n = nodes.size();
+  std::vector<bool> live = liveNodes(nodes, outputs);
+  auto is_xor = [&](int v) { return nodes[v].op == TraceOp::kXor; };
+  std::vector<bool> required(n);
+  int recorded_xors = 0;
+  for (int o : outputs) {
+    required[o] = true;
+  }
+  for (int v = 0; v < n; ++v) {
+    if (!live[v]) {
+      continue;
+    }
+    recorded_xors += is_xor(v);
+    if (!is_xor(v)) {
+      for (int i = 0; i < argCount(nodes[v].op); ++i) {
+        required[nodes[v].args[i]] = true;
+      }
+    }
+  }
+  // The sums, as sorted sets of non-xor nodes.
+  std::vector<std::vector<int>> sums(n);
+  std::vector<int> form_of(n, -1);
+  std::vector<std::vector<int>> forms;
+  int64_t pair_total = 0;
+  for (int v = 0; v < n; ++v) {
+    if (!live[v] || !is_xor(v)) {
+      continue;
+    }
+    auto sum = [&](int a) { return is_xor(a) ? sums[a] : std::vector{a}; };
+    std::vector<int> x = sum(nodes[v].args[0]);
+    std::vector<int> y = sum(nodes[v].args[1]);
+    std::set_symmetric_difference(x.begin(), x.end(), y.begin(), y.end(),
+                                  std::back_inserter(sums[v]));
+    if (required[v]) {
+      form_of[v] = forms.size();
+      forms.push_back(sums[v]);
+      int64_t s = sums[v].size();
+      pair_total += s * (s - 1) / 2;
+    }
+  }
+  if (pair_total > max_paar_pairs) {
+    return false;
+  }
+  PairCounts counts;
+  std::map<int, std::set<int>> occurrences;
+  for (int f = 0; f < static_cast<int>(forms.size()); ++f) {
+    for (int i = 0; i < static_cast<int>(forms[f].size()); ++i) {
+      occurrences[forms[f][i]].insert(f);
+      for (int j = 0; j < i; ++j) {
+        counts.adjust(forms[f][j], forms[f][i], 1);
+      }
+    }
+  }
+  // Element n + k of a form is the sum of pairs[k].
+  std::vector<std::pair<int, int>> pairs;
+  for (;;) {
+    auto [count, pair] = counts.top();
+    if (count < 2) {
+      break;
+    }
+    auto [a, b] = pair;
+    int t = n + pairs.size();
+    pairs.push_back(pair);
+    std::set<int> with_a = occurrences[a];
+    for (int f : with_a) {
+      std::vector<int> &form = forms[f];
+      if (!std::binary_search(form.begin(), form.end(), b)) {
+        continue;
+      }
+      counts.adjust(a, b, -1);
+      for (int x : form) {
+        if (x != a && x != b) {
+          counts.adjust(a, x, -1);
+          counts.adjust(b, x, -1);
+          counts.adjust(t, x, 1);
+        }
+      }
+      form.erase(std::find(form.begin(), form.end(), a));
+      form.erase(std::find(form.begin(), form.end(), b));
+      form.push_back(t);
+      occurrences[a].erase(f);
+      occurrences[b].erase(f);
+      occurrences[t].insert(f);
+    }
+  }
+  // Then each form is a chain of xors.
+  int paar_xors = pairs.size();
+  for (const std::vector<int> &form : forms) {
+    paar_xors += std::max<int>(form.size() - 1, 0);
+  }
+  if (paar_xors >= recorded_xors) {
+    return false;
+  }
+
+  std::vector<int> map(n, -1);
+  std::vector<int> pair_map(pairs.size(), -1);
+  auto value = [&](int e) { return e < n ? map[e] : pair_map[e - n]; };
+  // The elements of a pair are in every form it is in, so were mapped by the
+  // time it is needed, but for earlier pairs.
+  auto element = [&](int e) {
+    std::vector<int> stack;
+    if (e >= n) {
+      stack.push_back(e - n);
+    }
+    while (!stack.empty()) {
+      int k = stack.back();
+      bool ready = true;
+      for (int x : {pairs[k].first, pairs[k].second}) {
+        if (x >= n && pair_map[x - n] < 0) {
+          stack.push_back(x - n);
+          ready = false;
+        }
+      }
+      if (ready) {
+        stack.pop_back();
+        pair_map[k] = out.bitXor(value(pairs[k].first), value(pairs[k].second));
+      }
+    }
+    return value(e);
+  };
+  for (int v = 0; v < n; ++v) {
+    if (nodes[v].op == TraceOp::kInput) {
+      // Dead or not, to keep the input numbering.
+      map[v] = out.input();
+    } else if (!live[v]) {
+      continue;
+    } else if (!is_xor(v)) {
+      map[v] = copyNode(nodes[v], map, out);
+    } else if (required[v]) {
+      int sum = out.constant(false);
+      for (int e : forms[form_of[v]]) {
+        sum = out.bitXor(sum, element(e));
+      }
+      map[v] = sum;
+    }
+  }
+  for (int &o : outputs) {
+    o = map[o];
+  }
+  return true;
+}
+
+// A single-output function of at most 3 nodes, as a vpternlogq truth table.
+struct Expr {
+  std::vector<int> leaves;
+  uint8_t table = 0;
+};
+
+// The value of e where its leaves have the values bit(leaf).
+template <typename F> bool evaluate(const Expr &e, F bit) {
+  int index = 0;
+  for (int i = 0; i < static_cast<int>(e.leaves.size()); ++i) {
+    index |= bit(e.leaves[i]) << (2 - i);
+  }
+  return (e.table >> index) & 1;
+}
+
+// Fuses single-use xors and ands into their users, as ternary ops of at most
+// 3 operands. Constants fold into the truth tables.
+void fuseTernary(const std::vector<TraceNode> &nodes, std::vector<int> &outputs,
+                 Trace &out) {
+  const int n = nodes.size();
+  std::vector<bool> live = liveNodes(nodes, outputs);
+  std::vector<int> uses(n);
+  for (int o : outputs) {
+    ++uses[o];
+  }
+  for (int v = 0; v < n; ++v) {
+    if (live[v]) {
+      for (int i = 0; i < argCount(nodes[v].op); ++i) {
+        ++uses[nodes[v].args[i]];
+      }
+    }
+  }
+  std::vector<Expr> exprs(n);
+  std::vector<bool> fused(n), absorbed(n);
+  auto fusible = [&](int v) {
+    return argCount(nodes[v].op) > 0 && uses[v] == 1;
+  };
+  for (int v = 0; v < n; ++v) {
+    if (!live[v] || argCount(nodes[v].op) == 0) {
+      continue;
+    }
+    const TraceNode &node = nodes[v];
+    int arg_count = argCount(node.op);
+    // What each arg contributes, inlined or as a leaf, with constants folded.
+    auto operand = [&](int a, bool inline_it) {
+      if (nodes[a].op == TraceOp::kZero || nodes[a].op == TraceOp::kOne) {
+        return Expr{{}, uint8_t(nodes[a].op == TraceOp::kOne ? 0xFF : 0)};
+      }
+      if (inline_it) {
+        return exprs[a];
+      }
+      return Expr{{a}, 0xF0};
+    };
+    // Inlines as many args as fit in 3 leaves, first ones first.
+    std::vector<Expr> operands;
+    std::vector<int> leaves;
+    bool any_inlined = false;
+    for (int i = 0; i < arg_count; ++i) {
+      operands.push_back(operand(node.args[i], false));
+    }
+    auto leaves_of = [&]() {
+      std::vector<int> l;
+      for (const Expr &e : operands) {
+        for (int leaf : e.leaves) {
+          if (std::find(l.begin(), l.end(), leaf) == l.end()) {
+            l.push_back(leaf);
+          }
+        }
+      }
+      return l;
+    };
+    for (int i = 0; i < arg_count; ++i) {
+      if (!fusible(node.args[i])) {
+        continue;
+      }
+      Expr kept = operands[i];
+      operands[i] = operand(node.args[i], true);
+      if (leaves_of().size() > 3) {
+        operands[i] = kept;
+      } else {
+        any_inlined = true;
+        absorbed[node.args[i]] = true;
+      }
+    }
+    leaves = leaves_of();
+    Expr e{leaves, 0};
+    for (int m = 0; m < 8; ++m) {
+      auto bit = [&](int leaf) {
+        int pos =
+            std::find(leaves.begin(), leaves.end(), leaf) - leaves.begin();
+        return (m >> (2 - pos)) & 1;
+      };
+      bool r;
+      bool x = evaluate(operands[0], bit);
+      bool y = evaluate(operands[1], bit);
+      switch (node.op) {
+      case TraceOp::kXor:
+        r = x ^ y;
+        break;
+      case TraceOp::kAnd:
+        r = x & y;
+        break;
+      default: {
+        bool z = evaluate(operands[2], bit);
+        r = (node.imm >> (4 * x + 2 * y + z)) & 1;
+      }
+      }
+      e.table |= r << m;
+    }
+    exprs[v] = e;
+    fused[v] = any_inlined;
+  }
+  std::vector<int> map(n, -1);
+  for (int v = 0; v < n; ++v) {
+    if (nodes[v].op == TraceOp::kInput) {
+      map[v] = out.input();
+    } else if (!live[v] || absorbed[v]) {
+      continue;
+    } else if (!fused[v]) {
+      map[v] = copyNode(nodes[v], map, out);
+    } else {
+      const Expr &e = exprs[v];
+      if (e.leaves.empty()) {
+        map[v] = out.constant(e.table & 1);
+        continue;
+      }
+      // Unused positions repeat the first leaf, which the table ignores.
+      int a[3];
+      for (int i = 0; i < 3; ++i) {
+        a[i] = map[e.leaves[i < static_cast<int>(e.leaves.size()) ? i : 0]];
+      }
+      map[v] = out.ternary(e.table, a[0], a[1], a[2]);
+    }
+  }
+  for (int &o : outputs) {
+    o = map[o];
+  }
+}
+
+// Orders the live ops depth-first from the outputs, visiting first the args
+// that need the most slots, and assigns slots to their values by liveness.
+TraceProgram schedule(const std::vector<TraceNode> &nodes,
+                      const std::vector<int> &outputs, int input_count) {
+  const int n = nodes.size();
+  std::vector<bool> live = liveNodes(nodes, outputs);
+  // Slots needed to evaluate each node, as with Sethi-Ullman numbering.
+  std::vector<int> need(n, 1);
+  auto sorted_args = [&](int v) {
+    std::vector<int> args(nodes[v].args, nodes[v].args + argCount(nodes[v].op));
+    std::sort(args.begin(), args.end());
+    args.erase(std::unique(args.begin(), args.end()), args.end());
+    std::stable_sort(args.begin(), args.end(),
+                     [&](int a, int b) { return need[a] > need[b]; });
+    return args;
+  };
+  for (int v = 0; v < n; ++v) {
+    std::vector<int> args = sorted_args(v);
+    for (int i = 0; i < static_cast<int>(args.size()); ++i) {
+      need[v] = std::max(need[v], need[args[i]] + i);
+    }
+  }
+  std::vector<int> order;
+  std::vector<bool> visited(n);
+  for (int o : outputs) {
+    std::vector<std::pair<int, bool>> stack = {{o, false}};
+    while (!stack.empty()) {
+      auto [v, expanded] = stack.back();
+      stack.pop_back();
+      if (visited[v]) {
+        continue;
+      }
+      if (expanded) {
+        visited[v] = true;
+        if (nodes[v].op != TraceOp::kInput) {
+          order.push_back(v);
+        }
+        continue;
+      }
+      stack.push_back({v, true});
+      std::vector<int> args = sorted_args(v);
+      for (auto it = args.rbegin(); it != args.rend(); ++it) {
+        stack.push_back({*it, false});
+      }
+    }
+  }
+  std::vector<int> last_use(n, -1);
+  for (int i = 0; i < static_cast<int>(order.size()); ++i) {
+    for (int a : sorted_args(order[i])) {
+      last_use[a] = i;
+    }
+  }
+  for (int o : outputs) {
+    last_use[o] = INT_MAX;
+  }
+
+  TraceProgram program;
+  program.input_count = input_count;
+  program.slot_count = input_count;
+  std::vector<int> slot(n, -1);
+  std::vector<int> free_slots;
+  for (int v = n - 1; v >= 0; --v) {
+    if (nodes[v].op == TraceOp::kInput) {
+      slot[v] = nodes[v].args[0];
+      if (last_use[v] < 0) {
+        free_slots.push_back(slot[v]);
+      }
+    }
+  }
+  for (int i = 0; i < static_cast<int>(order.size()); ++i) {
+    int v = order[i];
+    TraceInstr instr{nodes[v].op, nodes[v].imm, -1};
+    for (int j = 0; j < argCount(nodes[v].op); ++j) {
+      instr.args[j] = slot[nodes[v].args[j]];
+    }
+    if (nodes[v].op == TraceOp::kSeq) {
+      instr.args[0] = nodes[v].args[0];
+    }
+    // Args read for the last time free their slots, which the result may
+    // then reuse.
+    for (int a : sorted_args(v)) {
+      if (last_use[a] == i) {
+        free_slots.push_back(slot[a]);
+      }
+    }
+    if (free_slots.empty()) {
+      slot[v] = program.slot_count++;
+    } else {
+      slot[v] = free_slots.back();
+      free_slots.pop_back();
+    }
+    instr.dst = slot[v];
+    program.instrs.push_back(instr);
+    program.stats.xors += instr.op == TraceOp::kXor;
+    program.stats.ands += instr.op == TraceOp::kAnd;
+    program.stats.ternaries += instr.op == TraceOp::kTernary;
+  }
+  for (int o : outputs) {
+    program.outputs.push_back(slot[o]);
+  }
+  program.stats.instructions = program.instrs.size();
+  program.stats.slots = program.slot_count;
+  return program;
+}
+
+using TernaryFn = Uint1xN (*)(Uint1xN, Uint1xN, Uint1xN);
+
+// ternary<imm> by imm.
+constexpr auto ternary_fns =
+    []<int... imm>(std::integer_sequence<int, imm...>) {
+      return std::array<TernaryFn, 256>{&ternary<imm>...};
+    }(std::make_integer_sequence<int, 256>());
+
+} // namespace
+
+TraceProgram compileTrace(const Trace &trace, const std::vector<int> &outputs,
+                          const TraceOptions &options) {
+  std::vector<TraceNode> nodes = trace.nodes();
+  std::vector<int> outs = outputs;
+  TraceStats recorded;
+  std::vector<bool> live = liveNodes(nodes, outs);
+  for (int v = 0; v < static_cast<int>(nodes.size()); ++v) {
+    if (live[v] && argCount(nodes[v].op) > 0) {
+      ++recorded.recorded_ops;
+      recorded.recorded_xors += nodes[v].op == TraceOp::kXor;
+    }
+  }
+  if (options.paar) {
+    Trace rewritten;
+    if (paarRewrite(nodes, outs, rewritten)) {
+      nodes = rewritten.nodes();
+    }
+  }
+  if (options.fuse_ternary) {
+    Trace fused;
+    fuseTernary(nodes, outs, fused);
+    nodes = fused.nodes();
+  }
+  TraceProgram program = schedule(nodes, outs, trace.inputCount());
+  program.stats.recorded_ops = recorded.recorded_ops;
+  program.stats.recorded_xors = recorded.recorded_xors;
+  return program;
+}
+
+void TraceProgram::run(const Uint1xN *in, Uint1xN *out) const {
+  thread_local std::vector<Uint1xN> slots;
+  slots.resize(slot_count);
+  std::copy(in, in + input_count, slots.begin());
+  for (const TraceInstr &instr : instrs) {
+    const int *a = instr.args;
+    Uint1xN r;
+    switch (instr.op) {
+    case TraceOp::kZero:
+      r = Uint1xN::cst(0);
+      break;
+    case TraceOp::kOne:
+      r = Uint1xN::cst(1);
+      break;
+    case TraceOp::kSeq:
+      r = Uint1xN::seq(a[0]);
+      break;
+    case TraceOp::kXor:
+      r = add(slots[a[0]], slots[a[1]]);
+      break;
+    case TraceOp::kAnd:
+      r = mul(slots[a[0]], slots[a[1]]);
+      break;
+    case TraceOp::kTernary:
+      r = ternary_fns[instr.imm](slots[a[0]], slots[a[1]], slots[a[2]]);
+      break;
+    case TraceOp::kInput:
+      assert(false);
+      r = Uint1xN::cst(0);
+    }
+    slots[instr.dst] = r;
+  }
+  for (int i = 0; i < static_cast<int>(outputs.size()); ++i) {
+    out[i] = slots[outputs[i]];
+  }
+}
+
+std::string TraceProgram::emitCpp(std::string_view name) const {
+  std::string s = fmt::format(
+      "// Generated by compileTrace: {} instructions over {} slots.\n"
+      "inline void {}(const Uint1xN *in, Uint1xN *out) {{\n",
+      instrs.size(), slot_count, name);
+  for (int i = 0; i < slot_count; ++i) {
+    if (i < input_count) {
+      s += fmt::format("  Uint1xN s{} = in[{}];\n", i, i);
+    } else {
+      s += fmt::format("  Uint1xN s{};\n", i);
+    }
+  }
+  for (const TraceInstr &instr : instrs) {
+    const int *a = instr.args;
+    std::string value;
+    switch (instr.op) {
+    case TraceOp::kZero:
+      value = "Uint1xN::cst(0)";
+      break;
+    case TraceOp::kOne:
+      value = "Uint1xN::cst(1)";
+      break;
+    case TraceOp::kSeq:
+      value = fmt::format("Uint1xN::seq({})", a[0]);
+      break;
+    case TraceOp::kXor:
+      value = fmt::format("add(s{}, s{})", a[0], a[1]);
+      break;
+    case TraceOp::kAnd:
+      value = fmt::format("mul(s{}, s{})", a[0], a[1]);
+      break;
+    case TraceOp::kTernary:
+      value = fmt::format("ternary<0x{:02x}>(s{}, s{}, s{})", instr.imm, a[0],
+                          a[1], a[2]);
+      break;
+    case TraceOp::kInput:
+      break;
+    }
+    s += fmt::format("  s{} = {};\n", instr.dst, value);
+  }
+  for (int i = 0; i < static_cast<int>(outputs.size()); ++i) {
+    s += fmt::format("  out[{}] = s{};\n", i, outputs[i]);
+  }
+  s += "}\n";
+  return s;
+}
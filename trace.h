@@ -0,0 +1,182 @@
+// Copyright 2024 The Hay Authors
+//
+// Licensed under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#ifndef HAY_TRACE_H_
+#define HAY_TRACE_H_
+
+#include "simd.h"
+#include "vector.h"
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+// Tracing of Uint1xN kernels into optimized straight-line programs. Running
+// a kernel once on Vectors of Traced, in place of Uint1xN, records the graph
+// of its add, mul and madd ops, merging common subexpressions and folding
+// trivial ops (x + x, x * 0, ...) as they are recorded. compileTrace then:
+//
+//   1. rewrites the xor sums of the graph with Paar's greedy pairing, which
+//      computes the pairs shared by the most sums first, if that takes fewer
+//      xors than the recorded ones;
+//   2. fuses single-use ops into 3-input ternary ops, i.e. vpternlogq, on
+//      backends that have one;
+//   3. orders the ops depth-first from the outputs, operands needing the most
+//      values first, and assigns them to as few value slots as their live
+//      ranges allow.
+//
+// The program runs on Uint1xN as interpreted bytecode, or can be emitted as
+// C++ source to compile in:
+//
+//   auto square = traceKernel<{8, 8}>([](auto x) { return matmul(x, x); });
+//   Vector<Uint1xN, {8, 8}> y = square(x);
+//   fmt::print("{}", square.program.emitCpp("square8x8"));
+
+enum class TraceOp : uint8_t {
+  kInput,   // Input args[0].
+  kZero,    // Uint1xN::cst(0).
+  kOne,     // Uint1xN::cst(1).
+  kSeq,     // Uint1xN::seq(args[0]).
+  kXor,     // add(args[0], args[1]).
+  kAnd,     // mul(args[0], args[1]).
+  kTernary, // ternary<imm>(args[0], args[1], args[2]).
+};
+
+struct TraceNode {
+  TraceOp op;
+  uint8_t imm = 0;
+  int args[3] = {-1, -1, -1};
+};
+
+// The recorded graph. Nodes only refer to earlier nodes.
+class Trace {
+public:
+  int input();
+  int constant(bool c);
+  int seq(int i);
+  int bitXor(int a, int b);
+  int bitAnd(int a, int b);
+  int ternary(uint8_t imm, int a, int b, int c);
+
+  const std::vector<TraceNode> &nodes() const { return graph; }
+  int inputCount() const { return inputs; }
+
+private:
+  // The existing node equal to `node`, or else a new one.
+  int intern(TraceNode node);
+
+  std::vector<TraceNode> graph;
+  std::map<std::tuple<TraceOp, uint8_t, int, int, int>, int> index;
+  int inputs = 0;
+};
+
+// The trace that Traced ops are recorded into, on this thread.
+inline thread_local Trace *active_trace = nullptr;
+
+// A Uint1xN-like element type whose ops record into active_trace.
+struct Traced {
+  static constexpr int elem_bits = 1;
+  static constexpr int elem_count = Uint1xN::elem_count;
+  int id;
+
+  static Traced cst(uint8_t c) { return {active_trace->constant(c)}; }
+  static Traced seq(int i) { return {active_trace->seq(i)}; }
+  friend Traced add(Traced x, Traced y) {
+    return {active_trace->bitXor(x.id, y.id)};
+  }
+  friend Traced mul(Traced x, Traced y) {
+    return {active_trace->bitAnd(x.id, y.id)};
+  }
+  friend Traced madd(Traced x, Traced y, Traced z) {
+    return add(x, mul(y, z));
+  }
+};
+
+template <> struct ScalarTypeImpl<Traced> {
+  using Type = uint8_t;
+};
+
+struct TraceOptions {
+  bool paar = true;
+  bool fuse_ternary = uint1_native_ternary;
+};
+
+struct TraceStats {
+  // Ops of the recorded graph that the outputs depend on.
+  int recorded_ops = 0;
+  int recorded_xors = 0;
+  // Ops of the program.
+  int xors = 0;
+  int ands = 0;
+  int ternaries = 0;
+  int instructions = 0;
+  int slots = 0;
+};
+
+struct TraceInstr {
+  TraceOp op;
+  uint8_t imm = 0;
+  int dst;
+  int args[3] = {-1, -1, -1};
+};
+
+// Straight-line code over an array of Uint1xN slots, inputs first.
+struct TraceProgram {
+  int input_count = 0;
+  int slot_count = 0;
+  std::vector<TraceInstr> instrs;
+  // The slot of each output.
+  std::vector<int> outputs;
+  TraceStats stats;
+
+  // Interprets the program.
+  void run(const Uint1xN *in, Uint1xN *out) const;
+  // A C++ function `void name(const Uint1xN *in, Uint1xN *out)` running the
+  // program, for the backend of this build.
+  std::string emitCpp(std::string_view name) const;
+};
+
+TraceProgram compileTrace(const Trace &trace, const std::vector<int> &outputs,
+                          const TraceOptions &options = {});
+
+template <Indices in_sizes, Indices out_sizes> struct TracedKernel {
+  TraceProgram program;
+
+  Vector<Uint1xN, out_sizes>
+  operator()(const Vector<Uint1xN, in_sizes> &x) const {
+    Vector<Uint1xN, out_sizes> y;
+    program.run(x.elems, y.elems);
+    return y;
+  }
+};
+
+// Records f(Vector<Traced, in_sizes>), which returns a Vector<Traced, ...>,
+// and compiles it.
+template <Indices in_sizes, typename F>
+auto traceKernel(F f, const TraceOptions &options = {}) {
+  Trace trace;
+  Trace *saved = active_trace;
+  active_trace = &trace;
+  Vector<Traced, in_sizes> x;
+  for (Traced &e : x.elems) {
+    e = {trace.input()};
+  }
+  auto y = f(x);
+  active_trace = saved;
+  std::vector<int> outputs;
+  for (Traced e : y.elems) {
+    outputs.push_back(e.id);
+  }
+  return [&]<Indices out_sizes>(const Vector<Traced, out_sizes> &) {
+    return TracedKernel<in_sizes, out_sizes>{
+        compileTrace(trace, outputs, options)};
+  }(y);
+}
+
+#endif // HAY_TRACE_H_
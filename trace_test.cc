@@ -0,0 +1,188 @@
+// Copyright 2024 The Hay Authors
+//
+// Licensed under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#include "testlib.h"
+#include "trace.h"
+
+#include <random>
+#include <string>
+
+// Sums sharing the pair a + b, and a product of sums.
+auto sharedSums(const Vector<Traced, {4}> &x) {
+  Vector<Traced, {4}> y;
+  y.elems[0] = add(add(x.elems[0], x.elems[1]), x.elems[2]);
+  y.elems[1] = add(add(x.elems[0], x.elems[3]), x.elems[1]);
+  y.elems[2] = add(add(x.elems[2], x.elems[1]), add(x.elems[3], x.elems[0]));
+  y.elems[3] = mul(add(x.elems[0], x.elems[2]), x.elems[3]);
+  return y;
+}
+
+Vector<Uint1xN, {4}> sharedSumsReference(const Vector<Uint1xN, {4}> &x) {
+  Vector<Uint1xN, {4}> y;
+  y.elems[0] = add(add(x.elems[0], x.elems[1]), x.elems[2]);
+  y.elems[1] = add(add(x.elems[0], x.elems[3]), x.elems[1]);
+  y.elems[2] = add(add(x.elems[2], x.elems[1]), add(x.elems[3], x.elems[0]));
+  y.elems[3] = mul(add(x.elems[0], x.elems[2]), x.elems[3]);
+  return y;
+}
+
+struct TestTraceRecording {
+  static void Run() {
+    Trace trace;
+    active_trace = &trace;
+    Traced a{trace.input()}, b{trace.input()};
+    // Common subexpressions and trivial ops are folded.
+    CHECK_EQ(add(a, b).id, add(b, a).id);
+    CHECK_EQ(add(a, a).id, Traced::cst(0).id);
+    CHECK_EQ(add(a, Traced::cst(0)).id, a.id);
+    CHECK_EQ(mul(a, Traced::cst(1)).id, a.id);
+    CHECK_EQ(mul(b, Traced::cst(0)).id, Traced::cst(0).id);
+    CHECK_EQ(madd(a, a, b).id, add(a, mul(b, a)).id);
+    active_trace = nullptr;
+    CHECK_EQ(trace.inputCount(), 2);
+    // 2 inputs, 0, 1, a + b, a * b and a + a * b.
+    CHECK_EQ(trace.nodes().size(), size_t{7});
+  }
+};
+
+struct TestTraceMatmul {
+  static void Run() {
+    std::minstd_rand0 engine;
+    for (TraceOptions options :
+         {TraceOptions{false, false}, TraceOptions{true, false},
+          TraceOptions{false, true}, TraceOptions{true, true}}) {
+      auto square =
+          traceKernel<{6, 6}>([](auto x) { return matmul(x, x); }, options);
+      for (int i = 0; i < 4; ++i) {
+        auto x = getRandom<Vector<Uint1xN, {6, 6}>>(engine);
+        CHECK_EQ(square(x), matmul(x, x));
+      }
+      // Output sizes other than the input ones, and constants.
+      auto row_sums = traceKernel<{4, 5}>(
+          [](auto x) { return matmul(x, Vector<Traced, {5, 2}>::cst(1)); },
+          options);
+      auto y = getRandom<Vector<Uint1xN, {4, 5}>>(engine);
+      CHECK_EQ(row_sums(y), matmul(y, Vector<Uint1xN, {5, 2}>::cst(1)));
+    }
+  }
+};
+
+struct TestTracePaar {
+  static void Run() {
+    std::minstd_rand0 engine;
+    TraceOptions options{true, false};
+    auto kernel = traceKernel<{4}>(sharedSums, options);
+    // Recorded: 2 + 2 + 2 + 1 xors, as y2 reuses the x3 + x0 of y1. With
+    // the pairs x0 + x1 and x0 + x1 + x2: 2 + 0 + 1 + 1 + 1.
+    CHECK_EQ(kernel.program.stats.recorded_xors, 7);
+    CHECK_EQ(kernel.program.stats.xors, 5);
+    CHECK_EQ(kernel.program.stats.ands, 1);
+    auto plain = traceKernel<{4}>(sharedSums, TraceOptions{false, false});
+    CHECK_EQ(plain.program.stats.xors, 7);
+    for (int i = 0; i < 16; ++i) {
+      auto x = getRandom<Vector<Uint1xN, {4}>>(engine);
+      CHECK_EQ(kernel(x), sharedSumsReference(x));
+      CHECK_EQ(plain(x), sharedSumsReference(x));
+    }
+  }
+};
+
+struct TestTraceTernary {
+  static void Run() {
+    std::minstd_rand0 engine;
+    for (int i = 0; i < 8; ++i) {
+      Uint1xN x = getRandom<Uint1xN>(engine);
+      Uint1xN y = getRandom<Uint1xN>(engine);
+      Uint1xN z = getRandom<Uint1xN>(engine);
+      CHECK_EQ(ternary<0x96>(x, y, z), add(add(x, y), z));
+      CHECK_EQ(ternary<0xF0>(x, y, z), x);
+      CHECK_EQ(ternary<0xCC>(x, y, z), y);
+      CHECK_EQ(ternary<0xAA>(x, y, z), z);
+      CHECK_EQ(ternary<0x78>(x, y, z), add(x, mul(y, z)));
+      CHECK_EQ(ternary<0x00>(x, y, z), Uint1xN::cst(0));
+    }
+    auto kernel = traceKernel<{4}>(sharedSums, TraceOptions{false, true});
+    const TraceStats &stats = kernel.program.stats;
+    // y0, y2 and y3 each fuse into one op. y1 and the x3 + x0 that it shares
+    // with y2 stay xors.
+    CHECK_EQ(stats.ternaries, 3);
+    CHECK_EQ(stats.instructions, 5);
+    for (int i = 0; i < 16; ++i) {
+      auto x = getRandom<Vector<Uint1xN, {4}>>(engine);
+      CHECK_EQ(kernel(x), sharedSumsReference(x));
+    }
+  }
+};
+
+struct TestTraceConstants {
+  static void Run() {
+    std::minstd_rand0 engine;
+    for (bool fuse : {false, true}) {
+      auto kernel = traceKernel<{2}>(
+          [](auto x) {
+            using E = Traced;
+            Vector<E, {4}> y;
+            y.elems[0] = E::cst(0);
+            y.elems[1] = add(x.elems[0], E::cst(1));
+            y.elems[2] = mul(x.elems[1], E::seq(3));
+            y.elems[3] = x.elems[0];
+            return y;
+          },
+          TraceOptions{true, fuse});
+      for (int i = 0; i < 4; ++i) {
+        auto x = getRandom<Vector<Uint1xN, {2}>>(engine);
+        Vector<Uint1xN, {4}> expected;
+        expected.elems[0] = Uint1xN::cst(0);
+        expected.elems[1] = add(x.elems[0], Uint1xN::cst(1));
+        expected.elems[2] = mul(x.elems[1], Uint1xN::seq(3));
+        expected.elems[3] = x.elems[0];
+        CHECK_EQ(kernel(x), expected);
+      }
+    }
+  }
+};
+
+// Slots are reused once their values are dead.
+struct TestTraceSlots {
+  static void Run() {
+    auto kernel = traceKernel<{8}>([](auto x) {
+      Traced sum = x.elems[0];
+      for (int i = 1; i < 8; ++i) {
+        sum = add(sum, mul(x.elems[i], x.elems[i - 1]));
+      }
+      return Vector<Traced, {1}>{{sum}};
+    }, TraceOptions{false, false});
+    CHECK_EQ(kernel.program.stats.instructions, 14);
+    CHECK_EQ(kernel.program.stats.slots, 9);
+  }
+};
+
+struct TestTraceEmitCpp {
+  static void Run() {
+    auto kernel = traceKernel<{2}>(
+        [](auto x) {
+          return Vector<Traced, {2}>{
+              {add(x.elems[0], x.elems[1]), mul(x.elems[0], x.elems[1])}};
+        },
+        TraceOptions{false, false});
+    std::string code = kernel.program.emitCpp("kernel");
+    CHECK_NE(code.find("inline void kernel(const Uint1xN *in, Uint1xN *out)"),
+             std::string::npos);
+    CHECK_NE(code.find("add(s0, s1)"), std::string::npos);
+    CHECK_NE(code.find("mul(s0, s1)"), std::string::npos);
+    CHECK_NE(code.find("out[1] = "), std::string::npos);
+  }
+};
+
+int main() {
+  TEST(TestTraceRecording);
+  TEST(TestTraceMatmul);
+  TEST(TestTracePaar);
+  TEST(TestTraceTernary);
+  TEST(TestTraceConstants);
+  TEST(TestTraceSlots);
+  TEST(TestTraceEmitCpp);
+}
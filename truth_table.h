@@ -0,0 +1,271 @@
+// Copyright 2024 The Hay Authors
+//
+// Licensed under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#ifndef HAY_TRUTH_TABLE_H_
+#define HAY_TRUTH_TABLE_H_
+
+#include "simd.h"
+#include "sliced_int.h"
+#include "vector.h"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Möbius (algebraic normal form) and Walsh-Hadamard transforms of Boolean
+// functions given by their truth tables, in two layouts:
+//
+// - Packed: one function, whose value at input i is lane i % elem_count of
+//   table[i / elem_count]. Uint1xN::seq(j) is the packed table of input
+//   variable j. Tables have a power-of-two number of Uint1xN, e.g. 2^20 bits.
+// - Batched: one function per lane, whose value at input i is elems[i] of a
+//   Vector<Uint1xN, {size}>.
+//
+// The Möbius transform is its own inverse and maps a truth table to the
+// coefficients of the algebraic normal form, that of monomial prod_{j in i}
+// x_j at index i. The Walsh spectrum of f is W(a) = sum_x (-1)^(f(x) + a.x),
+// and the nonlinearity of f is (size - max_a |W(a)|) / 2.
+
+namespace truth_table_internal {
+
+// Input variables that index the lanes of a Uint1xN.
+constexpr int lane_vars = std::countr_zero(unsigned{Uint1xN::elem_count});
+
+// Calls op(i, i + h) for each i with bit h clear, for each power of two h
+// below count, in an order such that all the strides up to a block of 64KiB
+// run in cache before the larger strides pass over the whole table.
+template <typename Op>
+void butterflies(int64_t count, int64_t elem_bytes, Op op) {
+  int64_t block =
+      std::clamp<int64_t>(std::bit_floor(uint64_t((1 << 16) / elem_bytes)), 1,
+                          count);
+  for (int64_t b = 0; b < count; b += block) {
+    for (int64_t h = 1; h < block; h *= 2) {
+      for (int64_t i = b; i < b + block; i += 2 * h) {
+        for (int64_t k = i; k < i + h; ++k) {
+          op(k, k + h);
+        }
+      }
+    }
+  }
+  for (int64_t h = block; h < count; h *= 2) {
+    for (int64_t i = 0; i < count; i += 2 * h) {
+      for (int64_t k = i; k < i + h; ++k) {
+        op(k, k + h);
+      }
+    }
+  }
+}
+
+// The Walsh spectra of all the packed tables of Int64xN::elem_count bits,
+// by table.
+inline const std::vector<Int64xN> &chunkSpectra() {
+  static const std::vector<Int64xN> spectra = [] {
+    constexpr int n = Int64xN::elem_count;
+    std::vector<Int64xN> s(1 << n);
+    for (int f = 0; f < (1 << n); ++f) {
+      int64_t w[n] = {};
+      for (int a = 0; a < n; ++a) {
+        for (int x = 0; x < n; ++x) {
+          w[a] += ((f >> x) ^ std::popcount(unsigned(a & x))) & 1 ? -1 : 1;
+        }
+      }
+      s[f] = Int64xN::load(w);
+    }
+    return s;
+  }();
+  return spectra;
+}
+
+} // namespace truth_table_internal
+
+// The Möbius transform of the packed table x.
+inline Uint1xN moebius_packed(Uint1xN x) {
+  [&]<int... j>(std::integer_sequence<int, j...>) {
+    ((x = madd(x, lane_xor_permute<j>(x), Uint1xN::seq(j))), ...);
+  }(std::make_integer_sequence<int, truth_table_internal::lane_vars>());
+  return x;
+}
+
+// The Möbius transform of the packed table of `count` Uint1xN, in place.
+inline void moebius_packed(Uint1xN *table, int64_t count) {
+  assert(std::has_single_bit(uint64_t(count)));
+  for (int64_t i = 0; i < count; ++i) {
+    table[i] = moebius_packed(table[i]);
+  }
+  truth_table_internal::butterflies(
+      count, sizeof(Uint1xN),
+      [&](int64_t i, int64_t j) { table[j] = add(table[j], table[i]); });
+}
+
+template <Indices sizes>
+Vector<Uint1xN, sizes> moebius_packed(Vector<Uint1xN, sizes> f) {
+  moebius_packed(f.elems, f.flatSize);
+  return f;
+}
+
+// The Walsh spectrum of the packed table of `count` Uint1xN, W(a) being lane
+// a % Int64xN::elem_count of spectrum[a / Int64xN::elem_count]. spectrum
+// holds count * Uint1xN::elem_count / Int64xN::elem_count Int64xN.
+inline void walsh_packed(const Uint1xN *table, int64_t count,
+                         Int64xN *spectrum) {
+  assert(std::has_single_bit(uint64_t(count)));
+  constexpr int chunk = Int64xN::elem_count;
+  constexpr int chunks = Uint1xN::elem_count / chunk;
+  static_assert(8 % chunk == 0);
+  const std::vector<Int64xN> &chunk_spectra =
+      truth_table_internal::chunkSpectra();
+  for (int64_t i = 0; i < count; ++i) {
+    uint8_t bytes[sizeof(Uint1xN)];
+    store(bytes, table[i]);
+    for (int c = 0; c < chunks; ++c) {
+      int bits = bytes[c * chunk / 8] >> (c * chunk % 8) & ((1 << chunk) - 1);
+      spectrum[i * chunks + c] = chunk_spectra[bits];
+    }
+  }
+  truth_table_internal::butterflies(
+      count * chunks, sizeof(Int64xN), [&](int64_t i, int64_t j) {
+        Int64xN u = spectrum[i];
+        spectrum[i] = add(u, spectrum[j]);
+        spectrum[j] = sub(u, spectrum[j]);
+      });
+}
+
+template <Indices sizes>
+Vector<Int64xN, {product(sizes) * Uint1xN::elem_count / Int64xN::elem_count}>
+walsh_packed(const Vector<Uint1xN, sizes> &f) {
+  Vector<Int64xN,
+         {product(sizes) * Uint1xN::elem_count / Int64xN::elem_count}>
+      spectrum;
+  walsh_packed(f.elems, f.flatSize, spectrum.elems);
+  return spectrum;
+}
+
+// The algebraic degree of the packed function whose Möbius transform is
+// the `count` Uint1xN of anf, -1 for the zero function.
+inline int degree_packed(const Uint1xN *anf, int64_t count) {
+  constexpr int lane_vars = truth_table_internal::lane_vars;
+  // Lanes by the weight of their index.
+  Uint1xN weight_masks[lane_vars + 1];
+  for (int k = 0; k <= lane_vars; ++k) {
+    weight_masks[k] =
+        lane_mask([&](int l) { return std::popcount(unsigned(l)) == k; });
+  }
+  int degree = -1;
+  for (int64_t i = 0; i < count; ++i) {
+    int high = std::popcount(uint64_t(i));
+    for (int k = lane_vars; k >= 0 && high + k > degree; --k) {
+      if (!is_zero(mul(anf[i], weight_masks[k]))) {
+        degree = high + k;
+      }
+    }
+  }
+  return degree;
+}
+
+// The nonlinearity of the packed function of `count` * Int64xN::elem_count
+// inputs whose Walsh spectrum is `spectrum`.
+inline int64_t nonlinearity_packed(const Int64xN *spectrum, int64_t count) {
+  Int64xN m = Int64xN::cst(0);
+  for (int64_t i = 0; i < count; ++i) {
+    m = max(m, max(spectrum[i], sub(Int64xN::cst(0), spectrum[i])));
+  }
+  int64_t max_abs = 0;
+  for (int l = 0; l < Int64xN::elem_count; ++l) {
+    max_abs = std::max(max_abs, extract(m, l));
+  }
+  return (count * Int64xN::elem_count - max_abs) / 2;
+}
+
+// The Möbius transforms of the batched functions f.
+template <Indices sizes>
+Vector<Uint1xN, sizes> moebius(Vector<Uint1xN, sizes> f) {
+  static_assert(std::has_single_bit(unsigned(product(sizes))));
+  truth_table_internal::butterflies(
+      f.flatSize, sizeof(Uint1xN),
+      [&](int64_t i, int64_t j) { f.elems[j] = add(f.elems[j], f.elems[i]); });
+  return f;
+}
+
+// Bits of the two's complement Walsh coefficients of functions of `size`
+// inputs, which range from -size to size.
+constexpr int walsh_bits(int size) {
+  return std::countr_zero(unsigned(size)) + 2;
+}
+
+// The Walsh spectra of the batched functions f, W(a) being the bitsliced
+// two's complement integer of walsh_bits(size) bits at row a.
+template <Indices sizes>
+Vector<Uint1xN, {sizes[0], walsh_bits(sizes[0])}>
+walsh(const Vector<Uint1xN, sizes> &f) {
+  static_assert(sizes.size() == 1);
+  constexpr int size = sizes[0];
+  constexpr int bits = walsh_bits(size);
+  static_assert(std::has_single_bit(unsigned(size)));
+  Vector<Uint1xN, {size, bits}> spectrum;
+  // (-1)^f is 1, or -1, which is all ones.
+  for (int i = 0; i < size; ++i) {
+    spectrum.elems[i * bits] = Uint1xN::cst(1);
+    std::fill_n(spectrum.elems + i * bits + 1, bits - 1, f.elems[i]);
+  }
+  truth_table_internal::butterflies(
+      size, bits * sizeof(Uint1xN), [&](int64_t i, int64_t j) {
+        UintKxN<bits> u, v;
+        std::copy_n(spectrum.elems + i * bits, bits, u.elems);
+        std::copy_n(spectrum.elems + j * bits, bits, v.elems);
+        std::copy_n(sliced_add(u, v).elems, bits, spectrum.elems + i * bits);
+        std::copy_n(sliced_sub(u, v).elems, bits, spectrum.elems + j * bits);
+      });
+  return spectrum;
+}
+
+// Mask of the lanes whose function, with Möbius transform anf, has degree
+// at most d.
+template <Indices sizes>
+Uint1xN degree_at_most(const Vector<Uint1xN, sizes> &anf, int d) {
+  Uint1xN above = Uint1xN::cst(0);
+  for (int i = 0; i < anf.flatSize; ++i) {
+    if (std::popcount(unsigned(i)) > d) {
+      above = bit_or(above, anf.elems[i]);
+    }
+  }
+  return bit_not(above);
+}
+
+// Mask of the lanes whose function, with Walsh spectrum `spectrum` from
+// walsh(), has nonlinearity at least nl, i.e. |W(a)| <= size - 2 nl for all
+// a.
+template <Indices sizes>
+Uint1xN nonlinearity_at_least(const Vector<Uint1xN, sizes> &spectrum,
+                              int64_t nl) {
+  static_assert(sizes.size() == 2);
+  constexpr int size = sizes[0];
+  constexpr int bits = sizes[1];
+  static_assert(bits == walsh_bits(size));
+  int64_t bound = size - 2 * nl;
+  if (bound >= size) {
+    return Uint1xN::cst(1);
+  }
+  if (bound < 0) {
+    return Uint1xN::cst(0);
+  }
+  // W(a) + bound is within [0, 2 bound] as an unsigned integer, which
+  // negative values are not, as they are at least 2^(bits - 1) > 2 bound.
+  UintKxN<bits> offset = sliced_cst<bits>(bound);
+  UintKxN<bits> limit = sliced_cst<bits>(2 * bound);
+  Uint1xN beyond = Uint1xN::cst(0);
+  for (int a = 0; a < size; ++a) {
+    UintKxN<bits> w;
+    std::copy_n(spectrum.elems + a * bits, bits, w.elems);
+    beyond = bit_or(beyond, sliced_less(limit, sliced_add(w, offset)));
+  }
+  return bit_not(beyond);
+}
+
+#endif // HAY_TRUTH_TABLE_H_
@@ -0,0 +1,207 @@
+// Copyright 2024 The Hay Authors
+//
+// Licensed under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#include "testlib.h"
+#include "truth_table.h"
+
+#include <bit>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+// The textbook transforms, on one truth table of 0s and 1s.
+std::vector<int> referenceMoebius(std::vector<int> f) {
+  for (size_t h = 1; h < f.size(); h *= 2) {
+    for (size_t i = 0; i < f.size(); ++i) {
+      if (i & h) {
+        f[i] ^= f[i ^ h];
+      }
+    }
+  }
+  return f;
+}
+
+std::vector<int64_t> referenceWalsh(const std::vector<int> &f) {
+  std::vector<int64_t> w(f.size());
+  for (size_t a = 0; a < f.size(); ++a) {
+    for (size_t x = 0; x < f.size(); ++x) {
+      w[a] += (f[x] + std::popcount(a & x)) % 2 ? -1 : 1;
+    }
+  }
+  return w;
+}
+
+int referenceDegree(const std::vector<int> &anf) {
+  int degree = -1;
+  for (size_t i = 0; i < anf.size(); ++i) {
+    if (anf[i]) {
+      degree = std::max(degree, std::popcount(i));
+    }
+  }
+  return degree;
+}
+
+int64_t referenceNonlinearity(const std::vector<int64_t> &w) {
+  int64_t max_abs = 0;
+  for (int64_t c : w) {
+    max_abs = std::max(max_abs, std::abs(c));
+  }
+  return (static_cast<int64_t>(w.size()) - max_abs) / 2;
+}
+
+std::vector<int> unpack(const std::vector<Uint1xN> &table) {
+  std::vector<int> f;
+  for (Uint1xN x : table) {
+    for (int l = 0; l < Uint1xN::elem_count; ++l) {
+      f.push_back(extract(x, l));
+    }
+  }
+  return f;
+}
+
+std::vector<Uint1xN> pack(const std::vector<int> &f) {
+  std::vector<Uint1xN> table;
+  for (size_t i = 0; i < f.size(); i += Uint1xN::elem_count) {
+    table.push_back(lane_mask([&](int l) { return f[i + l]; }));
+  }
+  return table;
+}
+
+// Tables of an even number of variables, for bent functions.
+constexpr int packed_count = truth_table_internal::lane_vars % 2 ? 2 : 4;
+
+struct TestMoebiusPacked {
+  static void Run() {
+    std::minstd_rand0 engine;
+    for (int j = 0; j < truth_table_internal::lane_vars; ++j) {
+      // The table of x_j is the monomial x_j.
+      CHECK_EQ(moebius_packed(Uint1xN::seq(j)),
+               lane_mask([&](int l) { return l == (1 << j); }));
+    }
+    std::vector<Uint1xN> table(packed_count);
+    for (Uint1xN &x : table) {
+      x = getRandom<Uint1xN>(engine);
+    }
+    std::vector<Uint1xN> anf = table;
+    moebius_packed(anf.data(), packed_count);
+    CHECK(unpack(anf) == referenceMoebius(unpack(table)));
+    CHECK_EQ(degree_packed(anf.data(), packed_count),
+             referenceDegree(unpack(anf)));
+    moebius_packed(anf.data(), packed_count);
+    CHECK(unpack(anf) == unpack(table));
+    // The zero function, and a monomial of the high variables.
+    std::vector<Uint1xN> zero(packed_count, Uint1xN::cst(0));
+    CHECK_EQ(degree_packed(zero.data(), packed_count), -1);
+    zero.back() = lane_mask([](int l) { return l == 0; });
+    CHECK_EQ(degree_packed(zero.data(), packed_count),
+             std::popcount(unsigned{packed_count - 1}));
+    // Large tables, as a Vector.
+    using V = Vector<Uint1xN, {2, 128}>;
+    auto v = getRandom<V>(engine);
+    CHECK_EQ(moebius_packed(moebius_packed(v)), v);
+  }
+};
+
+struct TestWalshPacked {
+  static void Run() {
+    std::minstd_rand0 engine;
+    constexpr int size = packed_count * Uint1xN::elem_count;
+    constexpr int spectrum_count = size / Int64xN::elem_count;
+    std::vector<Uint1xN> table(packed_count);
+    for (Uint1xN &x : table) {
+      x = getRandom<Uint1xN>(engine);
+    }
+    std::vector<Int64xN> spectrum(spectrum_count);
+    walsh_packed(table.data(), packed_count, spectrum.data());
+    std::vector<int64_t> expected = referenceWalsh(unpack(table));
+    for (int a = 0; a < size; ++a) {
+      CHECK_EQ(extract(spectrum[a / Int64xN::elem_count],
+                       a % Int64xN::elem_count),
+               expected[a]);
+    }
+    CHECK_EQ(nonlinearity_packed(spectrum.data(), spectrum_count),
+             referenceNonlinearity(expected));
+    // x0 x1 + x2 x3 + ... is bent, with the largest nonlinearity.
+    int n = std::countr_zero(unsigned{size});
+    std::vector<int> bent(size);
+    for (int x = 0; x < size; ++x) {
+      for (int j = 0; j < n; j += 2) {
+        bent[x] ^= (x >> j) & (x >> (j + 1)) & 1;
+      }
+    }
+    walsh_packed(pack(bent).data(), packed_count, spectrum.data());
+    CHECK_EQ(nonlinearity_packed(spectrum.data(), spectrum_count),
+             (int64_t{1} << (n - 1)) - (int64_t{1} << (n / 2 - 1)));
+    // Affine functions, with none.
+    walsh_packed(pack(std::vector<int>(size, 1)).data(), packed_count,
+                 spectrum.data());
+    CHECK_EQ(nonlinearity_packed(spectrum.data(), spectrum_count), 0);
+  }
+};
+
+// Lane l of the batched functions.
+template <Indices sizes>
+std::vector<int> laneFunction(const Vector<Uint1xN, sizes> &f, int l) {
+  std::vector<int> table(f.flatSize);
+  for (int i = 0; i < f.flatSize; ++i) {
+    table[i] = extract(f.elems[i], l);
+  }
+  return table;
+}
+
+struct TestBatched {
+  static void Run() {
+    std::minstd_rand0 engine;
+    constexpr int size = 16;
+    constexpr int bits = walsh_bits(size);
+    using V = Vector<Uint1xN, {size}>;
+    V f = getRandom<V>(engine);
+    // Make lane 0 bent and lane 1 affine.
+    for (int x = 0; x < size; ++x) {
+      int bent = ((x & (x >> 1)) ^ ((x >> 2) & (x >> 3))) & 1;
+      int affine = ((x >> 1) ^ (x >> 3)) & 1;
+      f.elems[x] = select(lane_mask([](int l) { return l < 2; }),
+                          lane_mask([&](int l) { return l ? affine : bent; }),
+                          f.elems[x]);
+    }
+    V anf = moebius(f);
+    CHECK_EQ(moebius(anf), f);
+    auto spectrum = walsh(f);
+    static_assert(std::is_same_v<decltype(spectrum),
+                                 Vector<Uint1xN, {size, bits}>>);
+    for (int d = -1; d <= 4; ++d) {
+      Uint1xN low_degree = degree_at_most(anf, d);
+      for (int l = 0; l < Uint1xN::elem_count; ++l) {
+        CHECK_EQ(extract(low_degree, l),
+                 referenceDegree(laneFunction(anf, l)) <= d);
+      }
+    }
+    for (int nl = 0; nl <= 8; ++nl) {
+      Uint1xN nonlinear = nonlinearity_at_least(spectrum, nl);
+      CHECK_EQ(extract(nonlinear, 0), nl <= 6);
+      CHECK_EQ(extract(nonlinear, 1), nl == 0);
+      for (int l = 0; l < Uint1xN::elem_count; ++l) {
+        std::vector<int> g = laneFunction(f, l);
+        CHECK(laneFunction(anf, l) == referenceMoebius(g));
+        std::vector<int64_t> w = referenceWalsh(g);
+        CHECK_EQ(extract(nonlinear, l), referenceNonlinearity(w) >= nl);
+        for (int a = 0; a < size; ++a) {
+          UintKxN<bits> c;
+          std::copy_n(spectrum.elems + a * bits, bits, c.elems);
+          // Sign-extended.
+          int64_t value = extract_uint(c, l);
+          CHECK_EQ(value - (value >> (bits - 1) << bits), w[a]);
+        }
+      }
+    }
+  }
+};
+
+int main() {
+  TEST(TestMoebiusPacked);
+  TEST(TestWalshPacked);
+  TEST(TestBatched);
+}
@@ -90,11 +90,48 @@ template <> struct Int64EType<Uint1xN> {
   using Type = Int64xN;
 };
 
+// Vector::seq enumerates vectors whose elements take the values 0 to
+// seq_radix<EType> - 1: 2, unless EType declares another `radix`.
+template <typename EType> inline constexpr int seq_radix = 2;
+template <typename EType>
+  requires requires { EType::radix; }
+inline constexpr int seq_radix<EType> = EType::radix;
+
+// Number of leading elements of Vector::seq that vary across lanes, as the
+// base-radix digits of the lane index: the largest k with radix^k at most
+// elem_count. Lanes past radix^k repeat the first ones.
+template <typename EType> constexpr int seq_lane_digits() {
+  int k = 0;
+  for (int lanes = seq_radix<EType>; lanes <= EType::elem_count;
+       lanes *= seq_radix<EType>) {
+    ++k;
+  }
+  return k;
+}
+
 template <int order> inline constexpr int product(Indices<order> sizes) {
   return std::reduce(std::begin(sizes), std::end(sizes), Index{1},
                      std::multiplies<Index>());
 }
 
+// Number of chunks of Vector<Uint1xN, sizes>::seq covering all candidates.
+template <Indices sizes> constexpr int64_t seq_chunk_count() {
+  constexpr int lane_bits = seq_lane_digits<Uint1xN>();
+  constexpr int flat_size = product(sizes);
+  static_assert(flat_size < 63);
+  return flat_size > lane_bits ? int64_t{1} << (flat_size - lane_bits) : 1;
+}
+
+// Product of sizes[begin] to sizes[end - 1].
+template <int order>
+inline constexpr int product(Indices<order> sizes, int begin, int end) {
+  int p = 1;
+  for (int i = begin; i < end; ++i) {
+    p *= sizes[i];
+  }
+  return p;
+}
+
 template <int order>
 inline constexpr Indices<order> permute(Indices<order> src,
                                         Indices<order> permutation) {
@@ -289,8 +326,9 @@ public:
     return contract<0, 1>(x).elems[0];
   }
 
-  friend Vector<ScalarType, sizes> reduce_add(Vector x) {
-    Vector<ScalarType, sizes> result;
+  // Of the element type's reduce_add, which may be wider than ScalarType.
+  friend auto reduce_add(Vector x) {
+    Vector<decltype(reduce_add(x.elems[0])), sizes> result;
     for (int i = 0; i < flatSize; ++i) {
       result.elems[i] = reduce_add(x.elems[i]);
     }
@@ -306,14 +344,15 @@ public:
   }
 
   static Vector seq(int i) {
+    constexpr int radix = seq_radix<EType>;
     Vector result;
     int j = 0;
-    for (; (1 << j) < EType::elem_count && j < flatSize; ++j) {
+    for (; j < seq_lane_digits<EType>() && j < flatSize; ++j) {
       result.elems[j] = EType::seq(j);
     }
-    int k = 0;
-    for (; j < flatSize; ++j, ++k) {
-      result.elems[j] = EType::cst((i >> k) & 1);
+    for (; j < flatSize; ++j) {
+      result.elems[j] = EType::cst(i % radix);
+      i /= radix;
     }
     return result;
   }
@@ -329,32 +368,69 @@ public:
   EType elems[flatSize];
 };
 
-template <Index c1, Index c2, typename EType, Indices sizes1, Indices sizes2>
+// contract<c1, c2>(v1, v2), accumulating the products with
+// madd_op(acc, x, y) instead of madd, e.g. for a cheaper multiply that the
+// values allow.
+template <Index c1, Index c2, typename EType, Indices sizes1, Indices sizes2,
+          typename MaddOp>
 Vector<EType, concat(drop(sizes1, Indices{c1}), drop(sizes2, Indices{c2}))>
-contract(Vector<EType, sizes1> v1, Vector<EType, sizes2> v2) {
+contract_with(Vector<EType, sizes1> v1, Vector<EType, sizes2> v2,
+              MaddOp madd_op) {
   static_assert(sizes1[c1] == sizes2[c2]);
-  using Vector1 = Vector<EType, sizes1>;
-  using Vector2 = Vector<EType, sizes2>;
   using ResultVector = Vector<EType, concat(drop(sizes1, Indices{c1}),
                                             drop(sizes2, Indices{c2}))>;
-  using ResultIndices = ResultVector::IndicesType;
+  // v1 is laid out as [outer1, k, inner1], v2 as [outer2, k, inner2] and the
+  // result as [outer1, inner1, outer2, inner2], so each result element is a
+  // dot product along k, without index arithmetic in the inner loop.
+  constexpr int k_size = sizes1[c1];
+  constexpr int outer1 = product(sizes1, 0, c1);
+  constexpr int inner1 = product(sizes1, c1 + 1, sizes1.size());
+  constexpr int outer2 = product(sizes2, 0, c2);
+  constexpr int inner2 = product(sizes2, c2 + 1, sizes2.size());
   ResultVector r = ResultVector::cst(0);
-  for (int i1 = 0; i1 < Vector1::flatSize; ++i1) {
-    auto ind1 = Vector1::unflatten_index(i1);
-    for (int i2 = 0; i2 < Vector2::flatSize; ++i2) {
-      auto ind2 = Vector2::unflatten_index(i2);
-      if (ind1[c1] == ind2[c2]) {
-        ResultIndices dst_ind =
-            concat(drop(ind1, Indices{c1}), drop(ind2, Indices{c2}));
-        int dst_flat_idx = ResultVector::flatten_indices(dst_ind);
-        r.elems[dst_flat_idx] =
-            madd(r.elems[dst_flat_idx], v1.elems[i1], v2.elems[i2]);
+  int dst = 0;
+  for (int o1 = 0; o1 < outer1; ++o1) {
+    for (int i1 = 0; i1 < inner1; ++i1) {
+      for (int o2 = 0; o2 < outer2; ++o2) {
+        for (int i2 = 0; i2 < inner2; ++i2) {
+          for (int k = 0; k < k_size; ++k) {
+            r.elems[dst] =
+                madd_op(r.elems[dst], v1.elems[(o1 * k_size + k) * inner1 + i1],
+                        v2.elems[(o2 * k_size + k) * inner2 + i2]);
+          }
+          ++dst;
+        }
       }
     }
   }
   return r;
 }
 
+template <Index c1, Index c2, typename EType, Indices sizes1, Indices sizes2>
+Vector<EType, concat(drop(sizes1, Indices{c1}), drop(sizes2, Indices{c2}))>
+contract(Vector<EType, sizes1> v1, Vector<EType, sizes2> v2) {
+  return contract_with<c1, c2>(
+      v1, v2, [](EType x, EType y, EType z) { return madd(x, y, z); });
+}
+
+// contract<c1, c2>(v1, v2) over Int64xN, given that the lanes of v1 and v2
+// have magnitudes at most bound1 and bound2. Within the int32 range, the
+// products take madd_lo32, a 32x32->64-bit multiply-add, which is much
+// cheaper than a full 64-bit one. Sums wrap modulo 2^64 either way.
+template <Index c1, Index c2, int64_t bound1, int64_t bound2, Indices sizes1,
+          Indices sizes2>
+Vector<Int64xN, concat(drop(sizes1, Indices{c1}), drop(sizes2, Indices{c2}))>
+contract_bounded(Vector<Int64xN, sizes1> v1, Vector<Int64xN, sizes2> v2) {
+  static_assert(bound1 >= 0 && bound2 >= 0);
+  if constexpr (bound1 <= INT32_MAX && bound2 <= INT32_MAX) {
+    return contract_with<c1, c2>(v1, v2, [](Int64xN x, Int64xN y, Int64xN z) {
+      return madd_lo32(x, y, z);
+    });
+  } else {
+    return contract<c1, c2>(v1, v2);
+  }
+}
+
 template <typename EType, Indices sizes1, Indices sizes2>
 Vector<EType, {sizes1[0], sizes2[1]}> matmul(Vector<EType, sizes1> v1,
                                              Vector<EType, sizes2> v2) {
@@ -364,6 +440,15 @@ Vector<EType, {sizes1[0], sizes2[1]}> matmul(Vector<EType, sizes1> v1,
   return contract<1, 0>(v1, v2);
 }
 
+template <int64_t bound1, int64_t bound2, Indices sizes1, Indices sizes2>
+Vector<Int64xN, {sizes1[0], sizes2[1]}>
+matmul_bounded(Vector<Int64xN, sizes1> v1, Vector<Int64xN, sizes2> v2) {
+  static_assert(sizes1.size() == 2);
+  static_assert(sizes2.size() == 2);
+  static_assert(sizes1[1] == sizes2[0]);
+  return contract_bounded<1, 0, bound1, bound2>(v1, v2);
+}
+
 template <typename EType, Indices sizes>
 struct fmt::formatter<Vector<EType, sizes>> {
   using V = Vector<EType, sizes>;
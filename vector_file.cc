@@ -0,0 +1,291 @@
+// Copyright 2024 The Hay Authors
+//
+// Licensed under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#include "vector_file.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <fmt/format.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+int elemBits(VectorFileType type) {
+  switch (type) {
+  case VectorFileType::kUint1:
+    return 1;
+  case VectorFileType::kInt8:
+    return 8;
+  case VectorFileType::kInt16:
+    return 16;
+  case VectorFileType::kInt32:
+    return 32;
+  case VectorFileType::kInt64:
+  case VectorFileType::kPoly64:
+    return 64;
+  }
+  return 0;
+}
+
+std::string shapeString(const VectorFileHeader &header) {
+  std::string s = "[";
+  for (uint32_t i = 0; i < header.order; ++i) {
+    s += fmt::format("{}{}", i ? ", " : "", header.sizes[i]);
+  }
+  return s + "]";
+}
+
+// Whether the header is one that this version writes, up to counts, for a
+// file of file_bytes. The fields are untrusted, so products are bounded by
+// divisions first: a size that overflowed could pass and let views read past
+// the mapping.
+bool isValid(const VectorFileHeader &header, int64_t file_bytes) {
+  if (elemBits(header.type) == 0 ||
+      header.elem_bits != uint32_t(elemBits(header.type)) ||
+      header.lane_count == 0 ||
+      int64_t{header.lane_count} * header.elem_bits % 8 != 0 ||
+      header.order > VectorFileHeader::max_order) {
+    return false;
+  }
+  // Records are at most the file size, so the flat size is too.
+  int64_t flat_size = 1;
+  for (uint32_t i = 0; i < header.order; ++i) {
+    if (header.sizes[i] <= 0 || header.sizes[i] > file_bytes / flat_size) {
+      return false;
+    }
+    flat_size *= header.sizes[i];
+  }
+  int64_t elem_bytes = header.elem_bytes();
+  if (header.record_bytes <= 0 || header.record_bytes % elem_bytes != 0 ||
+      header.record_bytes / elem_bytes != flat_size ||
+      header.payload_offset < int64_t{sizeof(VectorFileHeader)} ||
+      header.payload_offset % 64 != 0 ||
+      header.payload_offset > file_bytes || header.record_count < 0 ||
+      header.lane_total < 0) {
+    return false;
+  }
+  if (header.record_count >
+      (file_bytes - header.payload_offset) / header.record_bytes) {
+    return false;
+  }
+  // lane_total <= record_count * lane_count, rounding the records up.
+  int64_t lane_records = header.lane_total / header.lane_count +
+                         (header.lane_total % header.lane_count != 0);
+  return lane_records <= header.record_count;
+}
+
+} // namespace
+
+const char *vectorFileTypeName(VectorFileType type) {
+  switch (type) {
+  case VectorFileType::kUint1:
+    return "Uint1xN";
+  case VectorFileType::kInt8:
+    return "Int8xN";
+  case VectorFileType::kInt16:
+    return "Int16xN";
+  case VectorFileType::kInt32:
+    return "Int32xN";
+  case VectorFileType::kInt64:
+    return "Int64xN";
+  case VectorFileType::kPoly64:
+    return "Poly64xN";
+  }
+  return "unknown";
+}
+
+int64_t VectorFileHeader::flat_size() const {
+  int64_t size = 1;
+  for (uint32_t i = 0; i < order; ++i) {
+    size *= sizes[i];
+  }
+  return size;
+}
+
+void vector_file_internal::copyLanes(const uint8_t *src, int64_t src_lane,
+                                     uint8_t *dst, int64_t dst_lane,
+                                     int64_t n, int lane_bits) {
+  int64_t src_bit = src_lane * lane_bits;
+  int64_t dst_bit = dst_lane * lane_bits;
+  int64_t bits = n * lane_bits;
+  if ((src_bit | dst_bit | bits) % 8 == 0) {
+    memcpy(dst + dst_bit / 8, src + src_bit / 8, bits / 8);
+    return;
+  }
+  for (int64_t k = 0; k < bits; ++k) {
+    int64_t s = src_bit + k;
+    int64_t d = dst_bit + k;
+    uint8_t bit = (src[s / 8] >> (s % 8)) & 1;
+    dst[d / 8] = (dst[d / 8] & ~(1 << (d % 8))) | bit << (d % 8);
+  }
+}
+
+VectorFileWriter::VectorFileWriter(std::string path,
+                                   const VectorFileHeader &layout)
+    : path(std::move(path)), header(layout) {
+  header.record_count = 0;
+  header.lane_total = 0;
+  staged.assign(header.record_bytes, 0);
+  tmp_path = fmt::format("{}.{}.tmp", this->path, getpid());
+  file = fopen(tmp_path.c_str(), "wb");
+  if (!file) {
+    fmt::print(stderr, "VectorFileWriter: could not open {}: {}\n", tmp_path,
+               strerror(errno));
+    failed = true;
+    return;
+  }
+  // The header goes in last, once the counts are known.
+  std::vector<uint8_t> zeros(header.payload_offset, 0);
+  if (fwrite(zeros.data(), zeros.size(), 1, file) != 1) {
+    failed = true;
+  }
+}
+
+VectorFileWriter::~VectorFileWriter() {
+  if (file) {
+    fclose(file);
+    remove(tmp_path.c_str());
+  }
+}
+
+void VectorFileWriter::writeRecord(const void *record) {
+  if (file && fwrite(record, header.record_bytes, 1, file) != 1) {
+    failed = true;
+  }
+  ++header.record_count;
+}
+
+void VectorFileWriter::flushStaged() {
+  if (staged_lanes == 0) {
+    return;
+  }
+  writeRecord(staged.data());
+  std::fill(staged.begin(), staged.end(), 0);
+  staged_lanes = 0;
+}
+
+bool VectorFileWriter::finish() {
+  if (!file) {
+    return false;
+  }
+  flushStaged();
+  if (fseek(file, 0, SEEK_SET) != 0 ||
+      fwrite(&header, sizeof header, 1, file) != 1) {
+    failed = true;
+  }
+  if (fclose(file) != 0) {
+    failed = true;
+  }
+  file = nullptr;
+  if (failed) {
+    fmt::print(stderr, "VectorFileWriter: could not write {}: {}\n",
+               tmp_path, strerror(errno));
+    remove(tmp_path.c_str());
+    return false;
+  }
+  if (rename(tmp_path.c_str(), path.c_str()) != 0) {
+    fmt::print(stderr, "VectorFileWriter: could not rename {} to {}: {}\n",
+               tmp_path, path, strerror(errno));
+    remove(tmp_path.c_str());
+    return false;
+  }
+  return true;
+}
+
+VectorFile::~VectorFile() {
+  if (mapped) {
+    munmap(mapped, mapped_bytes);
+  }
+}
+
+bool VectorFile::open(const std::string &path) {
+  if (mapped) {
+    munmap(mapped, mapped_bytes);
+    mapped = nullptr;
+    mapped_header = nullptr;
+  }
+  this->path = path;
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    fmt::print(stderr, "VectorFile: could not open {}: {}\n", path,
+               strerror(errno));
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    fmt::print(stderr, "VectorFile: could not stat {}: {}\n", path,
+               strerror(errno));
+    close(fd);
+    return false;
+  }
+  if (st.st_size < int64_t{sizeof(VectorFileHeader)}) {
+    fmt::print(stderr, "VectorFile: {} is not a vector file\n", path);
+    close(fd);
+    return false;
+  }
+  void *ptr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (ptr == MAP_FAILED) {
+    fmt::print(stderr, "VectorFile: could not map {}: {}\n", path,
+               strerror(errno));
+    return false;
+  }
+  const auto *header = static_cast<const VectorFileHeader *>(ptr);
+  const char *error = nullptr;
+  if (memcmp(header->magic, VectorFileHeader::expected_magic, 8) != 0) {
+    error = "is not a vector file";
+  } else if (header->version != VectorFileHeader::current_version) {
+    error = "has an unsupported version";
+  } else if (!isValid(*header, st.st_size)) {
+    error = "has an invalid header or is truncated";
+  }
+  if (error) {
+    fmt::print(stderr, "VectorFile: {} {}\n", path, error);
+    munmap(ptr, st.st_size);
+    return false;
+  }
+  mapped = ptr;
+  mapped_bytes = st.st_size;
+  mapped_header = header;
+  return true;
+}
+
+void VectorFile::reslice(int lane_count, uint8_t *records,
+                         int64_t record_count) const {
+  const VectorFileHeader &h = header();
+  int64_t elem_bytes = int64_t{lane_count} * h.elem_bits / 8;
+  int64_t record_bytes = h.flat_size() * elem_bytes;
+  memset(records, 0, record_count * record_bytes);
+  for (int64_t r = 0; r < record_count; ++r) {
+    int64_t begin = r * lane_count;
+    int64_t end = std::min(begin + lane_count, h.lane_total);
+    // Runs of lanes within one record of the file.
+    for (int64_t g = begin; g < end;) {
+      int64_t file_record = g / h.lane_count;
+      int64_t lane = g % h.lane_count;
+      int64_t n = std::min<int64_t>(h.lane_count - lane, end - g);
+      const uint8_t *src = payload() + file_record * h.record_bytes;
+      uint8_t *dst = records + r * record_bytes;
+      for (int64_t i = 0; i < h.flat_size(); ++i) {
+        vector_file_internal::copyLanes(src + i * h.elem_bytes(), lane,
+                                        dst + i * elem_bytes, g - begin, n,
+                                        h.elem_bits);
+      }
+      g += n;
+    }
+  }
+}
+
+void VectorFile::reportMismatch(const VectorFileHeader &wanted) const {
+  fmt::print(stderr,
+             "VectorFile: {} holds {} of shape {}, not {} of shape {}\n", path,
+             vectorFileTypeName(header().type), shapeString(header()),
+             vectorFileTypeName(wanted.type), shapeString(wanted));
+}
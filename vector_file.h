@@ -0,0 +1,266 @@
+// Copyright 2024 The Hay Authors
+//
+// Licensed under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#ifndef HAY_VECTOR_FILE_H_
+#define HAY_VECTOR_FILE_H_
+
+#include "simd.h"
+#include "vector.h"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <span>
+#include <string>
+#include <vector>
+
+// Binary files of Vectors of one element type and shape, e.g. search results.
+//
+// A file is a VectorFileHeader followed, at the 64-byte aligned
+// payload_offset, by record_count records. A record is a Vector as stored by
+// the writer's SIMD backend: its flat elements in order, each element holding
+// lane_count lanes of elem_bits bits as `store` lays them out, i.e. lane l of
+// a Uint1xN at bit l % 8 of byte l / 8. All integers are little-endian.
+//
+// Lanes are numbered across records, lane l of record r being lane
+// r * lane_count + l of the file, and only the first lane_total of them are
+// meaningful. Readers whose backend has the same lane count map the records
+// directly as Vectors; others re-slice the lanes into records of their own
+// lane count on load.
+
+enum class VectorFileType : uint32_t {
+  kUint1 = 1,
+  kInt8,
+  kInt16,
+  kInt32,
+  kInt64,
+  kPoly64,
+};
+
+template <typename EType> struct VectorFileTypeImpl;
+template <> struct VectorFileTypeImpl<Uint1xN> {
+  static constexpr VectorFileType value = VectorFileType::kUint1;
+};
+template <> struct VectorFileTypeImpl<Int8xN> {
+  static constexpr VectorFileType value = VectorFileType::kInt8;
+};
+template <> struct VectorFileTypeImpl<Int16xN> {
+  static constexpr VectorFileType value = VectorFileType::kInt16;
+};
+template <> struct VectorFileTypeImpl<Int32xN> {
+  static constexpr VectorFileType value = VectorFileType::kInt32;
+};
+template <> struct VectorFileTypeImpl<Int64xN> {
+  static constexpr VectorFileType value = VectorFileType::kInt64;
+};
+template <> struct VectorFileTypeImpl<Poly64xN> {
+  static constexpr VectorFileType value = VectorFileType::kPoly64;
+};
+template <typename EType>
+inline constexpr VectorFileType vector_file_type =
+    VectorFileTypeImpl<EType>::value;
+
+const char *vectorFileTypeName(VectorFileType type);
+
+struct VectorFileHeader {
+  static constexpr char expected_magic[8] = {'H', 'A', 'Y', 'V',
+                                             'E', 'C', 'T', 'R'};
+  static constexpr uint32_t current_version = 1;
+  static constexpr int max_order = 8;
+
+  char magic[8] = {};
+  uint32_t version = 0;
+  VectorFileType type = {};
+  uint32_t elem_bits = 0;
+  uint32_t lane_count = 0;
+  uint32_t order = 0;
+  uint32_t reserved = 0;
+  int32_t sizes[max_order] = {};
+  int64_t record_count = 0;
+  int64_t lane_total = 0;
+  int64_t record_bytes = 0;
+  int64_t payload_offset = 0;
+  uint8_t padding[32] = {};
+
+  int64_t flat_size() const;
+  int64_t elem_bytes() const { return int64_t{lane_count} * elem_bits / 8; }
+  // Whether records are Vector<EType, sizes>, in any lane count.
+  template <typename EType, Indices sizes> bool holds() const {
+    if (type != vector_file_type<EType> || order != sizes.size()) {
+      return false;
+    }
+    for (size_t i = 0; i < sizes.size(); ++i) {
+      if (this->sizes[i] != sizes[i]) {
+        return false;
+      }
+    }
+    return true;
+  }
+};
+static_assert(sizeof(VectorFileHeader) == 128);
+static_assert(std::endian::native == std::endian::little);
+
+// The header of files of Vector<EType, sizes> on this backend, without
+// counts.
+template <typename EType, Indices sizes>
+VectorFileHeader vectorFileHeader() {
+  static_assert(sizes.size() <= VectorFileHeader::max_order);
+  // Elements are their stored lanes, so that records map as Vectors.
+  static_assert(sizeof(EType) * 8 == EType::elem_count * EType::elem_bits);
+  static_assert(sizeof(Vector<EType, sizes>) ==
+                product(sizes) * sizeof(EType));
+  VectorFileHeader header;
+  std::copy_n(VectorFileHeader::expected_magic, 8, header.magic);
+  header.version = VectorFileHeader::current_version;
+  header.type = vector_file_type<EType>;
+  header.elem_bits = EType::elem_bits;
+  header.lane_count = EType::elem_count;
+  header.order = sizes.size();
+  for (size_t i = 0; i < sizes.size(); ++i) {
+    header.sizes[i] = sizes[i];
+  }
+  header.record_bytes = sizeof(Vector<EType, sizes>);
+  header.payload_offset = sizeof(VectorFileHeader);
+  return header;
+}
+
+namespace vector_file_internal {
+
+// Copies n lanes of lane_bits bits from lane src_lane of src to lane dst_lane
+// of dst.
+void copyLanes(const uint8_t *src, int64_t src_lane, uint8_t *dst,
+               int64_t dst_lane, int64_t n, int lane_bits);
+
+} // namespace vector_file_internal
+
+// Writes a vector file to a temporary file beside `path`, which finish()
+// renames to it, so that readers never see a partial file.
+class VectorFileWriter {
+public:
+  // Failures are reported by finish().
+  VectorFileWriter(std::string path, const VectorFileHeader &layout);
+  ~VectorFileWriter();
+  VectorFileWriter(const VectorFileWriter &) = delete;
+  VectorFileWriter &operator=(const VectorFileWriter &) = delete;
+
+  // Appends all the lanes of v, after padding any partial record.
+  template <typename EType, Indices sizes>
+  void write(const Vector<EType, sizes> &v) {
+    assert((header.holds<EType, sizes>()));
+    flushStaged();
+    writeRecord(&v);
+    header.lane_total = header.record_count * header.lane_count;
+  }
+
+  // Appends lane l of v, e.g. one solution among those of a search.
+  template <typename EType, Indices sizes>
+  void writeLane(const Vector<EType, sizes> &v, int l) {
+    assert((header.holds<EType, sizes>()));
+    for (int i = 0; i < v.flatSize; ++i) {
+      vector_file_internal::copyLanes(
+          reinterpret_cast<const uint8_t *>(&v.elems[i]), l,
+          staged.data() + i * header.elem_bytes(), staged_lanes, 1,
+          header.elem_bits);
+    }
+    ++header.lane_total;
+    if (++staged_lanes == int(header.lane_count)) {
+      flushStaged();
+    }
+  }
+
+  int64_t lanes() const { return header.lane_total; }
+
+  // Writes the header and replaces the file at `path`. Returns false, with a
+  // message on stderr, on failure.
+  bool finish();
+
+private:
+  void writeRecord(const void *record);
+  void flushStaged();
+
+  std::string path;
+  std::string tmp_path;
+  VectorFileHeader header;
+  FILE *file = nullptr;
+  bool failed = false;
+  // The partial record of writeLane.
+  std::vector<uint8_t> staged;
+  int staged_lanes = 0;
+};
+
+// Writes the `count` Vectors at `vectors` to a vector file. Returns false,
+// with a message on stderr, on failure.
+template <typename EType, Indices sizes>
+bool writeVectorFile(const std::string &path,
+                     const Vector<EType, sizes> *vectors, int64_t count) {
+  VectorFileWriter writer(path, vectorFileHeader<EType, sizes>());
+  for (int64_t i = 0; i < count; ++i) {
+    writer.write(vectors[i]);
+  }
+  return writer.finish();
+}
+
+// A vector file mmap'ed read-only.
+class VectorFile {
+public:
+  VectorFile() = default;
+  ~VectorFile();
+  VectorFile(const VectorFile &) = delete;
+  VectorFile &operator=(const VectorFile &) = delete;
+
+  // Maps the file at `path`. Returns false, with a message on stderr, if it
+  // cannot be read or is not a valid vector file.
+  bool open(const std::string &path);
+
+  const VectorFileHeader &header() const { return *mapped_header; }
+  int64_t lanes() const { return header().lane_total; }
+
+  // The records, in place, if they are Vector<EType, sizes> of this
+  // backend's lane count, and else none.
+  template <typename EType, Indices sizes>
+  std::span<const Vector<EType, sizes>> view() const {
+    if (!header().template holds<EType, sizes>() ||
+        header().lane_count != EType::elem_count) {
+      return {};
+    }
+    return {reinterpret_cast<const Vector<EType, sizes> *>(payload()),
+            static_cast<size_t>(header().record_count)};
+  }
+
+  // The lanes re-sliced into Vectors of this backend's lane count, the last
+  // one padded with zero lanes, or none, with a message on stderr, if the
+  // records are not Vector<EType, sizes>.
+  template <typename EType, Indices sizes>
+  std::vector<Vector<EType, sizes>> load() const {
+    using V = Vector<EType, sizes>;
+    if (!header().template holds<EType, sizes>()) {
+      reportMismatch(vectorFileHeader<EType, sizes>());
+      return {};
+    }
+    constexpr int lane_count = EType::elem_count;
+    std::vector<V> vectors((lanes() + lane_count - 1) / lane_count);
+    reslice(lane_count, reinterpret_cast<uint8_t *>(vectors.data()),
+            vectors.size());
+    return vectors;
+  }
+
+private:
+  const uint8_t *payload() const {
+    return static_cast<const uint8_t *>(mapped) + header().payload_offset;
+  }
+  void reslice(int lane_count, uint8_t *records, int64_t record_count) const;
+  void reportMismatch(const VectorFileHeader &wanted) const;
+
+  std::string path;
+  void *mapped = nullptr;
+  size_t mapped_bytes = 0;
+  const VectorFileHeader *mapped_header = nullptr;
+};
+
+#endif // HAY_VECTOR_FILE_H_
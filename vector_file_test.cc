@@ -0,0 +1,175 @@
+// Copyright 2024 The Hay Authors
+//
+// Licensed under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+
+#include "testlib.h"
+#include "vector_file.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+static std::string tempPath() {
+  char path[] = "/tmp/vector_file_test_XXXXXX";
+  int fd = mkstemp(path);
+  CHECK(fd >= 0);
+  close(fd);
+  return path;
+}
+
+template <typename EType, Indices sizes>
+std::vector<Vector<EType, sizes>> randomVectors(int count) {
+  std::minstd_rand0 engine;
+  std::vector<Vector<EType, sizes>> vectors;
+  for (int i = 0; i < count; ++i) {
+    vectors.push_back(getRandom<Vector<EType, sizes>>(engine));
+  }
+  return vectors;
+}
+
+template <typename EType, Indices sizes>
+bool sameLane(const Vector<EType, sizes> &x, int lx,
+              const Vector<EType, sizes> &y, int ly) {
+  for (int i = 0; i < x.flatSize; ++i) {
+    if (extract(x.elems[i], lx) != extract(y.elems[i], ly)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+template <typename EType, Indices sizes> void checkRoundTrip() {
+  std::string path = tempPath();
+  auto vectors = randomVectors<EType, sizes>(3);
+  CHECK(writeVectorFile(path, vectors.data(), vectors.size()));
+  VectorFile file;
+  CHECK(file.open(path));
+  CHECK_EQ(file.header().record_count, 3);
+  CHECK_EQ(file.lanes(), 3 * EType::elem_count);
+  auto view = file.view<EType, sizes>();
+  CHECK_EQ(view.size(), size_t{3});
+  CHECK_EQ(reinterpret_cast<uintptr_t>(view.data()) % 64, uintptr_t{0});
+  auto loaded = file.load<EType, sizes>();
+  CHECK_EQ(loaded.size(), size_t{3});
+  for (int i = 0; i < 3; ++i) {
+    CHECK_EQ(view[i], vectors[i]);
+    CHECK_EQ(loaded[i], vectors[i]);
+  }
+  unlink(path.c_str());
+}
+
+struct TestVectorFileRoundTrip {
+  static void Run() {
+    checkRoundTrip<Uint1xN, {3, 5}>();
+    checkRoundTrip<Int64xN, {4}>();
+    checkRoundTrip<Int16xN, {2, 2}>();
+    checkRoundTrip<Poly64xN, {2}>();
+  }
+};
+
+// Writes all but the last lane of some vectors as a backend with file_lanes
+// lanes would, and loads them back.
+template <typename EType, Indices sizes> void checkReslice(int file_lanes) {
+  using V = Vector<EType, sizes>;
+  constexpr int lane_count = EType::elem_count;
+  std::string path = tempPath();
+  auto vectors = randomVectors<EType, sizes>(3);
+  int total = 3 * lane_count - 1;
+  VectorFileHeader layout = vectorFileHeader<EType, sizes>();
+  layout.lane_count = file_lanes;
+  layout.record_bytes = V::flatSize * layout.elem_bytes();
+  {
+    VectorFileWriter writer(path, layout);
+    for (int k = 0; k < total; ++k) {
+      writer.writeLane(vectors[k / lane_count], k % lane_count);
+    }
+    CHECK_EQ(writer.lanes(), total);
+    CHECK(writer.finish());
+  }
+  VectorFile file;
+  CHECK(file.open(path));
+  CHECK_EQ(file.lanes(), total);
+  CHECK_EQ(file.header().record_count,
+           (total + file_lanes - 1) / file_lanes);
+  CHECK_EQ((file.view<EType, sizes>().empty()), file_lanes != lane_count);
+  auto loaded = file.load<EType, sizes>();
+  CHECK_EQ(loaded.size(), size_t((total + lane_count - 1) / lane_count));
+  for (int k = 0; k < total; ++k) {
+    CHECK(sameLane(loaded[k / lane_count], k % lane_count,
+                   vectors[k / lane_count], k % lane_count));
+  }
+  if (lane_count > 1) {
+    CHECK(sameLane(loaded[2], lane_count - 1, V::cst(0), 0));
+  }
+  unlink(path.c_str());
+}
+
+struct TestVectorFileReslice {
+  static void Run() {
+    constexpr int n = Uint1xN::elem_count;
+    for (int file_lanes : {8, 24, n / 2, n, 2 * n, 3 * n + 8}) {
+      checkReslice<Uint1xN, {2, 3}>(file_lanes);
+    }
+    constexpr int n64 = Int64xN::elem_count;
+    for (int file_lanes : {1, 3, n64, 2 * n64}) {
+      checkReslice<Int64xN, {3}>(file_lanes);
+    }
+    checkReslice<Int8xN, {5}>(5);
+  }
+};
+
+struct TestVectorFileErrors {
+  static void Run() {
+    VectorFile file;
+    CHECK(!file.open("/nonexistent/vector_file"));
+    std::string path = tempPath();
+    // Too short, then not a vector file.
+    CHECK(!file.open(path));
+    FILE *f = fopen(path.c_str(), "wb");
+    for (int i = 0; i < 256; ++i) {
+      fputc(i, f);
+    }
+    fclose(f);
+    CHECK(!file.open(path));
+    // Truncated.
+    auto vectors = randomVectors<Uint1xN, {4}>(2);
+    CHECK(writeVectorFile(path, vectors.data(), vectors.size()));
+    CHECK(file.open(path));
+    CHECK_EQ(truncate(path.c_str(),
+                      sizeof(VectorFileHeader) + sizeof(vectors[0])),
+             0);
+    CHECK(!file.open(path));
+    // Counts whose byte size overflows to within the file.
+    CHECK(writeVectorFile(path, vectors.data(), vectors.size()));
+    VectorFileHeader header;
+    f = fopen(path.c_str(), "r+b");
+    CHECK_EQ(fread(&header, sizeof header, 1, f), size_t{1});
+    header.record_count = ~uint64_t{0} / header.record_bytes + 1;
+    header.lane_total = 0;
+    CHECK_EQ(uint64_t(header.record_count) * uint64_t(header.record_bytes),
+             uint64_t{0});
+    fseek(f, 0, SEEK_SET);
+    CHECK_EQ(fwrite(&header, sizeof header, 1, f), size_t{1});
+    fclose(f);
+    CHECK(!file.open(path));
+    // Another type or shape.
+    CHECK(writeVectorFile(path, vectors.data(), vectors.size()));
+    CHECK(file.open(path));
+    CHECK((file.view<Uint1xN, {2, 2}>().empty()));
+    CHECK((file.load<Uint1xN, {5}>().empty()));
+    CHECK((file.load<Int64xN, {4}>().empty()));
+    CHECK_EQ((file.load<Uint1xN, {4}>().size()), size_t{2});
+    unlink(path.c_str());
+  }
+};
+
+int main() {
+  TEST(TestVectorFileRoundTrip);
+  TEST(TestVectorFileReslice);
+  TEST(TestVectorFileErrors);
+}
@@ -115,6 +115,21 @@ struct TestVectorInt64xNArithmetic {
   }
 };
 
+struct TestVectorInt8xNArithmetic {
+  static void Run() {
+    using V = Vector<Int8xN, {2, 3}>;
+    std::minstd_rand0 engine;
+    V x = getRandom<V>(engine);
+    V y = getRandom<V>(engine);
+    Vector<int64_t, {2, 3}> rx = reduce_add(x);
+    for (int i = 0; i < V::flatSize; ++i) {
+      CHECK_EQ(max(x, y).elems[i], max(x.elems[i], y.elems[i]));
+      CHECK_EQ(add(x, y).elems[i], add(x.elems[i], y.elems[i]));
+      CHECK_EQ(rx.elems[i], reduce_add(x.elems[i]));
+    }
+  }
+};
+
 struct TestVectorUint1xNArithmetic {
   using E = Uint1xN;
   template <Indices sizes> static void Run() {
@@ -337,11 +352,68 @@ struct TestVectorUint1xNContractBinary {
   }
 };
 
+struct TestVectorInt64xNContractBinary {
+  static void Run() {
+    using E = Int64xN;
+    using V234 = Vector<E, {2, 3, 4}>;
+    using V43 = Vector<E, {4, 3}>;
+    std::minstd_rand0 engine;
+    V234 x = getRandom<V234>(engine);
+    V43 y = getRandom<V43>(engine);
+    Vector<E, {2, 4, 4}> r = contract<1, 1>(x, y);
+    for (int a = 0; a < 2; ++a) {
+      for (int b = 0; b < 4; ++b) {
+        for (int c = 0; c < 4; ++c) {
+          E expected = E::cst(0);
+          for (int k = 0; k < 3; ++k) {
+            expected = add(expected, mul(x.elems[(a * 3 + k) * 4 + b],
+                                         y.elems[c * 3 + k]));
+          }
+          CHECK_EQ(r.elems[(a * 4 + b) * 4 + c], expected);
+        }
+      }
+    }
+    // Random lanes are in the int32 range.
+    CHECK_EQ((contract_bounded<1, 1, INT32_MAX, INT32_MAX>(x, y)), r);
+    CHECK_EQ((contract_bounded<1, 1, INT64_MAX, 1>(x, y)), r);
+    using V32 = Vector<E, {3, 2}>;
+    using V24 = Vector<E, {2, 4}>;
+    V32 p = getRandom<V32>(engine);
+    V24 q = getRandom<V24>(engine);
+    CHECK_EQ((matmul_bounded<INT32_MAX, INT32_MAX>(p, q)), matmul(p, q));
+    CHECK_EQ(matmul(p, q), (contract<1, 0>(p, q)));
+    CHECK_EQ(matmul(p, q).elems[5],
+             add(mul(p.elems[2], q.elems[1]), mul(p.elems[3], q.elems[5])));
+  }
+};
+
+struct TestVectorPoly64xNContractBinary {
+  static void Run() {
+    using E = Poly64xN;
+    using V23 = Vector<E, {2, 3}>;
+    using V32 = Vector<E, {3, 2}>;
+    std::minstd_rand0 engine;
+    V23 x = getRandom<V23>(engine);
+    V32 y = getRandom<V32>(engine);
+    Vector<E, {2, 2}> matmul_result = matmul(x, y);
+    for (int i = 0; i < 2; ++i) {
+      for (int j = 0; j < 2; ++j) {
+        E expected = E::cst(0);
+        for (int k = 0; k < 3; ++k) {
+          expected = add(expected, mul(x.elems[3 * i + k], y.elems[2 * k + j]));
+        }
+        CHECK_EQ(matmul_result.elems[2 * i + j], expected);
+      }
+    }
+  }
+};
+
 int main() {
   TEST(TestVectorUint1xNLayout);
   TEST(TestVectorInt64xNLoadStore);
   TEST(TestVectorUint1xNLoadStore);
   TEST(TestVectorInt64xNArithmetic);
+  TEST(TestVectorInt8xNArithmetic);
   TEST(TestVectorUint1xNArithmetic);
   TEST(TestVectorUint1xNRow);
   TEST(TestVectorUint1xNReshape);
@@ -351,4 +423,6 @@ int main() {
   TEST(TestVectorUint1xNBits);
   TEST(TestVectorUint1xNContractUnary);
   TEST(TestVectorUint1xNContractBinary);
+  TEST(TestVectorInt64xNContractBinary);
+  TEST(TestVectorPoly64xNContractBinary);
 }
\ No newline at end of file